@@ -11,7 +11,8 @@ LOCAL_CPP_FEATURES := exceptions
 LOCAL_LDLIBS     := -llog
 LOCAL_SRC_FILES := src/opnmidi.cpp src/Ym2612_ChipEmu.cpp \
                    src/opnmidi_load.cpp src/opnmidi_midiplay.cpp \
-                   src/opnmidi_opn2.cpp src/opnmidi_private.cpp \
+                   src/opnmidi_opn2.cpp src/opnmidi_perf.cpp src/opnmidi_private.cpp \
+                   src/opnmidi_chipgroups.cpp src/opnmidi_renderahead.cpp \
                    src/opnmidi_xmi2mid.c src/opnmidi_mus2mid.c
 
 include $(BUILD_SHARED_LIBRARY)
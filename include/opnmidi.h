@@ -57,6 +57,15 @@ typedef char            OPN2_SInt8;
 typedef short           OPN2_SInt16;
 #endif
 
+#if (defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L)) || defined(__cplusplus)
+#include <stdint.h>
+typedef uint64_t        OPN2_UInt64;
+#elif defined(_MSC_VER)
+typedef unsigned __int64 OPN2_UInt64;
+#else
+typedef unsigned long long OPN2_UInt64;
+#endif
+
 
 /* == Deprecated function markers == */
 
@@ -141,10 +150,19 @@ enum OPNMIDI_ChannelAlloc
     OPNMIDI_ChanAlloc_SameInst,
     /*! Take any first released channel */
     OPNMIDI_ChanAlloc_AnyReleased,
-    /*! Count of available channel allocation modes */
+    /*! Like OffDelay, but steal playing notes which will be released soonest (uses durations known by the sequencer) */
+    OPNMIDI_ChanAlloc_LookAhead,
+    /*! Count of available channel allocation modes (new modes are appended before it, up to OPNMIDI_VOICE_STATS_ALLOC_MODES) */
     OPNMIDI_ChanAlloc_Count
 };
 
+/*!
+ * \brief Fixed count of entries in the OPN2_VoiceStats::releaseReuses array
+ *
+ * Keeps the layout of OPN2_VoiceStats when allocation modes get added
+ */
+#define OPNMIDI_VOICE_STATS_ALLOC_MODES 8
+
 /**
  * @brief Sound output format
  */
@@ -201,6 +219,8 @@ struct OPN2_MIDIPlayer
 
 /**
  * @brief Sets number of emulated chips (from 1 to 100). Emulation of multiple chips extends polyphony limits
+ *
+ * Disables the automatic choice of the number of chips enabled by opn2_setAutoNumChips().
  * @param device Instance of the library
  * @param numChips Count of virtual chips to emulate
  * @return 0 on success, <0 when any error has occurred
@@ -221,6 +241,51 @@ extern OPNMIDI_DECLSPEC int  opn2_getNumChips(struct OPN2_MIDIPlayer *device);
  */
 extern OPNMIDI_DECLSPEC int opn2_getNumChipsObtained(struct OPN2_MIDIPlayer *device);
 
+/**
+ * @brief Choose the number of emulated chips by the polyphony of every opened song
+ *
+ * When enabled, opening of a MIDI file finds the peak count of simultaneously sounding
+ * notes (including release tails of instruments) and uses the smallest number
+ * of chips which fits them, up to the given maximum. The chosen number
+ * is returned by opn2_getNumChipsObtained(), the value set by opn2_setNumChips()
+ * is used again once this mode gets disabled. The count of chips is estimated
+ * against FM channels, and also against SSG and rhythm channels when extra
+ * channels of OPNA are enabled. Any call of opn2_setNumChips() disables this mode.
+ *
+ * @param device Instance of the library
+ * @param maxChips Highest allowed number of chips (from 1 to 100), or 0 to disable
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setAutoNumChips(struct OPN2_MIDIPlayer *device, int maxChips);
+
+/**
+ * @brief Split emulated chips into the groups of separately rendered chips
+ *
+ * Chips are split into the given number of contiguous groups. Every MIDI port
+ * (a block of 16 MIDI channels of the multi-port song) has fixed affinity to
+ * one group: the port N plays on the group N modulo the count of groups. Notes
+ * of the port are allocated only on channels of its group, so every group keeps
+ * its own allocation state. Groups are mixed together after rendering.
+ *
+ * When the library is built with chip group threads support, every group except
+ * the first one is rendered by its own worker thread, otherwise groups are rendered
+ * one by one. The effective count of groups is never larger than the count of chips.
+ * Buffers and threads are made by this call and by every change of the chips count,
+ * so, the rendering itself never allocates or starts threads.
+ *
+ * @param device Instance of the library
+ * @param groups Count of chip groups (from 1 to 100), 1 to disable splitting
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setChipGroups(struct OPN2_MIDIPlayer *device, int groups);
+
+/**
+ * @brief Get the count of chip groups in use
+ * @param device Instance of the library
+ * @return Effective count of chip groups
+ */
+extern OPNMIDI_DECLSPEC int opn2_getChipGroups(struct OPN2_MIDIPlayer *device);
+
 /**
  * @brief Reference to dynamic bank
  */
@@ -271,7 +336,20 @@ enum
 typedef enum OPN2_InstrumentFlags
 {
     OPNMIDI_Ins_Pseudo8op  = 0x01, /*Reserved for future use, not implemented yet*/
-    OPNMIDI_Ins_IsBlank    = 0x02
+    OPNMIDI_Ins_IsBlank    = 0x02,
+
+    /* Rhythm voice of OPNA used by the extra channels mode (see opn2_setOpnaExtraChannels) */
+    OPNMIDI_Ins_RhythmAuto   = 0x00, /*Use the built-in GM percussion map for drums*/
+    OPNMIDI_Ins_RhythmBass   = 0x08,
+    OPNMIDI_Ins_RhythmSnare  = 0x10,
+    OPNMIDI_Ins_RhythmTop    = 0x18,
+    OPNMIDI_Ins_RhythmHiHat  = 0x20,
+    OPNMIDI_Ins_RhythmTom    = 0x28,
+    OPNMIDI_Ins_RhythmRim    = 0x30,
+    OPNMIDI_Ins_RhythmNone   = 0x38, /*Always play by FM*/
+    OPNMIDI_Ins_RhythmMask   = 0x38,
+    /* Simple tone, may be played by the SSG channel in the extra channels mode */
+    OPNMIDI_Ins_SSG          = 0x40
 } OPN2_InstrumentFlags;
 
 /**
@@ -528,6 +606,31 @@ extern OPNMIDI_DECLSPEC void opn2_setChannelAllocMode(struct OPN2_MIDIPlayer *de
  */
 extern OPNMIDI_DECLSPEC int opn2_getChannelAllocMode(struct OPN2_MIDIPlayer *device);
 
+/**
+ * @brief Enable(1) or Disable(0) the sparse bank loading mode
+ *
+ * When enabled, instrument records of the next loaded bank file are kept in the raw form,
+ * and only instruments referenced by loaded MIDI files are converted into the banks list.
+ * Any other instrument gets loaded on demand once it will be requested by the real-time
+ * note-on event. Real-time events don't allocate memory: new banks only take a few slots
+ * reserved at the song loading, once they are over, the instrument is treated as missing.
+ * Banks no longer used by loaded songs are dropped on the next song load, unless the user
+ * has changed their instruments. Banks made by opn2_getBank() are never overwritten.
+ * Bank walking functions like opn2_getFirstBank() will only see already loaded banks.
+ * Must be called before opn2_openBankFile() or opn2_openBankData() to take the effect.
+ *
+ * @param device Instance of the library
+ * @param sparse 0 - disabled (load every instrument, default), 1 - enabled
+ */
+extern OPNMIDI_DECLSPEC void opn2_setSparseBankLoading(struct OPN2_MIDIPlayer *device, int sparse);
+
+/**
+ * @brief Get the state of the sparse bank loading mode
+ * @param device Instance of the library
+ * @return 0 - disabled, 1 - enabled
+ */
+extern OPNMIDI_DECLSPEC int opn2_getSparseBankLoading(struct OPN2_MIDIPlayer *device);
+
 /**
  * @brief Load WOPN bank file from File System
  *
@@ -639,6 +742,51 @@ typedef struct {
  */
 extern OPNMIDI_DECLSPEC int opn2_setRunAtPcmRate(struct OPN2_MIDIPlayer *device, int enabled);
 
+/**
+ * @brief Use SSG and rhythm parts of OPNA chips as extra channels
+ *
+ * Every OPNA chip gets 3 SSG channels and 6 rhythm voices in addition to 6 FM channels.
+ * Percussions are played by rhythm voices, instruments marked by the OPNMIDI_Ins_SSG flag
+ * may be played by SSG channels when all FM channels are busy. This allows to reduce
+ * the count of chips needed to play the song. Has no effect on OPN2 chips.
+ *
+ * @param device Instance of the library
+ * @param enabled 0 - disabled, 1 - enabled
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setOpnaExtraChannels(struct OPN2_MIDIPlayer *device, int enabled);
+
+/**
+ * @brief Get the state of the OPNA extra channels mode
+ * @param device Instance of the library
+ * @return 1 when enabled, 0 when disabled, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_getOpnaExtraChannels(struct OPN2_MIDIPlayer *device);
+
+/**
+ * @brief Play percussion notes by prerendered PCM samples instead of FM channels
+ *
+ * Every drum is rendered once per instrument, key and velocity band by the separate
+ * instance of the current emulator, and the cached sample is mixed into the output.
+ * Drums don't occupy FM channels, and they cost no emulation while playing.
+ * Drums are played as one-shot samples, note-off events don't cut them.
+ * Samples are rendered for drums of the loaded songs on the load, and again after
+ * changes of the setup or of the instruments. Other drums, like ones of the real-time
+ * MIDI, are played by FM channels as usual, so, no rendering happens while playing.
+ *
+ * @param device Instance of the library
+ * @param enabled 0 - disabled, 1 - enabled
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setDacDrums(struct OPN2_MIDIPlayer *device, int enabled);
+
+/**
+ * @brief Get the state of the prerendered percussion mode
+ * @param device Instance of the library
+ * @return 1 when enabled, 0 when disabled, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_getDacDrums(struct OPN2_MIDIPlayer *device);
+
 /**
  * @brief Set 4-bit device identifier. Used by the SysEx processor.
  * @param device Instance of the library
@@ -698,6 +846,44 @@ extern OPNMIDI_DECLSPEC const char *opn2_errorInfo(struct OPN2_MIDIPlayer *devic
  */
 extern OPNMIDI_DECLSPEC struct OPN2_MIDIPlayer *opn2_init(long sample_rate);
 
+/**
+ * @brief Memory allocator given by the user
+ */
+typedef struct OPN2_Allocator
+{
+    /*! Allocate a block of the given size aligned as malloc() does, return NULL when out of memory */
+    void *(*allocate)(void *userData, size_t size);
+    /*! Release the block given by the allocate function */
+    void (*release)(void *userData, void *ptr);
+    /*! User data passed to both functions */
+    void *userData;
+} OPN2_Allocator;
+
+/**
+ * @brief Initialize OPNMIDI Player device with a custom memory allocator
+ *
+ * The allocator receives the player state, the synthesizer, the MIDI sequencers
+ * and their interfaces, the instrument banks storage, the chip emulators
+ * and the render-ahead queue. All chip emulators, including the state of their
+ * cores, are placed into one contiguous block. Still taken from the default heap
+ * are the buffers made inside of the MAME, Gens and low-level emulation cores,
+ * and the standard containers: song data, channel and note tables, and the
+ * buffers of chip groups (see `opn2_setChipGroups`).
+ *
+ * When the allocator returns NULL, this call returns NULL too. Calls which
+ * make chips again (`opn2_setNumChips`, `opn2_switchEmulator`, bank and music
+ * loads, etc.) return an error then, the player stays silent without chips
+ * until the next successful one of them.
+ *
+ * The allocator is copied, so the structure itself doesn't need to outlive the call.
+ * All memory is returned to the allocator by `opn2_close`.
+ *
+ * @param sample_rate Output sample rate
+ * @param allocator Memory allocator, or NULL to use the default heap like `opn2_init` does
+ * @return Instance of the library. If NULL was returned, check the `opn2_errorString` message for more info.
+ */
+extern OPNMIDI_DECLSPEC struct OPN2_MIDIPlayer *opn2_initEx(long sample_rate, const OPN2_Allocator *allocator);
+
 /**
  * @brief Close and delete OPNMIDI device
  * @param device Instance of the library
@@ -842,6 +1028,122 @@ extern OPNMIDI_DECLSPEC size_t opn2_trackCount(struct OPN2_MIDIPlayer *device);
 
 
 
+/* ======== Song slots ======== */
+
+/*! Count of song slots which play along with the main song on the same chips */
+#define OPNMIDI_SONG_SLOTS 4
+
+/**
+ * @brief Load the music file into the song slot
+ *
+ * Slot songs play on the same chips together with the main song, every slot
+ * gets its own block of 16 MIDI channels. The playback starts immediately,
+ * looping is disabled by default. Loading of the main song keeps slot songs
+ * playing on their channels, only their sounding notes are released once
+ * chips get reset.
+ *
+ * Available when library is built with built-in MIDI Sequencer support.
+ *
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param filePath Absolute or relative path to the music file. UTF8 encoding is required, even on Windows.
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_slotOpenFile(struct OPN2_MIDIPlayer *device, int slot, const char *filePath);
+
+/**
+ * @brief Load the music file data into the song slot
+ *
+ * Available when library is built with built-in MIDI Sequencer support.
+ *
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param mem Pointer to the buffer where music data is stored
+ * @param size Size of the buffer in bytes
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_slotOpenData(struct OPN2_MIDIPlayer *device, int slot, const void *mem, unsigned long size);
+
+/**
+ * @brief Stop the song of the slot and unload it
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotClose(struct OPN2_MIDIPlayer *device, int slot);
+
+/**
+ * @brief Pause or resume the song of the slot
+ *
+ * Playing notes of the slot are released on pause.
+ *
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param paused 1 to pause, 0 to resume
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSetPaused(struct OPN2_MIDIPlayer *device, int slot, int paused);
+
+/**
+ * @brief Reset the position of the slot song to begin, the song continues playing
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotRewind(struct OPN2_MIDIPlayer *device, int slot);
+
+/**
+ * @brief Jump the slot song to the absolute time position
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param seconds Destination time position in seconds to seek
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSeek(struct OPN2_MIDIPlayer *device, int slot, double seconds);
+
+/**
+ * @brief Enable or disable looping of the slot song
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param loopEn 0 - disabled, 1 - enabled
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSetLoopEnabled(struct OPN2_MIDIPlayer *device, int slot, int loopEn);
+
+/**
+ * @brief Set tempo multiplier of the slot song
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param tempo Tempo multiplier value: 1.0 - original tempo, >1 - play faster, <1 - play slower
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSetTempo(struct OPN2_MIDIPlayer *device, int slot, double tempo);
+
+/**
+ * @brief Set volume level of the slot song
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param volume Volume level from 0 to 127, 127 by default
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSetVolume(struct OPN2_MIDIPlayer *device, int slot, int volume);
+
+/**
+ * @brief Set priority of the slot song notes on allocation of chip channels
+ *
+ * The main song and real-time MIDI calls have the priority 0. Notes of a song never
+ * take chip channels playing notes of songs with a higher priority, so these channels
+ * stay reserved. Notes of songs with a lower priority are stolen first.
+ *
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @param priority Priority value, 0 by default
+ */
+extern OPNMIDI_DECLSPEC void opn2_slotSetPriority(struct OPN2_MIDIPlayer *device, int slot, int priority);
+
+/**
+ * @brief Returns 1 if the slot song has reached its end
+ * @param device Instance of the library
+ * @param slot Index of the slot (from 0 to OPNMIDI_SONG_SLOTS-1)
+ * @return 1 when the song is ended or the slot is empty, otherwise 0. <0 is returned on any error
+ */
+extern OPNMIDI_DECLSPEC int opn2_slotAtEnd(struct OPN2_MIDIPlayer *device, int slot);
+
+
+
 /* ======== Meta-Tags ======== */
 
 /**
@@ -909,6 +1211,12 @@ extern OPNMIDI_DECLSPEC struct Opn2_MarkerEntry opn2_metaMarker(struct OPN2_MIDI
 
 /* ======== Audio output Generation ======== */
 
+/*
+ * Once a bank and a song are loaded, the audio generation functions and the
+ * real-time MIDI functions below do no heap allocations, so they are safe to call
+ * from a real-time audio thread.
+ */
+
 /**
  * @brief Generate PCM signed 16-bit stereo audio output and iterate MIDI timers
  *
@@ -987,6 +1295,74 @@ extern OPNMIDI_DECLSPEC int  opn2_generate(struct OPN2_MIDIPlayer *device, int s
  */
 extern OPNMIDI_DECLSPEC int  opn2_generateFormat(struct OPN2_MIDIPlayer *device, int sampleCount, OPN2_UInt8 *left, OPN2_UInt8 *right, const struct OPNMIDI_AudioFormat *format);
 
+/**
+ * @brief Start the asynchronous render-ahead mode
+ *
+ * The library starts its own render thread which plays the song by opn2_playFormat()
+ * and keeps the given amount of audio queued ahead. The audio callback then takes
+ * the audio by opn2_readRendered(), which never waits for rendering and never locks.
+ *
+ * While the mode is active, don't call opn2_play() or opn2_playFormat() by yourself.
+ * Transport calls (opening of songs, song selection, seek, rewind, tempo change,
+ * reset, panic and song slot calls) are safe to use: they wait for the render thread
+ * to pause, and then drop the audio queued before, so, the change is heard immediately.
+ * Real-time MIDI calls (opn2_rt_*) are safe too: they wait for the render thread to finish
+ * the current block and keep the queued audio, so, they are heard after it.
+ * opn2_positionTell() is safe as well, it tells the position of the rendered audio.
+ * Any other setup calls should be done before the start or after opn2_stopRenderAhead().
+ * Event hooks are called from the render thread.
+ *
+ * Available when library is built with built-in MIDI Sequencer and render-ahead support.
+ *
+ * @param device Instance of the library
+ * @param aheadSamples Count of samples (not frames!) to keep queued
+ * @param format Output PCM format, or NULL for signed 16-bit interleaved stereo
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_startRenderAhead(struct OPN2_MIDIPlayer *device, int aheadSamples, const struct OPNMIDI_AudioFormat *format);
+
+/**
+ * @brief Stop the render thread of the render-ahead mode and drop all queued audio
+ *
+ * Stop the audio output before this call: opn2_readRendered() must not run at the same time.
+ *
+ * @param device Instance of the library
+ */
+extern OPNMIDI_DECLSPEC void opn2_stopRenderAhead(struct OPN2_MIDIPlayer *device);
+
+/**
+ * @brief Take the audio queued by the render-ahead mode
+ *
+ * Never blocks: when less audio is queued than requested (an underrun, or the song end),
+ * only the queued part is given and the rest of the output is left untouched.
+ * Samples are written in the format given to opn2_startRenderAhead().
+ *
+ * @param device Instance of the library
+ * @param sampleCount Count of samples (not frames!)
+ * @param left Left channel buffer output (Must be casted into bytes array)
+ * @param right Right channel buffer output (Must be casted into bytes array)
+ * @return Count of given samples
+ */
+extern OPNMIDI_DECLSPEC int opn2_readRendered(struct OPN2_MIDIPlayer *device, int sampleCount, OPN2_UInt8 *left, OPN2_UInt8 *right);
+
+/**
+ * @brief Get the count of samples queued by the render-ahead mode
+ * @param device Instance of the library
+ * @return Count of samples (not frames!) ready to be taken by opn2_readRendered()
+ */
+extern OPNMIDI_DECLSPEC int opn2_renderedQueued(struct OPN2_MIDIPlayer *device);
+
+/**
+ * @brief Has the render-ahead mode reached the song end and all the audio was taken?
+ *
+ * Unlike opn2_atEnd(), which tells about the sequencer which runs ahead of the output,
+ * this turns true only after the last rendered sample was taken by opn2_readRendered().
+ *
+ * @param device Instance of the library
+ * @return 1 when the playback has finished or the mode is not running, 0 otherwise
+ */
+extern OPNMIDI_DECLSPEC int opn2_renderAheadAtEnd(struct OPN2_MIDIPlayer *device);
+
 /**
  * @brief Periodic tick handler.
  * @param device
@@ -999,6 +1375,34 @@ extern OPNMIDI_DECLSPEC int  opn2_generateFormat(struct OPN2_MIDIPlayer *device,
  */
 extern OPNMIDI_DECLSPEC double opn2_tickEvents(struct OPN2_MIDIPlayer *device, double seconds, double granuality);
 
+/**
+ * @brief Process the next portion of the song directly into the VGM dumper
+ * @param device Instance of the library
+ * @return 1 while the song continues, 0 when the song end has been reached, <0 on error
+ *         (also when the output exceeds 128 MiB, see opn2_errorInfo())
+ *
+ * Use it with the OPNMIDI_VGM_DUMPER emulator instead of opn2_play() to advance
+ * the sequencer without rendering of any audio buffers. Every call records
+ * the same frames as opn2_play() would render, the VGM waits are counted
+ * in whole 1/44100'ths of second. The output is identical to the opn2_play()
+ * driven one when chips run at the PCM rate (see opn2_setRunAtPcmRate()).
+ * DON'T USE IT TOGETHER WITH opn2_play()!!!
+ */
+extern OPNMIDI_DECLSPEC int opn2_tickVgmDump(struct OPN2_MIDIPlayer *device);
+
+/**
+ * @brief Sets the path of the VGM file produced by the VGM dumper
+ * @param device Instance of the library
+ * @param path Path to the output VGM file
+ * @return 0 on success, <0 when the VGM dumper is not supported by this build
+ *
+ * The file gets written once the recorded song is finalized (on opn2_close() call).
+ * Has no effect when the VGM write hook is set (see opn2_setVgmWriteHook()).
+ * Songs longer than 128 MiB of VGM data are cut at that size.
+ * Loop points and errors of the recording are passed into the debug message hook.
+ */
+extern OPNMIDI_DECLSPEC int opn2_setVgmOutPath(struct OPN2_MIDIPlayer *device, const char *path);
+
 /**
  * @brief Track options
  */
@@ -1183,6 +1587,14 @@ typedef void (*OPN2_DebugMessageHook)(void *userdata, const char *fmt, ...);
  */
 typedef void (*OPN2_LoopPointHook)(void *userdata);
 
+/**
+ * @brief VGM dumper output callback
+ * @param userdata Pointer to user data (usually, context of someting)
+ * @param data Complete VGM data including the header
+ * @param size Size of the VGM data in bytes
+ */
+typedef void (*OPN2_VgmWriteHook)(void *userdata, const OPN2_UInt8 *data, size_t size);
+
 /**
  * @brief Set raw MIDI event hook
  *
@@ -1251,6 +1663,19 @@ extern OPNMIDI_DECLSPEC void opn2_setLoopStartHook(struct OPN2_MIDIPlayer *devic
  */
 extern OPNMIDI_DECLSPEC void opn2_setLoopEndHook(struct OPN2_MIDIPlayer *device, OPN2_LoopPointHook loopEndHook, void *userData);
 
+/**
+ * @brief Set the VGM dumper output hook
+ *
+ * When set, the recorded VGM data gets passed into this hook instead of
+ * writing it into the file. The hook is called once the recorded song is
+ * finalized (on opn2_close() call), songs without any recorded time are skipped.
+ *
+ * @param device Instance of the library
+ * @param vgmWriteHook Pointer to the callback function which receives the complete VGM data
+ * @param userData Pointer to user data which will be passed through the callback.
+ */
+extern OPNMIDI_DECLSPEC void opn2_setVgmWriteHook(struct OPN2_MIDIPlayer *device, OPN2_VgmWriteHook vgmWriteHook, void *userData);
+
 /**
  * @brief Get a textual description of the channel state. For display only.
  * @param device Instance of the library
@@ -1271,6 +1696,340 @@ extern OPNMIDI_DECLSPEC void opn2_setLoopEndHook(struct OPN2_MIDIPlayer *device,
  */
 extern OPNMIDI_DECLSPEC int opn2_describeChannels(struct OPN2_MIDIPlayer *device, char *text, char *attr, size_t size);
 
+
+/* ======== Register stream capture ======== */
+
+/**
+ * @brief Port value of the captured soft panning write
+ */
+#define OPNMIDI_RegCapture_PanPort 0xFF
+
+/**
+ * @brief Captured write into the chip register
+ */
+typedef struct OPN2_RegWrite
+{
+    /*! Count of sample frames generated since the capture start before this write */
+    OPN2_UInt64 sampleOffset;
+    /*! Index of the chip */
+    OPN2_UInt8 chip;
+    /*! Port of the chip (0 or 1), or OPNMIDI_RegCapture_PanPort for soft panning */
+    OPN2_UInt8 port;
+    /*! Register address, or the chip channel for soft panning */
+    OPN2_UInt16 addr;
+    /*! Written value */
+    OPN2_UInt8 value;
+} OPN2_RegWrite;
+
+/**
+ * @brief Caller-owned ring buffer of captured register writes
+ *
+ * The library appends records at the `head` position, the caller reads
+ * them from the `tail` position. Both positions are wrapped by `capacity`.
+ * The ring is empty when `head` equals to `tail`, so it holds up to `capacity - 1` records.
+ * When the ring is full, new records are dropped and counted in `dropped`.
+ *
+ * The ring may be read by another thread while the library renders. The library
+ * stores `head` with the release ordering after the record is written and loads `tail`
+ * with the acquire ordering. Such a reader must load `head` with the acquire ordering
+ * before reading records, and store `tail` with the release ordering after them
+ * (for example, by `__atomic_load_n()` and `__atomic_store_n()` of GCC and Clang).
+ */
+typedef struct OPN2_RegCaptureRing
+{
+    /*! Storage for records */
+    OPN2_RegWrite *records;
+    /*! Number of records in the storage */
+    size_t capacity;
+    /*! Write position, advanced by the library */
+    volatile size_t head;
+    /*! Read position, advanced by the caller */
+    volatile size_t tail;
+    /*! Count of records dropped because the ring was full */
+    size_t dropped;
+} OPN2_RegCaptureRing;
+
+/**
+ * @brief Start or stop capturing of chip register writes
+ *
+ * Every register write made by the synthesizer gets appended into the given ring
+ * while the audio keeps rendering normally. The sample offset counter starts from zero.
+ * The ring gets modified only inside of library calls, read it between them,
+ * or from another thread as described at OPN2_RegCaptureRing.
+ *
+ * @param device Instance of the library
+ * @param ring Ring buffer to fill, or NULL to stop capturing
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setRegisterCapture(struct OPN2_MIDIPlayer *device, OPN2_RegCaptureRing *ring);
+
+/**
+ * @brief Play the register log directly into chips, without the MIDI layer
+ *
+ * Register writes are sent into chips of currently selected emulator with sample-exact
+ * timing while generating audio by opn2_play() or opn2_generate() calls, MIDI sequencer,
+ * voice allocation and volume models are not used. Loading of any MIDI file finishes this mode.
+ * The count of chips and the chip family are changed for the log, and restored when
+ * the end of the log is reached.
+ *
+ * @param device Instance of the library
+ * @param records Register writes (for example, captured by opn2_setRegisterCapture()), the data gets copied
+ * @param count Count of register writes
+ * @param rate Sample rate at which sample offsets of records were counted
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_openRegisterLog(struct OPN2_MIDIPlayer *device, const OPN2_RegWrite *records, size_t count, unsigned long rate);
+
+/**
+ * @brief Play YM2612 or YM2608 commands of the VGM file directly into chips, without the MIDI layer
+ *
+ * Works same as opn2_openRegisterLog(). Files using both YM2612 and YM2608 chips are rejected.
+ *
+ * @param device Instance of the library
+ * @param filePath Absolute or relative path to the VGM file. UTF8 encoding is required, even on Windows.
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_openVgmFile(struct OPN2_MIDIPlayer *device, const char *filePath);
+
+/**
+ * @brief Play YM2612 or YM2608 commands of the VGM data directly into chips, without the MIDI layer
+ *
+ * Works same as opn2_openRegisterLog(). Files using both YM2612 and YM2608 chips are rejected.
+ *
+ * @param device Instance of the library
+ * @param mem Pointer to memory block where is raw data of VGM file is stored
+ * @param size Size of given memory block
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_openVgmData(struct OPN2_MIDIPlayer *device, const void *mem, unsigned long size);
+
+
+/* ======== Performance counters ======== */
+
+/**
+ * @brief Accumulated time and call count of one processing stage
+ */
+typedef struct OPN2_PerfCounter
+{
+    /*! Total time spent in the stage, in nanoseconds */
+    double nanoseconds;
+    /*! Count of times the stage was entered */
+    unsigned long calls;
+} OPN2_PerfCounter;
+
+/**
+ * @brief Performance counters of one chip
+ */
+typedef struct OPN2_PerfChipStats
+{
+    /*! Chip emulation */
+    OPN2_PerfCounter emulation;
+    /*! Register writes, the time is estimated from a sample of writes */
+    OPN2_PerfCounter regWrites;
+} OPN2_PerfChipStats;
+
+/**
+ * @brief Performance counters of the library instance
+ */
+typedef struct OPN2_PerfStats
+{
+    /*! MIDI sequencer, including the handling of the events it dispatches (voice allocation) */
+    OPN2_PerfCounter sequencer;
+    /*! Synth logic between events: note aging, vibrato, arpeggio, glide */
+    OPN2_PerfCounter synth;
+    /*! Chip emulation, all chips together */
+    OPN2_PerfCounter emulation;
+    /*! Conversion of the mixed signal into the output sample format */
+    OPN2_PerfCounter output;
+    /*! Register writes, all chips together. Only a sample of writes is timed, the time is an estimate */
+    OPN2_PerfCounter regWrites;
+    /*! Count of rendered sample frames */
+    unsigned long frames;
+    /*! [in] Caller-owned storage for per-chip counters, may be NULL */
+    OPN2_PerfChipStats *chips;
+    /*! [in] Number of elements in the `chips` storage */
+    size_t chipsCapacity;
+    /*! [out] Number of running chips, only first `chipsCapacity` of them are written */
+    size_t chipsCount;
+} OPN2_PerfStats;
+
+/**
+ * @brief Enable or disable accumulation of performance counters
+ *
+ * Counters are only available when the library is built with the WITH_PERF_COUNTERS
+ * CMake option, otherwise this call fails. Counters are disabled by default.
+ *
+ * @param device Instance of the library
+ * @param enabled 1 to accumulate counters, 0 to pause
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_setPerfCountersEnabled(struct OPN2_MIDIPlayer *device, int enabled);
+
+/**
+ * @brief Get the accumulated performance counters
+ * @param device Instance of the library
+ * @param stats Destination structure, the `chips` and `chipsCapacity` fields must be set by the caller
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_getPerfStats(struct OPN2_MIDIPlayer *device, OPN2_PerfStats *stats);
+
+/**
+ * @brief Reset all performance counters to zero
+ * @param device Instance of the library
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_resetPerfStats(struct OPN2_MIDIPlayer *device);
+
+
+/* ======== Voice allocation statistics ======== */
+
+/**
+ * @brief Statistics of the chip channels allocation
+ *
+ * Counters are accumulated since a song was opened, since the chips were reset
+ * (for example, by changing the count of chips), or since opn2_resetVoiceStats() call.
+ * Use them to find the smallest count of chips which plays a song without steals and drops.
+ */
+typedef struct OPN2_VoiceStats
+{
+    /*! Count of voices placed onto chip channels */
+    unsigned long placed;
+    /*! Count of playing or sustained notes killed to free a chip channel for a new note */
+    unsigned long steals;
+    /*! Count of playing notes moved onto another chip channel to free one for a new note (auto-arpeggio mode only) */
+    unsigned long evacuations;
+    /*! Count of voices not played because no chip channel was available */
+    unsigned long drops;
+    /*! Count of chip channels re-used while releasing a previous note, indexed by the effective OPNMIDI_ChannelAlloc mode, entries of unknown modes are zero */
+    unsigned long releaseReuses[OPNMIDI_VOICE_STATS_ALLOC_MODES];
+    /*! Highest count of simultaneously busy chip channels */
+    unsigned int peakChannels;
+    /*! Highest count of simultaneously playing voices (larger than peakChannels when auto-arpeggio is used) */
+    unsigned int peakVoices;
+    /*! Total count of chip channels */
+    unsigned int totalChannels;
+} OPN2_VoiceStats;
+
+/**
+ * @brief Get the statistics of the chip channels allocation
+ * @param device Instance of the library
+ * @param stats Destination structure
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_getVoiceStats(struct OPN2_MIDIPlayer *device, OPN2_VoiceStats *stats);
+
+/**
+ * @brief Reset the statistics of the chip channels allocation to zero
+ * @param device Instance of the library
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_resetVoiceStats(struct OPN2_MIDIPlayer *device);
+
+
+/* ======== Channels state snapshot ======== */
+
+/**
+ * @brief State of the chip channel
+ */
+enum OPNMIDI_ChipChannelStatus
+{
+    /*! Channel is silent */
+    OPNMIDI_ChipChan_Free = 0,
+    /*! Channel plays a key-on note */
+    OPNMIDI_ChipChan_KeyOn,
+    /*! Channel plays notes held by the sustain or sostenuto pedal only */
+    OPNMIDI_ChipChan_Sustained,
+    /*! Channel is keyed off and its release is still audible */
+    OPNMIDI_ChipChan_Releasing
+};
+
+/**
+ * @brief State of the single chip channel
+ */
+typedef struct OPN2_ChipChannelState
+{
+    /*! State of the channel, one of OPNMIDI_ChipChannelStatus */
+    OPN2_UInt8 state;
+    /*! Count of notes sharing this channel (more than one when auto-arpeggio is used) */
+    OPN2_UInt8 notesCount;
+    /*! MIDI channel of the current or the most recent note, channels of MIDI ports and song slots are going above 255 */
+    OPN2_UInt16 midiChannel;
+    /*! Key of the current or the most recent note */
+    OPN2_UInt8 note;
+    /*! MIDI program of the most recent note (key of the percussion) */
+    OPN2_UInt8 instrument;
+    /*! Is the most recent note a percussion */
+    OPN2_UInt8 isPercussion;
+    /*! Total level of the loudest carrier operator (0 is loudest, 127 is silent) */
+    OPN2_UInt8 totalLevel;
+    /*! Effective panning, from 0 (left) to 127 (right), 64 is center */
+    OPN2_UInt8 pan;
+} OPN2_ChipChannelState;
+
+/**
+ * @brief Summary of the single MIDI channel
+ */
+typedef struct OPN2_MidiChannelState
+{
+    /*! Count of currently playing notes */
+    OPN2_UInt8 activeNotes;
+    /*! Count of chip channels used by currently playing notes */
+    OPN2_UInt8 chipChannels;
+    /*! MIDI program */
+    OPN2_UInt8 patch;
+    /*! Bank MSB */
+    OPN2_UInt8 bankMsb;
+    /*! Bank LSB */
+    OPN2_UInt8 bankLsb;
+    /*! Volume controller value */
+    OPN2_UInt8 volume;
+    /*! Expression controller value */
+    OPN2_UInt8 expression;
+    /*! Panning controller value */
+    OPN2_UInt8 pan;
+    /*! Is sustain pedal pressed */
+    OPN2_UInt8 sustain;
+    /*! Is channel a percussion */
+    OPN2_UInt8 isPercussion;
+    /*! Pitch bend value, from -8192 to 8191 */
+    short pitchBend;
+} OPN2_MidiChannelState;
+
+/**
+ * @brief Snapshot of the chip and MIDI channels state
+ *
+ * Arrays are owned by the caller. Elements are written up to the capacity,
+ * the count fields always receive the full count of existing channels.
+ */
+typedef struct OPN2_ChannelsSnapshot
+{
+    /*! [in] Destination array for chip channels, may be NULL when chipChannelsCapacity is 0 */
+    OPN2_ChipChannelState *chipChannels;
+    /*! [in] Count of elements in the chipChannels array */
+    size_t chipChannelsCapacity;
+    /*! [out] Total count of chip channels */
+    size_t chipChannelsCount;
+    /*! [in] Destination array for MIDI channels, may be NULL when midiChannelsCapacity is 0 */
+    OPN2_MidiChannelState *midiChannels;
+    /*! [in] Count of elements in the midiChannels array */
+    size_t midiChannelsCapacity;
+    /*! [out] Total count of MIDI channels */
+    size_t midiChannelsCount;
+} OPN2_ChannelsSnapshot;
+
+/**
+ * @brief Get the structured state of chip and MIDI channels for visualization
+ *
+ * Unlike opn2_describeChannels(), the call allocates nothing and formats no text,
+ * so it can be called from the audio thread right after opn2_play() or opn2_generate()
+ * to fill one half of a double-buffered area read by the user interface.
+ *
+ * @param device Instance of the library
+ * @param snapshot Destination snapshot with caller-owned arrays
+ * @return 0 on success, <0 when any error has occurred
+ */
+extern OPNMIDI_DECLSPEC int opn2_getChannelsSnapshot(struct OPN2_MIDIPlayer *device, OPN2_ChannelsSnapshot *snapshot);
+
 #ifdef __cplusplus
 }
 #endif
@@ -53,10 +53,13 @@ SOURCES += \
     src/chips/nuked_opn2.cpp \
     src/chips/nuked/ym3438.c \
     src/opnmidi.cpp \
+    src/opnmidi_chipgroups.cpp \
     src/opnmidi_load.cpp \
     src/opnmidi_midiplay.cpp \
     src/opnmidi_opn2.cpp \
+    src/opnmidi_perf.cpp \
     src/opnmidi_private.cpp \
+    src/opnmidi_renderahead.cpp \
     src/opnmidi_sequencer.cpp \
     src/wopn/wopn_file.c \
     utils/midiplay/opnplay.cpp
@@ -38,7 +38,11 @@ HEADERS += \
     src/midi_sequencer_impl.hpp \
     src/fraction.hpp \
     src/opnbank.h \
+    src/opnmidi_atomic.hpp \
+    src/opnmidi_chipgroups.hpp \
+    src/opnmidi_perf.hpp \
     src/opnmidi_private.hpp \
+    src/opnmidi_renderahead.hpp \
     src/wopn/wopn_file.h
 
 SOURCES += \
@@ -51,9 +55,12 @@ SOURCES += \
     src/chips/nuked_opn2.cpp \
     src/chips/nuked/ym3438.c \
     src/opnmidi.cpp \
+    src/opnmidi_chipgroups.cpp \
     src/opnmidi_load.cpp \
     src/opnmidi_midiplay.cpp \
     src/opnmidi_opn2.cpp \
+    src/opnmidi_perf.cpp \
     src/opnmidi_private.cpp \
+    src/opnmidi_renderahead.cpp \
     src/opnmidi_sequencer.cpp \
     src/wopn/wopn_file.c
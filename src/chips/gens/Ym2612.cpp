@@ -172,6 +172,15 @@ int Ym2612Private::LFO_FREQ_TAB[LFO_LENGTH];	// LFO FMS TABLE
 Ym2612Private::Ym2612Private(Ym2612 *q)
 	: q(q)
 {
+	memset(&state, 0, sizeof(state));
+	memset(FINC_TAB, 0, sizeof(FINC_TAB));
+	memset(AR_TAB, 0, sizeof(AR_TAB));
+	memset(DR_TAB, 0, sizeof(DR_TAB));
+	memset(DT_TAB, 0, sizeof(DT_TAB));
+	memset(LFO_ENV_UP, 0, sizeof(LFO_ENV_UP));
+	memset(LFO_FREQ_UP, 0, sizeof(LFO_FREQ_UP));
+	memset(LFO_INC_TAB, 0, sizeof(LFO_INC_TAB));
+	int_cnt = 0;
 	if (!isInit) {
 		// Initialize the static tables.
 		isInit = true;
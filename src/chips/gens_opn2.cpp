@@ -22,6 +22,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cassert>
+#include <new>
 #include "gens/Ym2612.hpp"
 
 #ifndef INT16_MIN
@@ -31,16 +32,21 @@
 #define INT16_MAX   0x7fff
 #endif
 
-GensOPN2::GensOPN2(OPNFamily f)
+GensOPN2::GensOPN2(OPNFamily f, void *core)
     : OPNChipBaseBufferedT(f),
-      chip(new LibGens::Ym2612())
+      chip(new(core) LibGens::Ym2612())
 {
     GensOPN2::setRate(m_rate, m_clock);
 }
 
 GensOPN2::~GensOPN2()
 {
-    delete chip;
+    chip->~Ym2612();
+}
+
+size_t GensOPN2::coreSize()
+{
+    return sizeof(LibGens::Ym2612);
 }
 
 void GensOPN2::setRate(uint32_t rate, uint32_t clock)
@@ -28,9 +28,11 @@ class GensOPN2 final : public OPNChipBaseBufferedT<GensOPN2>
 {
     LibGens::Ym2612 *chip;
 public:
-    explicit GensOPN2(OPNFamily f);
+    explicit GensOPN2(OPNFamily f, void *core);
     ~GensOPN2() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return true; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
@@ -2194,12 +2194,17 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 }
 
 /* initialize generic tables */
+static int tables_ready = 0;
 static void init_tables(void)
 {
 	signed int i,x;
 	signed int n;
 	double o,m;
 
+	/* tables are shared by all chips and never change, build them once */
+	if (tables_ready)
+		return;
+
 	/* build Linear Power Table */
 	for (x=0; x<TL_RES_LEN; x++)
 	{
@@ -2292,6 +2297,8 @@ static void init_tables(void)
 		}
 	}
 
+	tables_ready = 1;
+
 #ifdef SAVE_SAMPLE
 	sample[0]=fopen("sampsum.pcm","wb");
 #endif
@@ -23,6 +23,7 @@
 #include "mamefm/fmopn_2608rom.h"
 #include "mamefm/2608intf.h"
 #include "mamefm/resampler.hpp"
+#include <new>
 
 struct MameOPNA::Impl {
     ym2608_device dev;
@@ -31,8 +32,15 @@ struct MameOPNA::Impl {
     // typedef chip::SincResampler Resampler;
     typedef chip::LinearResampler Resampler;
 
-    Resampler *psgrsm;
-    int32_t *psgbuffer;
+    //! Frames of the raw PSG buffer, longer blocks get resampled by parts
+    enum { psgBufferFrames = 2048 };
+
+    Resampler psgrsm;
+    int32_t psgbuffer[2 * psgBufferFrames];
+    //! Output rate of the PSG
+    uint32_t psgRate;
+    //! Was SSG touched since reset? If not, it gets skipped completely
+    bool psgActive;
 
     static const ssg_callbacks cbssg;
 
@@ -58,21 +66,24 @@ const ssg_callbacks MameOPNA::Impl::cbssg =
 };
 
 
-MameOPNA::MameOPNA(OPNFamily f)
-    : OPNChipBaseBufferedT(f), impl(new Impl)
+MameOPNA::MameOPNA(OPNFamily f, void *core)
+    : OPNChipBaseBufferedT(f), impl(new(core) Impl)
 {
     impl->chip = NULL;
-    impl->psgrsm = NULL;
-    impl->psgbuffer = NULL;
+    impl->psgRate = 0;
+    impl->psgActive = false;
     MameOPNA::setRate(m_rate, m_clock);
 }
 
 MameOPNA::~MameOPNA()
 {
-    delete impl->psgrsm;
-    delete[] impl->psgbuffer;
     ym2608_shutdown(impl->chip);
-    delete impl;
+    impl->~Impl();
+}
+
+size_t MameOPNA::coreSize()
+{
+    return sizeof(Impl);
 }
 
 void MameOPNA::setRate(uint32_t rate, uint32_t clock)
@@ -92,16 +103,13 @@ void MameOPNA::setRate(uint32_t rate, uint32_t clock)
     PSG *psg = &device->m_psg;
     memset(psg, 0, sizeof(PSG));
 
-    uint32_t psgRate = clock / 32;
+    uint32_t psgRate = impl->psgRate = clock / 32;
     PSG_init(psg, clock / 4, psgRate);  // TODO libOPNMIDI verify clocks
     PSG_setVolumeMode(psg, 1);  // YM2149 volume mode
 
-    delete impl->psgrsm;
-    Impl::Resampler *psgrsm = impl->psgrsm = new Impl::Resampler;
-    psgrsm->init(psgRate, chipRate, 40);
-
-    delete[] impl->psgbuffer;
-    impl->psgbuffer = new int32_t[2 * psgrsm->calculateInternalSampleSize(buffer_size)];
+    impl->psgrsm.init((int)psgRate, (int)chipRate, 40);
+    // FM-only until SSG registers get written
+    impl->psgActive = false;
 
     ym2608_reset_chip(chip);
     ym2608_write(chip, 0, 0x29);
@@ -115,11 +123,15 @@ void MameOPNA::reset()
     ym2608_reset_chip(chip);
     ym2608_write(chip, 0, 0x29);
     ym2608_write(chip, 1, 0x9f);
+    // SSG is silent after reset, skip it until it gets used again
+    impl->psgActive = false;
 }
 
 void MameOPNA::writeReg(uint32_t port, uint16_t addr, uint8_t data)
 {
     void *chip = impl->chip;
+    if(port == 0 && addr < 0x10)
+        impl->psgActive = true;
     ym2608_write(chip, 0 + (int)(port) * 2, (uint8_t)addr);
     ym2608_write(chip, 1 + (int)(port) * 2, data);
 }
@@ -140,29 +152,55 @@ void MameOPNA::nativeGenerateN(int16_t *output, size_t frames)
 
     ym2608_update_one(chip, fmbufs, (int)frames);
 
-    PSG *psg = &impl->dev.m_psg;
-    Impl::Resampler *psgrsm = impl->psgrsm;
-    size_t psgframes = psgrsm->calculateInternalSampleSize(frames);
+    if(!impl->psgActive)
+    {
+        // FM-only mode: no SSG emulation and no resampling
+        for(size_t i = 0; i < frames; ++i)
+        {
+            int32_t l = fmLR[i];
+            l = (l > -32768) ? l : -32768;
+            l = (l < 32767) ? l : 32767;
+            int32_t r = fmR[i];
+            r = (r > -32768) ? r : -32768;
+            r = (r < 32767) ? r : 32767;
+            output[2 * i] = l;
+            output[2 * i + 1] = r;
+        }
+        return;
+    }
 
+    PSG *psg = &impl->dev.m_psg;
+    Impl::Resampler &psgrsm = impl->psgrsm;
     int32_t *rawpsgLR = impl->psgbuffer;
-    int32_t *rawpsgR = rawpsgLR + psgframes;
+    int32_t *rawpsgR = rawpsgLR + Impl::psgBufferFrames;
     int32_t *rawpsgbufs[2] = { rawpsgLR, rawpsgR };
-    PSG_calc_stereo(psg, rawpsgbufs, (int32_t)psgframes);
-
-    int32_t **psgbufs = psgrsm->interpolate(rawpsgbufs, frames, psgframes);
-    int32_t *psgL = psgbufs[0];
-    int32_t *psgR = psgbufs[1];
 
-    for(size_t i = 0; i < frames; ++i)
+    for(size_t done = 0; done < frames;)
     {
-        int32_t l = fmLR[i] + psgL[i];
-        l = (l > -32768) ? l : -32768;
-        l = (l < 32767) ? l : 32767;
-        int32_t r = fmR[i] + psgR[i];
-        r = (r > -32768) ? r : -32768;
-        r = (r < 32767) ? r : 32767;
-        output[2 * i] = l;
-        output[2 * i + 1] = r;
+        // The interpolation reads one raw frame ahead
+        size_t part = frames - done;
+        while(part > 1 && psgrsm.calculateInternalSampleSize(part) >= Impl::psgBufferFrames)
+            part /= 2;
+        size_t psgframes = psgrsm.calculateInternalSampleSize(part);
+        PSG_calc_stereo(psg, rawpsgbufs, (int32_t)psgframes);
+
+        int32_t **psgbufs = psgrsm.interpolate(rawpsgbufs, part, psgframes);
+        int32_t *psgL = psgbufs[0];
+        int32_t *psgR = psgbufs[1];
+
+        for(size_t i = 0; i < part; ++i)
+        {
+            size_t o = done + i;
+            int32_t l = fmLR[o] + psgL[i];
+            l = (l > -32768) ? l : -32768;
+            l = (l < 32767) ? l : 32767;
+            int32_t r = fmR[o] + psgR[i];
+            r = (r > -32768) ? r : -32768;
+            r = (r < 32767) ? r : 32767;
+            output[2 * o] = l;
+            output[2 * o + 1] = r;
+        }
+        done += part;
     }
 }
 
@@ -28,9 +28,11 @@ class MameOPNA final : public OPNChipBaseBufferedT<MameOPNA>
     struct Impl;
     Impl *impl;
 public:
-    explicit MameOPNA(OPNFamily f);
+    explicit MameOPNA(OPNFamily f, void *core);
     ~MameOPNA() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return true; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
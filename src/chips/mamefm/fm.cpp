@@ -1572,12 +1572,17 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 }
 
 /* initialize generic tables */
+static bool tables_ready = false;
 static int init_tables(void)
 {
 	signed int i,x;
 	signed int n;
 	double o,m;
 
+	/* tables are shared by all chips and never change, build them once */
+	if (tables_ready)
+		return 1;
+
 	for (x=0; x<TL_RES_LEN; x++)
 	{
 		m = (1<<16) / pow(2, (x+1) * (ENV_STEP/4.0) / 8.0);
@@ -1677,7 +1682,7 @@ static int init_tables(void)
 		}
 	}
 
-
+	tables_ready = true;
 
 #ifdef SAVE_SAMPLE
 	sample[0]=fopen("sampsum.pcm","wb");
@@ -2683,8 +2688,12 @@ CONSTEXPR int steps[49] =
 
 void Init_ADPCMATable()
 {
+	static bool table_ready = false;
 	int step, nib;
 
+	if (table_ready)
+		return;
+
 	for (step = 0; step < 49; step++)
 	{
 		/* loop over all nibbles and compute the difference */
@@ -2694,6 +2703,8 @@ void Init_ADPCMATable()
 			jedi_table[step*16 + nib] = (nib&0x08) ? -value : value;
 		}
 	}
+
+	table_ready = true;
 }
 
 #ifdef MAME_EMU_SAVE_H
@@ -190,6 +190,9 @@ namespace FM
 
 		// libOPNMIDI: soft panning
 		void	SetPan(uint c, uint8 p);
+
+		// libOPNMIDI: FM-only mixing, skips SSG, rhythm and ADPCM parts
+		void	MixFM(Sample* buffer, int nsamples) { FMMix(buffer, nsamples); }
 	
 		void	DataSave(struct OPNABaseData* data);
 		void	DataLoad(struct OPNABaseData* data);
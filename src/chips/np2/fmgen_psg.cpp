@@ -86,15 +86,23 @@ void PSG::MakeNoiseTable()
 //
 void PSG::SetVolume(int volume)
 {
-	double base = 0x4000 / 3.0 * pow(10.0, volume / 40.0);
-	for (int i=31; i>=2; i--)
+	// Tables are shared by all instances, rebuild them only when the volume changes
+	static bool tablemade = false;
+	static int tablevolume = 0;
+	if (!tablemade || tablevolume != volume)
 	{
-		EmitTable[i] = int(base);
-		base /= 1.189207115;
+		double base = 0x4000 / 3.0 * pow(10.0, volume / 40.0);
+		for (int i=31; i>=2; i--)
+		{
+			EmitTable[i] = int(base);
+			base /= 1.189207115;
+		}
+		EmitTable[1] = 0;
+		EmitTable[0] = 0;
+		MakeEnvelopTable();
+		tablevolume = volume;
+		tablemade = true;
 	}
-	EmitTable[1] = 0;
-	EmitTable[0] = 0;
-	MakeEnvelopTable();
 
 	SetChannelMask(~mask);
 }
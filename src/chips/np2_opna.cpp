@@ -26,10 +26,11 @@
 #include <cstring>
 
 template <class ChipType>
-NP2OPNA<ChipType>::NP2OPNA(OPNFamily f)
-    : ChipBase(f)
+NP2OPNA<ChipType>::NP2OPNA(OPNFamily f, void *core)
+    : ChipBase(f), m_extrasActive(false)
 {
-    ChipType *opn = (ChipType *)std::calloc(1, sizeof(ChipType));
+    std::memset(core, 0, sizeof(ChipType));
+    ChipType *opn = static_cast<ChipType *>(core);
     chip = new(opn) ChipType;
     opn->Init(ChipBase::m_clock, ChipBase::m_rate);
     opn->SetReg(0x29, 0x9f);  // enable channels 4-6
@@ -39,7 +40,12 @@ template <class ChipType>
 NP2OPNA<ChipType>::~NP2OPNA()
 {
     chip->~ChipType();
-    std::free(chip);
+}
+
+template <class ChipType>
+size_t NP2OPNA<ChipType>::coreSize()
+{
+    return sizeof(ChipType);
 }
 
 template <class ChipType>
@@ -49,6 +55,7 @@ void NP2OPNA<ChipType>::setRate(uint32_t rate, uint32_t clock)
     uint32_t chipRate = ChipBase::isRunningAtPcmRate() ? rate : ChipBase::nativeRate();
     chip->SetRate(clock, chipRate, false);  // implies Reset()
     chip->SetReg(0x29, 0x9f);  // enable channels 4-6
+    m_extrasActive = false;
 }
 
 template <class ChipType>
@@ -57,11 +64,14 @@ void NP2OPNA<ChipType>::reset()
     ChipBase::reset();
     chip->Reset();
     chip->SetReg(0x29, 0x9f);  // enable channels 4-6
+    m_extrasActive = false;
 }
 
 template <class ChipType>
 void NP2OPNA<ChipType>::writeReg(uint32_t port, uint16_t addr, uint8_t data)
 {
+    if(opn_isExtraBlockRegister(port, addr))
+        m_extrasActive = true;
     chip->SetReg((port << 8) | addr, data);
 }
 
@@ -75,7 +85,10 @@ template <class ChipType>
 void NP2OPNA<ChipType>::nativeGenerateN(int16_t *output, size_t frames)
 {
     std::memset(output, 0, 2 * frames * sizeof(output[0]));
-    chip->Mix(output, static_cast<int>(frames));
+    if(m_extrasActive)
+        chip->Mix(output, static_cast<int>(frames));
+    else
+        chip->MixFM(output, static_cast<int>(frames));
 }
 
 template <>
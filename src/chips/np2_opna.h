@@ -29,10 +29,14 @@ class NP2OPNA final : public OPNChipBaseBufferedT<NP2OPNA<ChipType > >
 {
     typedef OPNChipBaseBufferedT<NP2OPNA<ChipType > > ChipBase;
     ChipType *chip;
+    //! Were SSG, rhythm or ADPCM blocks touched since reset? If not, only FM gets mixed
+    bool m_extrasActive;
 public:
-    explicit NP2OPNA(OPNFamily f);
+    explicit NP2OPNA(OPNFamily f, void *core);
     ~NP2OPNA() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return true; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
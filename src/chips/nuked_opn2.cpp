@@ -22,18 +22,24 @@
 #include "nuked/ym3438.h"
 #include <cstring>
 
-NukedOPN2::NukedOPN2(OPNFamily f, bool ym3438)
+NukedOPN2::NukedOPN2(OPNFamily f, bool ym3438, void *core)
     : OPNChipBaseT(f), m_isym3438(ym3438)
 {
-    OPN2_SetChipType(m_isym3438 ? ym3438_mode_readmode : ym3438_mode_ym2612);
-    chip = new ym3438_t;
+    ym3438_t *chip_r = static_cast<ym3438_t*>(core);
+    std::memset(chip_r, 0, sizeof(ym3438_t));
+    OPN2_SetChipType(chip_r, m_isym3438 ? ym3438_mode_readmode : ym3438_mode_ym2612);
+    chip = chip_r;
     NukedOPN2::setRate(m_rate, m_clock);
 }
 
 NukedOPN2::~NukedOPN2()
 {
-    ym3438_t *chip_r = reinterpret_cast<ym3438_t*>(chip);
-    delete chip_r;
+    // The core is a plain structure in the chip block, nothing to release
+}
+
+size_t NukedOPN2::coreSize()
+{
+    return sizeof(ym3438_t);
 }
 
 void NukedOPN2::setRate(uint32_t rate, uint32_t clock)
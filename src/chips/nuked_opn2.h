@@ -28,9 +28,11 @@ class NukedOPN2 final : public OPNChipBaseT<NukedOPN2>
     void *chip;
     bool m_isym3438;
 public:
-    explicit NukedOPN2(OPNFamily f, bool ym3438);
+    explicit NukedOPN2(OPNFamily f, bool ym3438, void *core);
     ~NukedOPN2() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return false; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
@@ -38,6 +38,54 @@ class VResampler;
 extern void opn2_audioTickHandler(void *instance, uint32_t chipId, uint32_t rate);
 #endif
 
+/**
+ * @brief Is this register a part of the SSG, rhythm or ADPCM blocks of OPNA/OPNB chips?
+ * @param port Register port
+ * @param addr Register address
+ * @return true if register doesn't belong to the FM part
+ */
+inline bool opn_isExtraBlockRegister(uint32_t port, uint16_t addr)
+{
+    return (port == 0) ? (addr < 0x20) : (addr < 0x30);
+}
+
+/*
+ * The state of the emulator core is placed into the same block right after
+ * its wrapper object. Every wrapper reports the size of its core by the static
+ * coreSize() call, and takes the storage of it by the constructor.
+ */
+
+//! Alignment of emulator cores placed after their wrappers
+enum { opn_chipCoreAlign = 16 };
+
+/**
+ * @brief Offset of the emulator core from the start of the chip block
+ * @param wrapperSize Size of the wrapper object
+ */
+inline size_t opn_chipCoreOffset(size_t wrapperSize)
+{
+    return ((wrapperSize + opn_chipCoreAlign - 1) / opn_chipCoreAlign) * opn_chipCoreAlign;
+}
+
+/**
+ * @brief Size of the chip block: the wrapper of the type T and its emulator core
+ */
+template <class T>
+inline size_t opn_chipBlockSize()
+{
+    return opn_chipCoreOffset(sizeof(T)) + T::coreSize();
+}
+
+/**
+ * @brief Storage of the emulator core of the type T in the chip block
+ * @param block Start of the chip block
+ */
+template <class T>
+inline void *opn_chipCore(void *block)
+{
+    return static_cast<char *>(block) + opn_chipCoreOffset(sizeof(T));
+}
+
 class OPNChipBase
 {
 protected:
@@ -102,6 +150,9 @@ public:
     explicit OPNChipBaseT(OPNFamily f);
     virtual ~OPNChipBaseT();
 
+    //! Size of the emulator core placed after the wrapper, the wrapper keeps its core by itself when 0
+    static size_t coreSize() { return 0; }
+
     OPNFamily family() const override;
     uint32_t nativeClockRate() const override;
 
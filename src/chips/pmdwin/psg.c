@@ -209,18 +209,24 @@ void PSGSetReg(PSG *psg, uint8_t regnum, uint8_t data)
 // Init code. Set volume to 0, reset the chip, enable all channels, seed the RNG.
 // RNG seed lifted from MAME's YM2149F emulation routine, appears to be correct.
 */
+static int tables_ready = 0;
 void PSGInit(PSG *psg)
 {
     int i;
     float base = 0x4000 / 3.0f;
-    for (i=31; i>=2; i--)
+    /* Tables are shared by all chips and never change, build them once */
+    if (!tables_ready)
     {
-        EmitTable[i] = lrintf(base);
-        base *= 0.840896415f; /* 1.0f / 1.189207115f */
+        for (i=31; i>=2; i--)
+        {
+            EmitTable[i] = lrintf(base);
+            base *= 0.840896415f; /* 1.0f / 1.189207115f */
+        }
+        EmitTable[1] = 0;
+        EmitTable[0] = 0;
+        MakeEnvelopTable();
+        tables_ready = 1;
     }
-    EmitTable[1] = 0;
-    EmitTable[0] = 0;
-    MakeEnvelopTable();
 
     PSGSetChannelMask(psg, psg->mask);
     psg->rng = 14231;
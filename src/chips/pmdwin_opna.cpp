@@ -23,18 +23,22 @@
 #include <cstring>
 #include <cassert>
 
-PMDWinOPNA::PMDWinOPNA(OPNFamily f)
+PMDWinOPNA::PMDWinOPNA(OPNFamily f, void *core)
     : OPNChipBaseBufferedT(f)
 {
-    OPNA *opn = new OPNA;
+    OPNA *opn = static_cast<OPNA *>(core);
     chip = reinterpret_cast<ChipType *>(opn);
     setRate(m_rate, m_clock);
 }
 
 PMDWinOPNA::~PMDWinOPNA()
 {
-    OPNA *opn = reinterpret_cast<OPNA *>(chip);
-    delete opn;
+    // The core is a plain structure in the chip block, nothing to release
+}
+
+size_t PMDWinOPNA::coreSize()
+{
+    return sizeof(OPNA);
 }
 
 void PMDWinOPNA::setRate(uint32_t rate, uint32_t clock)
@@ -28,9 +28,11 @@ class PMDWinOPNA final : public OPNChipBaseBufferedT<PMDWinOPNA>
     struct ChipType;
     ChipType *chip;
 public:
-    explicit PMDWinOPNA(OPNFamily f);
+    explicit PMDWinOPNA(OPNFamily f, void *core);
     ~PMDWinOPNA() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return true; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
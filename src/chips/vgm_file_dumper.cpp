@@ -20,8 +20,8 @@
 
 #include "vgm_file_dumper.h"
 #include <inttypes.h>
+#include <cstdio>
 #include <cstring>
-#include <cassert>
 
 #include <opnmidi_private.hpp>
 
@@ -33,92 +33,105 @@
 #   define PRIX32 "X"
 #endif
 
-//! FIXME: Replace this ugly crap with proper public call
-static const char *g_vgm_path = "kek.vgm";
+//! Output path for players which have no own destination set
+static std::string g_vgm_path = "kek.vgm";
 extern "C"
 {
+    /**
+     * @brief Sets the VGM file path for all players which have no own path set
+     * @deprecated Global and not thread-safe, use opn2_setVgmOutPath() or opn2_setVgmWriteHook()
+     */
     OPNMIDI_EXPORT void opn2_set_vgm_out_path(const char *path)
     {
-        g_vgm_path = path;
+        g_vgm_path = path ? path : "";
     }
 }
 
 
 #define VGM_LOOP_START_BASE 0x1C
 #define VGM_SONG_DATA_START 0x38
+//! YM2608 clock needs the VGM 1.51 header
+#define VGM_SONG_DATA_START_151 0x80
+//! Upper limit of the recorded data, longer songs are cut
+#define VGM_MAX_DATA_SIZE   0x8000000
 
-static void g_write_le(FILE *f_out, uint32_t &field)
+static void g_write_le(uint8_t *out, uint32_t field)
 {
-    uint8_t out[4];
     out[0] = (field) & 0xFF;
     out[1] = (field >> 8) & 0xFF;
     out[2] = (field >> 16) & 0xFF;
     out[3] = (field >> 24) & 0xFF;
-    std::fwrite(&out, 1, 4, f_out);
 }
 
-static void g_write_le(FILE *f_out, uint16_t &field)
+static void g_write_le(uint8_t *out, uint16_t field)
 {
-    uint8_t out[4];
     out[0] = (field) & 0xFF;
     out[1] = (field >> 8) & 0xFF;
-    std::fwrite(&out, 1, 2, f_out);
 }
 
 void VGMFileDumper::writeHead()
 {
-    if(!m_output)
-        return;
-
-    long offset = std::ftell(m_output);
-
-    if(offset < 0)
+    if(m_output.size() < m_data_start)
         return; // FATAL ERROR:
 
-    std::fseek(m_output, 0x00, SEEK_SET);
-    std::fwrite(m_vgm_head.magic, 1, 4, m_output);
-    g_write_le(m_output, m_vgm_head.eof_offset);
-    g_write_le(m_output, m_vgm_head.version);
-    g_write_le(m_output, m_vgm_head.clock_sn76489);
-    g_write_le(m_output, m_vgm_head.clock_ym2413);
-    g_write_le(m_output, m_vgm_head.offset_gd3);
-    g_write_le(m_output, m_vgm_head.total_samples);
-    g_write_le(m_output, m_vgm_head.offset_loop);
-    g_write_le(m_output, m_vgm_head.loop_samples);
-    g_write_le(m_output, m_vgm_head.rate);
-    g_write_le(m_output, m_vgm_head.feedback_sn76489);
-    std::fwrite(&m_vgm_head.shift_register_width_sn76489, 1, 1, m_output);
-    std::fwrite(&m_vgm_head.flags_sn76489, 1, 1, m_output);
-    g_write_le(m_output, m_vgm_head.clock_ym2612);
-    g_write_le(m_output, m_vgm_head.clock_ym2151);
-    g_write_le(m_output, m_vgm_head.offset_data);
-    std::fseek(m_output, offset, SEEK_SET);
+    uint8_t *out = &m_output[0];
+    std::memcpy(out + 0x00, m_vgm_head.magic, 4);
+    g_write_le(out + 0x04, m_vgm_head.eof_offset);
+    g_write_le(out + 0x08, m_vgm_head.version);
+    g_write_le(out + 0x0C, m_vgm_head.clock_sn76489);
+    g_write_le(out + 0x10, m_vgm_head.clock_ym2413);
+    g_write_le(out + 0x14, m_vgm_head.offset_gd3);
+    g_write_le(out + 0x18, m_vgm_head.total_samples);
+    g_write_le(out + 0x1C, m_vgm_head.offset_loop);
+    g_write_le(out + 0x20, m_vgm_head.loop_samples);
+    g_write_le(out + 0x24, m_vgm_head.rate);
+    g_write_le(out + 0x28, m_vgm_head.feedback_sn76489);
+    out[0x2A] = m_vgm_head.shift_register_width_sn76489;
+    out[0x2B] = m_vgm_head.flags_sn76489;
+    g_write_le(out + 0x2C, m_vgm_head.clock_ym2612);
+    g_write_le(out + 0x30, m_vgm_head.clock_ym2151);
+    g_write_le(out + 0x34, m_vgm_head.offset_data);
+    if(m_data_start >= VGM_SONG_DATA_START_151)
+        g_write_le(out + 0x48, m_vgm_head.clock_ym2608);
+}
+
+void VGMFileDumper::writeData(const uint8_t *data, size_t size)
+{
+    if(m_overflow)
+        return;
+    if(m_output.size() + size > VGM_MAX_DATA_SIZE)
+    {
+        // Keep the recorded part, and stop the song here
+        m_overflow = true;
+        m_end_caught = true;
+        message("VGM: Output exceeds %" PRIu32 " bytes, the rest of the song is cut", VGM_MAX_DATA_SIZE);
+        return;
+    }
+    m_output.insert(m_output.end(), data, data + size);
+    m_bytes_written += static_cast<uint32_t>(size);
 }
 
 void VGMFileDumper::writeWait(uint_fast16_t value)
 {
-    if(!m_output)
+    if(m_output.empty())
         return;
     uint8_t out[3];
     out[0] = 0x61;
     if(value == 735)
     {
         out[0] = 0x62;
-        std::fwrite(&out, 1, 1, m_output);
-        m_bytes_written += 1;
+        writeData(out, 1);
     }
     else if(value == 882)
     {
         out[0] = 0x63;
-        std::fwrite(&out, 1, 1, m_output);
-        m_bytes_written += 1;
+        writeData(out, 1);
     }
     else
     {
         out[1] = value & 0xFF;
         out[2] = (value >> 8) & 0xFF;
-        std::fwrite(&out, 1, 3, m_output);
-        m_bytes_written += 3;
+        writeData(out, 3);
     }
     m_samples_written += value;
     m_samples_loop += value;
@@ -126,7 +139,7 @@ void VGMFileDumper::writeWait(uint_fast16_t value)
 
 void VGMFileDumper::flushWait()
 {
-    if(!m_output)
+    if(m_output.empty())
         return;
 
     if(m_chip_index > 0)
@@ -151,40 +164,98 @@ void VGMFileDumper::flushWait()
 
 void VGMFileDumper::writeCommand(uint_fast8_t cmd, uint_fast16_t key, uint_fast8_t value)
 {
-    if(!m_output)
+    if(m_output.empty())
         return;
     uint8_t out[3];
     out[0] = static_cast<uint8_t>(cmd);
     out[1] = static_cast<uint8_t>(key);
     out[2] = static_cast<uint8_t>(value);
-    std::fwrite(&out, 1, 3, m_output);
-    m_bytes_written += 3;
+    writeData(out, 3);
 }
 
-VGMFileDumper::VGMFileDumper(OPNFamily f, int index, void *first)
-    : OPNChipBaseBufferedT(f)
+bool VGMFileDumper::finalize()
 {
-    m_output = NULL;
+    if(m_output.empty())
+        return true;
+
+    if(m_samples_written == 0)
+        return true; // Nothing was recorded, don't produce an empty song
+
+    if(m_latchPending)
+    {
+        m_latchPending = false;
+        emitReg(m_latchPort, m_latchAddr, m_latchData);
+    }
+
+    // End of sound data, always fits: the limit is checked before every command
+    m_output.push_back(0x66);
+    m_bytes_written += 1;
+
+    m_vgm_head.total_samples = m_samples_written;
+    m_vgm_head.loop_samples = m_samples_loop;
+    m_vgm_head.eof_offset = (m_data_start + m_bytes_written - 4);
+    m_vgm_head.offset_data = m_data_start - 0x34;
+
+    writeHead();
+
+    if(m_sink && m_sink->writeHook)
+        m_sink->writeHook(m_sink->writeHookData, &m_output[0], m_output.size());
+    else
+    {
+        const std::string &path = (m_sink && !m_sink->path.empty()) ? m_sink->path : g_vgm_path;
+        if(path.empty())
+            return !m_overflow;
+        FILE *f_out = std::fopen(path.c_str(), "wb");
+        if(!f_out)
+        {
+            if(m_sink && m_sink->messageHook)
+                m_sink->messageHook(m_sink->messageHookData, "VGM: Can't open the output file %s", path.c_str());
+            return false;
+        }
+        bool written = std::fwrite(&m_output[0], 1, m_output.size(), f_out) == m_output.size();
+        written = (std::fclose(f_out) == 0) && written;
+        if(!written)
+        {
+            if(m_sink && m_sink->messageHook)
+                m_sink->messageHook(m_sink->messageHookData, "VGM: Can't write the output file %s", path.c_str());
+            return false;
+        }
+    }
+
+    return !m_overflow;
+}
+
+VGMFileDumper::VGMFileDumper(OPNFamily f, int index, void *first, const Output *sink)
+    : OPNChipBaseT(f)
+{
+    m_sink = sink;
     m_bytes_written = 0;
     m_samples_written = 0;
     m_samples_loop = 0;
     m_actual_rate = 0;
     m_delay = 0;
+    m_delay_carry = 0;
     m_end_caught = false;
+    m_overflow = false;
     m_chip_index = index;
     m_first = NULL;
+    m_latchPending = false;
+    m_latchPort = 0;
+    m_latchAddr = 0;
+    m_latchData = 0;
+    m_data_start = (f == OPNChip_OPNA) ? VGM_SONG_DATA_START_151 : VGM_SONG_DATA_START;
+    clearShadow();
 
-    VGMFileDumper::setRate(m_rate, m_clock);
     std::memset(&m_vgm_head, 0, sizeof(VgmHead));
+    VGMFileDumper::setRate(m_rate, m_clock);
 
     if(m_chip_index == 0)
     {
-        m_output = std::fopen(g_vgm_path, "wb");
-        assert(m_output);
+        m_output.reserve(0x10000);
+        m_output.resize(m_data_start, 0);
         std::memcpy(m_vgm_head.magic, "Vgm ", 4);
-        m_vgm_head.version = 0x00000150;
-        m_vgm_head.offset_loop = VGM_LOOP_START_BASE;
-        std::fseek(m_output, VGM_SONG_DATA_START, SEEK_SET);
+        m_vgm_head.version = (m_data_start >= VGM_SONG_DATA_START_151) ? 0x00000151 : 0x00000150;
+        m_vgm_head.offset_loop = m_data_start - VGM_LOOP_START_BASE;
     }
     else
     {
@@ -196,41 +267,42 @@ VGMFileDumper::~VGMFileDumper()
 {
     if(m_chip_index > 0)
         return;
-
-    uint8_t out[1];
-    out[0] = 0x66;// end of sound data
-    std::fwrite(&out, 1, 1, m_output);
-    m_bytes_written += 1;
-
-    m_vgm_head.total_samples = m_samples_written;
-    m_vgm_head.loop_samples = m_samples_loop;
-    m_vgm_head.eof_offset = (VGM_SONG_DATA_START + m_bytes_written - 4);
-    m_vgm_head.offset_data = 0x04;
-
-    writeHead();
-
-    if(m_output)
-        std::fclose(m_output);
+    finalize();
 }
 
 void VGMFileDumper::setRate(uint32_t rate, uint32_t clock)
 {
-    OPNChipBaseBufferedT::setRate(rate, clock);
+    OPNChipBaseT::setRate(rate, clock);
     m_actual_rate = isRunningAtPcmRate() ? rate : nativeRate();
-    m_vgm_head.clock_ym2612 = m_clock;
+    chipClock() = m_clock;
+}
+
+uint32_t &VGMFileDumper::chipClock()
+{
+    return (m_family == OPNChip_OPNA) ? m_vgm_head.clock_ym2608 : m_vgm_head.clock_ym2612;
+}
+
+void VGMFileDumper::message(const char *fmt, uint32_t value) const
+{
+    if(m_sink && m_sink->messageHook)
+        m_sink->messageHook(m_sink->messageHookData, fmt, value);
 }
 
 void VGMFileDumper::reset()
 {
-    if(!m_output)
+    if(m_output.empty())
         return;
-    OPNChipBaseBufferedT::reset();
-    std::fseek(m_output, VGM_SONG_DATA_START, SEEK_SET);
+    OPNChipBaseT::reset();
+    m_output.resize(m_data_start);
     m_samples_written = 0;
     m_samples_loop = 0;
     m_bytes_written = 0;
     m_end_caught = false;
+    m_overflow = false;
     m_delay = 0;
+    m_delay_carry = 0;
+    m_latchPending = false;
+    clearShadow();
 }
 
 void VGMFileDumper::writeReg(uint32_t port, uint16_t addr, uint8_t data)
@@ -242,32 +314,151 @@ void VGMFileDumper::writeReg(uint32_t port, uint16_t addr, uint8_t data)
         return;
     }
 
-    if(!m_output)
+    if(m_output.empty())
         return;
 
     if(port >= 4u)
         return; // VGM DOESN'T SUPPORTS MORE THAN 2 CHIPS
 
-    if(port >= 2u && ((m_vgm_head.clock_ym2612 & 0x40000000) == 0))
-        m_vgm_head.clock_ym2612 |= 0x40000000;
+    if(port >= 2u && ((chipClock() & 0x40000000) == 0))
+        chipClock() |= 0x40000000; // Dual chip mode
+
+    addr &= 0xFF;
+
+    if(m_latchPending)
+    {
+        if(port == m_latchPort && addr == (m_latchAddr & 0xFB))
+        {
+            // Paired low byte of frequency: drop both when nothing changes
+            m_latchPending = false;
+            if(!regChanged(port, m_latchAddr, m_latchData) && !regChanged(port, addr, data))
+                return;
+            emitReg(port, m_latchAddr, m_latchData);
+            emitReg(port, addr, data);
+            return;
+        }
+        else if(port != m_latchPort || addr != m_latchAddr)
+        {
+            m_latchPending = false;
+            emitReg(m_latchPort, m_latchAddr, m_latchData);
+        }
+    }
+
+    if((addr & 0xF4) == 0xA4 && (addr & 0x03) != 0x03)
+    {
+        // Frequency high byte gets latched until the low byte write
+        m_latchPending = true;
+        m_latchPort = static_cast<uint8_t>(port);
+        m_latchAddr = addr;
+        m_latchData = data;
+        return;
+    }
+
+    if(!regChanged(port, addr, data))
+        return;
+
+    emitReg(port, addr, data);
+}
+
+void VGMFileDumper::clearShadow()
+{
+    std::memset(m_regData, 0, sizeof(m_regData));
+    std::memset(m_regValid, 0, sizeof(m_regValid));
+    std::memset(m_keyOn, 0, sizeof(m_keyOn));
+    std::memset(m_keyValid, 0, sizeof(m_keyValid));
+}
+
+bool VGMFileDumper::regChanged(uint32_t port, uint16_t addr, uint8_t data) const
+{
+    const size_t chip = port >> 1;
+    const uint_fast16_t reg = ((port & 1) << 8) | addr;
+
+    if(m_family == OPNChip_OPNA)
+    {
+        switch(reg)
+        {
+        case 0x00D: // SSG envelope shape, a write restarts the envelope
+        case 0x010: // Rhythm key-on and dump
+        case 0x100: // ADPCM control, starts and stops the playback
+            return true;
+        default:
+            break;
+        }
+    }
+
+    switch(reg)
+    {
+    case 0x024: // Timer Registers
+    case 0x025:
+    case 0x026:
+        return false;
+    case 0x027: // Only the Channel 3 mode bits are important
+        return !m_regValid[chip][reg] || (data & 0xC0) != (m_regData[chip][reg] & 0xC0);
+    case 0x028:
+        return !m_keyValid[chip][data & 0x07] || data != m_keyOn[chip][data & 0x07];
+    case 0x02A: // DAC data is always written
+        return true;
+    default:
+        return !m_regValid[chip][reg] || data != m_regData[chip][reg];
+    }
+}
+
+void VGMFileDumper::emitReg(uint32_t port, uint16_t addr, uint8_t data)
+{
+    const size_t chip = port >> 1;
+    const uint_fast16_t reg = ((port & 1) << 8) | addr;
+
+    if(reg == 0x028)
+    {
+        m_keyOn[chip][data & 0x07] = data;
+        m_keyValid[chip][data & 0x07] = true;
+    }
+    else
+    {
+        m_regData[chip][reg] = data;
+        m_regValid[chip][reg] = true;
+    }
 
     flushWait();
 
-    uint_fast8_t ports[] = {0x52, 0x53, 0xA2, 0xA3};
-    writeCommand(ports[port], addr, data);
+    static const uint_fast8_t portsOPN2[] = {0x52, 0x53, 0xA2, 0xA3};
+    static const uint_fast8_t portsOPNA[] = {0x56, 0x57, 0xA6, 0xA7};
+    writeCommand((m_family == OPNChip_OPNA) ? portsOPNA[port] : portsOPN2[port], addr, data);
 }
 
 void VGMFileDumper::writePan(uint16_t /*chan*/, uint8_t /*data*/)
 {}
 
-void VGMFileDumper::nativeGenerateN(int16_t *output, size_t frames)
+void VGMFileDumper::nativeGenerate(int16_t *frame)
+{
+    // Nothing gets played, but callers are mixing this output
+    frame[0] = 0;
+    frame[1] = 0;
+    if(m_output.empty())
+        return;
+    if(m_chip_index > 0 || m_end_caught) // When it's a second chip
+        return;
+    // Frame by frame, so the waits follow register writes without buffering latency
+    addDelay(1, m_actual_rate);
+}
+
+void VGMFileDumper::advanceTime(uint64_t frames)
 {
-    if(!m_output)
+    if(m_output.empty())
         return;
     if(m_chip_index > 0 || m_end_caught) // When it's a second chip
         return;
-    std::memset(output, 0, frames * sizeof(int16_t) * 2);
-    m_delay += size_t(frames * (44100.0 / double(m_actual_rate)));
+    addDelay(frames, m_rate);
+}
+
+void VGMFileDumper::addDelay(uint64_t frames, uint32_t rate)
+{
+    if(rate == 0)
+        return;
+    // Whole 1/44100'ths of second go into the wait, the remainder is kept exactly
+    m_delay_carry += frames * 44100;
+    m_delay += m_delay_carry / rate;
+    m_delay_carry %= rate;
 }
 
 const char *VGMFileDumper::emulatorName()
@@ -280,10 +471,11 @@ void VGMFileDumper::writeLoopStart()
     if(m_chip_index > 0)
         return;
     flushWait();
-    m_vgm_head.offset_loop = VGM_LOOP_START_BASE + m_bytes_written;
+    m_vgm_head.offset_loop = m_data_start - VGM_LOOP_START_BASE + m_bytes_written;
     m_samples_loop = 0;
-    std::printf(" - MIDI2VGM: Loop start at 0x%04" PRIX32 "\n", m_vgm_head.offset_loop);
-    std::fflush(stdout);
+    // Chip state at the loop end is unknown, all registers must be written again
+    clearShadow();
+    message("VGM: Loop start at 0x%04" PRIX32, m_vgm_head.offset_loop);
 }
 
 void VGMFileDumper::writeLoopEnd()
@@ -292,8 +484,7 @@ void VGMFileDumper::writeLoopEnd()
         return;
     m_end_caught = true;
     flushWait();
-    std::printf(" - MIDI2VGM: Loop end with total wait in %" PRIu32 " samples\n", m_samples_loop);
-    std::fflush(stdout);
+    message("VGM: Loop end with total wait in %" PRIu32 " samples", m_samples_loop);
 }
 
 void VGMFileDumper::loopStartHook(void *self)
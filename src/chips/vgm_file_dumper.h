@@ -22,11 +22,47 @@
 #define VGM_FILE_DUMPER_H
 
 #include "opn_chip_base.h"
+#include <string>
+#include <vector>
 
-class VGMFileDumper final : public OPNChipBaseBufferedT<VGMFileDumper>
+class VGMFileDumper final : public OPNChipBaseT<VGMFileDumper>
 {
-    //! Output file instance
-    FILE    *m_output;
+public:
+    //! Callback which receives the complete VGM data
+    typedef void (*WriteHook)(void *userData, const uint8_t *data, size_t size);
+    //! Callback which receives messages of the dumper (same as the debug message hook)
+    typedef void (*MessageHook)(void *userData, const char *fmt, ...);
+
+    /**
+     * @brief Destination of the finished VGM data
+     *
+     * When the write hook is set, the data is passed into it,
+     * otherwise it gets written into the file at the given path,
+     * or at the path set by the deprecated opn2_set_vgm_out_path() call.
+     * Loop points and errors are reported through the message hook.
+     */
+    struct Output
+    {
+        //! Path to the output file
+        std::string path;
+        //! Write callback
+        WriteHook   writeHook;
+        //! User data of the write callback
+        void       *writeHookData;
+        //! Message callback
+        MessageHook messageHook;
+        //! User data of the message callback
+        void       *messageHookData;
+        Output() : writeHook(NULL), writeHookData(NULL), messageHook(NULL), messageHookData(NULL) {}
+    };
+
+private:
+    //! Output data buffer, header is patched on finalizing
+    std::vector<uint8_t> m_output;
+    //! Destination of the output data (owned by the caller)
+    const Output *m_sink;
+    //! Offset of the song data, depends on the header version
+    uint32_t m_data_start;
     //! Count of song bytes written into the file
     uint32_t m_bytes_written;
     //! Waiting delay of song in 1/44100'ths of second
@@ -37,13 +73,34 @@ class VGMFileDumper final : public OPNChipBaseBufferedT<VGMFileDumper>
     uint32_t m_actual_rate;
     //! Cached delay value in 1/44100'ths of second
     uint64_t m_delay;
+    //! Remainder of the delay in 1/(44100 * rate)'ths of second
+    uint64_t m_delay_carry;
     //! Don't increase waiting delay after end of song caught
     bool     m_end_caught;
+    //! Output reached the size limit, nothing more gets recorded
+    bool     m_overflow;
     //! Index of chip (0'th is master, 1 is a helper)
     int      m_chip_index;
     //! First chip
     VGMFileDumper* m_first;
 
+    //! Shadow copy of registers of both chips, used to skip redundant writes
+    uint8_t  m_regData[2][0x200];
+    //! Shadow register has a known value
+    bool     m_regValid[2][0x200];
+    //! Shadow copy of Key-On state of every channel of both chips
+    uint8_t  m_keyOn[2][8];
+    //! Shadow Key-On state has a known value
+    bool     m_keyValid[2][8];
+    //! Frequency high byte write is held until the paired low byte write
+    bool     m_latchPending;
+    //! Port of the held frequency high byte write
+    uint8_t  m_latchPort;
+    //! Register of the held frequency high byte write
+    uint16_t m_latchAddr;
+    //! Value of the held frequency high byte write
+    uint8_t  m_latchData;
+
     struct VgmHead
     {
         char     magic[4];
@@ -62,15 +119,26 @@ class VGMFileDumper final : public OPNChipBaseBufferedT<VGMFileDumper>
         uint32_t clock_ym2612;
         uint32_t clock_ym2151;
         uint32_t offset_data;
+        uint32_t clock_ym2608;
     };
     VgmHead m_vgm_head;
 
     void writeHead();
+    void writeData(const uint8_t *data, size_t size);
     void writeCommand(uint_fast8_t cmd, uint_fast16_t key = 0, uint_fast8_t value = 0);
     void writeWait(uint_fast16_t value);
     void flushWait();
+    bool finalize();
+    void clearShadow();
+    void addDelay(uint64_t frames, uint32_t rate);
+    bool regChanged(uint32_t port, uint16_t addr, uint8_t data) const;
+    void emitReg(uint32_t port, uint16_t addr, uint8_t data);
+    //! Clock field of the header which belongs to the chip family
+    uint32_t &chipClock();
+    //! Pass the message into the message hook of the output
+    void message(const char *fmt, uint32_t value) const;
 public:
-    explicit VGMFileDumper(OPNFamily f, int index, void *first);
+    explicit VGMFileDumper(OPNFamily f, int index, void *first, const Output *sink = NULL);
     ~VGMFileDumper() override;
 
     bool canRunAtPcmRate() const override { return true; }
@@ -80,8 +148,18 @@ public:
     void writePan(uint16_t chan, uint8_t data) override;
     void nativePreGenerate() override {}
     void nativePostGenerate() override {}
-    void nativeGenerateN(int16_t *output, size_t frames) override;
+    void nativeGenerate(int16_t *frame) override;
     const char *emulatorName() override;
+    /**
+     * @brief Advance the song time directly without generating any audio
+     * @param frames Count of frames at the output sample rate to append to the pending wait
+     */
+    void advanceTime(uint64_t frames);
+    /**
+     * @brief Has the output reached the size limit?
+     * @return true when the rest of the song is cut
+     */
+    bool overflowed() const { return m_overflow; }
     void writeLoopStart();
     void writeLoopEnd();
     static void loopStartHook(void *self);
@@ -988,6 +988,7 @@ ym2608::ym2608(ymfm_interface &intf) :
 	m_address(0),
 	m_irq_enable(0x1f),
 	m_flag_control(0x1c),
+	m_fm_only(false),
 	m_fm(intf),
 	m_ssg(intf),
 	m_ssg_resampler(m_ssg),
@@ -1338,7 +1339,10 @@ void ym2608::generate(output_data *output, uint32_t numsamples)
 	}
 
 	// resample the SSG as configured
-	m_ssg_resampler.resample(output - numsamples, numsamples);
+	if (m_fm_only)
+		m_ssg_resampler.skip(output - numsamples, numsamples);
+	else
+		m_ssg_resampler.resample(output - numsamples, numsamples);
 }
 
 
@@ -1412,6 +1416,14 @@ void ym2608::clock_fm_and_adpcm()
 	// clock the system
 	uint32_t env_counter = m_fm.clock(fm_engine::ALL_CHANNELS);
 
+	// libOPNMIDI: FM-only mode, ADPCM engines are unused
+	if (m_fm_only)
+	{
+		m_fm.output(m_last_fm.clear(), 1, 32767, fmmask);
+		m_last_fm.clamp16();
+		return;
+	}
+
 	// clock the ADPCM-A engine on every envelope cycle
 	// (channels 4 and 5 clock every 2 envelope clocks)
 	if (bitfield(env_counter, 0, 2) == 0)
@@ -373,6 +373,15 @@ public:
 		(this->*m_resampler)(output, numsamples);
 	}
 
+	// libOPNMIDI: skip the SSG, write silence and only advance the sample index
+	void skip(OutputType *output, uint32_t numsamples)
+	{
+		for (uint32_t samp = 0; samp < numsamples; samp++, output++)
+			for (int index = 0; index < (MixTo1 ? 1 : 3); index++)
+				output->data[FirstOutput + index] = 0;
+		m_sampindex += numsamples;
+	}
+
 private:
 	// resample SSG output to the target at a rate of 1 SSG sample
 	// to every n output samples
@@ -508,6 +517,9 @@ public:
 	// configuration
 	void ssg_override(ssg_override &intf) { m_ssg.override(intf); }
 	void set_fidelity(opn_fidelity fidelity) { m_fidelity = fidelity; update_prescale(m_fm.clock_prescale()); }
+	// libOPNMIDI: skip SSG and ADPCM engines while they are unused
+	void set_fm_only(bool fm_only) { m_fm_only = fm_only; }
+	bool fm_only() const { return m_fm_only; }
 
 	// reset
 	void reset();
@@ -559,6 +571,7 @@ protected:
 	uint8_t m_fm_samples_per_output;    // how many samples to repeat
 	uint8_t m_irq_enable;               // IRQ enable register
 	uint8_t m_flag_control;             // flag control register
+	bool m_fm_only;                     // skip SSG and ADPCM engines (libOPNMIDI)
 	fm_engine::output_data m_last_fm;   // last FM output
 	fm_engine m_fm;                     // core FM engine
 	ssg_engine m_ssg;                   // SSG engine
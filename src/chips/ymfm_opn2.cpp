@@ -21,26 +21,39 @@
 #include "ymfm_opn2.h"
 #include "ymfm/ymfm_opn.h"
 #include <cstring>
+#include <new>
 #include <assert.h>
 
-YmFmOPN2::YmFmOPN2(OPNFamily f) :
+//! Emulator core, placed into the chip block after the wrapper
+struct YmFmOPN2_Core
+{
+    ymfm::ymfm_interface intf;
+    ymfm::ym2612 chip;
+
+    YmFmOPN2_Core() : intf(), chip(intf) {}
+};
+
+YmFmOPN2::YmFmOPN2(OPNFamily f, void *core) :
     OPNChipBaseT(f),
     m_headPos(0),
     m_tailPos(0),
     m_queueCount(0)
 {
-    ymfm::ymfm_interface* intf = new ymfm::ymfm_interface;
-    m_intf = intf;
-    m_chip = new ymfm::ym2612(*intf);
+    YmFmOPN2_Core *core_r = new(core) YmFmOPN2_Core;
+    m_core = core_r;
+    m_chip = &core_r->chip;
     YmFmOPN2::setRate(m_rate, m_clock);
 }
 
 YmFmOPN2::~YmFmOPN2()
 {
-    ymfm::ym2612 *chip_r = reinterpret_cast<ymfm::ym2612*>(m_chip);
-    ymfm::ymfm_interface *intf_r = reinterpret_cast<ymfm::ymfm_interface*>(m_intf);
-    delete chip_r;
-    delete intf_r;
+    YmFmOPN2_Core *core_r = reinterpret_cast<YmFmOPN2_Core*>(m_core);
+    core_r->~YmFmOPN2_Core();
+}
+
+size_t YmFmOPN2::coreSize()
+{
+    return sizeof(YmFmOPN2_Core);
 }
 
 void YmFmOPN2::setRate(uint32_t rate, uint32_t clock)
@@ -26,7 +26,7 @@
 class YmFmOPN2 final : public OPNChipBaseT<YmFmOPN2>
 {
     void *m_chip;
-    void *m_intf;
+    void *m_core;
 
     static const size_t c_queueSize = 2048;
 
@@ -42,9 +42,11 @@ class YmFmOPN2 final : public OPNChipBaseT<YmFmOPN2>
     long m_queueCount;
 
 public:
-    explicit YmFmOPN2(OPNFamily f);
+    explicit YmFmOPN2(OPNFamily f, void *core);
     ~YmFmOPN2() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return false; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
@@ -21,6 +21,7 @@
 #include "ymfm_opna.h"
 #include "ymfm/ymfm_opn.h"
 #include <cstring>
+#include <new>
 #include <assert.h>
 
 struct YmFmOPNA_Private
@@ -37,29 +38,39 @@ struct YmFmOPNA_Private
     void nativeGenerate(int16_t *frame, void *m_chip, void *m_output);
 };
 
-YmFmOPNA::YmFmOPNA(OPNFamily f) :
-    OPNChipBaseT(f),
-    p(new YmFmOPNA_Private)
+//! Emulator core, placed into the chip block after the wrapper
+struct YmFmOPNA_Core
 {
-    ymfm::ymfm_interface* intf = new ymfm::ymfm_interface;
-    m_intf = intf;
-    m_chip = new ymfm::ym2608(*intf);
-    ymfm::ym2608::output_data* output = new ymfm::ym2608::output_data;
-    output->clear();
-    m_output = output;
+    YmFmOPNA_Private p;
+    ymfm::ymfm_interface intf;
+    ymfm::ym2608 chip;
+    ymfm::ym2608::output_data output;
+
+    YmFmOPNA_Core() : p(), intf(), chip(intf), output() {}
+};
+
+YmFmOPNA::YmFmOPNA(OPNFamily f, void *core) :
+    OPNChipBaseT(f)
+{
+    YmFmOPNA_Core *core_r = new(core) YmFmOPNA_Core;
+    m_core = core_r;
+    p = &core_r->p;
+    m_chip = &core_r->chip;
+    core_r->output.clear();
+    m_output = &core_r->output;
     YmFmOPNA::setRate(m_rate, m_clock);
     writeReg(0, 0x29, 0x9f);  // enable channels 4-6
 }
 
 YmFmOPNA::~YmFmOPNA()
 {
-    delete p;
-    ymfm::ym2608 *chip_r = reinterpret_cast<ymfm::ym2608*>(m_chip);
-    ymfm::ymfm_interface *intf_r = reinterpret_cast<ymfm::ymfm_interface*>(m_intf);
-    ymfm::ym2608::output_data *output_r = reinterpret_cast<ymfm::ym2608::output_data*>(m_output);
-    delete chip_r;
-    delete intf_r;
-    delete output_r;
+    YmFmOPNA_Core *core_r = reinterpret_cast<YmFmOPNA_Core*>(m_core);
+    core_r->~YmFmOPNA_Core();
+}
+
+size_t YmFmOPNA::coreSize()
+{
+    return sizeof(YmFmOPNA_Core);
 }
 
 void YmFmOPNA::setRate(uint32_t rate, uint32_t clock)
@@ -70,6 +81,8 @@ void YmFmOPNA::setRate(uint32_t rate, uint32_t clock)
     p->m_out_step = 0x100000000ull / nativeRate();
     p->m_step = 0x100000000ull / chip_r->sample_rate(m_clock);
     p->m_pos = 0;
+    // FM-only until SSG, rhythm or ADPCM registers get written
+    chip_r->set_fm_only(p->m_queueCount == 0);
     writeReg(0, 0x29, 0x9f);  // enable channels 4-6
 }
 
@@ -81,11 +94,18 @@ void YmFmOPNA::reset()
     p->m_out_step = 0x100000000ull / nativeRate();
     p->m_step = 0x100000000ull / chip_r->sample_rate(m_clock);
     p->m_pos = 0;
+    // FM-only until SSG, rhythm or ADPCM registers get written
+    chip_r->set_fm_only(p->m_queueCount == 0);
     writeReg(0, 0x29, 0x9f);  // enable channels 4-6
 }
 
 void YmFmOPNA::writeReg(uint32_t port, uint16_t addr, uint8_t data)
 {
+    if(opn_isExtraBlockRegister(port, addr))
+    {
+        ymfm::ym2608 *chip_r = reinterpret_cast<ymfm::ym2608*>(m_chip);
+        chip_r->set_fm_only(false);
+    }
     p->writeReg(port, addr, data);
 }
 
@@ -29,7 +29,7 @@ class YmFmOPNA final : public OPNChipBaseT<YmFmOPNA>
 {
     friend struct YmFmOPNA_Private;
     void *m_chip;
-    void *m_intf;
+    void *m_core;
     void *m_output;
 
     static const size_t c_queueSize = 2048;
@@ -43,9 +43,11 @@ class YmFmOPNA final : public OPNChipBaseT<YmFmOPNA>
     YmFmOPNA_Private *p;
 
 public:
-    explicit YmFmOPNA(OPNFamily f);
+    explicit YmFmOPNA(OPNFamily f, void *core);
     ~YmFmOPNA() override;
 
+    static size_t coreSize();
+
     bool canRunAtPcmRate() const override { return false; }
     void setRate(uint32_t rate, uint32_t clock) override;
     void reset() override;
@@ -33,32 +33,46 @@
 #include "../midi_sequencer.hpp"
 
 
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
 double BW_MidiSequencer::Tick(double s, double granularity)
+{
+    return waitToSeconds(TickFrames(secondsToWait(s), secondsToWait(granularity)));
+}
+
+BW_MidiSequencer::WaitTime BW_MidiSequencer::TickFrames(WaitTime s, WaitTime granularity)
+#else
+double BW_MidiSequencer::Tick(double s, double granularity)
+#endif
 {
     assert(m_interface); // MIDI output interface must be defined!
 
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    s = static_cast<WaitTime>((static_cast<uint64_t>(s) * m_tempoMultiplierFx) >> WaitTimeShift);
+    m_currentPosition.absTimePosition += waitToSeconds(s);
+#else
     s *= m_tempoMultiplier;
+    m_currentPosition.absTimePosition += s;
+#endif
 #ifdef ENABLE_BEGIN_SILENCE_SKIPPING
     if(CurrentPositionNew.began)
 #endif
         m_currentPosition.wait -= s;
-    m_currentPosition.absTimePosition += s;
 
     int antiFreezeCounter = 10000; // Limit 10000 loops to avoid freezing
-    while((m_currentPosition.wait <= granularity * 0.5) && (antiFreezeCounter > 0))
+    while((m_currentPosition.wait <= granularity / 2) && (antiFreezeCounter > 0))
     {
         if(!processEvents())
             break;
-        if(m_currentPosition.wait <= 0.0)
+        if(m_currentPosition.wait <= 0)
             antiFreezeCounter--;
     }
 
     if(antiFreezeCounter <= 0)
-        m_currentPosition.wait += 1.0; /* Add extra 1 second when over 10000 events
-                                          with zero delay are been detected */
+        m_currentPosition.wait += secondsToWait(1.0); /* Add extra 1 second when over 10000 events
+                                                         with zero delay are been detected */
 
-    if(m_currentPosition.wait < 0.0) // Avoid negative delay value!
-        return 0.0;
+    if(m_currentPosition.wait < 0) // Avoid negative delay value!
+        return 0;
 
     return m_currentPosition.wait;
 }
@@ -108,8 +122,9 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
 {
     if(seconds < 0.0)
         return 0.0; // Seeking negative position is forbidden! :-P
-    const double granualityHalf = granularity * 0.5,
-                 s = seconds; // m_setup.delay < m_setup.maxdelay ? m_setup.delay : m_setup.maxdelay;
+    const WaitTime granualityHalf = secondsToWait(granularity) / 2,
+                   waitStep = secondsToWait(seconds);
+    const double   s = seconds; // m_setup.delay < m_setup.maxdelay ? m_setup.delay : m_setup.maxdelay;
 
     /* Attempt to go away out of song end must rewind position to begin */
     if(seconds > m_fullSongTimeLength)
@@ -144,10 +159,10 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
     while((m_currentPosition.absTimePosition < seconds) &&
           (m_currentPosition.absTimePosition < m_fullSongTimeLength))
     {
-        m_currentPosition.wait -= s;
+        m_currentPosition.wait -= waitStep;
         m_currentPosition.absTimePosition += s;
         int antiFreezeCounter = 10000; // Limit 10000 loops to avoid freezing
-        double dstWait = m_currentPosition.wait + granualityHalf;
+        WaitTime dstWait = m_currentPosition.wait + granualityHalf;
         while((m_currentPosition.wait <= granualityHalf)/*&& (antiFreezeCounter > 0)*/)
         {
             // std::fprintf(stderr, "wait = %g...\n", CurrentPosition.wait);
@@ -163,12 +178,12 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
             }
         }
         if(antiFreezeCounter <= 0)
-            m_currentPosition.wait += 1.0;/* Add extra 1 second when over 10000 events
-                                             with zero delay are been detected */
+            m_currentPosition.wait += secondsToWait(1.0);/* Add extra 1 second when over 10000 events
+                                                            with zero delay are been detected */
     }
 
-    if(m_currentPosition.wait < 0.0)
-        m_currentPosition.wait = 0.0;
+    if(m_currentPosition.wait < 0)
+        m_currentPosition.wait = 0;
 
     if(m_atEnd)
     {
@@ -178,10 +193,10 @@ double BW_MidiSequencer::seek(double seconds, const double granularity)
     }
 
     m_time.reset();
-    m_time.delay = m_currentPosition.wait;
+    m_time.delay = waitToSeconds(m_currentPosition.wait);
 
     m_loopEnabled = loopFlagState;
-    return m_currentPosition.wait;
+    return m_time.delay;
 }
 
 double BW_MidiSequencer::tell()
@@ -241,6 +256,16 @@ double BW_MidiSequencer::getTempoMultiplier()
 void BW_MidiSequencer::setTempo(double tempo)
 {
     m_tempoMultiplier = tempo;
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    m_tempoMultiplierFx = static_cast<uint64_t>(tempo * (1 << WaitTimeShift));
+#endif
 }
 
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+uint64_t BW_MidiSequencer::getTempoMultiplierFx()
+{
+    return m_tempoMultiplierFx;
+}
+#endif
+
 #endif /* BW_MIDISEQ_IO_IMPL_HPP */
@@ -27,6 +27,7 @@
 #define BW_MIDISEQ_MIDIDATA_IMPL_HPP
 
 #include <cstring>
+#include <algorithm>
 #ifdef BWMIDI_DEBUG_TIME_CALCULATION
 #   include <inttypes.h>
 #   if !defined(__PRIPTR_PREFIX)
@@ -64,11 +65,13 @@ void BW_MidiSequencer::buildSmfSetupReset(size_t trackCount)
     m_currentPosition.clear();
     m_trackBeginPosition.clear();
     m_loopBeginPosition.clear();
+    m_rowBeginPosition.clear();
 
     m_musTrackTitles.clear();
     m_musMarkers.clear();
     m_dataBank.clear();
     m_eventBank.clear();
+    m_noteDurations.clear();
     m_branches.clear();
 
     m_trackData.clear();
@@ -355,6 +358,62 @@ void BW_MidiSequencer::buildTimeLine(const std::vector<TempoEvent> &tempos,
                 break;
         }
     }
+
+    reservePositions();
+
+    if(m_interface && m_interface->rt_noteDuration)
+        buildNoteDurations();
+}
+
+void BW_MidiSequencer::reservePositions()
+{
+    size_t i, tk, depth;
+
+    // Positions get copied while playing: keep their storage big enough
+    // to never allocate the memory from the audio thread
+    m_currentPosition.track.reserve(m_tracksCount);
+    m_loopBeginPosition.track.reserve(m_tracksCount);
+    m_rowBeginPosition.track.reserve(m_tracksCount);
+
+    // The first entry of the loop stack is being used even when no stack loops are in the song
+    depth = std::max<size_t>(m_loop.stackDepth, 1);
+    for(i = 0; i < depth; ++i)
+        m_loop.stack[i].startPosition.track.reserve(m_tracksCount);
+
+    // Track-local loops store the state of their own track only
+    for(tk = 0; tk < m_tracksCount; ++tk)
+    {
+        LoopState &loop = m_trackState[tk].loop;
+        depth = std::max<size_t>(loop.stackDepth, 1);
+        for(i = 0; i < depth; ++i)
+            loop.stack[i].startPosition.track.reserve(1);
+    }
+}
+
+void BW_MidiSequencer::buildNoteDurations()
+{
+    std::vector<NoteSpan> spans;
+    getNoteSpans(spans);
+
+    // Negative value marks the unknown duration
+    m_noteDurations.assign(m_eventBank.size(), -1.0);
+
+    for(size_t i = 0; i < spans.size(); ++i)
+    {
+        const NoteSpan &n = spans[i];
+        m_noteDurations[n.event] = n.end - n.begin;
+    }
+}
+
+void BW_MidiSequencer::updateNoteDurations()
+{
+    if(m_interface && m_interface->rt_noteDuration)
+    {
+        if(m_noteDurations.size() != m_eventBank.size())
+            buildNoteDurations();
+    }
+    else
+        std::vector<double>().swap(m_noteDurations);
 }
 
 #endif /* BW_MIDISEQ_READ_SMF_IMPL_HPP */
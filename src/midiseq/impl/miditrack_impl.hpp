@@ -65,7 +65,7 @@ BW_MidiSequencer::Position::TrackInfo &BW_MidiSequencer::Position::TrackInfo::op
 }
 
 BW_MidiSequencer::Position::Position():
-    wait(0.0),
+    wait(0),
     absTimePosition(0.0),
     absTickPosition(0),
     began(false),
@@ -74,7 +74,7 @@ BW_MidiSequencer::Position::Position():
 
 void BW_MidiSequencer::Position::clear()
 {
-    wait = 0.0;
+    wait = 0;
     began = false;
     absTimePosition = 0.0;
     absTickPosition = 0;
@@ -33,6 +33,17 @@
 
 
 
+void BW_MidiSequencer::passNoteDuration(const MidiEvent &evt, size_t midCh)
+{
+    const size_t index = static_cast<size_t>(&evt - &m_eventBank[0]);
+    double seconds = -1.0;
+
+    if(index < m_noteDurations.size() && m_noteDurations[index] >= 0.0)
+        seconds = m_noteDurations[index] / m_tempoMultiplier;
+
+    m_interface->rt_noteDuration(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], seconds);
+}
+
 void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEvent &evt, int32_t &status)
 {
     size_t length, midCh, loopStackLevel;
@@ -337,6 +348,8 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
     case MidiEvent::T_NOTEON:  // Note on
         if(evt.channel < 16 && m_channelDisable[evt.channel])
             return; // Disabled channel
+        if(m_interface->rt_noteDuration)
+            passNoteDuration(evt, midCh);
         m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         return;
 
@@ -347,6 +360,8 @@ void BW_MidiSequencer::handleEvent(size_t track, const BW_MidiSequencer::MidiEve
             note->note = evt.data_loc[0];
             note->velocity = evt.data_loc[1];
             note->ttl = readBEint(evt.data_loc + 2, 3);
+            if(m_interface->rt_noteDuration)
+                passNoteDuration(evt, midCh);
             m_interface->rt_noteOn(m_interface->rtUserData, static_cast<uint8_t>(midCh), evt.data_loc[0], evt.data_loc[1]);
         }
         return;
@@ -520,7 +535,7 @@ bool BW_MidiSequencer::processLoopPoints(LoopRuntimeState &state, LoopState &loo
                     if(m_loopHooksOnly) // Stop song on reaching loop end
                     {
                         m_atEnd = true; // Don't handle events anymore
-                        m_currentPosition.wait += m_postSongWaitDelay; // One second delay until stop playing
+                        m_currentPosition.wait += secondsToWait(m_postSongWaitDelay); // One second delay until stop playing
                     }
                 }
 
@@ -666,7 +681,9 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
 
     m_loop.caughtEnd = false;
     const size_t        trackCount = m_currentPosition.track.size();
-    const Position      rowBeginPosition(m_currentPosition);
+    // Storage of the row position is reserved on load, so copying doesn't allocate
+    m_rowBeginPosition = m_currentPosition;
+    const Position      &rowBeginPosition = m_rowBeginPosition;
     LoopRuntimeState    loopState, loopStateLoc;
     Tempo_t t;
 
@@ -808,7 +825,7 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
     if(m_currentPosition.began)
 #endif
     {
-        m_currentPosition.wait += tempo_get(&t);
+        m_currentPosition.wait += tempo_getWait(&t);
         m_currentPosition.absTickPosition += shortestDelay;
     }
 
@@ -829,7 +846,7 @@ bool BW_MidiSequencer::processEvents(bool isSeek)
         if(!m_loopEnabled || (shortestDelayNotFound && m_loop.loopsCount >= 0 && m_loop.loopsLeft < 1) || m_loopHooksOnly)
         {
             m_atEnd = true; // Don't handle events anymore
-            m_currentPosition.wait += m_postSongWaitDelay; // One second delay until stop playing
+            m_currentPosition.wait += secondsToWait(m_postSongWaitDelay); // One second delay until stop playing
             return true; // We have caugh end here!
         }
 
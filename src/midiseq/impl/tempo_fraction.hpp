@@ -69,4 +69,17 @@ void BW_MidiSequencer::tempo_mul(Tempo_t *out, const Tempo_t *val1, uint64_t val
     tempo_optimize(out);
 }
 
+BW_MidiSequencer::WaitTime BW_MidiSequencer::tempo_getWait(const Tempo_t *tempo) const
+{
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    // Keep the fraction integer: whole frames first, then the fraction part of the frame
+    uint64_t frames = tempo->nom * m_time.sampleRate;
+    uint64_t whole = frames / tempo->denom;
+    uint64_t rest = ((frames % tempo->denom) << WaitTimeShift) / tempo->denom;
+    return static_cast<WaitTime>((whole << WaitTimeShift) + rest);
+#else
+    return tempo->nom / (double)tempo->denom;
+#endif
+}
+
 #endif /* BW_MIDISEQ_TEMPO_FRACTION_HPP */
@@ -48,6 +48,8 @@ typedef void (*SongStartHook)(void *userdata);
 
 /*! Note-On MIDI event */
 typedef void (*RtNoteOn)(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity);
+/*! Remaining duration of the Note-On MIDI event which will be passed next */
+typedef void (*RtNoteDuration)(void *userdata, uint8_t channel, uint8_t note, double seconds);
 /*! Note-Off MIDI event */
 typedef void (*RtNoteOff)(void *userdata, uint8_t channel, uint8_t note);
 /*! Note-Off MIDI event with a velocity */
@@ -162,6 +164,9 @@ typedef struct BW_MidiRtInterface
     /*! Get the channels offset for current MIDI device hook. Returms multiple to 16 value. */
     RtCurrentDevice     rt_currentDevice;
 
+    /*! Note duration hook, called right before the Note-On with the time until the note will be released */
+    RtNoteDuration      rt_noteDuration;
+
 
     /******************************************
      * NonStandard events. There are optional *
@@ -42,6 +42,20 @@ public:
      *                   Public structures and types definitions                      *
      **********************************************************************************/
 
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    /*!
+     * \brief Waiting time in 1/65536 fractions of the PCM frame
+     *
+     * The frame rate is the pcmSampleRate field of the real-time interface
+     */
+    typedef int64_t WaitTime;
+    //! Count of fraction bits in the WaitTime value
+    enum { WaitTimeShift = 16 };
+#else
+    //! Waiting time in seconds
+    typedef double WaitTime;
+#endif
+
     /*!
      * \brief Reference to the data bank entry
      */
@@ -143,6 +157,48 @@ public:
         Device_ANY              = 0xFFFF
     };
 
+    /**
+     * @brief Bit-masks of patches, banks and keys referenced by the loaded song
+     */
+    struct InstrumentsUsage
+    {
+        //! Patch numbers set on every MIDI channel
+        uint8_t patches[16][16];
+        //! Bank MSB values set on every MIDI channel
+        uint8_t bankMsb[16][16];
+        //! Bank LSB values set on every MIDI channel
+        uint8_t bankLsb[16][16];
+        //! Note keys played on every MIDI channel
+        uint8_t notes[16][16];
+        //! Song contains SysEx messages which may change the channel setup
+        bool    hasSysEx;
+    };
+
+    /**
+     * @brief Time span of one note played by the loaded song
+     */
+    struct NoteSpan
+    {
+        //! Time of the Note-On event in seconds
+        double  begin;
+        //! Time of the Note-Off event in seconds
+        double  end;
+        //! MIDI channel
+        uint8_t channel;
+        //! Note key
+        uint8_t note;
+        //! Note velocity
+        uint8_t velocity;
+        //! Patch set on the channel at the Note-On time
+        uint8_t patch;
+        //! Bank MSB set on the channel at the Note-On time
+        uint8_t bankMsb;
+        //! Bank LSB set on the channel at the Note-On time
+        uint8_t bankLsb;
+        //! Index of the Note-On event in the events bank
+        size_t  event;
+    };
+
 private:
     /**********************************************************************************
      *                   Private structures and types definitions                     *
@@ -514,8 +570,8 @@ private:
             TrackInfo &operator=(const TrackInfo &o);
         };
 
-        //! Waiting time before next event in seconds
-        double wait;
+        //! Waiting time before next event
+        WaitTime wait;
         //! Absolute time position on the track in seconds
         double absTimePosition;
         //! Absolute MIDI tick position on the song
@@ -742,6 +798,9 @@ private:
     //! Array of all MIDI events across all tracks
     std::vector<MidiEvent> m_eventBank;
 
+    //! Durations of Note-On events in seconds, indexed like the events bank (only with the note duration hook)
+    std::vector<double> m_noteDurations;
+
     //! The number of track of multi-track file (for exmaple, XMI) to load
     int m_loadTrackNumber;
 
@@ -767,6 +826,8 @@ private:
     Position m_trackBeginPosition;
     //! Loop start point
     Position m_loopBeginPosition;
+    //! Position at the begin of the currently processed row (scratch of processEvents())
+    Position m_rowBeginPosition;
 
     //! Is looping enabled or not
     bool    m_loopEnabled;
@@ -843,6 +904,10 @@ private:
 
     //! Global tempo multiplier factor
     double  m_tempoMultiplier;
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    //! Global tempo multiplier factor in 16.16 fixed-point format
+    uint64_t m_tempoMultiplierFx;
+#endif
     //! File parsing errors string (adding into m_errorString on aborting of the process)
     ErrString m_parsingErrorsString;
     //! Common error string
@@ -860,6 +925,41 @@ private:
      */
     static inline double tempo_get(Tempo_t *tempo) { return tempo->nom / (double)tempo->denom; }
 
+    /**
+     * @brief Convert fraction into the waiting time value
+     * @param tempo Tempo fraction value
+     * @return Waiting time converted from the fraction
+     */
+    WaitTime tempo_getWait(const Tempo_t *tempo) const;
+
+    /**
+     * @brief Convert time in seconds into the waiting time value
+     * @param seconds Time in seconds
+     * @return Waiting time value
+     */
+    inline WaitTime secondsToWait(double seconds) const
+    {
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+        return static_cast<WaitTime>(seconds * m_time.sampleRate * (1 << WaitTimeShift));
+#else
+        return seconds;
+#endif
+    }
+
+    /**
+     * @brief Convert the waiting time value into seconds
+     * @param wait Waiting time value
+     * @return Time in seconds
+     */
+    inline double waitToSeconds(WaitTime wait) const
+    {
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+        return static_cast<double>(wait) / (static_cast<double>(m_time.sampleRate) * (1 << WaitTimeShift));
+#else
+        return wait;
+#endif
+    }
+
     /**
      * @brief Multiple tempo fraction by integer
      * @param out Product output
@@ -968,6 +1068,20 @@ private:
                        uint64_t loopStartTicks = 0,
                        uint64_t loopEndTicks = 0);
 
+    /**
+     * @brief Reserve the storage of positions copied during playback
+     *
+     * Called by buildTimeLine() to keep the playback free of memory allocations
+     */
+    void reservePositions();
+
+    /**
+     * @brief Pre-calculate durations of all notes for the note duration hook
+     *
+     * Called by buildTimeLine() when the interface has the note duration hook
+     */
+    void buildNoteDurations();
+
 
     /**********************************************************************************
      *                                 Process                                        *
@@ -981,6 +1095,13 @@ private:
      */
     void handleEvent(size_t tk, const MidiEvent &evt, int32_t &status);
 
+    /**
+     * @brief Pass the remaining duration of the Note-On event to the note duration hook
+     * @param evt Note-On event entry of the events bank
+     * @param midCh Destination MIDI channel
+     */
+    void passNoteDuration(const MidiEvent &evt, size_t midCh);
+
     /**
      * @brief Run processing of active durated notes, trigger true Note-OFF events for expired notes
      * @param track Track where to run the operation
@@ -1411,6 +1532,31 @@ public:
      */
     const std::vector<MIDI_MarkerEntry> &getMarkers();
 
+    /**
+     * @brief Scan all events of the loaded song for patches, banks and keys in use
+     * @param usage Destination usage masks structure
+     */
+    void getInstrumentsUsage(InstrumentsUsage &usage) const;
+
+    /**
+     * @brief Count the different devices (MIDI ports) the loaded song switches to
+     * @return Count of distinct device names, zero if the song has no device switch events
+     */
+    size_t getDevicesCount() const;
+
+    /**
+     * @brief Walk through the whole song once (ignoring loops) and collect time spans of all notes
+     * @param spans Destination list of notes, ordered by the Note-On time
+     */
+    void getNoteSpans(std::vector<NoteSpan> &spans) const;
+
+    /**
+     * @brief Build or free durations of notes after the note duration hook was set or unset
+     *
+     * Durations are built while loading the song only when the hook is set already
+     */
+    void updateNoteDurations();
+
 
     /**********************************************************************************
      *                                 Load music                                     *
@@ -1462,6 +1608,22 @@ public:
      */
     double Tick(double s, double granularity);
 
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    /**
+     * @brief Periodic tick handler which counts time in the PCM frames
+     * @param s time since last call (see WaitTime)
+     * @param granularity don't expect intervals smaller than this (see WaitTime)
+     * @return desired time until next call (see WaitTime)
+     */
+    WaitTime TickFrames(WaitTime s, WaitTime granularity);
+
+    /**
+     * @brief Get current tempo multiplier value in 16.16 fixed-point format
+     * @return Tempo multiplier
+     */
+    uint64_t getTempoMultiplierFx();
+#endif
+
     /**
      * @brief Runs ticking in a sync with audio streaming. Use this together with onPcmRender hook to easily play MIDI.
      * @param stream pointer to the output PCM stream
@@ -25,6 +25,8 @@
 #include "midi_sequencer.hpp"
 #include <stdio.h>
 #include <cstring>
+#include <algorithm>
+#include <string>
 #include <cerrno>
 #include <cstdarg>
 #include <assert.h>
@@ -112,6 +114,9 @@ BW_MidiSequencer::BW_MidiSequencer() :
     m_deviceMaskAvailable(Device_ANY),
     m_trackSolo(~static_cast<size_t>(0)),
     m_tempoMultiplier(1.0)
+#ifdef BWMIDI_ENABLE_SAMPLE_TIMING
+    , m_tempoMultiplierFx(1 << WaitTimeShift)
+#endif
 {
     m_loop.reset();
     m_loop.invalidLoop = false;
@@ -392,3 +397,209 @@ const std::vector<BW_MidiSequencer::MIDI_MarkerEntry> &BW_MidiSequencer::getMark
 {
     return m_musMarkers;
 }
+
+void BW_MidiSequencer::getInstrumentsUsage(InstrumentsUsage &usage) const
+{
+    std::memset(&usage, 0, sizeof(InstrumentsUsage));
+
+    for(size_t i = 0; i < m_eventBank.size(); ++i)
+    {
+        const MidiEvent &evt = m_eventBank[i];
+        size_t ch = evt.channel % 16;
+
+        switch(evt.type)
+        {
+        case MidiEvent::T_NOTEON:
+        case MidiEvent::T_NOTEON_DURATED:
+            usage.notes[ch][(evt.data_loc[0] & 0x7F) / 8] |= static_cast<uint8_t>(1 << (evt.data_loc[0] % 8));
+            break;
+
+        case MidiEvent::T_PATCHCHANGE:
+            usage.patches[ch][(evt.data_loc[0] & 0x7F) / 8] |= static_cast<uint8_t>(1 << (evt.data_loc[0] % 8));
+            break;
+
+        case MidiEvent::T_CTRLCHANGE:
+            if(evt.data_loc[0] == 0)
+                usage.bankMsb[ch][(evt.data_loc[1] & 0x7F) / 8] |= static_cast<uint8_t>(1 << (evt.data_loc[1] % 8));
+            else if(evt.data_loc[0] == 32)
+                usage.bankLsb[ch][(evt.data_loc[1] & 0x7F) / 8] |= static_cast<uint8_t>(1 << (evt.data_loc[1] % 8));
+            break;
+
+        case MidiEvent::T_SYSEX:
+        case MidiEvent::T_SYSEX2:
+            usage.hasSysEx = true;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+size_t BW_MidiSequencer::getDevicesCount() const
+{
+    std::vector<std::string> names;
+
+    for(size_t i = 0; i < m_eventBank.size(); ++i)
+    {
+        const MidiEvent &evt = m_eventBank[i];
+        if(evt.type != MidiEvent::T_SPECIAL || evt.subtype != MidiEvent::ST_DEVICESWITCH)
+            continue;
+
+        size_t length = evt.data_block.size > 0 ? evt.data_block.size : static_cast<size_t>(evt.data_loc_size);
+        const uint8_t *data = evt.data_block.size > 0 ? getData(evt.data_block) : evt.data_loc;
+        std::string name(reinterpret_cast<const char *>(data), length);
+
+        if(std::find(names.begin(), names.end(), name) == names.end())
+            names.push_back(name);
+    }
+
+    return names.size();
+}
+
+/**
+ * @brief Reference to the channel event of some track, used by the note spans scanner
+ */
+struct BW_MidiSeqTimedEvent
+{
+    double time;
+    double secondsPerTick;
+    size_t event;
+
+    bool operator<(const BW_MidiSeqTimedEvent &o) const
+    {
+        return time < o.time;
+    }
+};
+
+void BW_MidiSequencer::getNoteSpans(std::vector<NoteSpan> &spans) const
+{
+    std::vector<BW_MidiSeqTimedEvent> events;
+    double songEnd = 0.0;
+
+    spans.clear();
+
+    for(size_t tk = 0; tk < m_trackData.size(); ++tk)
+    {
+        double secondsPerTick = 0.0;
+
+        for(MidiTrackQueue::const_iterator row = m_trackData[tk].begin(); row != m_trackData[tk].end(); ++row)
+        {
+            if(row->delay > 0)
+                secondsPerTick = row->timeDelay / static_cast<double>(row->delay);
+            if(row->time > songEnd)
+                songEnd = row->time;
+
+            for(size_t i = row->events_begin; i < row->events_end; ++i)
+            {
+                switch(m_eventBank[i].type)
+                {
+                case MidiEvent::T_NOTEON:
+                case MidiEvent::T_NOTEON_DURATED:
+                case MidiEvent::T_NOTEOFF:
+                case MidiEvent::T_PATCHCHANGE:
+                case MidiEvent::T_CTRLCHANGE:
+                {
+                    BW_MidiSeqTimedEvent e;
+                    e.time = row->time;
+                    e.secondsPerTick = secondsPerTick;
+                    e.event = i;
+                    events.push_back(e);
+                    break;
+                }
+
+                default:
+                    break;
+                }
+            }
+        }
+    }
+
+    // Same-time events of every track are kept in their order
+    std::stable_sort(events.begin(), events.end());
+
+    uint8_t patch[16], bankMsb[16], bankLsb[16];
+    bool sustain[16];
+    std::vector<size_t> playing(16 * 128, ~static_cast<size_t>(0));
+    // Notes released while the sustain pedal is held, they end on the pedal release
+    std::vector<size_t> sustained[16];
+    std::memset(patch, 0, sizeof(patch));
+    std::memset(sustain, 0, sizeof(sustain));
+    std::memset(bankMsb, 0, sizeof(bankMsb));
+    std::memset(bankLsb, 0, sizeof(bankLsb));
+
+    for(size_t i = 0; i < events.size(); ++i)
+    {
+        const BW_MidiSeqTimedEvent &e = events[i];
+        const MidiEvent &evt = m_eventBank[e.event];
+        const size_t ch = evt.channel % 16;
+
+        switch(evt.type)
+        {
+        case MidiEvent::T_PATCHCHANGE:
+            patch[ch] = evt.data_loc[0] & 0x7F;
+            break;
+
+        case MidiEvent::T_CTRLCHANGE:
+            if(evt.data_loc[0] == 0)
+                bankMsb[ch] = evt.data_loc[1] & 0x7F;
+            else if(evt.data_loc[0] == 32)
+                bankLsb[ch] = evt.data_loc[1] & 0x7F;
+            else if(evt.data_loc[0] == 64)
+            {
+                sustain[ch] = evt.data_loc[1] >= 64;
+                if(!sustain[ch])
+                {
+                    for(size_t j = 0; j < sustained[ch].size(); ++j)
+                        spans[sustained[ch][j]].end = e.time;
+                    sustained[ch].clear();
+                }
+            }
+            break;
+
+        case MidiEvent::T_NOTEON:
+        case MidiEvent::T_NOTEON_DURATED:
+        case MidiEvent::T_NOTEOFF:
+        {
+            const size_t key = ch * 128 + (evt.data_loc[0] & 0x7F);
+
+            // Note-On of already playing note, or Note-Off: finish the previous note
+            if(playing[key] < spans.size())
+            {
+                spans[playing[key]].end = e.time;
+                if(sustain[ch] && evt.type == MidiEvent::T_NOTEOFF)
+                {
+                    spans[playing[key]].end = songEnd;
+                    sustained[ch].push_back(playing[key]);
+                }
+                playing[key] = ~static_cast<size_t>(0);
+            }
+
+            if(evt.type == MidiEvent::T_NOTEOFF || evt.data_loc[1] == 0)
+                break;
+
+            NoteSpan span;
+            span.begin = e.time;
+            span.end = songEnd;
+            span.channel = static_cast<uint8_t>(ch);
+            span.note = evt.data_loc[0] & 0x7F;
+            span.velocity = evt.data_loc[1] & 0x7F;
+            span.patch = patch[ch];
+            span.bankMsb = bankMsb[ch];
+            span.bankLsb = bankLsb[ch];
+            span.event = e.event;
+
+            if(evt.type == MidiEvent::T_NOTEON_DURATED)
+                span.end = e.time + static_cast<double>(readBEint(evt.data_loc + 2, 3)) * e.secondsPerTick;
+            else
+                playing[key] = spans.size();
+
+            spans.push_back(span);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+}
@@ -469,3 +469,54 @@ uint16_t opnModel_genericFreqOPN2(double tone, uint32_t *mul_offset)
     return freq | (octave << 11);
 }
 
+
+/*
+ * Fixed-point version of the formula above for the targets without FPU.
+ * Limits are the same as above, scaled by OPN_TONE_FX_ONE, and the division
+ * by the table step is replaced with the multiplication by 2^32/step.
+ */
+#define OPN2_FX_MAX_TONE        789089  /* 30.823808 * 25600 */
+#define OPN2_FX_MAX_TONE_EXTRA  817495  /* 31.933413 * 25600 */
+#define OPN2_FX_OCTAVE          (12 * OPN_TONE_FX_ONE)
+#define OPN2_FX_INV_STEP        19764842u /* 2^32 / (0.0084884139 * 25600) */
+
+uint16_t opnModel_genericFreqOPN2Fx(int32_t tone, uint32_t *mul_offset)
+{
+    uint32_t octave = 0;
+    uint16_t freq;
+    size_t idx;
+
+    *mul_offset = 0;
+
+    if(tone < 0)
+        tone = 0;
+
+    /* Basic range until max of octaves reaching */
+    while(tone > OPN2_FX_MAX_TONE && octave < 7)
+    {
+        tone -= OPN2_FX_OCTAVE;
+        ++octave;
+    }
+
+    /* Extended range, rely on frequency multiplication increment */
+    while(tone > OPN2_FX_MAX_TONE_EXTRA)
+    {
+        tone -= OPN2_FX_OCTAVE;
+        ++octave;
+    }
+
+    idx = (size_t)(((uint64_t)tone * OPN2_FX_INV_STEP) >> 32) + 1;
+
+    if(idx >= OPN2_EXP_TABLE_SIZE)
+        idx = OPN2_EXP_TABLE_SIZE - 1; /* Out of range! */
+
+    freq = s_OPN2genericExpTable[idx];
+
+    while(octave > 7)
+    {
+        ++(*mul_offset);
+        --octave;
+    }
+
+    return freq | (octave << 11);
+}
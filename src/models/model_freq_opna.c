@@ -472,3 +472,45 @@ uint16_t opnModel_genericFreqOPNA(double tone, uint32_t *mul_offset)
     return freq | (octave << 11);
 }
 
+
+/*
+ * Fixed-point version of the formula above for the targets without FPU.
+ * Limits are the same as above, scaled by OPN_TONE_FX_ONE, and the division
+ * by the table step is replaced with the multiplication by 2^32/step.
+ */
+#define OPNA_FX_MAX_TONE        836944  /* 32.693164 * 25600 */
+#define OPNA_FX_OCTAVE          (12 * OPN_TONE_FX_ONE)
+#define OPNA_FX_INV_STEP        19767385u /* 2^32 / (0.0084873220 * 25600) */
+
+uint16_t opnModel_genericFreqOPNAFx(int32_t tone, uint32_t *mul_offset)
+{
+    uint32_t octave = 0;
+    uint16_t freq;
+    size_t idx;
+
+    *mul_offset = 0;
+
+    if(tone < 0)
+        tone = 0;
+
+    while(tone > OPNA_FX_MAX_TONE)
+    {
+        tone -= OPNA_FX_OCTAVE;
+        ++octave;
+    }
+
+    idx = (size_t)(((uint64_t)tone * OPNA_FX_INV_STEP) >> 32);
+
+    if(idx >= OPNA_EXP_TABLE_SIZE)
+        idx = OPNA_EXP_TABLE_SIZE - 1; /* Out of range! */
+
+    freq = s_OPNAgenericExpTable[idx];
+
+    while(octave > 7)
+    {
+        ++(*mul_offset);
+        --octave;
+    }
+
+    return freq | (octave << 11);
+}
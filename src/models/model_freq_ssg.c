@@ -0,0 +1,109 @@
+/*
+ * OPN2/OPNA models library - a set of various conversion models for OPL-family chips
+ *
+ * Copyright (c) 2025-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stddef.h>
+#include "opn_models.h"
+
+
+/***************************************************************
+ *                 SSG tone period formula                     *
+ ***************************************************************/
+
+/***************************************************************
+ * The SSG part of OPNA plays a square wave with the frequency *
+ * hz = clock / (64 * TP), where TP is a 12-bit tone period.   *
+ * The MIDI tone gives hz = 440 * 2^((tone - 69) / 12), so:    *
+ * TP = (clock / (64 * 440)) * 2^(-(tone - 69) / 12)           *
+ *                                                             *
+ * The fractional power of two is taken from the table of the  *
+ * 64 steps per octave with the linear interpolation.          *
+ ***************************************************************/
+
+#define SSG_OCTAVE_FX           (12 * OPN_TONE_FX_ONE)
+#define SSG_POW2_TABLE_STEPS    64
+#define SSG_POW2_TABLE_STEP     (SSG_OCTAVE_FX / SSG_POW2_TABLE_STEPS)
+#define SSG_PERIOD_MAX          0xFFF
+
+/* 2^(-i/64) in 16.16 fixed-point */
+static const uint32_t s_ssgPow2Table[SSG_POW2_TABLE_STEPS + 1] =
+{
+    65536, 64830, 64132, 63441, 62757, 62081, 61413, 60751,
+    60097, 59449, 58809, 58176, 57549, 56929, 56316, 55709,
+    55109, 54515, 53928, 53347, 52773, 52204, 51642, 51085,
+    50535, 49991, 49452, 48920, 48393, 47871, 47356, 46846,
+    46341, 45842, 45348, 44859, 44376, 43898, 43425, 42958,
+    42495, 42037, 41584, 41136, 40693, 40255, 39821, 39392,
+    38968, 38548, 38133, 37722, 37316, 36914, 36516, 36123,
+    35734, 35349, 34968, 34591, 34219, 33850, 33486, 33125,
+    32768
+};
+
+uint16_t opnModel_genericPeriodSSGFx(int32_t tone, uint32_t clock)
+{
+    int32_t rel = tone - 69 * OPN_TONE_FX_ONE;
+    int32_t octave, frac, idx, sub;
+    uint64_t period;
+    uint32_t mul;
+
+    /* Floor division, tones below the A4 give the negative octave */
+    octave = rel / SSG_OCTAVE_FX;
+    if(rel < 0 && octave * SSG_OCTAVE_FX != rel)
+        --octave;
+
+    frac = rel - octave * SSG_OCTAVE_FX;
+    idx = frac / SSG_POW2_TABLE_STEP;
+    sub = frac % SSG_POW2_TABLE_STEP;
+    mul = s_ssgPow2Table[idx] - (uint32_t)(((s_ssgPow2Table[idx] - s_ssgPow2Table[idx + 1]) * (uint32_t)sub) / SSG_POW2_TABLE_STEP);
+
+    /* 16.16 period of the tone at the octave of A4 */
+    period = ((uint64_t)clock * mul) / (64 * 440);
+
+    if(octave >= 0)
+        period = (octave < 40) ? (period >> octave) : 0;
+    else if(octave > -20)
+        period <<= -octave;
+    else
+        period = (uint64_t)SSG_PERIOD_MAX << 16;
+
+    period = (period + 0x8000) >> 16;
+
+    if(period < 1)
+        period = 1;
+    else if(period > SSG_PERIOD_MAX)
+        period = SSG_PERIOD_MAX;
+
+    return (uint16_t)period;
+}
+
+uint16_t opnModel_genericPeriodSSG(double tone, uint32_t clock)
+{
+    double fx = tone * OPN_TONE_FX_ONE;
+
+    if(fx > 0x7FFFFFFF - 1)
+        fx = 0x7FFFFFFF - 1;
+    else if(fx < -0x7FFFFFFF + 1)
+        fx = -0x7FFFFFFF + 1;
+
+    return opnModel_genericPeriodSSGFx((int32_t)(fx + (fx >= 0 ? 0.5 : -0.5)), clock);
+}
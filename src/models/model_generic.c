@@ -23,7 +23,6 @@
  */
 
 #include <stddef.h>
-#include <math.h>   /* log() */
 #include "opn_models.h"
 
 
@@ -31,27 +30,50 @@
  *                     Generic volume formula                  *
  ***************************************************************/
 
+/*! Pre-computed thresholds of the generic volume formula.
+    The N-th value is the lowest product of all input levels
+    where the formula result reaches (N + 1) * 2. Result of:
+    ```
+    volume = (uint_fast32_t)(log((double)volume) * c1 - c2) * 2;
+    ```
+    where c1 is 11.541560327111707 and c2 is 1.601379199767093e+02.
+    Products up to 1108075 (8725 * 127) are giving the zero result.
+*/
+static const uint32_t s_genericVolumeThresholds[] =
+{
+    1157227,   1261965,   1376183,   1500738,   1636566,   1784688,
+    1946216,   2122363,   2314454,   2523930,   2752365,   3001475,
+    3273132,   3569375,   3892431,   4244726,   4628907,   5047859,
+    5504729,   6002950,   6546263,   7138750,   7784862,   8489452,
+    9257814,   10095717,  11009458,  12005899,  13092525,  14277500,
+    15569724,  16978904,  18515627,  20191434,  22018915,  24011797,
+    26185050,  28554999,  31139448,  33957808,  37031253,  40382867,
+    44037829,  48023593,  52370100,  57109998,  62278895,  67915616,
+    74062505,  80765734,  88075658,  96047186,  104740199, 114219996,
+    124557789, 135831232, 148125009, 161531468, 176151315, 192094371,
+    209480397, 228439992, 249115578
+};
+
 void opnModel_genericVolume(struct OPNVolume_t *v)
 {
-    const double c1 = 11.541560327111707;
-    const double c2 = 1.601379199767093e+02;
-    const uint_fast32_t minVolume = 1108075; /* 8725 * 127 */
-    double lv;
+    const size_t thresholdsCount = sizeof(s_genericVolumeThresholds) / sizeof(uint32_t);
     uint_fast32_t volume = 0;
+    size_t lo = 0, hi = thresholdsCount, mid;
     size_t i;
 
     volume = v->vel * v->masterVolume * v->chVol * v->chExpr;
 
-    if(volume > minVolume)
+    /* Binary search of the count of passed thresholds */
+    while(lo < hi)
     {
-        lv = log((double)volume);
-        volume = (uint_fast32_t)(lv * c1 - c2) * 2;
-
-        if(volume > 127)
-            volume = 127;
+        mid = (lo + hi) / 2;
+        if(volume >= s_genericVolumeThresholds[mid])
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    else
-        volume = 0;
+
+    volume = (uint_fast32_t)lo * 2;
 
     for(i = 0; i < 4; ++i)
     {
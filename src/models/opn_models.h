@@ -53,6 +53,41 @@ extern uint16_t opnModel_genericFreqOPN2(double tone, uint32_t *mul_offset);
  */
 extern uint16_t opnModel_genericFreqOPNA(double tone, uint32_t *mul_offset);
 
+/*! Fixed-point tone scale: 1/256 of cent, so one semi-tone is 25600 units */
+#define OPN_TONE_FX_ONE 25600
+
+/**
+ * @brief Generic frequency formula for OPN2 chips, fixed-point version
+ * @param tone MIDI Note tone in fixed-point cents (see OPN_TONE_FX_ONE)
+ * @param mul_offset !REQUIRED! A pointer to the frequency multiplier offset if note is too high
+ * @return FNum+Block value compatible to OPN chips
+ */
+extern uint16_t opnModel_genericFreqOPN2Fx(int32_t tone, uint32_t *mul_offset);
+
+/**
+ * @brief Generic frequency formula for OPNA chips, fixed-point version
+ * @param tone MIDI Note tone in fixed-point cents (see OPN_TONE_FX_ONE)
+ * @param mul_offset !REQUIRED! A pointer to the frequency multiplier offset if note is too high
+ * @return FNum+Block value compatible to OPN chips
+ */
+extern uint16_t opnModel_genericFreqOPNAFx(int32_t tone, uint32_t *mul_offset);
+
+/**
+ * @brief Tone period formula for SSG part of OPNA chips
+ * @param tone MIDI Note semi-tone with detune (decimal is a detune)
+ * @param clock Master clock of the chip
+ * @return 12-bit tone period value
+ */
+extern uint16_t opnModel_genericPeriodSSG(double tone, uint32_t clock);
+
+/**
+ * @brief Tone period formula for SSG part of OPNA chips, fixed-point version
+ * @param tone MIDI Note tone in fixed-point cents (see OPN_TONE_FX_ONE)
+ * @param clock Master clock of the chip
+ * @return 12-bit tone period value
+ */
+extern uint16_t opnModel_genericPeriodSSGFx(int32_t tone, uint32_t clock);
+
 
 
 /***************************************************************
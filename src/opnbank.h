@@ -97,7 +97,11 @@ struct OpnInstMeta
     enum
     {
         Flag_Pseudo8op = 0x01,
-        Flag_NoSound = 0x02
+        Flag_NoSound = 0x02,
+        //! Rhythm voice of OPNA to use instead of FM (see OPN2_InstrumentFlags)
+        Flag_RhythmMask = 0x38,
+        //! Instrument may be played by the SSG channel of OPNA
+        Flag_SSG = 0x40
     };
 
     //! Operator data
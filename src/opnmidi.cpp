@@ -25,6 +25,7 @@
 #include "opnmidi_opn2.hpp"
 #include "opnmidi_private.hpp"
 #include "chips/opn_chip_base.h"
+#include "opnmidi_renderahead.hpp"
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
 #include "midiseq/midi_sequencer.hpp"
 #endif
@@ -46,25 +47,92 @@ static const OPNMIDI_AudioFormat opn2_DefaultAudioFormat =
     2 * sizeof(int16_t),
 };
 
+/**
+ * @brief Pauses the render thread of the render-ahead mode while the state gets changed
+ *
+ * On the transport changes, the audio rendered before gets dropped.
+ */
+class RenderAheadGuard
+{
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+    OpnRenderAhead *m_render;
+    bool m_flush;
+public:
+    explicit RenderAheadGuard(MidiPlayer *play, bool flush = true) :
+        m_render(play->m_renderAhead),
+        m_flush(flush)
+    {
+        if(m_render)
+            m_render->lock();
+    }
+
+    ~RenderAheadGuard()
+    {
+        if(m_render)
+            m_render->unlock(m_flush);
+    }
+#else
+public:
+    explicit RenderAheadGuard(MidiPlayer *, bool = true)
+    {}
+#endif
+};
+
 /*---------------------------EXPORTS---------------------------*/
 
 OPNMIDI_EXPORT struct OPN2_MIDIPlayer *opn2_init(long sample_rate)
 {
+    return opn2_initEx(sample_rate, NULL);
+}
+
+OPNMIDI_EXPORT struct OPN2_MIDIPlayer *opn2_initEx(long sample_rate, const OPN2_Allocator *allocator)
+{
+    ADLMIDI_Allocator alloc;
+    const ADLMIDI_Allocator *allocP = NULL;
+
+    if(allocator)
+    {
+        if(!allocator->allocate || !allocator->release)
+        {
+            OPN2MIDI_ErrorString = "Can't initialize OPNMIDI: allocator must have both allocate and release functions!";
+            return NULL;
+        }
+        alloc.allocate = allocator->allocate;
+        alloc.release = allocator->release;
+        alloc.userData = allocator->userData;
+        allocP = &alloc;
+    }
+
     OPN2_MIDIPlayer *midi_device;
-    midi_device = (OPN2_MIDIPlayer *)malloc(sizeof(OPN2_MIDIPlayer));
+    midi_device = (OPN2_MIDIPlayer *)adlmidi_allocMem(allocP, sizeof(OPN2_MIDIPlayer));
     if(!midi_device)
     {
         OPN2MIDI_ErrorString = "Can't initialize OPNMIDI: out of memory!";
         return NULL;
     }
 
-    OPNMIDIplay *player = new(std::nothrow) OPNMIDIplay(static_cast<unsigned long>(sample_rate));
-    if(!player)
+    void *mem = adlmidi_allocMem(allocP, sizeof(OPNMIDIplay));
+    if(!mem)
+    {
+        adlmidi_freeMem(midi_device);
+        OPN2MIDI_ErrorString = "Can't initialize OPNMIDI: out of memory!";
+        return NULL;
+    }
+
+    OPNMIDIplay *player;
+    try
+    {
+        player = new(mem) OPNMIDIplay(static_cast<unsigned long>(sample_rate), allocP);
+    }
+    catch(const std::bad_alloc &)
     {
-        free(midi_device);
+        // Members made before the failure are released already
+        adlmidi_freeMem(mem);
+        adlmidi_freeMem(midi_device);
         OPN2MIDI_ErrorString = "Can't initialize OPNMIDI: out of memory!";
         return NULL;
     }
+
     midi_device->opn2_midiPlayer = player;
     return midi_device;
 }
@@ -93,11 +161,16 @@ OPNMIDI_EXPORT int opn2_setNumChips(OPN2_MIDIPlayer *device, int numChips)
         return -1;
     }
 
+    // The explicitly set count of chips replaces the automatic choice
+    play->m_setup.autoNumChipsMax = 0;
+    play->m_setup.autoNumChips = 0;
+
     Synth &synth = *play->m_synth;
     if(!synth.setupLocked())
     {
         synth.m_numChips = play->m_setup.numChips;
-        play->partialReset();
+        if(!play->partialReset())
+            return -1;
     }
 
     return 0;
@@ -121,6 +194,76 @@ OPNMIDI_EXPORT int opn2_getNumChipsObtained(struct OPN2_MIDIPlayer *device)
     return (int)play->m_synth->m_numChips;
 }
 
+OPNMIDI_EXPORT int opn2_setAutoNumChips(struct OPN2_MIDIPlayer *device, int maxChips)
+{
+    if(device == NULL)
+        return -2;
+
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(maxChips < 0 || maxChips > OPN_MAX_CHIPS)
+    {
+        play->setErrorString("number of chips may only be 1.." OPN_MAX_CHIPS_STR ".\n");
+        return -1;
+    }
+
+    play->m_setup.autoNumChipsMax = static_cast<unsigned int>(maxChips);
+
+    if(maxChips == 0 && play->m_setup.autoNumChips > 0)
+    {
+        // Return to the manually set number of chips
+        play->m_setup.autoNumChips = 0;
+        Synth &synth = *play->m_synth;
+        if(!synth.setupLocked())
+        {
+            synth.m_numChips = play->m_setup.numChips;
+            if(!play->partialReset())
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+OPNMIDI_EXPORT int opn2_setChipGroups(struct OPN2_MIDIPlayer *device, int groups)
+{
+    if(device == NULL)
+        return -2;
+
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(groups < 1 || groups > OPN_MAX_CHIPS)
+    {
+        play->setErrorString("number of chip groups may only be 1.." OPN_MAX_CHIPS_STR ".\n");
+        return -1;
+    }
+
+    Synth &synth = *play->m_synth;
+    RenderAheadGuard guard(play, false);
+
+    // Notes already playing are staying on their chips until they end
+    const uint32_t oldGroups = synth.m_numChipGroups;
+    synth.m_numChipGroups = static_cast<uint32_t>(groups);
+    if(!synth.m_groupRenderer.prepare(synth))
+    {
+        synth.m_numChipGroups = oldGroups;
+        synth.m_groupRenderer.prepare(synth);
+        play->setErrorString("out of memory while preparing chip groups.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+OPNMIDI_EXPORT int opn2_getChipGroups(struct OPN2_MIDIPlayer *device)
+{
+    if(device == NULL)
+        return -2;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return (int)play->m_synth->chipGroupsCount();
+}
+
 
 OPNMIDI_EXPORT int opn2_reserveBanks(OPN2_MIDIPlayer *device, unsigned banks)
 {
@@ -129,7 +272,15 @@ OPNMIDI_EXPORT int opn2_reserveBanks(OPN2_MIDIPlayer *device, unsigned banks)
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
     Synth::BankMap &map = play->m_synth->m_insBanks;
-    map.reserve(banks);
+    try
+    {
+        map.reserve(banks);
+    }
+    catch(const std::bad_alloc &)
+    {
+        play->setErrorString("OPN2 MIDI: Out of memory");
+        return -1;
+    }
     return (int)map.capacity();
 }
 
@@ -170,7 +321,17 @@ OPNMIDI_EXPORT int opn2_getBank(OPN2_MIDIPlayer *device, const OPN2_BankId *idp,
                 return -1;
         }
         else
-            ir = map.insert(value);
+        {
+            try
+            {
+                ir = map.insert(value);
+            }
+            catch(const std::bad_alloc &)
+            {
+                play->setErrorString("OPN2 MIDI: Out of memory");
+                return -1;
+            }
+        }
         it = ir.first;
     }
 
@@ -201,7 +362,17 @@ OPNMIDI_EXPORT int opn2_removeBank(OPN2_MIDIPlayer *device, OPN2_Bank *bank)
     Synth::BankMap &map = play->m_synth->m_insBanks;
     Synth::BankMap::iterator it = Synth::BankMap::iterator::from_ptrs(bank->pointer);
     size_t size = map.size();
+    bool isPercussion = (it->first & Synth::PercussionTag) != 0;
+    play->sparseForgetBank(it->first);
     map.erase(it);
+    if(isPercussion)
+    {
+        // Percussion samples of the bank are no longer valid
+        play->m_synth->clearDacDrums();
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+        play->prerenderDacDrums();
+#endif
+    }
     return (map.size() != size) ? 0 : -1;
 }
 
@@ -258,8 +429,18 @@ OPNMIDI_EXPORT int opn2_setInstrument(OPN2_MIDIPlayer *device, OPN2_Bank *bank,
     if(ins->version != 0)
         return -1;
 
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
     Synth::BankMap::iterator it = Synth::BankMap::iterator::from_ptrs(bank->pointer);
     cvt_OPNI_to_FMIns(it->second.ins[index], *ins);
+    play->sparseKeepInstrument(it->first, index);
+    if((it->first & Synth::PercussionTag) != 0)
+    {
+        // Percussion samples of the old instrument data are no longer valid
+        play->m_synth->clearDacDrums(it->first, index);
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+        play->prerenderDacDrums();
+#endif
+    }
     return 0;
 }
 
@@ -403,6 +584,24 @@ OPNMIDI_EXPORT int opn2_getAutoArpeggio(OPN2_MIDIPlayer *device)
     return play->m_setup.enableAutoArpeggio ? 1 : 0;
 }
 
+OPNMIDI_EXPORT void opn2_setSparseBankLoading(OPN2_MIDIPlayer *device, int sparse)
+{
+    if(!device)
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    play->m_setup.sparseBanks = (sparse != 0);
+}
+
+OPNMIDI_EXPORT int opn2_getSparseBankLoading(OPN2_MIDIPlayer *device)
+{
+    if(!device)
+        return 0;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return play->m_setup.sparseBanks ? 1 : 0;
+}
+
 OPNMIDI_EXPORT void opn2_setLoopEnabled(OPN2_MIDIPlayer *device, int loopEn)
 {
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
@@ -410,6 +609,7 @@ OPNMIDI_EXPORT void opn2_setLoopEnabled(OPN2_MIDIPlayer *device, int loopEn)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->m_sequencer->setLoopEnabled(loopEn != 0);
 #else
     ADL_UNUSED(device);
@@ -498,7 +698,14 @@ OPNMIDI_EXPORT void opn2_setChannelAllocMode(struct OPN2_MIDIPlayer *device, int
     Synth &synth = *play->m_synth;
     if(chanalloc < -1 || chanalloc >= OPNMIDI_ChanAlloc_Count)
         chanalloc = OPNMIDI_ChanAlloc_AUTO;
+    if(synth.m_channelAlloc == static_cast<OPNMIDI_ChannelAlloc>(chanalloc))
+        return;
+
+    RenderAheadGuard guard(play);
     synth.m_channelAlloc = static_cast<OPNMIDI_ChannelAlloc>(chanalloc);
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    play->updateNoteDurations();
+#endif
 }
 
 OPNMIDI_EXPORT int opn2_getChannelAllocMode(struct OPN2_MIDIPlayer *device)
@@ -525,6 +732,7 @@ OPNMIDI_EXPORT int opn2_openFile(OPN2_MIDIPlayer *device, const char *filePath)
     {
         MidiPlayer *play = GET_MIDI_PLAYER(device);
         assert(play);
+        RenderAheadGuard guard(play);
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
         play->m_setup.tick_skip_samples_delay = 0;
         if(!play->LoadMIDI(filePath))
@@ -552,6 +760,7 @@ OPNMIDI_EXPORT int opn2_openData(OPN2_MIDIPlayer *device, const void *mem, unsig
     {
         MidiPlayer *play = GET_MIDI_PLAYER(device);
         assert(play);
+        RenderAheadGuard guard(play);
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
         play->m_setup.tick_skip_samples_delay = 0;
         if(!play->LoadMIDI(mem, static_cast<size_t>(size)))
@@ -582,6 +791,7 @@ OPNMIDI_EXPORT void opn2_selectSongNum(struct OPN2_MIDIPlayer *device, int songN
 
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->m_sequencer->setSongNum(songNumber);
 #else
     ADL_UNUSED(device);
@@ -631,8 +841,7 @@ OPNMIDI_EXPORT int opn2_switchEmulator(struct OPN2_MIDIPlayer *device, int emula
         if(opn2_isEmulatorAvailable(emulator))
         {
             play->m_setup.emulator = emulator;
-            play->partialReset();
-            return 0;
+            return play->partialReset() ? 0 : -1;
         }
         play->setErrorString("OPN2 MIDI: Unknown emulation core!");
     }
@@ -648,13 +857,65 @@ OPNMIDI_EXPORT int opn2_setRunAtPcmRate(OPN2_MIDIPlayer *device, int enabled)
         assert(play);
         Synth &synth = *play->m_synth;
         play->m_setup.runAtPcmRate = (enabled != 0);
-        if(!synth.setupLocked())
-            play->partialReset();
+        if(!synth.setupLocked() && !play->partialReset())
+            return -1;
+        return 0;
+    }
+    return -1;
+}
+
+OPNMIDI_EXPORT int opn2_setOpnaExtraChannels(OPN2_MIDIPlayer *device, int enabled)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        Synth &synth = *play->m_synth;
+        play->m_setup.extraChannels = (enabled != 0);
+        if(!synth.setupLocked() && !play->partialReset())
+            return -1;
+        return 0;
+    }
+    return -1;
+}
+
+OPNMIDI_EXPORT int opn2_getOpnaExtraChannels(OPN2_MIDIPlayer *device)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        return play->m_setup.extraChannels ? 1 : 0;
+    }
+    return -1;
+}
+
+OPNMIDI_EXPORT int opn2_setDacDrums(OPN2_MIDIPlayer *device, int enabled)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        Synth &synth = *play->m_synth;
+        play->m_setup.dacDrums = (enabled != 0);
+        if(!synth.setupLocked() && !play->partialReset())
+            return -1;
         return 0;
     }
     return -1;
 }
 
+OPNMIDI_EXPORT int opn2_getDacDrums(OPN2_MIDIPlayer *device)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        return play->m_setup.dacDrums ? 1 : 0;
+    }
+    return -1;
+}
+
 
 OPNMIDI_EXPORT const char *opn2_linkedLibraryVersion()
 {
@@ -691,9 +952,11 @@ OPNMIDI_EXPORT void opn2_close(OPN2_MIDIPlayer *device)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    delete play;
+    opn2_stopRenderAhead(device);
+    play->~MidiPlayer();
+    adlmidi_freeMem(play);
     device->opn2_midiPlayer = NULL;
-    free(device);
+    adlmidi_freeMem(device);
     device = NULL;
 }
 
@@ -703,6 +966,7 @@ OPNMIDI_EXPORT void opn2_reset(OPN2_MIDIPlayer *device)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->partialReset();
     play->resetMIDI();
 }
@@ -756,6 +1020,8 @@ OPNMIDI_EXPORT double opn2_positionTell(struct OPN2_MIDIPlayer *device)
         return -1.0;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    // The render thread moves the position
+    RenderAheadGuard guard(play, false);
     return play->m_sequencer->tell();
 #else
     ADL_UNUSED(device);
@@ -772,9 +1038,11 @@ OPNMIDI_EXPORT void opn2_positionSeek(struct OPN2_MIDIPlayer *device, double sec
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->realTime_panic();
-    play->m_setup.delay = play->m_sequencer->seek(seconds, play->m_setup.mindelay);
-    play->m_setup.carry = 0.0;
+    double delay = play->m_sequencer->seek(seconds, play->tickTimeToSeconds(play->m_setup.mindelay));
+    play->m_setup.delay = play->secondsToTickTime(delay);
+    play->m_setup.carry = 0;
 #else
     ADL_UNUSED(device);
     ADL_UNUSED(seconds);
@@ -788,6 +1056,7 @@ OPNMIDI_EXPORT void opn2_positionRewind(struct OPN2_MIDIPlayer *device)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->realTime_panic();
     play->m_sequencer->rewind();
 #else
@@ -802,6 +1071,7 @@ OPNMIDI_EXPORT void opn2_setTempo(struct OPN2_MIDIPlayer *device, double tempo)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->m_sequencer->setTempo(tempo);
 #else
     ADL_UNUSED(device);
@@ -821,101 +1091,285 @@ OPNMIDI_EXPORT int opn2_describeChannels(struct OPN2_MIDIPlayer *device, char *s
 }
 
 
-OPNMIDI_EXPORT const char *opn2_metaMusicTitle(struct OPN2_MIDIPlayer *device)
+OPNMIDI_EXPORT int opn2_setRegisterCapture(struct OPN2_MIDIPlayer *device, OPN2_RegCaptureRing *ring)
 {
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     if(!device)
-        return "";
+        return -1;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    return play->m_sequencer->getMusicTitle();
-#else
-    ADL_UNUSED(device);
-    return "";
-#endif
+    Synth &synth = *play->m_synth;
+    if(ring && (!ring->records || ring->capacity < 2))
+    {
+        play->setErrorString("Register capture ring must have a storage of at least 2 records");
+        return -1;
+    }
+    synth.m_regCapture = ring;
+    synth.m_regCaptureOffset = 0;
+    return 0;
 }
 
 
-OPNMIDI_EXPORT const char *opn2_metaMusicCopyright(struct OPN2_MIDIPlayer *device)
+OPNMIDI_EXPORT int opn2_openRegisterLog(struct OPN2_MIDIPlayer *device, const OPN2_RegWrite *records, size_t count, unsigned long rate)
 {
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     if(!device)
-        return "";
+        return -1;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    return play->m_sequencer->getMusicCopyright();
-#else
-    ADL_UNUSED(device);
+    if(!play->LoadRegLog(records, count, rate))
+        return -1;
     return 0;
-#endif
 }
 
-OPNMIDI_EXPORT size_t opn2_metaTrackTitleCount(struct OPN2_MIDIPlayer *device)
+OPNMIDI_EXPORT int opn2_openVgmFile(struct OPN2_MIDIPlayer *device, const char *filePath)
 {
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     if(!device)
-        return 0;
+    {
+        OPN2MIDI_ErrorString = "Can't load file: OPN2 MIDI is not initialized";
+        return -1;
+    }
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    return play->m_sequencer->getTrackTitles().size();
-#else
-    ADL_UNUSED(device);
+    if(!play->LoadVGM(filePath))
+    {
+        std::string err = play->getErrorString();
+        if(err.empty())
+            play->setErrorString("OPN2 MIDI: Can't load VGM file");
+        return -1;
+    }
     return 0;
-#endif
 }
 
-OPNMIDI_EXPORT const char *opn2_metaTrackTitle(struct OPN2_MIDIPlayer *device, size_t index)
+OPNMIDI_EXPORT int opn2_openVgmData(struct OPN2_MIDIPlayer *device, const void *mem, unsigned long size)
 {
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     if(!device)
-        return "";
+    {
+        OPN2MIDI_ErrorString = "Can't load file: OPN2 MIDI is not initialized";
+        return -1;
+    }
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    const std::vector<BW_MidiSequencer::DataBlock> &titles = play->m_sequencer->getTrackTitles();
-    if(index >= titles.size())
-        return "INVALID";
-    return reinterpret_cast<const char*>(play->m_sequencer->getData(titles[index]));
-#else
-    ADL_UNUSED(device);
-    ADL_UNUSED(index);
-    return "NOT SUPPORTED";
-#endif
+    if(!play->LoadVGM(mem, static_cast<size_t>(size)))
+    {
+        std::string err = play->getErrorString();
+        if(err.empty())
+            play->setErrorString("OPN2 MIDI: Can't load VGM data from memory");
+        return -1;
+    }
+    return 0;
 }
 
 
-OPNMIDI_EXPORT size_t opn2_metaMarkerCount(struct OPN2_MIDIPlayer *device)
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+static void copyPerfCounter(OPN2_PerfCounter &dst, const OpnPerfCounter &src)
+{
+    dst.nanoseconds = src.totalNs();
+    dst.calls = static_cast<unsigned long>(src.calls);
+}
+#endif
+
+OPNMIDI_EXPORT int opn2_setPerfCountersEnabled(struct OPN2_MIDIPlayer *device, int enabled)
 {
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     if(!device)
-        return 0;
+        return -1;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    return play->m_sequencer->getMarkers().size();
-#else
-    ADL_UNUSED(device);
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    play->m_synth->m_perf.enabled = (enabled != 0);
     return 0;
+#else
+    ADL_UNUSED(enabled);
+    play->setErrorString("Performance counters are not supported by this build of the library");
+    return -1;
 #endif
 }
 
-OPNMIDI_EXPORT Opn2_MarkerEntry opn2_metaMarker(struct OPN2_MIDIPlayer *device, size_t index)
+OPNMIDI_EXPORT int opn2_getPerfStats(struct OPN2_MIDIPlayer *device, OPN2_PerfStats *stats)
 {
-    struct Opn2_MarkerEntry marker;
-
-#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
-    if(!device)
+    if(!device || !stats)
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    const OpnPerfCounters &perf = play->m_synth->m_perf;
+    copyPerfCounter(stats->sequencer, perf.sequencer);
+    copyPerfCounter(stats->synth, perf.synth);
+    copyPerfCounter(stats->emulation, perf.chips);
+    copyPerfCounter(stats->output, perf.output);
+    copyPerfCounter(stats->regWrites, perf.regWrites);
+    stats->frames = static_cast<unsigned long>(perf.frames);
+    stats->chipsCount = perf.chipGen.size();
+    for(size_t i = 0; stats->chips && i < stats->chipsCapacity && i < stats->chipsCount; ++i)
     {
-        marker.label = "INVALID";
-        marker.pos_time = 0.0;
-        marker.pos_ticks = 0;
-        return marker;
+        copyPerfCounter(stats->chips[i].emulation, perf.chipGen[i]);
+        copyPerfCounter(stats->chips[i].regWrites, perf.chipRegs[i]);
     }
+    return 0;
+#else
+    play->setErrorString("Performance counters are not supported by this build of the library");
+    return -1;
+#endif
+}
 
+OPNMIDI_EXPORT int opn2_resetPerfStats(struct OPN2_MIDIPlayer *device)
+{
+    if(!device)
+        return -1;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-
-    const std::vector<MidiSequencer::MIDI_MarkerEntry> &markers = play->m_sequencer->getMarkers();
-    if(index >= markers.size())
-    {
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    play->m_synth->m_perf.clear();
+    return 0;
+#else
+    play->setErrorString("Performance counters are not supported by this build of the library");
+    return -1;
+#endif
+}
+
+// Every allocation mode must fit into the fixed-size array of the public structure
+typedef char OpnVoiceStatsModesCheck[(OPNMIDI_ChanAlloc_Count <= OPNMIDI_VOICE_STATS_ALLOC_MODES) ? 1 : -1];
+
+OPNMIDI_EXPORT int opn2_getVoiceStats(struct OPN2_MIDIPlayer *device, OPN2_VoiceStats *stats)
+{
+    if(!device || !stats)
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    const MidiPlayer::VoiceStats &vs = play->m_voiceStats;
+
+    stats->placed = static_cast<unsigned long>(vs.placed);
+    stats->steals = static_cast<unsigned long>(vs.steals);
+    stats->evacuations = static_cast<unsigned long>(vs.evacuations);
+    stats->drops = static_cast<unsigned long>(vs.drops);
+    for(size_t i = 0; i < OPNMIDI_VOICE_STATS_ALLOC_MODES; ++i)
+    {
+        stats->releaseReuses[i] = (i < OPNMIDI_ChanAlloc_Count) ?
+                                  static_cast<unsigned long>(vs.releaseReuses[i]) : 0;
+    }
+    stats->peakChannels = static_cast<unsigned int>(vs.peakChannels);
+    stats->peakVoices = static_cast<unsigned int>(vs.peakVoices);
+    stats->totalChannels = static_cast<unsigned int>(play->m_synth->m_numChannels);
+    return 0;
+}
+
+OPNMIDI_EXPORT int opn2_resetVoiceStats(struct OPN2_MIDIPlayer *device)
+{
+    if(!device)
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    play->m_voiceStats.clear();
+    return 0;
+}
+
+OPNMIDI_EXPORT int opn2_getChannelsSnapshot(struct OPN2_MIDIPlayer *device, OPN2_ChannelsSnapshot *snapshot)
+{
+    if(!device || !snapshot)
+        return -1;
+    if((snapshot->chipChannelsCapacity > 0 && !snapshot->chipChannels) ||
+       (snapshot->midiChannelsCapacity > 0 && !snapshot->midiChannels))
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    play->getChannelsSnapshot(*snapshot);
+    return 0;
+}
+
+
+OPNMIDI_EXPORT const char *opn2_metaMusicTitle(struct OPN2_MIDIPlayer *device)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+        return "";
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return play->m_sequencer->getMusicTitle();
+#else
+    ADL_UNUSED(device);
+    return "";
+#endif
+}
+
+
+OPNMIDI_EXPORT const char *opn2_metaMusicCopyright(struct OPN2_MIDIPlayer *device)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+        return "";
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return play->m_sequencer->getMusicCopyright();
+#else
+    ADL_UNUSED(device);
+    return 0;
+#endif
+}
+
+OPNMIDI_EXPORT size_t opn2_metaTrackTitleCount(struct OPN2_MIDIPlayer *device)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+        return 0;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return play->m_sequencer->getTrackTitles().size();
+#else
+    ADL_UNUSED(device);
+    return 0;
+#endif
+}
+
+OPNMIDI_EXPORT const char *opn2_metaTrackTitle(struct OPN2_MIDIPlayer *device, size_t index)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+        return "";
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    const std::vector<BW_MidiSequencer::DataBlock> &titles = play->m_sequencer->getTrackTitles();
+    if(index >= titles.size())
+        return "INVALID";
+    return reinterpret_cast<const char*>(play->m_sequencer->getData(titles[index]));
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(index);
+    return "NOT SUPPORTED";
+#endif
+}
+
+
+OPNMIDI_EXPORT size_t opn2_metaMarkerCount(struct OPN2_MIDIPlayer *device)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+        return 0;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    return play->m_sequencer->getMarkers().size();
+#else
+    ADL_UNUSED(device);
+    return 0;
+#endif
+}
+
+OPNMIDI_EXPORT Opn2_MarkerEntry opn2_metaMarker(struct OPN2_MIDIPlayer *device, size_t index)
+{
+    struct Opn2_MarkerEntry marker;
+
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device)
+    {
+        marker.label = "INVALID";
+        marker.pos_time = 0.0;
+        marker.pos_ticks = 0;
+        return marker;
+    }
+
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+
+    const std::vector<MidiSequencer::MIDI_MarkerEntry> &markers = play->m_sequencer->getMarkers();
+    if(index >= markers.size())
+    {
         marker.label = "INVALID";
         marker.pos_time = 0.0;
         marker.pos_ticks = 0;
@@ -975,6 +1429,11 @@ OPNMIDI_EXPORT void opn2_setDebugMessageHook(struct OPN2_MIDIPlayer *device, OPN
     play->m_sequencerInterface->onDebugMessage = debugMessageHook;
     play->m_sequencerInterface->onDebugMessage_userData = userData;
 #endif
+#ifdef OPNMIDI_MIDI2VGM
+    Synth &synth = *play->m_synth;
+    synth.m_vgmOutput.messageHook = debugMessageHook;
+    synth.m_vgmOutput.messageHookData = userData;
+#endif
 }
 
 /* Set loop start hook */
@@ -1007,6 +1466,22 @@ OPNMIDI_EXPORT void opn2_setLoopEndHook(struct OPN2_MIDIPlayer *device, OPN2_Loo
 #endif
 }
 
+OPNMIDI_EXPORT void opn2_setVgmWriteHook(struct OPN2_MIDIPlayer *device, OPN2_VgmWriteHook vgmWriteHook, void *userData)
+{
+    if(!device)
+        return;
+#ifdef OPNMIDI_MIDI2VGM
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    Synth &synth = *play->m_synth;
+    synth.m_vgmOutput.writeHook = vgmWriteHook;
+    synth.m_vgmOutput.writeHookData = userData;
+#else
+    ADL_UNUSED(vgmWriteHook);
+    ADL_UNUSED(userData);
+#endif
+}
+
 
 
 template <class Dst>
@@ -1030,6 +1505,67 @@ static void CopySamplesTransformed(OPN2_UInt8 *dstLeft, OPN2_UInt8 *dstRight, co
     }
 }
 
+static void GenerateChips(Synth &synth, int32_t *out_buf, size_t frames)
+{
+    OPN_PERF_SCOPE(perfChips, synth.m_perf, synth.m_perf.chips);
+    unsigned int chips = synth.m_numChips;
+    if(synth.chipGroupsCount() > 1)
+        synth.m_groupRenderer.render(synth, out_buf, frames);
+    else if(chips == 1)
+    {
+        OPN_PERF_SCOPE(perfChip, synth.m_perf, synth.m_perf.chipGen[0]);
+        synth.m_chips[0]->generate32(out_buf, frames);
+    }
+    else
+    {
+        /* Generate data from every chip and mix result */
+        for(size_t card = 0; card < chips; ++card)
+        {
+            OPN_PERF_SCOPE(perfChip, synth.m_perf, synth.m_perf.chipGen[card]);
+            synth.m_chips[card]->generateAndMix32(out_buf, frames);
+        }
+    }
+    synth.mixDacDrums(out_buf, frames);
+    OPN_PERF_FRAMES(synth.m_perf, frames);
+}
+
+/**
+ * @brief Add the passed time into the carry and take whole output frames from it
+ * @param setup Player setup which keeps the carry
+ * @param eat_delay Passed time (see OpnTickTime)
+ * @return Count of whole frames to generate
+ */
+static ssize_t EatDelayFrames(MidiPlayer::Setup &setup, OpnTickTime eat_delay)
+{
+    ssize_t frames;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    setup.carry += eat_delay;
+    frames = static_cast<ssize_t>(setup.carry >> OPN_TICK_TIME_SHIFT);
+    setup.carry -= static_cast<OpnTickTime>(frames) << OPN_TICK_TIME_SHIFT;
+#else
+    setup.carry += double(setup.PCM_RATE) * eat_delay;
+    frames = static_cast<ssize_t>(setup.carry);
+    setup.carry -= double(frames);
+#endif
+    return frames;
+}
+
+/**
+ * @brief Convert the count of output frames into the time value
+ * @param setup Player setup which keeps the sample rate
+ * @param frames Count of frames
+ * @return Time value (see OpnTickTime)
+ */
+static OpnTickTime FramesToTickTime(const MidiPlayer::Setup &setup, ssize_t frames)
+{
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    ADL_UNUSED(setup);
+    return static_cast<OpnTickTime>(frames) << OPN_TICK_TIME_SHIFT;
+#else
+    return double(frames) / double(setup.PCM_RATE);
+#endif
+}
+
 static int SendStereoAudio(int         samples_requested,
                            ssize_t     in_size,
                            int32_t    *_in,
@@ -1134,6 +1670,50 @@ static int SendStereoAudio(int         samples_requested,
 }
 
 
+static int opn2_playRegLog(MidiPlayer *player, int sampleCount,
+                           OPN2_UInt8 *out_left, OPN2_UInt8 *out_right,
+                           const OPNMIDI_AudioFormat *format)
+{
+    Synth &synth = *player->m_synth;
+    ssize_t gotten_len = 0;
+    int left = sampleCount;
+
+    while(left > 0)
+    {
+        uint64_t untilNext = player->regLogProcess();
+        if(untilNext == 0)
+        {
+            player->regLogFinish(); // Chips of the log aren't needed anymore
+            break;//Stop to fetch samples at reaching the log end
+        }
+
+        ssize_t leftSamples = left / 2;
+        //! Count of stereo samples
+        ssize_t in_generatedStereo = (leftSamples > 512) ? 512 : leftSamples;
+        if(uint64_t(in_generatedStereo) > untilNext)
+            in_generatedStereo = static_cast<ssize_t>(untilNext);
+        //! Total count of samples
+        ssize_t in_generatedPhys = in_generatedStereo * 2;
+
+        int32_t *out_buf = player->m_outBuf;
+        std::memset(out_buf, 0, static_cast<size_t>(in_generatedPhys) * sizeof(out_buf[0]));
+        GenerateChips(synth, out_buf, (size_t)in_generatedStereo);
+        synth.m_regCaptureOffset += static_cast<uint64_t>(in_generatedStereo);
+        /* Process it */
+        {
+            OPN_PERF_SCOPE(perfOutput, synth.m_perf, synth.m_perf.output);
+            if(SendStereoAudio(sampleCount, in_generatedStereo, out_buf, gotten_len, out_left, out_right, format) == -1)
+                return 0;
+        }
+
+        left -= (int)in_generatedPhys;
+        gotten_len += in_generatedPhys;
+        player->m_regLog.frames += uint64_t(in_generatedStereo);
+    }
+
+    return static_cast<int>(gotten_len);
+}
+
 OPNMIDI_EXPORT int opn2_play(struct OPN2_MIDIPlayer *device, int sampleCount, short *out)
 {
     return opn2_playFormat(device, sampleCount, (OPN2_UInt8 *)out, (OPN2_UInt8 *)(out + 1), &opn2_DefaultAudioFormat);
@@ -1143,6 +1723,14 @@ OPNMIDI_EXPORT int opn2_playFormat(OPN2_MIDIPlayer *device, int sampleCount,
                                    OPN2_UInt8 *out_left, OPN2_UInt8 *out_right,
                                    const OPNMIDI_AudioFormat *format)
 {
+    if(device && GET_MIDI_PLAYER(device)->m_regLog.active)
+    {
+        sampleCount -= sampleCount % 2; //Avoid even sample requests
+        if(sampleCount < 0)
+            return 0;
+        return opn2_playRegLog(GET_MIDI_PLAYER(device), sampleCount, out_left, out_right, format);
+    }
+
 #if defined(OPNMIDI_DISABLE_MIDI_SEQUENCER)
     ADL_UNUSED(device);
     ADL_UNUSED(sampleCount);
@@ -1171,7 +1759,7 @@ OPNMIDI_EXPORT int opn2_playFormat(OPN2_MIDIPlayer *device, int sampleCount,
 
     while(left > 0)
     {
-        const double eat_delay = setup.delay < setup.maxdelay ? setup.delay : setup.maxdelay;
+        const OpnTickTime eat_delay = setup.delay < setup.maxdelay ? setup.delay : setup.maxdelay;
         if(hasSkipped)
         {
             size_t samples = setup.tick_skip_samples_delay > sampleCount ? sampleCount : setup.tick_skip_samples_delay;
@@ -1180,16 +1768,14 @@ OPNMIDI_EXPORT int opn2_playFormat(OPN2_MIDIPlayer *device, int sampleCount,
         else
         {
             setup.delay -= eat_delay;
-            setup.carry += double(setup.PCM_RATE) * eat_delay;
-            n_periodCountStereo = static_cast<ssize_t>(setup.carry);
-            setup.carry -= double(n_periodCountStereo);
+            n_periodCountStereo = EatDelayFrames(setup, eat_delay);
         }
 
         //if(setup.SkipForward > 0)
         //    setup.SkipForward -= 1;
         //else
         {
-            if((player->m_sequencer->positionAtEnd()) && (setup.delay <= 0.0))
+            if(player->songsAtEnd() && (setup.delay <= 0))
                 break;//Stop to fetch samples at reaching the song end with disabled loop
 
             ssize_t leftSamples = left / 2;
@@ -1207,18 +1793,14 @@ OPNMIDI_EXPORT int opn2_playFormat(OPN2_MIDIPlayer *device, int sampleCount,
             int32_t *out_buf = player->m_outBuf;
             std::memset(out_buf, 0, static_cast<size_t>(in_generatedPhys) * sizeof(out_buf[0]));
             Synth &synth = *player->m_synth;
-            unsigned int chips = synth.m_numChips;
-            if(chips == 1)
-                synth.m_chips[0]->generate32(out_buf, (size_t)in_generatedStereo);
-            else/* if(n_periodCountStereo > 0)*/
+            GenerateChips(synth, out_buf, (size_t)in_generatedStereo);
+            synth.m_regCaptureOffset += static_cast<uint64_t>(in_generatedStereo);
+            /* Process it */
             {
-                /* Generate data from every chip and mix result */
-                for(size_t card = 0; card < chips; ++card)
-                    synth.m_chips[card]->generateAndMix32(out_buf, (size_t)in_generatedStereo);
+                OPN_PERF_SCOPE(perfOutput, synth.m_perf, synth.m_perf.output);
+                if(SendStereoAudio(sampleCount, in_generatedStereo, out_buf, gotten_len, out_left, out_right, format) == -1)
+                    return 0;
             }
-            /* Process it */
-            if(SendStereoAudio(sampleCount, in_generatedStereo, out_buf, gotten_len, out_left, out_right, format) == -1)
-                return 0;
 
             left -= (int)in_generatedPhys;
             gotten_len += (in_generatedPhys) /* - setup.stored_samples*/;
@@ -1227,7 +1809,12 @@ OPNMIDI_EXPORT int opn2_playFormat(OPN2_MIDIPlayer *device, int sampleCount,
         {
             setup.tick_skip_samples_delay -= n_periodCountStereo * 2;
             hasSkipped = setup.tick_skip_samples_delay > 0;
+            // Events of the period are processed after all of its samples
+            if(!hasSkipped)
+                setup.delay = player->Tick(setup.tick_skip_delay, setup.mindelay);
         }
+        else if(setup.tick_skip_samples_delay > 0)
+            setup.tick_skip_delay = eat_delay; // The rest of the period goes into the next call
         else
             setup.delay = player->Tick(eat_delay, setup.mindelay);
     }
@@ -1254,23 +1841,24 @@ OPNMIDI_EXPORT int opn2_generateFormat(struct OPN2_MIDIPlayer *device, int sampl
 
     MidiPlayer *player = GET_MIDI_PLAYER(device);
     assert(player);
+    if(player->m_regLog.active)
+        return opn2_playRegLog(player, sampleCount, out_left, out_right, format);
+
     MidiPlayer::Setup &setup = player->m_setup;
 
     ssize_t gotten_len = 0;
     ssize_t n_periodCountStereo = 512;
 
     int     left = sampleCount;
-    double  delay = double(sampleCount / 2) / double(setup.PCM_RATE);
+    OpnTickTime delay = FramesToTickTime(setup, sampleCount / 2);
 
     while(left > 0)
     {
-        if(delay <= 0.0)
-            delay = double(left / 2) / double(setup.PCM_RATE);
-        const double eat_delay = delay < setup.maxdelay ? delay : setup.maxdelay;
+        if(delay <= 0)
+            delay = FramesToTickTime(setup, left / 2);
+        const OpnTickTime eat_delay = delay < setup.maxdelay ? delay : setup.maxdelay;
         delay -= eat_delay;
-        setup.carry += double(setup.PCM_RATE) * eat_delay;
-        n_periodCountStereo = static_cast<ssize_t>(setup.carry);
-        setup.carry -= double(n_periodCountStereo);
+        n_periodCountStereo = EatDelayFrames(setup, eat_delay);
 
         {
             ssize_t leftSamples = left / 2;
@@ -1285,18 +1873,14 @@ OPNMIDI_EXPORT int opn2_generateFormat(struct OPN2_MIDIPlayer *device, int sampl
             int32_t *out_buf = player->m_outBuf;
             std::memset(out_buf, 0, static_cast<size_t>(in_generatedPhys) * sizeof(out_buf[0]));
             Synth &synth = *player->m_synth;
-            unsigned int chips = synth.m_numChips;
-            if(chips == 1)
-                synth.m_chips[0]->generate32(out_buf, (size_t)in_generatedStereo);
-            else/* if(n_periodCountStereo > 0)*/
+            GenerateChips(synth, out_buf, (size_t)in_generatedStereo);
+            synth.m_regCaptureOffset += static_cast<uint64_t>(in_generatedStereo);
+            /* Process it */
             {
-                /* Generate data from every chip and mix result */
-                for(size_t card = 0; card < chips; ++card)
-                    synth.m_chips[card]->generateAndMix32(out_buf, (size_t)in_generatedStereo);
+                OPN_PERF_SCOPE(perfOutput, synth.m_perf, synth.m_perf.output);
+                if(SendStereoAudio(sampleCount, in_generatedStereo, out_buf, gotten_len, out_left, out_right, format) == -1)
+                    return 0;
             }
-            /* Process it */
-            if(SendStereoAudio(sampleCount, in_generatedStereo, out_buf, gotten_len, out_left, out_right, format) == -1)
-                return 0;
 
             left -= (int)in_generatedPhys;
             gotten_len += (in_generatedPhys) /* - setup.stored_samples*/;
@@ -1308,6 +1892,123 @@ OPNMIDI_EXPORT int opn2_generateFormat(struct OPN2_MIDIPlayer *device, int sampl
     return static_cast<int>(gotten_len);
 }
 
+OPNMIDI_EXPORT int opn2_startRenderAhead(struct OPN2_MIDIPlayer *device, int aheadSamples, const struct OPNMIDI_AudioFormat *format)
+{
+    if(!device)
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+#if defined(OPNMIDI_ENABLE_RENDER_AHEAD) && !defined(OPNMIDI_DISABLE_MIDI_SEQUENCER)
+    if(aheadSamples < 2)
+    {
+        play->setErrorString("OPN2 MIDI: Render-ahead queue must have at least one frame");
+        return -1;
+    }
+
+    opn2_stopRenderAhead(device);
+
+    if(!format)
+        format = &opn2_DefaultAudioFormat;
+    if(format->containerSize == 0)
+    {
+        play->setErrorString("OPN2 MIDI: Invalid audio format");
+        return -1;
+    }
+
+    const ADLMIDI_Allocator *allocator = &play->m_synth->m_allocator;
+    OpnRenderAhead *render = adlmidi_new<OpnRenderAhead>(allocator, allocator);
+    if(!render)
+    {
+        play->setErrorString("OPN2 MIDI: Out of memory");
+        return -1;
+    }
+
+    if(!render->start(device, static_cast<size_t>(aheadSamples / 2), *format))
+    {
+        ADLMIDI_AllocDelete<OpnRenderAhead>()(render);
+        play->setErrorString("OPN2 MIDI: Out of memory or can't start the render thread");
+        return -1;
+    }
+
+    play->m_renderAhead = render;
+    return 0;
+#else
+    ADL_UNUSED(aheadSamples);
+    ADL_UNUSED(format);
+    play->setErrorString("OPNMIDI: Render-ahead mode is not supported in this build of library!");
+    return -1;
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_stopRenderAhead(struct OPN2_MIDIPlayer *device)
+{
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+    if(!device)
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(!play->m_renderAhead)
+        return;
+    play->m_renderAhead->stop();
+    ADLMIDI_AllocDelete<OpnRenderAhead>()(play->m_renderAhead);
+    play->m_renderAhead = NULL;
+#else
+    ADL_UNUSED(device);
+#endif
+}
+
+OPNMIDI_EXPORT int opn2_readRendered(struct OPN2_MIDIPlayer *device, int sampleCount, OPN2_UInt8 *left, OPN2_UInt8 *right)
+{
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+    if(!device || sampleCount < 0)
+        return 0;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(!play->m_renderAhead)
+        return 0;
+    size_t frames = play->m_renderAhead->read(static_cast<size_t>(sampleCount / 2), left, right);
+    return static_cast<int>(frames * 2);
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(sampleCount);
+    ADL_UNUSED(left);
+    ADL_UNUSED(right);
+    return 0;
+#endif
+}
+
+OPNMIDI_EXPORT int opn2_renderedQueued(struct OPN2_MIDIPlayer *device)
+{
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+    if(!device)
+        return 0;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(!play->m_renderAhead)
+        return 0;
+    return static_cast<int>(play->m_renderAhead->queuedFrames() * 2);
+#else
+    ADL_UNUSED(device);
+    return 0;
+#endif
+}
+
+OPNMIDI_EXPORT int opn2_renderAheadAtEnd(struct OPN2_MIDIPlayer *device)
+{
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+    if(!device)
+        return 1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    if(!play->m_renderAhead)
+        return 1;
+    return play->m_renderAhead->atEnd() ? 1 : 0;
+#else
+    ADL_UNUSED(device);
+    return 1;
+#endif
+}
+
 OPNMIDI_EXPORT double opn2_tickEvents(struct OPN2_MIDIPlayer *device, double seconds, double granuality)
 {
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
@@ -1315,7 +2016,7 @@ OPNMIDI_EXPORT double opn2_tickEvents(struct OPN2_MIDIPlayer *device, double sec
         return -1.0;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
-    return play->Tick(seconds, granuality);
+    return play->tickTimeToSeconds(play->Tick(play->secondsToTickTime(seconds), play->secondsToTickTime(granuality)));
 #else
     ADL_UNUSED(device);
     ADL_UNUSED(seconds);
@@ -1324,6 +2025,63 @@ OPNMIDI_EXPORT double opn2_tickEvents(struct OPN2_MIDIPlayer *device, double sec
 #endif
 }
 
+OPNMIDI_EXPORT int opn2_tickVgmDump(struct OPN2_MIDIPlayer *device)
+{
+#if defined(OPNMIDI_MIDI2VGM) && !defined(OPNMIDI_DISABLE_MIDI_SEQUENCER)
+    if(!device)
+        return -1;
+    MidiPlayer *player = GET_MIDI_PLAYER(device);
+    assert(player);
+    MidiPlayer::Setup &setup = player->m_setup;
+    Synth &synth = *player->m_synth;
+
+    if(setup.emulator != OPNMIDI_VGM_DUMPER || synth.m_chips.empty())
+    {
+        player->setErrorString("VGM dumper is not in use");
+        return -1;
+    }
+
+    const OpnTickTime eat_delay = setup.delay < setup.maxdelay ? setup.delay : setup.maxdelay;
+    setup.delay -= eat_delay;
+
+    if(player->songsAtEnd() && (setup.delay <= 0))
+        return 0;//Stop at reaching the song end with disabled loop
+
+    // Frames which opn2_play() would render go into the dumper as a wait value
+    VGMFileDumper *dumper = static_cast<VGMFileDumper *>(synth.m_chips[0].get());
+    dumper->advanceTime(static_cast<uint64_t>(EatDelayFrames(setup, eat_delay)));
+    setup.delay = player->Tick(eat_delay, setup.mindelay);
+
+    if(dumper->overflowed())
+    {
+        player->setErrorString("VGM: Output exceeds 128 MiB, the rest of the song is cut");
+        return -1;
+    }
+
+    return 1;
+#else
+    ADL_UNUSED(device);
+    return -1;
+#endif
+}
+
+OPNMIDI_EXPORT int opn2_setVgmOutPath(struct OPN2_MIDIPlayer *device, const char *path)
+{
+    if(!device)
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+#ifdef OPNMIDI_MIDI2VGM
+    Synth &synth = *play->m_synth;
+    synth.m_vgmOutput.path = path ? path : "";
+    return 0;
+#else
+    ADL_UNUSED(path);
+    play->setErrorString("VGM dumper is not supported by this build of the library");
+    return -1;
+#endif
+}
+
 OPNMIDI_EXPORT int opn2_atEnd(struct OPN2_MIDIPlayer *device)
 {
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
@@ -1352,6 +2110,245 @@ OPNMIDI_EXPORT size_t opn2_trackCount(struct OPN2_MIDIPlayer *device)
 #endif
 }
 
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+static bool isValidSongSlot(int slot)
+{
+    return slot >= 0 && slot < OPNMIDI_SONG_SLOTS;
+}
+#endif
+
+OPNMIDI_EXPORT int opn2_slotOpenFile(struct OPN2_MIDIPlayer *device, int slot, const char *filePath)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        RenderAheadGuard guard(play);
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+        if(!isValidSongSlot(slot))
+        {
+            play->setErrorString("OPN2 MIDI: Invalid song slot index");
+            return -1;
+        }
+        play->setErrorString(std::string());
+        if(!play->LoadSlotMIDI(static_cast<size_t>(slot), filePath))
+        {
+            std::string err = play->getErrorString();
+            if(err.empty())
+                play->setErrorString("OPN2 MIDI: Can't load file");
+            return -1;
+        }
+        else return 0;
+#else
+        ADL_UNUSED(slot);
+        ADL_UNUSED(filePath);
+        play->setErrorString("OPNMIDI: MIDI Sequencer is not supported in this build of library!");
+        return -1;
+#endif
+    }
+
+    OPN2MIDI_ErrorString = "Can't load file: OPN2 MIDI is not initialized";
+    return -1;
+}
+
+OPNMIDI_EXPORT int opn2_slotOpenData(struct OPN2_MIDIPlayer *device, int slot, const void *mem, unsigned long size)
+{
+    if(device)
+    {
+        MidiPlayer *play = GET_MIDI_PLAYER(device);
+        assert(play);
+        RenderAheadGuard guard(play);
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+        if(!isValidSongSlot(slot))
+        {
+            play->setErrorString("OPN2 MIDI: Invalid song slot index");
+            return -1;
+        }
+        play->setErrorString(std::string());
+        if(!play->LoadSlotMIDI(static_cast<size_t>(slot), mem, static_cast<size_t>(size)))
+        {
+            std::string err = play->getErrorString();
+            if(err.empty())
+                play->setErrorString("OPN2 MIDI: Can't load data from memory");
+            return -1;
+        }
+        else return 0;
+#else
+        ADL_UNUSED(slot);
+        ADL_UNUSED(mem);
+        ADL_UNUSED(size);
+        play->setErrorString("OPNMIDI: MIDI Sequencer is not supported in this build of library!");
+        return -1;
+#endif
+    }
+
+    OPN2MIDI_ErrorString = "Can't load file: OPN2 MIDI is not initialized";
+    return -1;
+}
+
+OPNMIDI_EXPORT void opn2_slotClose(struct OPN2_MIDIPlayer *device, int slot)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play);
+    play->closeSlot(static_cast<size_t>(slot));
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSetPaused(struct OPN2_MIDIPlayer *device, int slot, int paused)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play);
+    MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    if(paused && !s.paused)
+        play->releaseSlotNotes(static_cast<size_t>(slot));
+    s.paused = (paused != 0);
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(paused);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotRewind(struct OPN2_MIDIPlayer *device, int slot)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play);
+    MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    if(!s.sequencer.get())
+        return;
+    play->releaseSlotNotes(static_cast<size_t>(slot));
+    s.sequencer->rewind();
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSeek(struct OPN2_MIDIPlayer *device, int slot, double seconds)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(seconds < 0.0)
+        return;//Seeking negative position is forbidden! :-P
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play);
+    MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    if(!s.sequencer.get())
+        return;
+    play->releaseSlotNotes(static_cast<size_t>(slot));
+    s.sequencer->seek(seconds, play->tickTimeToSeconds(play->m_setup.mindelay));
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(seconds);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSetLoopEnabled(struct OPN2_MIDIPlayer *device, int slot, int loopEn)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play, false);
+    MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    if(s.sequencer.get())
+        s.sequencer->setLoopEnabled(loopEn != 0);
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(loopEn);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSetTempo(struct OPN2_MIDIPlayer *device, int slot, double tempo)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot) || (tempo <= 0.0))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play);
+    MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    if(s.sequencer.get())
+        s.sequencer->setTempo(tempo);
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(tempo);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSetVolume(struct OPN2_MIDIPlayer *device, int slot, int volume)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play, false);
+    if(volume < 0)
+        volume = 0;
+    else if(volume > 127)
+        volume = 127;
+    play->setSlotVolume(static_cast<size_t>(slot), static_cast<uint8_t>(volume));
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(volume);
+#endif
+}
+
+OPNMIDI_EXPORT void opn2_slotSetPriority(struct OPN2_MIDIPlayer *device, int slot, int priority)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    RenderAheadGuard guard(play, false);
+    play->m_songSlots[slot].priority = priority;
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    ADL_UNUSED(priority);
+#endif
+}
+
+OPNMIDI_EXPORT int opn2_slotAtEnd(struct OPN2_MIDIPlayer *device, int slot)
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(!device || !isValidSongSlot(slot))
+        return -1;
+    MidiPlayer *play = GET_MIDI_PLAYER(device);
+    assert(play);
+    const MidiPlayer::SongSlot &s = play->m_songSlots[slot];
+    return (!s.sequencer.get() || s.sequencer->positionAtEnd()) ? 1 : 0;
+#else
+    ADL_UNUSED(device);
+    ADL_UNUSED(slot);
+    return -1;
+#endif
+}
+
 OPNMIDI_EXPORT int opn2_setTrackOptions(struct OPN2_MIDIPlayer *device, size_t trackNumber, unsigned trackOptions)
 {
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
@@ -1418,6 +2415,7 @@ OPNMIDI_EXPORT void opn2_panic(struct OPN2_MIDIPlayer *device)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play);
     play->realTime_panic();
 }
 
@@ -1427,6 +2425,7 @@ OPNMIDI_EXPORT void opn2_rt_resetState(struct OPN2_MIDIPlayer *device)
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_ResetState();
 }
 
@@ -1436,6 +2435,7 @@ OPNMIDI_EXPORT int opn2_rt_noteOn(struct OPN2_MIDIPlayer *device, OPN2_UInt8 cha
         return 0;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     return (int)play->realTime_NoteOn(channel, note, velocity);
 }
 
@@ -1445,6 +2445,7 @@ OPNMIDI_EXPORT void opn2_rt_noteOff(struct OPN2_MIDIPlayer *device, OPN2_UInt8 c
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_NoteOff(channel, note);
 }
 
@@ -1454,6 +2455,7 @@ OPNMIDI_EXPORT void opn2_rt_noteAfterTouch(struct OPN2_MIDIPlayer *device, OPN2_
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_NoteAfterTouch(channel, note, atVal);
 }
 
@@ -1463,6 +2465,7 @@ OPNMIDI_EXPORT void opn2_rt_channelAfterTouch(struct OPN2_MIDIPlayer *device, OP
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_ChannelAfterTouch(channel, atVal);
 }
 
@@ -1472,6 +2475,7 @@ OPNMIDI_EXPORT void opn2_rt_controllerChange(struct OPN2_MIDIPlayer *device, OPN
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_Controller(channel, type, value);
 }
 
@@ -1481,6 +2485,7 @@ OPNMIDI_EXPORT void opn2_rt_patchChange(struct OPN2_MIDIPlayer *device, OPN2_UIn
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_PatchChange(channel, patch);
 }
 
@@ -1490,6 +2495,7 @@ OPNMIDI_EXPORT void opn2_rt_pitchBend(struct OPN2_MIDIPlayer *device, OPN2_UInt8
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_PitchBend(channel, pitch);
 }
 
@@ -1499,6 +2505,7 @@ OPNMIDI_EXPORT void opn2_rt_pitchBendML(struct OPN2_MIDIPlayer *device, OPN2_UIn
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_PitchBend(channel, msb, lsb);
 }
 
@@ -1508,6 +2515,7 @@ OPNMIDI_EXPORT void opn2_rt_bankChangeLSB(struct OPN2_MIDIPlayer *device, OPN2_U
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_BankChangeLSB(channel, lsb);
 }
 
@@ -1517,6 +2525,7 @@ OPNMIDI_EXPORT void opn2_rt_bankChangeMSB(struct OPN2_MIDIPlayer *device, OPN2_U
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_BankChangeMSB(channel, msb);
 }
 
@@ -1526,6 +2535,7 @@ OPNMIDI_EXPORT void opn2_rt_bankChange(struct OPN2_MIDIPlayer *device, OPN2_UInt
         return;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     play->realTime_BankChange(channel, (uint16_t)bank);
 }
 
@@ -1535,5 +2545,6 @@ OPNMIDI_EXPORT int opn2_rt_systemExclusive(struct OPN2_MIDIPlayer *device, const
         return -1;
     MidiPlayer *play = GET_MIDI_PLAYER(device);
     assert(play);
+    RenderAheadGuard guard(play, false);
     return play->realTime_SysEx(msg, size);
 }
@@ -0,0 +1,66 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPNMIDI_ATOMIC_HPP
+#define OPNMIDI_ATOMIC_HPP
+
+/*
+ * Positions shared between two threads without locks.
+ *
+ * The writer stores the position after the data it covers, and the reader
+ * loads the position before the data, so, the reader never sees the position
+ * ahead of the data written before it.
+ */
+
+#include <stddef.h>
+
+#if !defined(__GNUC__) && !defined(__clang__) && defined(_WIN32)
+#   include <windows.h>
+#endif
+
+static inline size_t opn2_atomicLoad(const volatile size_t *p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(_WIN32)
+    size_t v = *p;
+    MemoryBarrier();
+    return v;
+#else
+    return *p;
+#endif
+}
+
+static inline void opn2_atomicStore(volatile size_t *p, size_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#elif defined(_WIN32)
+    MemoryBarrier();
+    *p = v;
+#else
+    *p = v;
+#endif
+}
+
+#endif // OPNMIDI_ATOMIC_HPP
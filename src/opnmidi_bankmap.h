@@ -44,7 +44,10 @@ public:
     typedef T mapped_type;
     typedef std::pair<key_type, T> value_type;
 
-    BasicBankMap();
+    /**
+     * @param allocator Allocator of the slots storage, NULL to use the default heap
+     */
+    explicit BasicBankMap(const ADLMIDI_Allocator *allocator = NULL);
     void reserve(size_t capacity);
 
     size_t size() const
@@ -108,8 +111,11 @@ private:
         value_type value;
         Slot() : next(NULL), prev(NULL) {}
     };
-    AdlMIDI_SPtrArray<Slot *> m_buckets;
-    std::list< AdlMIDI_SPtrArray<Slot> > m_allocations;
+    typedef AdlMIDI_SPtr<Slot *, ADLMIDI_AllocArrayDelete<Slot *> > BucketsPtr;
+    typedef AdlMIDI_SPtr<Slot, ADLMIDI_AllocArrayDelete<Slot> > SlotsPtr;
+    ADLMIDI_Allocator m_allocator;
+    BucketsPtr m_buckets;
+    std::list<SlotsPtr> m_allocations;
     Slot *m_freeslots;
     size_t m_size;
     size_t m_capacity;
@@ -25,12 +25,21 @@
 #include <cassert>
 
 template <class T>
-inline BasicBankMap<T>::BasicBankMap()
+inline BasicBankMap<T>::BasicBankMap(const ADLMIDI_Allocator *allocator)
     : m_freeslots(NULL),
       m_size(0),
       m_capacity(0)
 {
-    m_buckets.reset(new Slot *[hash_buckets]());
+    if(allocator)
+        m_allocator = *allocator;
+    else
+    {
+        m_allocator.allocate = NULL;
+        m_allocator.release = NULL;
+        m_allocator.userData = NULL;
+    }
+
+    m_buckets.reset(adlmidi_allocArray<Slot *>(&m_allocator, hash_buckets));
 }
 
 template <class T>
@@ -52,8 +61,8 @@ void BasicBankMap<T>::reserve(size_t capacity)
     const size_t minalloc = static_cast<size_t>(minimum_allocation);
     need = (need < minalloc) ? minalloc : need;
 
-    AdlMIDI_SPtrArray<Slot> slotz;
-    slotz.reset(new Slot[need]);
+    SlotsPtr slotz;
+    slotz.reset(adlmidi_allocArray<Slot>(&m_allocator, need));
     m_allocations.push_back(slotz);
     m_capacity += need;
 
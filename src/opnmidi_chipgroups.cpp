@@ -0,0 +1,359 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opnmidi_chipgroups.hpp"
+#include "opnmidi_opn2.hpp"
+#include "chips/opn_chip_base.h"
+
+#include <new>
+
+OpnChipGroupRenderer::OpnChipGroupRenderer() :
+    m_groups(0),
+    m_chips(0)
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    ,
+    m_jobSynth(NULL),
+    m_jobFrames(0),
+    m_jobSerial(0),
+    m_jobPending(0),
+    m_quit(false)
+#endif
+{
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+#   ifdef _WIN32
+    InitializeCriticalSection(&m_lock);
+    InitializeConditionVariable(&m_jobStart);
+    InitializeConditionVariable(&m_jobDone);
+#   else
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_jobStart, NULL);
+    pthread_cond_init(&m_jobDone, NULL);
+#   endif
+#endif
+}
+
+OpnChipGroupRenderer::~OpnChipGroupRenderer()
+{
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    stopWorkers();
+#   ifdef _WIN32
+    DeleteCriticalSection(&m_lock);
+#   else
+    pthread_cond_destroy(&m_jobDone);
+    pthread_cond_destroy(&m_jobStart);
+    pthread_mutex_destroy(&m_lock);
+#   endif
+#endif
+}
+
+bool OpnChipGroupRenderer::prepare(const OPN2 &synth)
+{
+    const uint32_t groups = synth.chipGroupsCount();
+    const size_t chips = synth.m_chips.size();
+
+    if(m_groups == groups && m_chips == chips)
+        return true;
+
+    m_groups = 0;
+    m_chips = 0;
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    stopWorkers();
+#endif
+
+    if(groups <= 1)
+    {
+        std::vector<std::vector<int32_t> >().swap(m_buffers);
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+        std::vector<OpnPerfCounter>().swap(m_chipPerf);
+#endif
+        m_groups = groups;
+        m_chips = chips;
+        return true;
+    }
+
+    try
+    {
+        m_buffers.resize(groups);
+        for(uint32_t g = 1; g < groups; ++g)
+            m_buffers[g].resize(static_cast<size_t>(MaxJobFrames) * 2);
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+        const OpnPerfCounter zero = {0, 0, 0};
+        m_chipPerf.assign(chips, zero);
+#endif
+    }
+    catch(const std::bad_alloc &)
+    {
+        return false;
+    }
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    startWorkers(groups - 1);
+#endif
+
+    m_groups = groups;
+    m_chips = chips;
+    return true;
+}
+
+void OpnChipGroupRenderer::render(OPN2 &synth, int32_t *output, size_t frames)
+{
+    const uint32_t groups = synth.chipGroupsCount();
+
+    if(groups != m_groups || synth.m_chips.size() != m_chips)
+    {
+        // Not prepared yet, generate all chips one by one
+        for(size_t chip = 0; chip < synth.m_chips.size(); ++chip)
+        {
+            OPN_PERF_SCOPE(perfChip, synth.m_perf, synth.m_perf.chipGen[chip]);
+            if(chip == 0)
+                synth.m_chips[chip]->generate32(output, frames);
+            else
+                synth.m_chips[chip]->generateAndMix32(output, frames);
+        }
+        return;
+    }
+
+    while(frames > 0)
+    {
+        const size_t job = (frames > static_cast<size_t>(MaxJobFrames)) ? static_cast<size_t>(MaxJobFrames) : frames;
+        renderJob(synth, output, job);
+        output += job * 2;
+        frames -= job;
+    }
+
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    // Workers are idle here, so, their counters are merged safely
+    for(size_t chip = 0; chip < m_chipPerf.size() && chip < synth.m_perf.chipGen.size(); ++chip)
+    {
+        OpnPerfCounter &src = m_chipPerf[chip];
+        OpnPerfCounter &dst = synth.m_perf.chipGen[chip];
+        dst.ns += src.ns;
+        dst.calls += src.calls;
+        dst.timed += src.timed;
+        src.ns = 0;
+        src.calls = 0;
+        src.timed = 0;
+    }
+#endif
+}
+
+void OpnChipGroupRenderer::renderJob(OPN2 &synth, int32_t *output, size_t frames)
+{
+    const uint32_t groups = m_groups;
+    const size_t samples = frames * 2;
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    lock();
+    m_jobSynth = &synth;
+    m_jobFrames = frames;
+    m_jobPending = m_workers.size();
+    ++m_jobSerial;
+#   ifdef _WIN32
+    WakeAllConditionVariable(&m_jobStart);
+#   else
+    pthread_cond_broadcast(&m_jobStart);
+#   endif
+    unlock();
+
+    generateGroup(synth, 0, output, frames);
+
+    lock();
+    while(m_jobPending > 0)
+    {
+#   ifdef _WIN32
+        SleepConditionVariableCS(&m_jobDone, &m_lock, INFINITE);
+#   else
+        pthread_cond_wait(&m_jobDone, &m_lock);
+#   endif
+    }
+    unlock();
+
+    // Groups without a worker are generated by the calling thread
+    for(uint32_t g = static_cast<uint32_t>(m_workers.size()) + 1; g < groups; ++g)
+        generateGroup(synth, g, &m_buffers[g][0], frames);
+#else
+    generateGroup(synth, 0, output, frames);
+    for(uint32_t g = 1; g < groups; ++g)
+        generateGroup(synth, g, &m_buffers[g][0], frames);
+#endif
+
+    // Final mix of all groups
+    for(uint32_t g = 1; g < groups; ++g)
+    {
+        const int32_t *src = &m_buffers[g][0];
+        for(size_t i = 0; i < samples; ++i)
+            output[i] += src[i];
+    }
+}
+
+void OpnChipGroupRenderer::generateGroup(OPN2 &synth, uint32_t group, int32_t *output, size_t frames)
+{
+    const uint32_t groups = m_groups;
+    const size_t first = (group * m_chips + groups - 1) / groups;
+    const size_t last = ((group + 1) * m_chips + groups - 1) / groups;
+
+    for(size_t chip = first; chip < last; ++chip)
+    {
+        OPN_PERF_SCOPE(perfChip, synth.m_perf, m_chipPerf[chip]);
+        if(chip == first)
+            synth.m_chips[chip]->generate32(output, frames);
+        else
+            synth.m_chips[chip]->generateAndMix32(output, frames);
+    }
+}
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+void OpnChipGroupRenderer::lock()
+{
+#   ifdef _WIN32
+    EnterCriticalSection(&m_lock);
+#   else
+    pthread_mutex_lock(&m_lock);
+#   endif
+}
+
+void OpnChipGroupRenderer::unlock()
+{
+#   ifdef _WIN32
+    LeaveCriticalSection(&m_lock);
+#   else
+    pthread_mutex_unlock(&m_lock);
+#   endif
+}
+
+#   ifdef _WIN32
+DWORD WINAPI OpnChipGroupRenderer::workerThread(LPVOID arg)
+{
+    Worker *w = static_cast<Worker *>(arg);
+    w->self->runWorker(w);
+    return 0;
+}
+#   else
+void *OpnChipGroupRenderer::workerThread(void *arg)
+{
+    Worker *w = static_cast<Worker *>(arg);
+    w->self->runWorker(w);
+    return NULL;
+}
+#   endif
+
+void OpnChipGroupRenderer::runWorker(Worker *w)
+{
+    // Taken at the start, so, the job posted before the thread got running is not missed
+    uint64_t lastSerial = w->startSerial;
+
+    lock();
+
+    for(;;)
+    {
+        while(!m_quit && m_jobSerial == lastSerial)
+        {
+#   ifdef _WIN32
+            SleepConditionVariableCS(&m_jobStart, &m_lock, INFINITE);
+#   else
+            pthread_cond_wait(&m_jobStart, &m_lock);
+#   endif
+        }
+
+        if(m_quit)
+            break;
+
+        lastSerial = m_jobSerial;
+        OPN2 *synth = m_jobSynth;
+        size_t frames = m_jobFrames;
+        int32_t *buffer = &m_buffers[w->group][0];
+        unlock();
+
+        generateGroup(*synth, w->group, buffer, frames);
+
+        lock();
+        if(--m_jobPending == 0)
+        {
+#   ifdef _WIN32
+            WakeConditionVariable(&m_jobDone);
+#   else
+            pthread_cond_signal(&m_jobDone);
+#   endif
+        }
+    }
+
+    unlock();
+}
+
+void OpnChipGroupRenderer::startWorkers(size_t count)
+{
+    m_quit = false;
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        Worker *w = new(std::nothrow) Worker;
+        if(!w)
+            break;
+        w->self = this;
+        w->group = static_cast<uint32_t>(i + 1);
+        w->startSerial = m_jobSerial;
+#   ifdef _WIN32
+        w->thread = CreateThread(NULL, 0, &workerThread, w, 0, NULL);
+        if(w->thread == NULL)
+#   else
+        if(pthread_create(&w->thread, NULL, &workerThread, w) != 0)
+#   endif
+        {
+            delete w;
+            break;
+        }
+        m_workers.push_back(w);
+    }
+}
+
+void OpnChipGroupRenderer::stopWorkers()
+{
+    if(m_workers.empty())
+        return;
+
+    lock();
+    m_quit = true;
+#   ifdef _WIN32
+    WakeAllConditionVariable(&m_jobStart);
+#   else
+    pthread_cond_broadcast(&m_jobStart);
+#   endif
+    unlock();
+
+    for(size_t i = 0; i < m_workers.size(); ++i)
+    {
+        Worker *w = m_workers[i];
+#   ifdef _WIN32
+        WaitForSingleObject(w->thread, INFINITE);
+        CloseHandle(w->thread);
+#   else
+        pthread_join(w->thread, NULL);
+#   endif
+        delete w;
+    }
+
+    m_workers.clear();
+    m_quit = false;
+}
+#endif
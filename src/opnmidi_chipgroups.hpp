@@ -0,0 +1,152 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPNMIDI_CHIPGROUPS_HPP
+#define OPNMIDI_CHIPGROUPS_HPP
+
+/*
+ * Renderer of the chip groups.
+ *
+ * Every chip group is generated into its own buffer, then all buffers are
+ * summed into the output. When OPNMIDI_ENABLE_CHIP_GROUP_THREADS is defined,
+ * every group except the first one is generated by its own worker thread,
+ * otherwise all groups are generated one by one by the calling thread.
+ *
+ * Workers only run the emulators of their own chips while the calling
+ * thread waits for them, so, all register writes are still done by the
+ * calling thread between the render calls.
+ *
+ * Buffers and workers are made by prepare() on every reset of the chips and
+ * change of the groups count, the render itself never allocates. Until the
+ * renderer gets prepared for the current chips, all of them are generated
+ * one by one into the output.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+#   include "opnmidi_perf.hpp"
+#endif
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+#   ifdef _WIN32
+#       include <windows.h>
+#   else
+#       include <pthread.h>
+#   endif
+#endif
+
+class OPN2;
+
+class OpnChipGroupRenderer
+{
+public:
+    OpnChipGroupRenderer();
+    ~OpnChipGroupRenderer();
+
+    //! Maximum count of frames generated by one job, longer renders are split
+    enum { MaxJobFrames = 512 };
+
+    /**
+     * @brief Allocate mix buffers and start workers for current chips and groups
+     * @param synth Synthesizer which chips will be generated
+     * @return false when out of memory, the renderer then generates chips one by one
+     */
+    bool prepare(const OPN2 &synth);
+
+    /**
+     * @brief Generate all chip groups of the synthesizer and mix them
+     * @param synth Synthesizer which chips should be generated
+     * @param output Output buffer of interleaved stereo frames, filled with zeros
+     * @param frames Count of frames to generate
+     */
+    void render(OPN2 &synth, int32_t *output, size_t frames);
+
+private:
+    //! Mix buffers of the chip groups, the group 0 is generated into the output directly
+    std::vector<std::vector<int32_t> > m_buffers;
+    //! Count of groups the renderer is prepared for, 0 when it is not prepared
+    uint32_t m_groups;
+    //! Count of chips the renderer is prepared for
+    size_t m_chips;
+
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    //! Emulation time of every chip, written by the thread of its group and merged by the calling thread
+    std::vector<OpnPerfCounter> m_chipPerf;
+#endif
+
+    void renderJob(OPN2 &synth, int32_t *output, size_t frames);
+    void generateGroup(OPN2 &synth, uint32_t group, int32_t *output, size_t frames);
+
+#ifdef OPNMIDI_ENABLE_CHIP_GROUP_THREADS
+    struct Worker
+    {
+        OpnChipGroupRenderer *self;
+        uint32_t group;
+        uint64_t startSerial;
+#   ifdef _WIN32
+        HANDLE thread;
+#   else
+        pthread_t thread;
+#   endif
+    };
+
+    //! Running worker threads, the worker N generates the group N + 1
+    std::vector<Worker *> m_workers;
+    //! Synthesizer of the current job
+    OPN2 *m_jobSynth;
+    //! Count of frames of the current job
+    size_t m_jobFrames;
+    //! Serial number of the current job
+    uint64_t m_jobSerial;
+    //! Count of workers which are still busy by the current job
+    size_t m_jobPending;
+    //! Stop all workers
+    bool m_quit;
+
+#   ifdef _WIN32
+    CRITICAL_SECTION m_lock;
+    CONDITION_VARIABLE m_jobStart;
+    CONDITION_VARIABLE m_jobDone;
+    static DWORD WINAPI workerThread(LPVOID arg);
+#   else
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_jobStart;
+    pthread_cond_t m_jobDone;
+    static void *workerThread(void *arg);
+#   endif
+
+    void lock();
+    void unlock();
+    void runWorker(Worker *w);
+    void startWorkers(size_t count);
+    void stopWorkers();
+#endif
+
+    OpnChipGroupRenderer(const OpnChipGroupRenderer &);
+    OpnChipGroupRenderer &operator=(const OpnChipGroupRenderer &);
+};
+
+#endif // OPNMIDI_CHIPGROUPS_HPP
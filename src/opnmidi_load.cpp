@@ -56,6 +56,20 @@ void cvt_FMIns_to_OPNI(OPN2_Instrument &ins, const OpnInstMeta &in)
 }
 
 bool OPNMIDIplay::LoadBank(FileAndMemReader &fr)
+{
+    try
+    {
+        return LoadBankData(fr);
+    }
+    catch(const std::bad_alloc &)
+    {
+        // Bank storage couldn't grow
+        errorStringOut = "Custom bank: Out of memory!";
+        return false;
+    }
+}
+
+bool OPNMIDIplay::LoadBankData(FileAndMemReader &fr)
 {
     int err = 0;
     WOPNFile *wopn = NULL;
@@ -70,6 +84,10 @@ bool OPNMIDIplay::LoadBank(FileAndMemReader &fr)
     // Read complete bank file into the memory
     fsize = fr.fileSize();
     fr.seek(0, FileAndMemReader::SET);
+
+    if(m_setup.sparseBanks)
+        return LoadBankSparse(fr, fsize);
+
     // Allocate necessary memory block
     raw_file_data = (char*)malloc(fsize);
     if(!raw_file_data)
@@ -87,45 +105,18 @@ bool OPNMIDIplay::LoadBank(FileAndMemReader &fr)
     // Check for any erros
     if(!wopn)
     {
-        switch(err)
-        {
-        case WOPN_ERR_BAD_MAGIC:
-            errorStringOut = "Custom bank: Invalid magic!";
-            return false;
-        case WOPN_ERR_UNEXPECTED_ENDING:
-            errorStringOut = "Custom bank: Unexpected ending!";
-            return false;
-        case WOPN_ERR_INVALID_BANKS_COUNT:
-            errorStringOut = "Custom bank: Invalid banks count!";
-            return false;
-        case WOPN_ERR_NEWER_VERSION:
-            errorStringOut = "Custom bank: Version is newer than supported by this library!";
-            return false;
-        case WOPN_ERR_OUT_OF_MEMORY:
-            errorStringOut = "Custom bank: Out of memory!";
-            return false;
-        default:
-            errorStringOut = "Custom bank: Unknown error!";
-            return false;
-        }
+        setBankErrorString(err);
+        return false;
     }
 
     Synth &synth = *m_synth;
 
     synth.resetInstCache();
-
-    synth.m_insBankSetup.volumeModel = wopn->volume_model;
-    synth.m_insBankSetup.lfoEnable = (wopn->lfo_freq & 8) != 0;
-    synth.m_insBankSetup.lfoFrequency = wopn->lfo_freq & 7;
-    synth.m_insBankSetup.chipType = wopn->chip_type;
-    // FIXME: Implement the bank-side flag to enable this
-    synth.m_insBankSetup.mt32defaults = false;
-    m_setup.VolumeModel = OPNMIDI_VolumeModel_AUTO;
-    m_setup.lfoEnable = -1;
-    m_setup.lfoFrequency = -1;
-    m_setup.chipType = -1;
+    setBankSetup(wopn);
 
     synth.m_insBanks.clear();
+    std::vector<char>().swap(m_sparseBankData);
+    m_sparseBanks.clear();
 
     uint16_t slots_counts[2] = {wopn->banks_count_melodic, wopn->banks_count_percussion};
     WOPNBank *slots_src_ins[2] = { wopn->banks_melodic, wopn->banks_percussive };
@@ -148,35 +139,379 @@ bool OPNMIDIplay::LoadBank(FileAndMemReader &fr)
         }
     }
 
-    applySetup();
+    bool ok = applySetup();
 
     WOPN_Free(wopn);
 
+    return ok;
+}
+
+bool OPNMIDIplay::LoadBankSparse(FileAndMemReader &fr, size_t fsize)
+{
+    int err = 0;
+    WOPNFile info;
+    size_t ins_offset = 0;
+    std::vector<char> raw_file_data;
+
+    raw_file_data.resize(fsize);
+    if(fsize > 0)
+        fr.read(&raw_file_data[0], 1, fsize);
+
+    err = WOPN_LoadBankInfoFromMem(&info, fsize > 0 ? &raw_file_data[0] : NULL, fsize, &ins_offset);
+    if(err != WOPN_ERR_OK)
+    {
+        setBankErrorString(err);
+        return false;
+    }
+
+    Synth &synth = *m_synth;
+    const size_t ins_size = WOPN_BankInstRecordSize(info.version);
+    const size_t banks_total = size_t(info.banks_count_melodic) + info.banks_count_percussion;
+
+    synth.resetInstCache();
+    setBankSetup(&info);
+
+    synth.m_insBanks.clear();
+    m_sparseBanks.clear();
+    m_sparseBankVersion = info.version;
+    m_sparseInsSize = ins_size;
+
+    uint16_t slots_counts[2] = {info.banks_count_melodic, info.banks_count_percussion};
+    size_t offset = 0;
+
+    for(size_t ss = 0; ss < 2; ss++)
+    {
+        for(size_t i = 0; i < slots_counts[ss]; i++)
+        {
+            uint8_t msb = 0, lsb = 0;
+            WOPN_LoadBankIdFromMem(&raw_file_data[0], raw_file_data.size(),
+                                   static_cast<uint8_t>(ss), static_cast<uint16_t>(i), &msb, &lsb);
+            size_t bankno = (msb * 256) + lsb + (ss ? size_t(Synth::PercussionTag) : 0);
+            SparseBank &bank = m_sparseBanks[bankno];
+            bank.offset = offset;
+            std::memset(bank.loaded, 0, sizeof(bank.loaded));
+            bank.created = false;
+            bank.used = false;
+            bank.keep = false;
+            offset += 128 * ins_size;
+        }
+    }
+
+    // Only instrument records are kept, the header was parsed already
+    m_sparseBankData.assign(raw_file_data.begin() + static_cast<std::ptrdiff_t>(ins_offset),
+                            raw_file_data.begin() + static_cast<std::ptrdiff_t>(ins_offset + banks_total * 128 * ins_size));
+
+    if(!applySetup())
+        return false;
+
+    sparseUpdateBanks();
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    // Drums of the song are only found once their instruments are loaded
+    prerenderDacDrums();
+#endif
+
+    return true;
+}
+
+void OPNMIDIplay::setBankSetup(const WOPNFile *wopn)
+{
+    Synth &synth = *m_synth;
+    synth.m_insBankSetup.volumeModel = wopn->volume_model;
+    synth.m_insBankSetup.lfoEnable = (wopn->lfo_freq & 8) != 0;
+    synth.m_insBankSetup.lfoFrequency = wopn->lfo_freq & 7;
+    synth.m_insBankSetup.chipType = wopn->chip_type;
+    // FIXME: Implement the bank-side flag to enable this
+    synth.m_insBankSetup.mt32defaults = false;
+    m_setup.VolumeModel = OPNMIDI_VolumeModel_AUTO;
+    m_setup.lfoEnable = -1;
+    m_setup.lfoFrequency = -1;
+    m_setup.chipType = -1;
+}
+
+void OPNMIDIplay::setBankErrorString(int err)
+{
+    switch(err)
+    {
+    case WOPN_ERR_BAD_MAGIC:
+        errorStringOut = "Custom bank: Invalid magic!";
+        break;
+    case WOPN_ERR_UNEXPECTED_ENDING:
+        errorStringOut = "Custom bank: Unexpected ending!";
+        break;
+    case WOPN_ERR_INVALID_BANKS_COUNT:
+        errorStringOut = "Custom bank: Invalid banks count!";
+        break;
+    case WOPN_ERR_NEWER_VERSION:
+        errorStringOut = "Custom bank: Version is newer than supported by this library!";
+        break;
+    case WOPN_ERR_OUT_OF_MEMORY:
+        errorStringOut = "Custom bank: Out of memory!";
+        break;
+    default:
+        errorStringOut = "Custom bank: Unknown error!";
+        break;
+    }
+}
+
+const OpnInstMeta *OPNMIDIplay::findInstrument(size_t bankno, size_t ins)
+{
+    Synth &synth = *m_synth;
+
+    if(!m_sparseBanks.empty())
+        sparseLoadInstrument(bankno, ins, false);
+
+    Synth::BankMap::iterator b = synth.m_insBanks.find(bankno);
+    if(b == synth.m_insBanks.end())
+        return NULL;
+
+    return &b->second.ins[ins];
+}
+
+const OpnInstMeta *OPNMIDIplay::findLoadedInstrument(size_t bankno, size_t ins) const
+{
+    Synth &synth = *m_synth;
+
+    Synth::BankMap::iterator b = synth.m_insBanks.find(bankno);
+    if(b == synth.m_insBanks.end())
+        return NULL;
+
+    return &b->second.ins[ins];
+}
+
+bool OPNMIDIplay::sparseLoadInstrument(size_t bankno, size_t ins, bool mayAllocate)
+{
+    SparseBankMap::iterator s = m_sparseBanks.find(bankno);
+    if(s == m_sparseBanks.end())
+        return false;
+
+    Synth &synth = *m_synth;
+    SparseBank &src = s->second;
+    const uint8_t mask = static_cast<uint8_t>(1 << (ins % 8));
+
+    if((src.loaded[ins / 8] & mask) != 0)
+        return true;
+
+    Synth::BankMap::iterator b = synth.m_insBanks.find(bankno);
+    if(b == synth.m_insBanks.end())
+    {
+        // Create a blank bank, instruments will be filled on demand
+        std::pair<size_t, Synth::Bank> value;
+        value.first = bankno;
+        std::memset(&value.second, 0, sizeof(value.second));
+        for(size_t i = 0; i < 128; ++i)
+            value.second.ins[i].flags = OpnInstMeta::Flag_NoSound;
+
+        if(mayAllocate)
+        {
+            try
+            {
+                b = synth.m_insBanks.insert(value).first;
+            }
+            catch(const std::bad_alloc &)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // Real-time events only take the reserved slots
+            b = synth.m_insBanks.insert(value, Synth::BankMap::do_not_expand_t()).first;
+            if(b == synth.m_insBanks.end())
+                return false;
+        }
+
+        src.created = true;
+    }
+    else if(!src.created)
+        return false; // The bank was made by the user, don't touch it
+
+    WOPNInstrument inIns;
+    WOPN_LoadBankInstRecord(&inIns, &m_sparseBankData[src.offset + ins * m_sparseInsSize], m_sparseBankVersion);
+
+    OpnInstMeta &outIns = b->second.ins[ins];
+    std::memset(&outIns, 0, sizeof(OpnInstMeta));
+    cvt_generic_to_FMIns(outIns, inIns);
+    src.loaded[ins / 8] |= mask;
+
     return true;
 }
 
+void OPNMIDIplay::sparseUpdateBanks()
+{
+    if(m_sparseBanks.empty())
+        return;
+
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    Synth &synth = *m_synth;
+
+    for(SparseBankMap::iterator it = m_sparseBanks.begin(); it != m_sparseBanks.end(); ++it)
+        it->second.used = false;
+
+    sparseLoadSongInstruments(*m_sequencer);
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        if(m_songSlots[i].sequencer.get())
+            sparseLoadSongInstruments(*m_songSlots[i].sequencer);
+    }
+
+    // Drop banks used by previous songs and by real-time events only
+    bool dropped = false;
+    for(SparseBankMap::iterator it = m_sparseBanks.begin(); it != m_sparseBanks.end(); ++it)
+    {
+        SparseBank &src = it->second;
+        if(!src.created || src.used || src.keep)
+            continue;
+
+        Synth::BankMap::iterator b = synth.m_insBanks.find(it->first);
+        if(b != synth.m_insBanks.end())
+            synth.m_insBanks.erase(b);
+        std::memset(src.loaded, 0, sizeof(src.loaded));
+        src.created = false;
+        dropped = true;
+    }
+
+    // Freed slots will be taken by other banks
+    if(dropped)
+        synth.resetInstCache();
+#endif
+
+    sparseReserveBanks();
+}
+
+void OPNMIDIplay::sparseReserveBanks()
+{
+    Synth &synth = *m_synth;
+    size_t pending = 0;
+
+    for(SparseBankMap::iterator it = m_sparseBanks.begin(); it != m_sparseBanks.end(); ++it)
+    {
+        if(!it->second.created && synth.m_insBanks.find(it->first) == synth.m_insBanks.end())
+            ++pending;
+    }
+
+    if(pending > SparseSpareBanks)
+        pending = SparseSpareBanks;
+
+    try
+    {
+        synth.m_insBanks.reserve(synth.m_insBanks.size() + pending);
+    }
+    catch(const std::bad_alloc &)
+    {
+        // Real-time events will find less of banks
+    }
+}
+
+void OPNMIDIplay::sparseKeepInstrument(size_t bankno, size_t ins)
+{
+    SparseBankMap::iterator s = m_sparseBanks.find(bankno);
+    if(s == m_sparseBanks.end())
+        return;
+    s->second.loaded[ins / 8] |= static_cast<uint8_t>(1 << (ins % 8));
+    s->second.keep = true;
+}
+
+void OPNMIDIplay::sparseForgetBank(size_t bankno)
+{
+    SparseBankMap::iterator s = m_sparseBanks.find(bankno);
+    if(s != m_sparseBanks.end())
+        m_sparseBanks.erase(s);
+}
+
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
 
+static inline bool sparseBitIsSet(const uint8_t *mask, size_t bit)
+{
+    return (mask[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+void OPNMIDIplay::sparseLoadSongInstruments(const MidiSequencer &seq)
+{
+    if(m_sparseBanks.empty())
+        return;
+
+    MidiSequencer::InstrumentsUsage usage;
+    seq.getInstrumentsUsage(usage);
+
+    for(size_t ch = 0; ch < 16; ++ch)
+    {
+        // Initial state of every channel is always a zero bank and a zero patch
+        usage.bankMsb[ch][0] |= 1;
+        usage.bankLsb[ch][0] |= 1;
+        usage.patches[ch][0] |= 1;
+    }
+
+    for(SparseBankMap::iterator it = m_sparseBanks.begin(); it != m_sparseBanks.end(); ++it)
+    {
+        const size_t bankno = it->first;
+        const bool isPercussion = (bankno & Synth::PercussionTag) != 0;
+        const size_t bankId = bankno & ~static_cast<size_t>(Synth::PercussionTag);
+        const size_t msb = (bankId >> 8) & 0xFF;
+        const size_t lsb = bankId & 0xFF;
+
+        for(size_t ch = 0; ch < 16; ++ch)
+        {
+            // XG drum kits and any SysEx may turn a regular channel into percussion
+            bool canBeDrums = (ch == 9) || usage.hasSysEx ||
+                              sparseBitIsSet(usage.bankMsb[ch], 0x7E) ||
+                              sparseBitIsSet(usage.bankMsb[ch], 0x7F);
+            const uint8_t *insMask;
+
+            if(isPercussion)
+            {
+                // Percussion bank number is a patch number (+128 for XG SFX kits)
+                if(!canBeDrums)
+                    continue;
+                bool used = (bankId == 0) || (bankId == 128);
+                if(!used && bankId < 256)
+                    used = sparseBitIsSet(usage.patches[ch], bankId & 0x7F);
+                if(!used)
+                    continue;
+                insMask = usage.notes[ch];
+            }
+            else
+            {
+                if(ch == 9 || msb > 127 || lsb > 127)
+                    continue;
+                // Zero LSB banks are also used as a fallback of any other LSB
+                if(!sparseBitIsSet(usage.bankMsb[ch], msb))
+                    continue;
+                if(lsb != 0 && !sparseBitIsSet(usage.bankLsb[ch], lsb))
+                    continue;
+                insMask = usage.patches[ch];
+            }
+
+            for(size_t ins = 0; ins < 128; ++ins)
+            {
+                if(sparseBitIsSet(insMask, ins))
+                {
+                    it->second.used = true;
+                    sparseLoadInstrument(bankno, ins, true);
+                }
+            }
+        }
+    }
+}
+
 bool OPNMIDIplay::LoadMIDI_pre()
 {
     Synth &synth = *m_synth;
-    if(synth.m_insBanks.empty())
+    if(synth.m_insBanks.empty() && m_sparseBanks.empty())
     {
         errorStringOut = "Bank is not set! Please load any instruments bank by using of adl_openBankFile() or adl_openBankData() functions!";
         return false;
     }
 
     /**** Set all properties BEFORE starting of actial file reading! ****/
+    m_regLog.active = false;
+    m_regLog.chipsChanged = false; // Chips are set up below
+    std::vector<OPN2_RegWrite>().swap(m_regLog.events);
     resetMIDI();
-    applySetup();
-
-    return true;
+    return applySetup();
 }
 
-bool OPNMIDIplay::LoadMIDI_post()
+bool OPNMIDIplay::checkSongFormat(MidiSequencer &seq)
 {
-    Synth &synth = *m_synth;
-    MidiSequencer &seq = *m_sequencer;
     MidiSequencer::FileFormat format = seq.getFormat();
     if(format == MidiSequencer::Format_CMF)
     {
@@ -195,14 +530,44 @@ bool OPNMIDIplay::LoadMIDI_post()
         /* Same as for CMF */
         return false;
     }
-    else if(format == MidiSequencer::Format_XMIDI)
+
+    return true;
+}
+
+bool OPNMIDIplay::LoadMIDI_post()
+{
+    Synth &synth = *m_synth;
+    MidiSequencer &seq = *m_sequencer;
+
+    if(!checkSongFormat(seq))
+        return false;
+
+    if(seq.getFormat() == MidiSequencer::Format_XMIDI)
         synth.m_musicMode = Synth::MODE_XMIDI;
 
+    sparseUpdateBanks();
+
+    if(m_setup.autoNumChipsMax > 0)
+    {
+        m_setup.autoNumChips = estimateNumChips(m_setup.autoNumChipsMax);
+        synth.m_numChips = m_setup.autoNumChips;
+    }
+
     m_setup.tick_skip_samples_delay = 0;
-    synth.reset(m_setup.emulator, m_setup.PCM_RATE, synth.chipFamily(), this); // Reset OPN2 chip
+    // Chips are reset below, songs of slots continue with new notes
+    releaseSlotNotes();
+    if(!synth.reset(m_setup.emulator, m_setup.PCM_RATE, synth.chipFamily(), this)) // Reset OPN2 chip
+    {
+        errorStringOut = "OPN2 MIDI: Out of memory, can't make chips!";
+        return false;
+    }
     m_chipChannels.clear();
     m_chipChannels.resize(synth.m_numChannels);
     resetMIDIDefaults();
+    // Blocks of song slots are taken already, devices of the song go after them
+    reserveMidiDevices(seq.getDevicesCount() + m_midiDevicesUsed);
+
+    prerenderDacDrums();
 #ifdef OPNMIDI_MIDI2VGM
     m_sequencerInterface->onloopStart = synth.m_loopStartHook;
     m_sequencerInterface->onloopStart_userData = synth.m_loopStartHookData;
@@ -266,4 +631,296 @@ bool OPNMIDIplay::LoadMIDI(const void *data, size_t size)
     return true;
 }
 
+bool OPNMIDIplay::LoadSlotMIDI(size_t slot, const std::string &filename)
+{
+    FileAndMemReader file;
+    file.openFile(filename.c_str());
+    file.dumpFile();
+    return LoadSlotMIDI(slot, file);
+}
+
+bool OPNMIDIplay::LoadSlotMIDI(size_t slot, const void *data, size_t size)
+{
+    FileAndMemReader file;
+    file.openData(data, size);
+    return LoadSlotMIDI(slot, file);
+}
+
+bool OPNMIDIplay::LoadSlotMIDI(size_t slot, FileAndMemReader &fr)
+{
+    Synth &synth = *m_synth;
+
+    if(synth.m_insBanks.empty() && m_sparseBanks.empty())
+    {
+        errorStringOut = "Bank is not set! Please load any instruments bank by using of adl_openBankFile() or adl_openBankData() functions!";
+        return false;
+    }
+
+    closeSlot(slot);
+
+    SongSlot &s = m_songSlots[slot];
+    s.sequencer.reset(adlmidi_new<MidiSequencer>(&synth.m_allocator));
+    if(!s.sequencer.get() || !initSlotInterface(slot))
+    {
+        s.sequencer.reset();
+        errorStringOut = "Out of memory!";
+        return false;
+    }
+
+    MidiSequencer &seq = *s.sequencer;
+    seq.setDeviceMask(MidiSequencer::Device_OPL2|MidiSequencer::Device_OPL3);
+
+    bool loaded = seq.loadMIDI(fr);
+    if(!loaded)
+        errorStringOut = seq.getErrorString();
+
+    if(!loaded || !checkSongFormat(seq))
+    {
+        s.sequencer.reset();
+        s.rtInterface.reset();
+        return false;
+    }
+
+    seq.setLoopEnabled(false);
+    ++m_songSlotsUsed;
+    s.paused = false;
+    s.channelBase = chooseSlotDevice(slot);
+    resetSlotState(slot);
+
+    if(!m_sparseBanks.empty())
+    {
+        sparseLoadSongInstruments(seq);
+        sparseReserveBanks();
+    }
+    if(synth.dacDrumsActive())
+        prerenderDacDrums(seq);
+
+    return true;
+}
+
 #endif //OPNMIDI_DISABLE_MIDI_SEQUENCER
+
+
+static bool regLogOffsetLess(const OPN2_RegWrite &a, const OPN2_RegWrite &b)
+{
+    return a.sampleOffset < b.sampleOffset;
+}
+
+bool OPNMIDIplay::LoadRegLog(const OPN2_RegWrite *events, size_t count, unsigned long rate)
+{
+    if(!events || count == 0)
+    {
+        errorStringOut = "Register log is empty!";
+        return false;
+    }
+
+    if(rate == 0)
+    {
+        errorStringOut = "Register log: Invalid sample rate!";
+        return false;
+    }
+
+    size_t chips = 1;
+    std::vector<OPN2_RegWrite> log(events, events + count);
+    std::stable_sort(log.begin(), log.end(), regLogOffsetLess);
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(size_t(log[i].chip) + 1 > chips)
+            chips = size_t(log[i].chip) + 1;
+    }
+
+    m_regLog.events.swap(log);
+    m_regLog.rate = rate;
+    m_regLog.length = m_regLog.events.back().sampleOffset;
+    return regLogStart(m_synth->chipFamily(), chips);
+}
+
+bool OPNMIDIplay::LoadVGM(const std::string &filename)
+{
+    FileAndMemReader file;
+    file.openFile(filename.c_str());
+    return LoadVGM(file);
+}
+
+bool OPNMIDIplay::LoadVGM(const void *data, size_t size)
+{
+    FileAndMemReader file;
+    file.openData(data, size);
+    return LoadVGM(file);
+}
+
+static inline uint32_t vgmReadLE32(const std::vector<uint8_t> &data, size_t offset)
+{
+    return  static_cast<uint32_t>(data[offset + 0]) |
+           (static_cast<uint32_t>(data[offset + 1]) << 8) |
+           (static_cast<uint32_t>(data[offset + 2]) << 16) |
+           (static_cast<uint32_t>(data[offset + 3]) << 24);
+}
+
+static inline void vgmPushReg(std::vector<OPN2_RegWrite> &events, uint64_t time,
+                              uint8_t chip, uint8_t port, uint8_t addr, uint8_t value)
+{
+    OPN2_RegWrite e;
+    e.sampleOffset = time;
+    e.chip = chip;
+    e.port = port;
+    e.addr = addr;
+    e.value = value;
+    events.push_back(e);
+}
+
+bool OPNMIDIplay::LoadVGM(FileAndMemReader &fr)
+{
+    if(!fr.isValid())
+    {
+        errorStringOut = "VGM: Invalid data stream!";
+        return false;
+    }
+
+    size_t fsize = fr.fileSize();
+    fr.seek(0, FileAndMemReader::SET);
+
+    std::vector<uint8_t> data(fsize);
+    if(fsize > 0)
+        fr.read(&data[0], 1, fsize);
+
+    if(fsize < 0x40 || std::memcmp(&data[0], "Vgm ", 4) != 0)
+    {
+        errorStringOut = "VGM: Invalid file header!";
+        return false;
+    }
+
+    uint32_t version = vgmReadLE32(data, 0x08);
+    uint32_t clockOPN2 = vgmReadLE32(data, version >= 0x110 ? 0x2C : 0x10);
+    uint32_t clockOPNA = (version >= 0x151 && fsize >= 0x4C) ? vgmReadLE32(data, 0x48) : 0;
+    uint32_t dataOffset = version >= 0x150 ? vgmReadLE32(data, 0x34) : 0;
+    size_t pos = dataOffset ? 0x34 + size_t(dataOffset) : 0x40;
+
+    if(clockOPN2 != 0 && clockOPNA != 0)
+    {
+        errorStringOut = "VGM: Files with both YM2612 and YM2608 chips are not supported!";
+        return false;
+    }
+
+    OPNFamily family = (clockOPN2 == 0 && clockOPNA != 0) ? OPNChip_OPNA : OPNChip_OPN2;
+    const bool isOPNA = (family == OPNChip_OPNA);
+    uint32_t clock = (family == OPNChip_OPNA) ? clockOPNA : clockOPN2;
+    if(clock == 0)
+    {
+        errorStringOut = "VGM: File has no YM2612 or YM2608 data!";
+        return false;
+    }
+
+    size_t chips = (clock & 0x40000000) ? 2 : 1;
+
+    std::vector<OPN2_RegWrite> events;
+    std::vector<uint8_t> pcm;
+    size_t pcmPos = 0;
+    uint64_t time = 0;
+    bool end = false;
+
+    while(!end && pos < fsize)
+    {
+        const uint8_t cmd = data[pos];
+        size_t len;
+
+        if(cmd >= 0x30 && cmd <= 0x3F)
+            len = 2;
+        else if((cmd >= 0x40 && cmd <= 0x4E) || (cmd >= 0x51 && cmd <= 0x5F) || (cmd >= 0xA0 && cmd <= 0xBF))
+            len = 3;
+        else if(cmd == 0x4F || cmd == 0x50)
+            len = 2;
+        else if(cmd == 0x61)
+            len = 3;
+        else if(cmd == 0x67)
+            len = 7 + (pos + 7 <= fsize ? (vgmReadLE32(data, pos + 3) & 0x7FFFFFFF) : 0);
+        else if(cmd == 0x68)
+            len = 12;
+        else if(cmd >= 0x90 && cmd <= 0x95)
+        {
+            static const size_t streamLen[6] = {5, 5, 6, 11, 2, 5};
+            len = streamLen[cmd - 0x90];
+        }
+        else if(cmd >= 0xC0 && cmd <= 0xDF)
+            len = 4;
+        else if(cmd >= 0xE0)
+            len = 5;
+        else if(cmd == 0x62 || cmd == 0x63 || cmd == 0x66 || (cmd >= 0x70 && cmd <= 0x8F))
+            len = 1;
+        else
+            break; // Unknown command
+
+        if(pos + len > fsize)
+            break;
+
+        const uint8_t *c = &data[pos];
+
+        switch(cmd)
+        {
+        case 0x52: // YM2612, first chip
+        case 0x53:
+            if(!isOPNA)
+                vgmPushReg(events, time, 0, cmd & 1, c[1], c[2]);
+            break;
+        case 0x56: // YM2608, first chip
+        case 0x57:
+            if(isOPNA)
+                vgmPushReg(events, time, 0, cmd & 1, c[1], c[2]);
+            break;
+        case 0xA2: // YM2612, second chip
+        case 0xA3:
+            if(!isOPNA)
+                vgmPushReg(events, time, 1, cmd & 1, c[1], c[2]);
+            break;
+        case 0xA6: // YM2608, second chip
+        case 0xA7:
+            if(isOPNA)
+                vgmPushReg(events, time, 1, cmd & 1, c[1], c[2]);
+            break;
+        case 0x61:
+            time += uint64_t(c[1]) | (uint64_t(c[2]) << 8);
+            break;
+        case 0x62:
+            time += 735;
+            break;
+        case 0x63:
+            time += 882;
+            break;
+        case 0x66:
+            end = true;
+            break;
+        case 0x67:
+            if(c[2] == 0x00) // YM2612 PCM data
+                pcm.insert(pcm.end(), c + 7, c + len);
+            break;
+        case 0xE0:
+            pcmPos = vgmReadLE32(data, pos + 1);
+            break;
+        default:
+            if(cmd >= 0x70 && cmd <= 0x7F)
+                time += (cmd & 0x0F) + 1;
+            else if(cmd >= 0x80 && cmd <= 0x8F)
+            {
+                if(!isOPNA && pcmPos < pcm.size()) // DAC of YM2612
+                    vgmPushReg(events, time, 0, 0, 0x2A, pcm[pcmPos++]);
+                time += cmd & 0x0F;
+            }
+            break;
+        }
+
+        pos += len;
+    }
+
+    if(events.empty())
+    {
+        errorStringOut = "VGM: File has no YM2612 or YM2608 data!";
+        return false;
+    }
+
+    uint64_t totalSamples = vgmReadLE32(data, 0x18);
+    m_regLog.events.swap(events);
+    m_regLog.rate = 44100;
+    m_regLog.length = time > totalSamples ? time : totalSamples;
+    return regLogStart(family, chips);
+}
@@ -32,6 +32,78 @@
 // Minimum life time of percussion notes
 static const double drum_note_min_time = 0.03;
 
+/*! Rhythm voices of OPNA for GM percussion keys 35...59, 0 - play by FM, 1...6 - rhythm voice (see OPN2_InstrumentFlags) */
+static const uint8_t s_gmRhythmMap[25] =
+{
+    1, 1, 6, 2, 2, 2, 5, 4, 5, 4, 5, 4, 5, /* 35...47 */
+    5, 3, 5, 3, 3, 3, 4, 3, 6, 3, 0, 3     /* 48...59 */
+};
+
+/**
+ * @brief Choose the category of the chip channel for the note when OPNA extra channels are in use
+ * @param ains Instrument of the note
+ * @param isPercussion Is the note of the percussion channel
+ * @param note MIDI key of the note
+ * @return Category of the channel (see OPN2::ChanCat)
+ */
+static char opnExtraChannelCategory(const OpnInstMeta *ains, bool isPercussion, uint8_t note)
+{
+    uint8_t rhythm = static_cast<uint8_t>((ains->flags & OpnInstMeta::Flag_RhythmMask) >> 3);
+
+    if(rhythm == 0 && isPercussion && note >= 35 && note <= 59)
+        rhythm = s_gmRhythmMap[note - 35];
+
+    if(rhythm >= 1 && rhythm <= 6)
+        return static_cast<char>(Synth::ChanCat_Rhythm_Bass + (rhythm - 1));
+
+    if(ains->flags & OpnInstMeta::Flag_SSG)
+        return static_cast<char>(Synth::ChanCat_SSG);
+
+    return static_cast<char>(Synth::ChanCat_Regular);
+}
+
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+/*! Quarter of the sine period in 64 steps, scaled by 32767. Result of:
+    ```
+    round(32767.0 * sin(i * M_PI / 128.0))
+    ```
+*/
+static const int16_t s_vibratoSine[65] =
+{
+        0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+     6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767
+};
+
+/**
+ * @brief Fixed-point sine with linear interpolation between table steps
+ * @param phase Phase value, full period is 2^32
+ * @return Sine value scaled by 32767
+ */
+static int32_t vibratoSine(uint32_t phase)
+{
+    uint32_t quarter = phase >> 30;
+    uint32_t pos = (phase >> 16) & 0x3FFF;
+
+    if(quarter & 1)
+        pos = 0x4000 - pos;
+
+    uint32_t idx = pos >> 8;
+    int32_t frac = static_cast<int32_t>(pos & 0xFF);
+    int32_t a = s_vibratoSine[idx];
+    int32_t b = s_vibratoSine[idx < 64 ? idx + 1 : 64];
+    int32_t ret = a + ((b - a) * frac) / 256;
+
+    return (quarter & 2) ? -ret : ret;
+}
+#endif
+
 enum { MasterVolumeDefault = 127 };
 
 inline bool isXgPercChannel(uint8_t msb, uint8_t lsb)
@@ -58,27 +130,41 @@ void OPNMIDIplay::OpnChannel::addAge(int64_t us)
             if(!d.fixed_sustain)
                 d.kon_time_until_neglible_us = std::max(d.kon_time_until_neglible_us - us, neg);
             d.vibdelay_us += us;
+            if(d.kon_time_until_end_us > 0)
+                d.kon_time_until_end_us = std::max<int64_t>(d.kon_time_until_end_us - us, 0);
         }
     }
 }
 
-OPNMIDIplay::OPNMIDIplay(unsigned long sampleRate) :
+OPNMIDIplay::OPNMIDIplay(unsigned long sampleRate, const ADLMIDI_Allocator *allocator) :
     m_sysExDeviceId(0),
     m_synthMode(Mode_XG),
     m_arpeggioCounter(0)
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
     , m_audioTickCounter(0)
 #endif
+    , m_noteDurationUs(-1)
+    , m_renderAhead(NULL)
 {
     m_setup.emulator = opn2_getLowestEmulator();
     m_setup.runAtPcmRate = false;
+    m_setup.extraChannels = false;
+    m_setup.dacDrums = false;
 
     m_setup.PCM_RATE = sampleRate;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    m_setup.mindelay = static_cast<OpnTickTime>(1) << OPN_TICK_TIME_SHIFT;
+    m_setup.maxdelay = static_cast<OpnTickTime>(512) << OPN_TICK_TIME_SHIFT;
+#else
     m_setup.mindelay = 1.0 / static_cast<double>(m_setup.PCM_RATE);
     m_setup.maxdelay = 512.0 / static_cast<double>(m_setup.PCM_RATE);
+#endif
+    m_drumNoteMinTime = secondsToTickTime(drum_note_min_time);
 
     m_setup.OpnBank    = 0;
     m_setup.numChips   = 2;
+    m_setup.autoNumChipsMax = 0;
+    m_setup.autoNumChips = 0;
     m_setup.LogarithmicVolumes  = false;
     m_setup.VolumeModel = OPNMIDI_VolumeModel_AUTO;
     m_setup.lfoEnable = -1;
@@ -88,18 +174,47 @@ OPNMIDIplay::OPNMIDIplay(unsigned long sampleRate) :
     m_setup.ScaleModulators     = 0;
     m_setup.fullRangeBrightnessCC74 = false;
     m_setup.enableAutoArpeggio = false;
-    m_setup.delay = 0.0;
-    m_setup.carry = 0.0;
+    m_setup.sparseBanks = false;
+    m_sparseBankVersion = 0;
+    m_sparseInsSize = 0;
+    m_setup.delay = 0;
+    m_setup.carry = 0;
     m_setup.tick_skip_samples_delay = 0;
-
-    m_synth.reset(new Synth);
+    m_setup.tick_skip_delay = 0;
+
+    m_regLog.rate = 44100;
+    m_regLog.length = 0;
+    m_regLog.pos = 0;
+    m_regLog.frames = 0;
+    m_regLog.active = false;
+    m_regLog.chipsChanged = false;
+    m_regLog.savedChips = 0;
+    m_regLog.savedFamily = OPNChip_OPN2;
+
+    // Failures are thrown to opn2_initEx() which releases everything
+    m_synth.reset(adlmidi_new<Synth>(allocator, allocator));
+    if(!m_synth.get())
+        throw std::bad_alloc();
 
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
-    m_sequencer.reset(new MidiSequencer);
-    initSequencerInterface();
+    m_sequencer.reset(adlmidi_new<MidiSequencer>(allocator));
+    if(!m_sequencer.get() || !initSequencerInterface())
+        throw std::bad_alloc();
+
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        SongSlot &slot = m_songSlots[i];
+        slot.player = this;
+        slot.channelBase = 0;
+        slot.paused = false;
+        slot.volume = 127;
+        slot.priority = 0;
+    }
+    m_songSlotsUsed = 0;
 #endif
     resetMIDI();
-    applySetup();
+    if(!applySetup())
+        throw std::bad_alloc();
     realTime_ResetState();
 }
 
@@ -107,7 +222,7 @@ OPNMIDIplay::~OPNMIDIplay()
 {
 }
 
-void OPNMIDIplay::applySetup()
+bool OPNMIDIplay::applySetup()
 {
     Synth &synth = *m_synth;
 
@@ -116,6 +231,8 @@ void OPNMIDIplay::applySetup()
     m_setup.tick_skip_samples_delay = 0;
 
     synth.m_runAtPcmRate            = m_setup.runAtPcmRate;
+    synth.m_extraChannels           = m_setup.extraChannels;
+    synth.m_dacDrums                = m_setup.dacDrums;
 
     synth.m_scaleModulators         = (m_setup.ScaleModulators != 0);
 
@@ -127,7 +244,7 @@ void OPNMIDIplay::applySetup()
     if(m_setup.VolumeModel == OPNMIDI_VolumeModel_AUTO)
         synth.setFrequencyModel(static_cast<Synth::VolumesScale>(synth.m_insBankSetup.volumeModel));
 
-    synth.m_numChips    = m_setup.numChips;
+    synth.m_numChips    = (m_setup.autoNumChips > 0) ? m_setup.autoNumChips : m_setup.numChips;
 
     if(m_setup.lfoEnable < 0)
         synth.m_lfoEnable = (synth.m_insBankSetup.lfoEnable != 0);
@@ -145,9 +262,14 @@ void OPNMIDIplay::applySetup()
     else
         chipType = m_setup.chipType;
 
-    synth.reset(m_setup.emulator, m_setup.PCM_RATE, static_cast<OPNFamily>(chipType), this);
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    // Chips are reset below, songs of slots continue with new notes
+    releaseSlotNotes();
+#endif
+    bool ok = synth.reset(m_setup.emulator, m_setup.PCM_RATE, static_cast<OPNFamily>(chipType), this);
     m_chipChannels.clear();
     m_chipChannels.resize(synth.m_numChannels, OpnChannel());
+    m_voiceStats.clear();
     resetMIDIDefaults();
 #if defined(OPNMIDI_MIDI2VGM) && !defined(OPNMIDI_DISABLE_MIDI_SEQUENCER)
     m_sequencerInterface->onloopStart = synth.m_loopStartHook;
@@ -158,17 +280,31 @@ void OPNMIDIplay::applySetup()
 #endif
     // Reset the arpeggio counter
     m_arpeggioCounter = 0;
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    // Samples were dropped by the chips reset or by the bank change
+    if(ok)
+        prerenderDacDrums();
+#endif
+
+    if(!ok)
+        errorStringOut = "OPN2 MIDI: Out of memory, can't make chips!";
+    return ok;
 }
 
-void OPNMIDIplay::partialReset()
+bool OPNMIDIplay::partialReset()
 {
     Synth &synth = *m_synth;
     realTime_panic();
     m_setup.tick_skip_samples_delay = 0;
     synth.m_runAtPcmRate = m_setup.runAtPcmRate;
-    synth.reset(m_setup.emulator, m_setup.PCM_RATE, synth.chipFamily(), this);
+    synth.m_extraChannels = m_setup.extraChannels;
+    synth.m_dacDrums = m_setup.dacDrums;
+    if(synth.m_numChips == 0) // Chips were lost by a failed allocation
+        synth.m_numChips = (m_setup.autoNumChips > 0) ? m_setup.autoNumChips : m_setup.numChips;
+    bool ok = synth.reset(m_setup.emulator, m_setup.PCM_RATE, synth.chipFamily(), this);
     m_chipChannels.clear();
     m_chipChannels.resize(synth.m_numChannels);
+    m_voiceStats.clear();
     resetMIDIDefaults();
 #if defined(OPNMIDI_MIDI2VGM) && !defined(OPNMIDI_DISABLE_MIDI_SEQUENCER)
     m_sequencerInterface->onloopStart = synth.m_loopStartHook;
@@ -177,6 +313,89 @@ void OPNMIDIplay::partialReset()
     m_sequencerInterface->onloopEnd_userData = synth.m_loopEndHookData;
     m_sequencer->setLoopHooksOnly(m_sequencerInterface->onloopStart != NULL);
 #endif
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(ok)
+        prerenderDacDrums();
+#endif
+
+    if(!ok)
+        errorStringOut = "OPN2 MIDI: Out of memory, can't make chips!";
+    return ok;
+}
+
+bool OPNMIDIplay::regLogStart(OPNFamily family, size_t chips)
+{
+    Synth &synth = *m_synth;
+    realTime_panic();
+    m_setup.tick_skip_samples_delay = 0;
+    synth.m_runAtPcmRate = m_setup.runAtPcmRate;
+    if(!m_regLog.chipsChanged)
+    {
+        m_regLog.savedChips = synth.m_numChips;
+        m_regLog.savedFamily = synth.chipFamily();
+        m_regLog.chipsChanged = true;
+    }
+    synth.m_numChips = static_cast<unsigned int>(chips);
+    if(!synth.reset(m_setup.emulator, m_setup.PCM_RATE, family, this))
+    {
+        errorStringOut = "OPN2 MIDI: Out of memory, can't make chips!";
+        return false;
+    }
+    m_chipChannels.clear();
+    m_chipChannels.resize(synth.m_numChannels);
+    resetMIDIDefaults();
+    m_regLog.pos = 0;
+    m_regLog.frames = 0;
+    m_regLog.active = true;
+    return true;
+}
+
+uint64_t OPNMIDIplay::regLogProcess()
+{
+    Synth &synth = *m_synth;
+    RegLog &log = m_regLog;
+    const uint64_t rate = log.rate > 0 ? log.rate : 1;
+    const uint64_t outRate = m_setup.PCM_RATE;
+    const size_t chips = synth.m_chips.size();
+
+    while(log.pos < log.events.size())
+    {
+        const OPN2_RegWrite &e = log.events[log.pos];
+        const uint64_t due = (e.sampleOffset * outRate) / rate;
+        if(due > log.frames)
+            return due - log.frames;
+
+        if(e.chip < chips)
+        {
+            if(e.port == OPNMIDI_RegCapture_PanPort)
+                synth.writePan(e.chip, e.addr, e.value);
+            else
+                synth.writeReg(e.chip, e.port, static_cast<uint8_t>(e.addr), e.value);
+        }
+        ++log.pos;
+    }
+
+    const uint64_t end = (log.length * outRate) / rate;
+    return end > log.frames ? end - log.frames : 0;
+}
+
+bool OPNMIDIplay::regLogFinish()
+{
+    Synth &synth = *m_synth;
+    RegLog &log = m_regLog;
+    if(!log.chipsChanged)
+        return true;
+
+    log.chipsChanged = false;
+    synth.m_numChips = log.savedChips;
+    bool ok = synth.reset(m_setup.emulator, m_setup.PCM_RATE, log.savedFamily, this);
+    m_chipChannels.clear();
+    m_chipChannels.resize(synth.m_numChannels);
+    resetMIDIDefaults();
+
+    if(!ok)
+        errorStringOut = "OPN2 MIDI: Out of memory, can't make chips!";
+    return ok;
 }
 
 void OPNMIDIplay::resetMIDI()
@@ -187,18 +406,29 @@ void OPNMIDIplay::resetMIDI()
     m_synthMode = Mode_XG;
     m_arpeggioCounter = 0;
 
-    std::memset(m_midiDevices, 0, sizeof(m_midiDevices));
     std::memset(m_currentMidiDevice, 0, sizeof(m_currentMidiDevice));
-    m_midiDevicesUsed = 0;
 
-    m_midiChannels.clear();
-    m_midiChannels.resize(16, MIDIchannel());
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    if(m_songSlotsUsed > 0)
+    {
+        // Songs of slots keep playing on their channels
+        resetMainSongDevices();
+    }
+    else
+#endif
+    {
+        std::memset(m_midiDevices, 0, sizeof(m_midiDevices));
+        m_midiDevicesUsed = 0;
 
-    resetMIDIDefaults();
+        m_midiChannels.clear();
+        m_midiChannels.resize(16, MIDIchannel());
+
+        resetMIDIDefaults();
+    }
 
-    caugh_missing_instruments.clear();
-    caugh_missing_banks_melodic.clear();
-    caugh_missing_banks_percussion.clear();
+    caugh_missing_instruments.reset();
+    caugh_missing_banks_melodic.reset();
+    caugh_missing_banks_percussion.reset();
 }
 
 void OPNMIDIplay::resetMIDIDefaults(int offset)
@@ -220,13 +450,37 @@ void OPNMIDIplay::resetMIDIDefaults(int offset)
     }
 }
 
-void OPNMIDIplay::TickIterators(double s)
+OpnTickTime OPNMIDIplay::secondsToTickTime(double seconds) const
+{
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    return static_cast<OpnTickTime>(seconds * m_setup.PCM_RATE * (1 << OPN_TICK_TIME_SHIFT));
+#else
+    return seconds;
+#endif
+}
+
+double OPNMIDIplay::tickTimeToSeconds(OpnTickTime t) const
+{
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    return static_cast<double>(t) / (static_cast<double>(m_setup.PCM_RATE) * (1 << OPN_TICK_TIME_SHIFT));
+#else
+    return t;
+#endif
+}
+
+void OPNMIDIplay::TickIterators(OpnTickTime s)
 {
     Synth &synth = *m_synth;
+    OPN_PERF_SCOPE(perfSynth, synth.m_perf, synth.m_perf.synth);
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    const int64_t us = (s * 1000000) / (static_cast<int64_t>(m_setup.PCM_RATE) << OPN_TICK_TIME_SHIFT);
+#else
+    const int64_t us = static_cast<int64_t>(s * 1e6);
+#endif
     for(uint32_t c = 0, n = synth.m_numChannels; c < n; ++c)
     {
         OpnChannel &ch = m_chipChannels[c];
-        ch.addAge(static_cast<int64_t>(s * 1e6));
+        ch.addAge(us);
     }
 
     // Resolve "hell of all times" of too short drum notes
@@ -241,7 +495,7 @@ void OPNMIDIplay::TickIterators(double s)
             MIDIchannel::notes_iterator i(inext++);
             MIDIchannel::NoteInfo &ni = i->value;
 
-            double ttl = ni.ttl;
+            OpnTickTime ttl = ni.ttl;
             if(ttl <= 0)
                 continue;
 
@@ -269,22 +523,25 @@ void OPNMIDIplay::realTime_ResetState()
 {
     Synth &synth = *m_synth;
     for(size_t ch = 0; ch < m_midiChannels.size(); ch++)
-    {
-        MIDIchannel &chan = m_midiChannels[ch];
-        chan.resetAllControllers();
-        chan.vibpos = 0.0;
-        chan.lastlrpn = 0;
-        chan.lastmrpn = 0;
-        chan.nrpn = false;
-        if((m_synthMode & Mode_GS) != 0)// Reset custom drum channels on GS
-            chan.is_xg_percussion = false;
-        noteUpdateAll(uint16_t(ch), Upd_All);
-        noteUpdateAll(uint16_t(ch), Upd_Off);
-    }
+        resetChannelState(ch);
     synth.m_masterVolume = MasterVolumeDefault;
 }
 
-bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocity)
+void OPNMIDIplay::resetChannelState(size_t ch)
+{
+    MIDIchannel &chan = m_midiChannels[ch];
+    chan.resetAllControllers();
+    chan.vibpos = 0;
+    chan.lastlrpn = 0;
+    chan.lastmrpn = 0;
+    chan.nrpn = false;
+    if((m_synthMode & Mode_GS) != 0)// Reset custom drum channels on GS
+        chan.is_xg_percussion = false;
+    noteUpdateAll(uint16_t(ch), Upd_All);
+    noteUpdateAll(uint16_t(ch), Upd_Off);
+}
+
+bool OPNMIDIplay::realTime_NoteOn(size_t channel, uint8_t note, uint8_t velocity)
 {
     Synth &synth = *m_synth;
 
@@ -307,7 +564,7 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         }
     }
 
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
 
     // noteOff(channel, note, velocity != 0);
@@ -362,18 +619,18 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         bank += Synth::PercussionTag;
 
     const OpnInstMeta *ains = &Synth::m_emptyInstrument;
+    // Bank which the instrument was taken from
+    size_t insBank = bank;
 
     //Set bank bank
-    const Synth::Bank *bnk = NULL;
+    const OpnInstMeta *bnkIns = NULL;
     bool caughtMissingBank = false;
     if((bank & ~static_cast<uint16_t>(Synth::PercussionTag)) > 0)
     {
-        Synth::BankMap::iterator b = synth.m_insBanks.find(bank);
-        if(b != synth.m_insBanks.end())
-            bnk = &b->second;
+        bnkIns = findInstrument(bank, midiins);
 
-        if(bnk)
-            ains = &bnk->ins[midiins];
+        if(bnkIns)
+            ains = bnkIns;
         else
             caughtMissingBank = true;
     }
@@ -384,13 +641,16 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         size_t fallback = bank & ~(size_t)0x7F;
         if(fallback != bank)
         {
-            Synth::BankMap::iterator b = synth.m_insBanks.find(fallback);
+            const OpnInstMeta *fallbackIns = findInstrument(fallback, midiins);
             caughtMissingBank = false;
-            if(b != synth.m_insBanks.end())
-                bnk = &b->second;
+            if(fallbackIns)
+            {
+                bnkIns = fallbackIns;
+                insBank = fallback;
+            }
 
-            if(bnk)
-                ains = &bnk->ins[midiins];
+            if(bnkIns)
+                ains = bnkIns;
             else
                 caughtMissingBank = true;
         }
@@ -398,26 +658,30 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
 
     if(caughtMissingBank && hooks.onDebugMessage)
     {
-        std::set<size_t> &missing = (isPercussion) ?
-                                    caugh_missing_banks_percussion : caugh_missing_banks_melodic;
+        std::bitset<65536> &missing = (isPercussion) ?
+                                      caugh_missing_banks_percussion : caugh_missing_banks_melodic;
         const char *text = (isPercussion) ?
                            "percussion" : "melodic";
-        if(missing.insert(bank).second)
+        if(!missing.test(bank & 0xFFFF))
         {
+            missing.set(bank & 0xFFFF);
             hooks.onDebugMessage(hooks.onDebugMessage_userData,
                                  "[%i] Playing missing %s MIDI bank %i (patch %i)",
-                                 channel, text, (bank & ~static_cast<uint16_t>(Synth::PercussionTag)), midiins);
+                                 static_cast<int>(channel), text, (bank & ~static_cast<uint16_t>(Synth::PercussionTag)), midiins);
         }
     }
 
     //Or fall back to first bank
     if((ains->flags & OpnInstMeta::Flag_NoSound) != 0)
     {
-        Synth::BankMap::iterator b = synth.m_insBanks.find(bank & Synth::PercussionTag);
-        if(b != synth.m_insBanks.end())
-            bnk = &b->second;
-        if(bnk)
-            ains = &bnk->ins[midiins];
+        const OpnInstMeta *firstIns = findInstrument(bank & Synth::PercussionTag, midiins);
+        if(firstIns)
+        {
+            bnkIns = firstIns;
+            insBank = bank & Synth::PercussionTag;
+        }
+        if(bnkIns)
+            ains = bnkIns;
     }
 
     const int veloffset = ains->midiVelocityOffset;
@@ -430,10 +694,10 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         {
             if(hooks.onDebugMessage)
             {
-                if(!caugh_missing_instruments.count(static_cast<uint8_t>(midiins)))
+                if(!caugh_missing_instruments.test(static_cast<uint8_t>(midiins)))
                 {
-                    hooks.onDebugMessage(hooks.onDebugMessage_userData, "[%i] Caught a blank instrument %i (offset %i) in the MIDI bank %u", channel, midiChan.patch, midiins, bank);
-                    caugh_missing_instruments.insert(static_cast<uint8_t>(midiins));
+                    hooks.onDebugMessage(hooks.onDebugMessage_userData, "[%i] Caught a blank instrument %i (offset %i) in the MIDI bank %u", static_cast<int>(channel), midiChan.patch, midiins, bank);
+                    caugh_missing_instruments.set(static_cast<uint8_t>(midiins));
                 }
             }
             bank = 0;
@@ -449,21 +713,17 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
             tone = ains->drumTone;
     }
 
-    //bool pseudo_4op = ains.flags & opnInstMeta::Flag_Pseudo8op;
-    MIDIchannel::NoteInfo::Phys voices[MIDIchannel::NoteInfo::MaxNumPhysChans] =
-    {
-        {0, &ains->op[0], false},
-        {0, &ains->op[0] /*&ains->op[0]*/, false /*FIXME: When double-voice will be implemented, put here an instrument's flag!*/},
-    };
+    MIDIchannel::NoteInfo::Phys voices[MIDIchannel::NoteInfo::MaxNumPhysChans];
+    noteVoices(ains, voices);
 
     bool isBlankNote = (ains->flags & OpnInstMeta::Flag_NoSound) != 0;
 
     if(hooks.onDebugMessage)
     {
-        if(!caugh_missing_instruments.count(static_cast<uint8_t>(midiins)) && isBlankNote)
+        if(!caugh_missing_instruments.test(static_cast<uint8_t>(midiins)) && isBlankNote)
         {
-            hooks.onDebugMessage(hooks.onDebugMessage_userData, "[%i] Playing missing instrument %i", channel, midiins);
-            caugh_missing_instruments.insert(static_cast<uint8_t>(midiins));
+            hooks.onDebugMessage(hooks.onDebugMessage_userData, "[%i] Playing missing instrument %i", static_cast<int>(channel), midiins);
+            caugh_missing_instruments.set(static_cast<uint8_t>(midiins));
         }
     }
 
@@ -485,9 +745,37 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         return false;
     }
 
+    // The drum is played by the sample prerendered on the load, the note holds no chip channels.
+    // Drums unknown to the loaded songs are played by FM channels.
+    if(isPercussion && synth.dacDrumsActive()
+       && midiChan.activenotes.size() < midiChan.activenotes.capacity()
+       && synth.dacDrumOn(insBank, midiins, tone, velocity, channelVolume(channel), midiChan.expression, midiChan.panning))
+    {
+        MIDIchannel::notes_iterator i = midiChan.ensure_create_activenote(note);
+        MIDIchannel::NoteInfo &drum = i->value;
+        drum.isBlank = true;
+        drum.isOnExtendedLifeTime = false;
+        drum.ttl = 0;
+        drum.ains = NULL;
+        drum.chip_channels_count = 0;
+        midiChan.portamentoSource = static_cast<int8_t>(note);
+        return true;
+    }
+
     // Allocate OPN2 channel (the physical sound channel for the note)
     int32_t adlchannel[MIDIchannel::NoteInfo::MaxNumPhysChans] = { -1, -1 };
 
+    // Kind of the channel which may play this note, SSG notes may also use FM channels
+    char expectedCat = Synth::ChanCat_Regular;
+    if(synth.hasExtraChannels())
+        expectedCat = opnExtraChannelCategory(ains, isPercussion, note);
+
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    const int notePriority = channelPriority(channel);
+#endif
+    const bool useChipGroups = synth.chipGroupsCount() > 1;
+    const uint32_t noteGroup = channelChipGroup(channel);
+
     for(uint32_t ccount = 0; ccount < MIDIchannel::NoteInfo::MaxNumPhysChans; ++ccount)
     {
         int32_t c = -1;
@@ -505,22 +793,26 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         {
             if(ccount == 1 && static_cast<int32_t>(a) == adlchannel[0]) continue;
             // ^ Don't use the same channel for primary&secondary
-            // ===== Kept for future pseudo-8-op mode
-            //if(voices[0] == voices[1] || pseudo_4op)
-            //{
-            //    // Only use regular channels
-            //    uint8_t expected_mode = 0;
-            //    if(opn.AdlPercussionMode == 1)
-            //    {
-            //        if(cmf_percussion_mode)
-            //            expected_mode = MidCh < 11 ? 0 : (3 + MidCh - 11); // CMF
-            //        else
-            //            expected_mode = PercussionMap[midiins & 0xFF];
-            //    }
-            //    if(opn.four_op_category[a] != expected_mode)
-            //        continue;
-            //}
+            if(useChipGroups && synth.chipGroup(synth.channelChip(a)) != noteGroup)
+                continue; // Chip of another group
+            char cat = synth.m_channelCategory[a];
+            if(cat != expectedCat && !(expectedCat == Synth::ChanCat_SSG && cat == Synth::ChanCat_Regular))
+                continue;
             int64_t s = calculateChipChannelGoodness(a, voices[ccount]);
+            if(cat == Synth::ChanCat_SSG)
+                ++s; // Keep FM channels free for the rest of notes
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+            if(m_songSlotsUsed > 0 && !m_chipChannels[a].users.empty())
+            {
+                int chanPriority = INT32_MIN;
+                for(OpnChannel::users_iterator j = m_chipChannels[a].users.begin(); !j.is_end(); ++j)
+                    chanPriority = std::max(chanPriority, channelPriority(j->value.loc.MidCh));
+                if(chanPriority > notePriority)
+                    continue; // Reserved by the song of higher priority
+                if(chanPriority < notePriority)
+                    s += 2000000; // Steal notes of lower priority songs first
+            }
+#endif
             if(s > bs)
             {
                 bs = static_cast<int32_t>(s);    // Best candidate wins
@@ -533,12 +825,18 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
             if(hooks.onDebugMessage)
                 hooks.onDebugMessage(hooks.onDebugMessage_userData,
                                      "ignored unplaceable note [bank %i, inst %i, note %i, MIDI channel %i]",
-                                     bank, midiChan.patch, note, channel);
+                                     bank, midiChan.patch, note, static_cast<int>(channel));
+            ++m_voiceStats.drops;
             continue; // Could not play this note. Ignore it.
         }
 
+        const OpnChannel &chan = m_chipChannels[static_cast<size_t>(c)];
+        if(chan.users.empty() && chan.koff_time_until_neglible_us > 0)
+            ++m_voiceStats.releaseReuses[effectiveChannelAlloc()];
+
         prepareChipChannelForNewNote(static_cast<size_t>(c), voices[ccount]);
         adlchannel[ccount] = c;
+        ++m_voiceStats.placed;
     }
 
     if(adlchannel[0] < 0 && adlchannel[1] < 0)
@@ -551,19 +849,26 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
     //    hooks.onDebugMessage(hooks.onDebugMessage_userData, "i1=%d:%d, i2=%d:%d", i[0],adlchannel[0], i[1],adlchannel[1]);
 
     if(midiChan.softPedal) // Apply Soft Pedal level reducing
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        velocity = static_cast<uint8_t>((velocity * 4) / 5);
+#else
         velocity = static_cast<uint8_t>(std::floor(static_cast<float>(velocity) * 0.8f));
+#endif
 
     // Allocate active note for MIDI channel
     if(midiChan.activenotes.size() >= midiChan.activenotes.capacity())
+    {
+        ++m_voiceStats.drops;
         return false; // Overflow!
+    }
 
     MIDIchannel::notes_iterator ir = midiChan.ensure_create_activenote(note);
     MIDIchannel::NoteInfo &ni = ir->value;
     ni.vol     = velocity;
     ni.vibrato = midiChan.noteAftertouch[note];
     ni.noteTone = static_cast<int16_t>(tone);
-    ni.currentTone = tone;
-    ni.glideRate = HUGE_VAL;
+    ni.currentTone = OPN_NOTE_TONE(tone);
+    ni.glideRate = OPN_GLIDE_NONE;
     ni.midiins = midiins;
     ni.isPercussion = isPercussion;
     ni.isBlank = isBlankNote;
@@ -573,9 +878,9 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
     ni.chip_channels_count = 0;
 
     int8_t currentPortamentoSource = midiChan.portamentoSource;
-    double currentPortamentoRate = midiChan.portamentoRate;
+    OpnTone currentPortamentoRate = midiChan.portamentoRate;
     bool portamentoEnable =
-        midiChan.portamentoEnable && currentPortamentoRate != HUGE_VAL && !isPercussion;
+        midiChan.portamentoEnable && currentPortamentoRate != OPN_GLIDE_NONE && !isPercussion;
     // Record the last note on MIDI channel as source of portamento
     midiChan.portamentoSource = static_cast<int8_t>(note);
     // midiChan.portamentoSource = portamentoEnable ? (int8_t)note : (int8_t)-1;
@@ -583,7 +888,7 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
     // Enable gliding on portamento note
     if (portamentoEnable && currentPortamentoSource >= 0)
     {
-        ni.currentTone = currentPortamentoSource;
+        ni.currentTone = OPN_NOTE_TONE(currentPortamentoSource);
         ni.glideRate = currentPortamentoRate;
         ++midiChan.gliding_note_count;
     }
@@ -591,7 +896,7 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
     // Enable life time extension on percussion note
     if (isPercussion)
     {
-        ni.ttl = drum_note_min_time;
+        ni.ttl = m_drumNoteMinTime;
         ++midiChan.extended_note_count;
     }
 
@@ -611,23 +916,223 @@ bool OPNMIDIplay::realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocit
         int32_t c = adlchannel[ccount];
         if(c < 0)
             continue;
-        m_chipChannels[c].recent_ins = voices[ccount];
-        m_chipChannels[c].addAge(0);
+        OpnChannel &chan = m_chipChannels[c];
+        chan.recent_ins = voices[ccount];
+        chan.recent_loc.MidCh = static_cast<uint16_t>(channel);
+        chan.recent_loc.note = note;
+        chan.recent_midiins = static_cast<uint8_t>(midiins & 0x7F);
+        chan.recent_percussion = isPercussion;
+        chan.addAge(0);
     }
 
+    updateVoicePeaks();
+
     return true;
 }
 
-void OPNMIDIplay::realTime_NoteOff(uint8_t channel, uint8_t note)
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+const OpnInstMeta *OPNMIDIplay::findSpanInstrument(uint8_t channel, uint8_t note, uint8_t patch,
+                                                   uint8_t bankMsb, uint8_t bankLsb, bool &isPercussion,
+                                                   size_t &insBank) const
+{
+    size_t bank, ins;
+
+    isPercussion = (channel == 9) || isXgPercChannel(bankMsb, bankLsb);
+
+    // Same bank mapping as noteOn() does, without GS and XG specifics set by SysEx
+    if(isPercussion)
+    {
+        bank = patch + Synth::PercussionTag;
+        ins = note;
+    }
+    else
+    {
+        bank = (bankMsb * 256) + bankLsb;
+        ins = patch;
+    }
+
+    insBank = bank;
+    const OpnInstMeta *ains = findLoadedInstrument(bank, ins);
+    if(!ains || (ains->flags & OpnInstMeta::Flag_NoSound) != 0)
+    {
+        insBank = bank & Synth::PercussionTag;
+        ains = findLoadedInstrument(insBank, ins);
+    }
+    if(!ains || (ains->flags & OpnInstMeta::Flag_NoSound) != 0)
+        return NULL;
+
+    return ains;
+}
+
+void OPNMIDIplay::prerenderDacDrums(const MidiSequencer &seq)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    Synth &synth = *m_synth;
+    std::vector<MidiSequencer::NoteSpan> spans;
+    seq.getNoteSpans(spans);
+
+    for(size_t i = 0; i < spans.size(); ++i)
+    {
+        const MidiSequencer::NoteSpan &n = spans[i];
+        bool isPercussion;
+        size_t insBank;
+        const OpnInstMeta *ains = findSpanInstrument(n.channel, n.note, n.patch, n.bankMsb, n.bankLsb, isPercussion, insBank);
+        if(!ains || !isPercussion)
+            continue;
+
+        int32_t tone = n.note;
+        if(ains->drumTone)
+            tone = (ains->drumTone >= 128) ? (ains->drumTone - 128) : ains->drumTone;
+
+        synth.prerenderDacDrum(insBank, n.note, ains, tone, n.velocity);
+    }
+}
+
+void OPNMIDIplay::prerenderDacDrums()
+{
+    if(!m_synth->dacDrumsActive())
+        return;
+
+    prerenderDacDrums(*m_sequencer);
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        if(m_songSlots[i].sequencer.get())
+            prerenderDacDrums(*m_songSlots[i].sequencer);
+    }
+}
+
+unsigned int OPNMIDIplay::estimateNumChips(unsigned int maxChips)
+{
+    Synth &synth = *m_synth;
+    std::vector<MidiSequencer::NoteSpan> spans;
+    m_sequencer->getNoteSpans(spans);
+
+    int chipType = (m_setup.chipType < 0) ? synth.m_insBankSetup.chipType : m_setup.chipType;
+    bool extras = m_setup.extraChannels && (chipType == OPNChip_OPNA);
+
+    // Kinds of notes by channels they may take, see noteOn(): FM-only notes,
+    // notes playable by SSG or FM channels, and each of rhythm voices
+    enum
+    {
+        KindFM = 0,
+        KindSSG,
+        KindRhythm,
+        KindCount = KindRhythm + (Synth::ChanCat_Rhythm_Rim - Synth::ChanCat_Rhythm_Bass) + 1
+    };
+
+    // Start and end points of every chip channel taken by notes, the kind is stored
+    // as (kind + 1), negative for the end. Ends go first on the same time, so
+    // a released channel gets re-used.
+    std::vector<std::pair<double, int> > points;
+    points.reserve(spans.size() * 2);
+
+    for(size_t i = 0; i < spans.size(); ++i)
+    {
+        const MidiSequencer::NoteSpan &n = spans[i];
+        bool isPercussion;
+        size_t insBank;
+        const OpnInstMeta *ains = findSpanInstrument(n.channel, n.note, n.patch, n.bankMsb, n.bankLsb, isPercussion, insBank);
+        if(!ains)
+            continue; // Blank notes don't use chip channels
+
+        int kind = KindFM;
+        if(extras)
+        {
+            char cat = opnExtraChannelCategory(ains, isPercussion, n.note);
+            if(cat >= Synth::ChanCat_Rhythm_Bass)
+                kind = KindRhythm + (cat - Synth::ChanCat_Rhythm_Bass);
+            else if(cat == Synth::ChanCat_SSG)
+                kind = KindSSG;
+        }
+
+        double begin = n.begin;
+        double end = n.end;
+        if(isPercussion && end < begin + drum_note_min_time)
+            end = begin + drum_note_min_time;
+
+        // The release tail only sounds if the note didn't fade out while being held
+        double keyOn = ains->soundKeyOnMs / 1000.0;
+        if(ains->soundKeyOnMs == 0 || begin + keyOn >= end)
+            end += ains->soundKeyOffMs / 1000.0;
+
+        MIDIchannel::NoteInfo::Phys voices[MIDIchannel::NoteInfo::MaxNumPhysChans];
+        size_t count = noteVoices(ains, voices);
+        for(size_t v = 0; v < count; ++v)
+        {
+            points.push_back(std::make_pair(begin, +(kind + 1)));
+            points.push_back(std::make_pair(end, -(kind + 1)));
+        }
+    }
+
+    std::sort(points.begin(), points.end());
+
+    // FM-only notes, notes on FM and SSG channels, and every rhythm voice are counted separately
+    size_t voices = 0, peak = 0;
+    size_t voicesMixed = 0, peakMixed = 0;
+    size_t voicesRhythm[KindCount] = {0}, peakRhythm[KindCount] = {0};
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        int kind = points[i].second;
+        bool start = kind > 0;
+        kind = (start ? kind : -kind) - 1;
+
+        if(kind >= KindRhythm)
+        {
+            if(start && ++voicesRhythm[kind] > peakRhythm[kind])
+                peakRhythm[kind] = voicesRhythm[kind];
+            else if(!start)
+                --voicesRhythm[kind];
+            continue;
+        }
+
+        if(start)
+        {
+            if(kind == KindFM && ++voices > peak)
+                peak = voices;
+            if(++voicesMixed > peakMixed)
+                peakMixed = voicesMixed;
+        }
+        else
+        {
+            if(kind == KindFM)
+                --voices;
+            --voicesMixed;
+        }
+    }
+
+    size_t chips = (peak + Synth::FmChannelsPerChip - 1) / Synth::FmChannelsPerChip;
+    if(extras)
+    {
+        const size_t mixedPerChip = Synth::FmChannelsPerChip + Synth::SsgChannelsPerChip;
+        size_t chipsMixed = (peakMixed + mixedPerChip - 1) / mixedPerChip;
+        if(chipsMixed > chips)
+            chips = chipsMixed;
+
+        // Every chip has one channel of each rhythm voice
+        for(int k = KindRhythm; k < KindCount; ++k)
+        {
+            if(peakRhythm[k] > chips)
+                chips = peakRhythm[k];
+        }
+    }
+    if(chips < 1)
+        chips = 1;
+    if(chips > maxChips)
+        chips = maxChips;
+
+    return static_cast<unsigned int>(chips);
+}
+#endif
+
+void OPNMIDIplay::realTime_NoteOff(size_t channel, uint8_t note)
+{
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     noteOff(channel, note);
 }
 
-void OPNMIDIplay::realTime_NoteAfterTouch(uint8_t channel, uint8_t note, uint8_t atVal)
+void OPNMIDIplay::realTime_NoteAfterTouch(size_t channel, uint8_t note, uint8_t atVal)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     MIDIchannel &chan = m_midiChannels[channel];
     MIDIchannel::notes_iterator i = m_midiChannels[channel].find_activenote(note);
@@ -647,16 +1152,16 @@ void OPNMIDIplay::realTime_NoteAfterTouch(uint8_t channel, uint8_t note, uint8_t
     }
 }
 
-void OPNMIDIplay::realTime_ChannelAfterTouch(uint8_t channel, uint8_t atVal)
+void OPNMIDIplay::realTime_ChannelAfterTouch(size_t channel, uint8_t atVal)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].aftertouch = atVal;
 }
 
-void OPNMIDIplay::realTime_Controller(uint8_t channel, uint8_t type, uint8_t value)
+void OPNMIDIplay::realTime_Controller(size_t channel, uint8_t type, uint8_t value)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     switch(type)
     {
@@ -800,46 +1305,46 @@ void OPNMIDIplay::realTime_Controller(uint8_t channel, uint8_t type, uint8_t val
     }
 }
 
-void OPNMIDIplay::realTime_PatchChange(uint8_t channel, uint8_t patch)
+void OPNMIDIplay::realTime_PatchChange(size_t channel, uint8_t patch)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].patch = patch;
 }
 
-void OPNMIDIplay::realTime_PitchBend(uint8_t channel, uint16_t pitch)
+void OPNMIDIplay::realTime_PitchBend(size_t channel, uint16_t pitch)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].bend = int(pitch) - 8192;
     noteUpdateAll(channel, Upd_Pitch);
 }
 
-void OPNMIDIplay::realTime_PitchBend(uint8_t channel, uint8_t msb, uint8_t lsb)
+void OPNMIDIplay::realTime_PitchBend(size_t channel, uint8_t msb, uint8_t lsb)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].bend = int(lsb) + int(msb) * 128 - 8192;
     noteUpdateAll(channel, Upd_Pitch);
 }
 
-void OPNMIDIplay::realTime_BankChangeLSB(uint8_t channel, uint8_t lsb)
+void OPNMIDIplay::realTime_BankChangeLSB(size_t channel, uint8_t lsb)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].bank_lsb = lsb;
 }
 
-void OPNMIDIplay::realTime_BankChangeMSB(uint8_t channel, uint8_t msb)
+void OPNMIDIplay::realTime_BankChangeMSB(size_t channel, uint8_t msb)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].bank_msb = msb;
 }
 
-void OPNMIDIplay::realTime_BankChange(uint8_t channel, uint16_t bank)
+void OPNMIDIplay::realTime_BankChange(size_t channel, uint16_t bank)
 {
-    if(static_cast<size_t>(channel) > m_midiChannels.size())
+    if(channel >= m_midiChannels.size())
         channel = channel % 16;
     m_midiChannels[channel].bank_lsb = uint8_t(bank & 0xFF);
     m_midiChannels[channel].bank_msb = uint8_t((bank >> 8) & 0xFF);
@@ -1107,6 +1612,20 @@ void OPNMIDIplay::AudioTick(uint32_t chipId, uint32_t rate)
 }
 #endif
 
+size_t OPNMIDIplay::noteVoices(const OpnInstMeta *ains, MIDIchannel::NoteInfo::Phys voices[MIDIchannel::NoteInfo::MaxNumPhysChans])
+{
+    //bool pseudo_4op = ains.flags & opnInstMeta::Flag_Pseudo8op;
+    const MIDIchannel::NoteInfo::Phys v[MIDIchannel::NoteInfo::MaxNumPhysChans] =
+    {
+        {0, &ains->op[0], false},
+        {0, &ains->op[0] /*&ains->op[0]*/, false /*FIXME: When double-voice will be implemented, put here an instrument's flag!*/},
+    };
+
+    voices[0] = v[0];
+    voices[1] = v[1];
+    return (voices[0] == voices[1]) ? 1 : 2;
+}
+
 void OPNMIDIplay::noteUpdPatch(const OpnChannel::Location &loc, const MIDIchannel::NoteInfo::Phys &ins, const OpnInstMeta *ains)
 {
     m_synth->setPatch(ins.chip_chan, ins.ains);
@@ -1119,6 +1638,7 @@ void OPNMIDIplay::noteUpdPatch(const OpnChannel::Location &loc, const MIDIchanne
         d.vibdelay_us  = 0;
         d.fixed_sustain = (ains->soundKeyOnMs == static_cast<uint16_t>(opnNoteOnMaxTime));
         d.kon_time_until_neglible_us = 1000 * ains->soundKeyOnMs;
+        d.kon_time_until_end_us = m_noteDurationUs;
         d.ins       = ins;
     }
 }
@@ -1182,7 +1702,7 @@ void OPNMIDIplay::noteUpdVolume(size_t midCh, MIDIchannel::NoteInfo &info, const
             brightness *= 2;
     }
 
-    m_synth->touchNote(ins.chip_chan, info.vol, ch.volume, ch.expression, static_cast<uint8_t>(brightness), is_percussion);
+    m_synth->touchNote(ins.chip_chan, info.vol, channelVolume(midCh), ch.expression, static_cast<uint8_t>(brightness), is_percussion);
 }
 
 void OPNMIDIplay::noteUpdFreq(size_t midCh, const OpnChannel::Location &loc, MIDIchannel::NoteInfo &info, const MIDIchannel::NoteInfo::Phys &ins)
@@ -1193,23 +1713,42 @@ void OPNMIDIplay::noteUpdFreq(size_t midCh, const OpnChannel::Location &loc, MID
     if(d.is_end() || (d->value.sustained == OpnChannel::LocationData::Sustain_None))
     {
         MIDIchannel &chan = m_midiChannels[midCh];
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        OpnTone midibend = static_cast<OpnTone>((static_cast<int64_t>(chan.bend) * chan.bendsense) / 1024);
+        OpnTone bend = midibend + OPN_NOTE_TONE(ins.ains->noteOffset);
+        OpnTone phase = 0;
+#else
         double midibend = chan.bend * chan.bendsense;
         double bend = midibend + ins.ains->noteOffset;
         double phase = 0.0;
+#endif
         uint8_t vibrato = std::max(chan.vibrato, chan.aftertouch);
 
         vibrato = std::max(vibrato, info.vibrato);
 
         if((info.ains->flags & OpnInstMeta::Flag_Pseudo8op) && ins.dbl_voice)
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            phase = static_cast<OpnTone>(info.ains->voice2_fine_tune * OPN_TONE_FX_ONE);
+#else
             phase = info.ains->voice2_fine_tune;
+#endif
 
         if(vibrato && (d.is_end() || d->value.vibdelay_us >= chan.vibdelay_us))
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            bend += static_cast<OpnTone>((static_cast<int64_t>(vibrato) * chan.vibdepth * vibratoSine(chan.vibpos)) / (1 << 23));
+#else
             bend += static_cast<double>(vibrato) * chan.vibdepth * std::sin(chan.vibpos);
+#endif
 
         m_synth->noteOn(ins.chip_chan, info.currentTone + bend + phase);
 
         if(hooks.onNote)
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            hooks.onNote(hooks.onNote_userData, ins.chip_chan, info.noteTone, static_cast<int>(info.midiins), info.vol,
+                         static_cast<double>(midibend) / OPN_TONE_FX_ONE);
+#else
             hooks.onNote(hooks.onNote_userData, ins.chip_chan, info.noteTone, static_cast<int>(info.midiins), info.vol, midibend);
+#endif
     }
 }
 
@@ -1296,19 +1835,12 @@ void OPNMIDIplay::setErrorString(const std::string &err)
 
 int64_t OPNMIDIplay::calculateChipChannelGoodness(size_t c, const MIDIchannel::NoteInfo::Phys &ins) const
 {
-    Synth &synth = *m_synth;
     const OpnChannel &chan = m_chipChannels[c];
     int64_t koff_ms = chan.koff_time_until_neglible_us / 1000;
     int64_t s = -koff_ms;
-    OPNMIDI_ChannelAlloc allocType = synth.m_channelAlloc;
-
-    if(allocType == OPNMIDI_ChanAlloc_AUTO)
-    {
-        if(synth.m_musicMode == Synth::MODE_CMF)
-            allocType = OPNMIDI_ChanAlloc_SameInst;
-        else
-            allocType = OPNMIDI_ChanAlloc_OffDelay;
-    }
+    OPNMIDI_ChannelAlloc allocType = effectiveChannelAlloc();
+    // Notes to be released within this time are cheap to steal in the look-ahead mode
+    const int64_t lookAheadStealMs = 200;
 
     // Rate channel with a releasing note
     if(s < 0 && chan.users.empty())
@@ -1342,8 +1874,18 @@ int64_t OPNMIDIplay::calculateChipChannelGoodness(size_t c, const MIDIchannel::N
         const OpnChannel::LocationData &jd = j->value;
 
         int64_t kon_ms = jd.kon_time_until_neglible_us / 1000;
-        s -= (jd.sustained == OpnChannel::LocationData::Sustain_None) ?
-            (4000000 + kon_ms) : (500000 + (kon_ms / 2));
+        if(allocType == OPNMIDI_ChanAlloc_LookAhead && jd.kon_time_until_end_us >= 0
+           && jd.kon_time_until_end_us < 1000 * lookAheadStealMs)
+        {
+            // The note will be released soon anyway, stealing it is less audible.
+            // Notes ending later are rated as usual: stealing the ones ending
+            // soonest would keep the long notes and cause more steals after.
+            int64_t end_ms = jd.kon_time_until_end_us / 1000;
+            s -= 100000 + end_ms * 1000;
+        }
+        else
+            s -= (jd.sustained == OpnChannel::LocationData::Sustain_None) ?
+                (4000000 + kon_ms) : (500000 + (kon_ms / 2));
 
         MIDIchannel::notes_iterator
         k = const_cast<MIDIchannel &>(m_midiChannels[jd.loc.MidCh]).find_activenote(jd.loc.note);
@@ -1394,6 +1936,41 @@ int64_t OPNMIDIplay::calculateChipChannelGoodness(size_t c, const MIDIchannel::N
     return s;
 }
 
+OPNMIDI_ChannelAlloc OPNMIDIplay::effectiveChannelAlloc() const
+{
+    const Synth &synth = *m_synth;
+    OPNMIDI_ChannelAlloc allocType = synth.m_channelAlloc;
+
+    if(allocType == OPNMIDI_ChanAlloc_AUTO)
+    {
+        if(synth.m_musicMode == Synth::MODE_CMF)
+            allocType = OPNMIDI_ChanAlloc_SameInst;
+        else
+            allocType = OPNMIDI_ChanAlloc_OffDelay;
+    }
+
+    return allocType;
+}
+
+void OPNMIDIplay::updateVoicePeaks()
+{
+    size_t channels = 0, voices = 0;
+
+    for(size_t c = 0; c < m_chipChannels.size(); ++c)
+    {
+        size_t users = m_chipChannels[c].users.size();
+        if(users > 0)
+        {
+            ++channels;
+            voices += users;
+        }
+    }
+
+    if(channels > m_voiceStats.peakChannels)
+        m_voiceStats.peakChannels = channels;
+    if(voices > m_voiceStats.peakVoices)
+        m_voiceStats.peakVoices = voices;
+}
 
 void OPNMIDIplay::prepareChipChannelForNewNote(size_t c, const MIDIchannel::NoteInfo::Phys &ins)
 {
@@ -1412,6 +1989,7 @@ void OPNMIDIplay::prepareChipChannelForNewNote(size_t c, const MIDIchannel::Note
 
             m_midiChannels[jd.loc.MidCh].clear_all_phys_users(c);
             m_chipChannels[c].users.erase(j);
+            ++m_voiceStats.steals;
         }
 
         synth.noteOff(c);
@@ -1450,6 +2028,11 @@ void OPNMIDIplay::prepareChipChannelForNewNote(size_t c, const MIDIchannel::Note
     // Kill all sustained notes on this channel
     // Don't keep them for arpeggio, because arpeggio requires
     // an intact "activenotes" record. This is a design flaw.
+    for(OpnChannel::users_iterator j = m_chipChannels[c].users.begin(); !j.is_end(); ++j)
+    {
+        if(j->value.sustained != OpnChannel::LocationData::Sustain_None)
+            ++m_voiceStats.steals;
+    }
     killSustainingNotes(-1, static_cast<int32_t>(c), OpnChannel::LocationData::Sustain_ANY);
 
     // Keyoff the channel so that it can be retriggered,
@@ -1463,7 +2046,7 @@ void OPNMIDIplay::killOrEvacuate(size_t from_channel,
                                  OPNMIDIplay::MIDIchannel::notes_iterator i)
 {
     Synth &synth = *m_synth;
-    uint32_t maxChannels = OPN_MAX_CHIPS * 6;
+    uint32_t maxChannels = OPN_MAX_CHIPS * (Synth::FmChannelsPerChip + Synth::ExtraChannelsPerChip);
     OpnChannel::LocationData &jd = j->value;
     MIDIchannel::NoteInfo &info = i->value;
 
@@ -1480,8 +2063,10 @@ void OPNMIDIplay::killOrEvacuate(size_t from_channel,
             break;
         if(c == from_channel)
             continue;
-        //if(opn.four_op_category[c] != opn.four_op_category[from_channel])
-        //    continue;
+        if(synth.m_channelCategory[c] != synth.m_channelCategory[from_channel])
+            continue;
+        if(synth.chipGroup(synth.channelChip(c)) != synth.chipGroup(synth.channelChip(from_channel)))
+            continue; // Notes never leave their chip group
 
         OpnChannel &adlch = m_chipChannels[c];
         if(adlch.users.size() == adlch.users.capacity())
@@ -1514,8 +2099,13 @@ void OPNMIDIplay::killOrEvacuate(size_t from_channel,
 
             info.phys_erase(static_cast<uint16_t>(from_channel));
             info.phys_ensure_find_or_create(cs)->assign(jd.ins);
-            m_chipChannels[cs].users.push_back(jd);
+            adlch.recent_ins = jd.ins;
+            adlch.recent_loc = jd.loc;
+            adlch.recent_midiins = static_cast<uint8_t>(info.midiins & 0x7F);
+            adlch.recent_percussion = info.isPercussion;
+            adlch.users.push_back(jd);
             m_chipChannels[from_channel].users.erase(j);
+            ++m_voiceStats.evacuations;
             return;
         }
     }
@@ -1528,6 +2118,7 @@ void OPNMIDIplay::killOrEvacuate(size_t from_channel,
                 ins
                 );*/
     // Kill it
+    ++m_voiceStats.steals;
     noteUpdate(jd.loc.MidCh,
                i,
                Upd_Off,
@@ -1536,7 +2127,7 @@ void OPNMIDIplay::killOrEvacuate(size_t from_channel,
 
 void OPNMIDIplay::panic()
 {
-    for(uint8_t chan = 0; chan < m_midiChannels.size(); chan++)
+    for(size_t chan = 0; chan < m_midiChannels.size(); chan++)
     {
         for(uint8_t note = 0; note < 128; note++)
             realTime_NoteOff(chan, note);
@@ -1621,16 +2212,26 @@ void OPNMIDIplay::setRPN(size_t midCh, unsigned value, bool MSB)
     case 0x0108 + 1*0x10000 + 1*0x20000: // Vibrato speed
         if((m_synthMode & Mode_XG) != 0) // Vibrato speed
         {
-            if(value == 64)      m_midiChannels[midCh].vibspeed = 1.0;
-            else if(value < 100) m_midiChannels[midCh].vibspeed = 1.0 / (1.6e-2 * (value ? value : 1));
-            else                 m_midiChannels[midCh].vibspeed = 1.0 / (0.051153846 * value - 3.4965385);
-            m_midiChannels[midCh].vibspeed *= 2 * 3.141592653 * 5.0;
+            double speed;
+            if(value == 64)      speed = 1.0;
+            else if(value < 100) speed = 1.0 / (1.6e-2 * (value ? value : 1));
+            else                 speed = 1.0 / (0.051153846 * value - 3.4965385);
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            m_midiChannels[midCh].vibspeed = static_cast<int32_t>(speed * 5.0 * 65536.0);
+#else
+            m_midiChannels[midCh].vibspeed = speed * (2 * 3.141592653 * 5.0);
+#endif
         }
         break;
     case 0x0109 + 1*0x10000 + 1*0x20000:
         if((m_synthMode & Mode_XG) != 0) // Vibrato depth
         {
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            // 0.0015 semi-tones per step, in 1/256 of tone unit
+            m_midiChannels[midCh].vibdepth = ((static_cast<int>(value) - 64) * 98304) / 10;
+#else
             m_midiChannels[midCh].vibdepth = ((static_cast<int>(value) - 64) * 0.15) * 0.01;
+#endif
         }
         break;
     case 0x010A + 1*0x10000 + 1*0x20000:
@@ -1651,7 +2252,11 @@ void OPNMIDIplay::updatePortamento(size_t midCh)
     uint16_t midival = m_midiChannels[midCh].portamento;
     if(m_midiChannels[midCh].portamentoEnable && midival > 0)
         rate = 350.0 * std::pow(2.0, -0.062 * (1.0 / 128) * midival);
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    m_midiChannels[midCh].portamentoRate = (rate == HUGE_VAL) ? OPN_GLIDE_NONE : static_cast<OpnTone>(rate * OPN_TONE_FX_ONE);
+#else
     m_midiChannels[midCh].portamentoRate = rate;
+#endif
 }
 
 void OPNMIDIplay::noteOff(size_t midCh, uint8_t note, bool forceNow)
@@ -1670,17 +2275,23 @@ void OPNMIDIplay::noteOff(size_t midCh, uint8_t note, bool forceNow)
 }
 
 
-void OPNMIDIplay::updateVibrato(double amount)
+void OPNMIDIplay::updateVibrato(OpnTickTime amount)
 {
     for(size_t a = 0, b = m_midiChannels.size(); a < b; ++a)
     {
         if(m_midiChannels[a].hasVibrato() && !m_midiChannels[a].activenotes.empty())
         {
             noteUpdateAll(static_cast<uint16_t>(a), Upd_Pitch);
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            // 16.16 frames by 16.16 periods per second gives the phase in 2^32 units per period
+            m_midiChannels[a].vibpos += static_cast<uint32_t>((amount * m_midiChannels[a].vibspeed) /
+                                                              static_cast<int64_t>(m_setup.PCM_RATE));
+#else
             m_midiChannels[a].vibpos += amount * m_midiChannels[a].vibspeed;
+#endif
         }
         else
-            m_midiChannels[a].vibpos = 0.0;
+            m_midiChannels[a].vibpos = 0;
     }
 }
 
@@ -1690,8 +2301,17 @@ size_t OPNMIDIplay::chooseDevice(const char *name, size_t len)
     size_t cmpSize = len < 100 ? len : 100;
     bool found = false;
 
+    size_t freeBlock = m_midiDevicesSize;
+
     for( ; i < m_midiDevicesSize && i < m_midiDevicesUsed; ++i)
     {
+        if(m_midiDevices[i].free)
+        {
+            if(freeBlock == m_midiDevicesSize)
+                freeBlock = i;
+            continue;
+        }
+
         if(std::memcmp(m_midiDevices[i].name, name, cmpSize) == 0)
         {
             found = true;
@@ -1702,22 +2322,219 @@ size_t OPNMIDIplay::chooseDevice(const char *name, size_t len)
     if(found)
         return m_midiDevices[i].track;
 
+    if(freeBlock < m_midiDevicesSize)
+    {
+        // Take the block left by the previous song, its channels are reset already
+        MidiDeviceEntry &e = m_midiDevices[freeBlock];
+        std::memset(e.name, 0, sizeof(e.name));
+        std::memcpy(e.name, name, cmpSize);
+        e.free = false;
+        return e.track;
+    }
+
     if(i >= m_midiDevicesSize)
         return 0; // Overflow, just fall back to zero
 
     size_t j = m_midiDevicesUsed++;
     size_t n = j * 16;
 
+    std::memset(m_midiDevices[j].name, 0, sizeof(m_midiDevices[j].name));
     std::memcpy(m_midiDevices[j].name, name, cmpSize);
     m_midiDevices[j].track = n;
+    m_midiDevices[j].free = false;
 
-    m_midiChannels.resize(n + 16);
+    // Channels of reserved devices are already here
+    if(m_midiChannels.size() < n + 16)
+    {
+        m_midiChannels.resize(n + 16);
+        resetMIDIDefaults(static_cast<int>(n));
+    }
 
-    resetMIDIDefaults(static_cast<int>(n));
     return n;
 }
 
-void OPNMIDIplay::updateArpeggio(double) // amount = amount of time passed
+void OPNMIDIplay::reserveMidiDevices(size_t count)
+{
+    if(count > m_midiDevicesSize)
+        count = m_midiDevicesSize;
+
+    size_t n = m_midiChannels.size();
+    if(n >= count * 16)
+        return;
+
+    m_midiChannels.resize(count * 16);
+    resetMIDIDefaults(static_cast<int>(n));
+}
+
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+size_t OPNMIDIplay::chooseSlotDevice(size_t slot)
+{
+    char name[] = "\x01OPNMIDI song slot #0";
+
+    // Keep the first block for the main song tracks without a device name
+    if(m_midiDevicesUsed == 0)
+        m_midiDevicesUsed = 1;
+
+    name[sizeof(name) - 2] = static_cast<char>('0' + slot);
+
+    return chooseDevice(name, sizeof(name) - 1);
+}
+
+const OPNMIDIplay::SongSlot *OPNMIDIplay::findChannelSlot(size_t midCh) const
+{
+    if(m_songSlotsUsed == 0)
+        return NULL;
+
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        const SongSlot &slot = m_songSlots[i];
+        if(slot.sequencer.get() && midCh >= slot.channelBase && midCh < slot.channelBase + 16)
+            return &slot;
+    }
+
+    return NULL;
+}
+
+void OPNMIDIplay::closeSlot(size_t slot)
+{
+    SongSlot &s = m_songSlots[slot];
+    if(!s.sequencer.get())
+        return;
+
+    releaseSlotNotes(slot);
+    s.sequencer.reset();
+    s.rtInterface.reset();
+    --m_songSlotsUsed;
+}
+
+void OPNMIDIplay::releaseSlotNotes(size_t slot)
+{
+    const SongSlot &s = m_songSlots[slot];
+    if(!s.sequencer.get())
+        return;
+
+    for(size_t ch = s.channelBase; ch < s.channelBase + 16 && ch < m_midiChannels.size(); ++ch)
+    {
+        for(uint8_t note = 0; note < 128; note++)
+            realTime_NoteOff(ch, note);
+        killSustainingNotes(static_cast<int32_t>(ch), -1, OpnChannel::LocationData::Sustain_ANY);
+    }
+}
+
+void OPNMIDIplay::releaseSlotNotes()
+{
+    if(m_songSlotsUsed == 0)
+        return;
+
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+        releaseSlotNotes(i);
+}
+
+void OPNMIDIplay::resetMainSongDevices()
+{
+    for(size_t ch = 0; ch < m_midiChannels.size(); ++ch)
+    {
+        if(findChannelSlot(ch))
+            continue;
+        for(uint8_t note = 0; note < 128; note++)
+            realTime_NoteOff(ch, note);
+        killSustainingNotes(static_cast<int32_t>(ch), -1, OpnChannel::LocationData::Sustain_ANY);
+        m_midiChannels[ch] = MIDIchannel();
+    }
+    resetMIDIDefaults();
+
+    // Blocks of the main song are left for devices of the next song
+    for(size_t i = 1; i < m_midiDevicesUsed; ++i)
+    {
+        MidiDeviceEntry &e = m_midiDevices[i];
+        if(findChannelSlot(e.track))
+            continue;
+        std::memset(e.name, 0, sizeof(e.name));
+        e.free = true;
+    }
+}
+
+void OPNMIDIplay::setSlotVolume(size_t slot, uint8_t volume)
+{
+    SongSlot &s = m_songSlots[slot];
+    s.volume = volume;
+    if(!s.sequencer.get())
+        return;
+    for(size_t ch = s.channelBase; ch < s.channelBase + 16 && ch < m_midiChannels.size(); ++ch)
+        noteUpdateAll(ch, Upd_Volume);
+}
+
+void OPNMIDIplay::resetSlotState(size_t slot)
+{
+    const SongSlot &s = m_songSlots[slot];
+
+    for(size_t ch = s.channelBase; ch < s.channelBase + 16 && ch < m_midiChannels.size(); ++ch)
+        resetChannelState(ch);
+}
+
+void OPNMIDIplay::resetMainSongState()
+{
+    if(m_songSlotsUsed == 0)
+    {
+        realTime_ResetState();
+        return;
+    }
+
+    Synth &synth = *m_synth;
+    for(size_t ch = 0; ch < m_midiChannels.size(); ch++)
+    {
+        if(!findChannelSlot(ch))
+            resetChannelState(ch);
+    }
+    synth.m_masterVolume = MasterVolumeDefault;
+}
+
+bool OPNMIDIplay::songsAtEnd() const
+{
+    if(!m_sequencer->positionAtEnd())
+        return false;
+
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        const SongSlot &slot = m_songSlots[i];
+        if(slot.sequencer.get() && !slot.paused && !slot.sequencer->positionAtEnd())
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+int OPNMIDIplay::channelPriority(size_t midCh) const
+{
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    const SongSlot *slot = findChannelSlot(midCh);
+    if(slot)
+        return slot->priority;
+#else
+    ADL_UNUSED(midCh);
+#endif
+    return 0;
+}
+
+uint8_t OPNMIDIplay::channelVolume(size_t midCh) const
+{
+    uint8_t volume = m_midiChannels[midCh].volume;
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    const SongSlot *slot = findChannelSlot(midCh);
+    if(slot)
+        volume = static_cast<uint8_t>((volume * slot->volume) / 127);
+#endif
+    return volume;
+}
+
+uint32_t OPNMIDIplay::channelChipGroup(size_t midCh) const
+{
+    const Synth &synth = *m_synth;
+    return static_cast<uint32_t>((midCh / 16) % synth.chipGroupsCount());
+}
+
+void OPNMIDIplay::updateArpeggio(OpnTickTime) // amount = amount of time passed
 {
     // If there is an adlib channel that has multiple notes
     // simulated on the same channel, arpeggio them.
@@ -1799,7 +2616,7 @@ retry_arpeggio:
     }
 }
 
-void OPNMIDIplay::updateGlide(double amount)
+void OPNMIDIplay::updateGlide(OpnTickTime amount)
 {
     size_t num_channels = m_midiChannels.size();
 
@@ -1813,17 +2630,29 @@ void OPNMIDIplay::updateGlide(double amount)
             !it.is_end(); ++it)
         {
             MIDIchannel::NoteInfo &info = it->value;
-            double finalTone = info.noteTone;
-            double previousTone = info.currentTone;
+            OpnTone finalTone = OPN_NOTE_TONE(info.noteTone);
+            OpnTone previousTone = info.currentTone;
 
             bool directionUp = previousTone < finalTone;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            // Round up to never stall on the short ticks
+            const int64_t frameRate = static_cast<int64_t>(m_setup.PCM_RATE) << OPN_TICK_TIME_SHIFT;
+            OpnTone toneIncr = static_cast<OpnTone>((amount * info.glideRate + frameRate - 1) / frameRate);
+            if(!directionUp)
+                toneIncr = -toneIncr;
+#else
             double toneIncr = amount * (directionUp ? +info.glideRate : -info.glideRate);
+#endif
 
-            double currentTone = previousTone + toneIncr;
+            OpnTone currentTone = previousTone + toneIncr;
             bool glideFinished = !(directionUp ? (currentTone < finalTone) : (currentTone > finalTone));
             currentTone = glideFinished ? finalTone : currentTone;
 
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            if(currentTone != previousTone)
+#else
             if(int64_t(currentTone * 1000000.0) != int64_t(previousTone * 1000000.0))
+#endif
             {
                 info.currentTone = currentTone;
                 noteUpdate(static_cast<uint16_t>(channel), it, Upd_Pitch);
@@ -1874,6 +2703,72 @@ void OPNMIDIplay::describeChannels(char *str, char *attr, size_t size)
     attr[index] = 0;
 }
 
+void OPNMIDIplay::getChannelsSnapshot(OPN2_ChannelsSnapshot &snapshot)
+{
+    Synth &synth = *m_synth;
+    size_t numChannels = synth.m_numChannels;
+
+    snapshot.chipChannelsCount = numChannels;
+    snapshot.midiChannelsCount = m_midiChannels.size();
+
+    for(size_t c = 0; c < numChannels && c < snapshot.chipChannelsCapacity; ++c)
+    {
+        const OpnChannel &chan = m_chipChannels[c];
+        OPN2_ChipChannelState &dst = snapshot.chipChannels[c];
+        OpnChannel::const_users_iterator loc = chan.users.begin();
+
+        dst.notesCount = static_cast<OPN2_UInt8>(std::min<size_t>(chan.users.size(), 255));
+        dst.totalLevel = synth.carrierLevel(c);
+        dst.pan = synth.panning(c);
+
+        dst.midiChannel = chan.recent_loc.MidCh;
+        dst.note = chan.recent_loc.note;
+        dst.instrument = chan.recent_midiins;
+        dst.isPercussion = chan.recent_percussion ? 1 : 0;
+        dst.state = (chan.koff_time_until_neglible_us > 0) ?
+                    OPNMIDI_ChipChan_Releasing : OPNMIDI_ChipChan_Free;
+
+        if(!loc.is_end())
+        {
+            const OpnChannel::LocationData &ld = loc->value;
+            dst.midiChannel = ld.loc.MidCh;
+            dst.note = ld.loc.note;
+            dst.state = (ld.sustained == OpnChannel::LocationData::Sustain_None) ?
+                        OPNMIDI_ChipChan_KeyOn : OPNMIDI_ChipChan_Sustained;
+
+            // The first user may be not the recently placed note when it was joined by an evacuated one
+            MIDIchannel::notes_iterator i = m_midiChannels[ld.loc.MidCh].find_activenote(ld.loc.note);
+            if(!i.is_end())
+            {
+                dst.instrument = static_cast<OPN2_UInt8>(i->value.midiins & 0x7F);
+                dst.isPercussion = i->value.isPercussion ? 1 : 0;
+            }
+        }
+    }
+
+    for(size_t ch = 0; ch < m_midiChannels.size() && ch < snapshot.midiChannelsCapacity; ++ch)
+    {
+        const MIDIchannel &mc = m_midiChannels[ch];
+        OPN2_MidiChannelState &dst = snapshot.midiChannels[ch];
+        size_t chipChannels = 0;
+
+        for(MIDIchannel::const_notes_iterator i = mc.activenotes.begin(); !i.is_end(); ++i)
+            chipChannels += i->value.chip_channels_count;
+
+        dst.activeNotes = static_cast<OPN2_UInt8>(std::min<size_t>(mc.activenotes.size(), 255));
+        dst.chipChannels = static_cast<OPN2_UInt8>(std::min<size_t>(chipChannels, 255));
+        dst.patch = mc.patch;
+        dst.bankMsb = mc.bank_msb;
+        dst.bankLsb = mc.bank_lsb;
+        dst.volume = mc.volume;
+        dst.expression = mc.expression;
+        dst.pan = mc.panning;
+        dst.sustain = mc.sustain ? 1 : 0;
+        dst.isPercussion = ((ch % 16) == 9 || mc.is_xg_percussion) ? 1 : 0;
+        dst.pitchBend = static_cast<short>(mc.bend);
+    }
+}
+
 /* TODO */
 
 //#ifndef ADLMIDI_DISABLE_CPP_EXTRAS
@@ -27,8 +27,13 @@
 #include "opnbank.h"
 #include "opnmidi_private.hpp"
 #include "opnmidi_ptr.hpp"
+#include "opnmidi_bankmap.h"
+#include "chips/opn_chip_family.h"
 #include "structures/pl_list.hpp"
 
+struct WOPNFile;
+class OpnRenderAhead;
+
 /**
  * @brief Hooks of the internal events
  */
@@ -66,12 +71,24 @@ class OPNMIDIplay
 {
     friend void opn2_reset(struct OPN2_MIDIPlayer*);
 public:
-    explicit OPNMIDIplay(unsigned long sampleRate = 22050);
+    /**
+     * @param sampleRate Output sample rate
+     * @param allocator Allocator of the player memory, NULL to use the default heap
+     */
+    explicit OPNMIDIplay(unsigned long sampleRate = 22050, const ADLMIDI_Allocator *allocator = NULL);
     ~OPNMIDIplay();
 
-    void applySetup();
+    /**
+     * @brief Apply the setup to the synthesizer and reset it
+     * @return false when chips can't be allocated, the error string is set then
+     */
+    bool applySetup();
 
-    void partialReset();
+    /**
+     * @brief Reset chips keeping the chip type
+     * @return false when chips can't be allocated, the error string is set then
+     */
+    bool partialReset();
     void resetMIDI();
 
 private:
@@ -118,8 +135,8 @@ public:
         bool portamentoEnable;
         //! Source note number used by portamento
         int8_t portamentoSource;  // note number or -1
-        //! Portamento rate
-        double portamentoRate;
+        //! Portamento rate (tone units per second)
+        OpnTone portamentoRate;
         //! Per note Aftertouch values
         uint8_t noteAftertouch[128];
         //! Is note aftertouch has any non-zero value
@@ -128,18 +145,32 @@ public:
         char _padding[6];
         //! Pitch bend value
         int bend;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        //! Pitch bend sensitivity (tone units per 1024 pitch bend units)
+        int32_t bendsense;
+#else
         //! Pitch bend sensitivity
         double bendsense;
+#endif
         //! Pitch bend sensitivity LSB value
         int bendsense_lsb,
         //! Pitch bend sensitivity MSB value
             bendsense_msb;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        //! Vibrato phase (full period is 2^32)
+        uint32_t vibpos;
+        //! Vibrato speed value (periods per second in 16.16 fixed-point)
+        int32_t  vibspeed,
+        //! Vibrato depth value (1/256 of tone unit per vibrato level)
+                 vibdepth;
+#else
         //! Vibrato position value
         double  vibpos,
         //! Vibrato speed value
                 vibspeed,
         //! Vibrato depth value
                 vibdepth;
+#endif
         //! Vibrato delay time
         int64_t vibdelay_us;
         //! Last LSB part of RPN value received
@@ -168,9 +199,9 @@ public:
             //! Tone selected on noteon:
             int16_t noteTone;
             //! Current tone (!= noteTone if gliding note)
-            double currentTone;
-            //! Gliding rate
-            double glideRate;
+            OpnTone currentTone;
+            //! Gliding rate (tone units per second)
+            OpnTone glideRate;
             //! Patch selected on noteon; index to bank.ins[]
             size_t  midiins;
             //! Is note the percussion instrument
@@ -180,7 +211,7 @@ public:
             //! Whether releasing and on extended life time defined by TTL
             bool    isOnExtendedLifeTime;
             //! Time-to-live until release (short percussion note fix)
-            double  ttl;
+            OpnTickTime ttl;
             //! Patch selected
             const OpnInstMeta *ains;
             enum
@@ -392,13 +423,18 @@ public:
             aftertouch = 0;
             std::memset(noteAftertouch, 0, 128);
             noteAfterTouchInUse = false;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            vibspeed = 5 << 16;
+            vibdepth = 25801; // 0.5 / 127 * OPN_TONE_FX_ONE * 256
+#else
             vibspeed = 2 * 3.141592653 * 5.0;
             vibdepth = 0.5 / 127;
+#endif
             vibdelay_us = 0;
             portamento = 0;
             portamentoEnable = false;
             portamentoSource = -1;
-            portamentoRate = HUGE_VAL;
+            portamentoRate = OPN_GLIDE_NONE;
         }
 
         /**
@@ -416,7 +452,12 @@ public:
         void updateBendSensitivity()
         {
             int cent = bendsense_msb * 128 + bendsense_lsb;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+            // cent * OPN_TONE_FX_ONE / (128 * 8192), scaled by 1024
+            bendsense = cent * 25;
+#else
             bendsense = cent * (1.0 / (128 * 8192));
+#endif
         }
 
         /**
@@ -425,7 +466,7 @@ public:
         void cleanupNote(notes_iterator i)
         {
             NoteInfo &info = i->value;
-            if(info.glideRate != HUGE_VAL)
+            if(info.glideRate != OPN_GLIDE_NONE)
                 --gliding_note_count;
             if(info.ttl > 0)
                 --extended_note_count;
@@ -473,6 +514,8 @@ public:
             //! Timeout until note will be allowed to be killed by channel manager while it is on
             int64_t kon_time_until_neglible_us;
             int64_t vibdelay_us;
+            //! Time until the note will be released as known by the sequencer, -1 if unknown
+            int64_t kon_time_until_end_us;
 
             struct FindPredicate
             {
@@ -489,6 +532,13 @@ public:
         //! Recently passed instrument, improves a goodness of released but busy channel when matching
         MIDIchannel::NoteInfo::Phys recent_ins;
 
+        //! Recently played note, reported while the channel is releasing
+        Location recent_loc;
+        //! MIDI instrument of the recently played note (the key for percussion)
+        uint8_t  recent_midiins;
+        //! Is the recently played note a percussion
+        bool     recent_percussion;
+
         pl_list<LocationData> users;
         typedef pl_list<LocationData>::iterator users_iterator;
         typedef pl_list<LocationData>::const_iterator const_users_iterator;
@@ -511,18 +561,25 @@ public:
         }
 
         // For channel allocation:
-        OpnChannel(): koff_time_until_neglible_us(0), users(128)
+        OpnChannel(): koff_time_until_neglible_us(0), recent_midiins(0), recent_percussion(false), users(128)
         {
             std::memset(&recent_ins, 0, sizeof(MIDIchannel::NoteInfo::Phys));
+            recent_loc.MidCh = 0;
+            recent_loc.note = 0;
         }
 
-        OpnChannel(const OpnChannel &oth): koff_time_until_neglible_us(oth.koff_time_until_neglible_us), users(oth.users)
+        OpnChannel(const OpnChannel &oth): koff_time_until_neglible_us(oth.koff_time_until_neglible_us),
+            recent_loc(oth.recent_loc), recent_midiins(oth.recent_midiins), recent_percussion(oth.recent_percussion),
+            users(oth.users)
         {
         }
 
         OpnChannel &operator=(const OpnChannel &oth)
         {
             koff_time_until_neglible_us = oth.koff_time_until_neglible_us;
+            recent_loc = oth.recent_loc;
+            recent_midiins = oth.recent_midiins;
+            recent_percussion = oth.recent_percussion;
             users = oth.users;
             return *this;
         }
@@ -538,25 +595,75 @@ public:
     /**
      * @brief MIDI files player sequencer
      */
-    AdlMIDI_UPtr<MidiSequencer> m_sequencer;
+    AdlMIDI_UPtr<MidiSequencer, ADLMIDI_AllocDelete<MidiSequencer> > m_sequencer;
 
     /**
      * @brief Interface between MIDI sequencer and this library
      */
-    AdlMIDI_UPtr<BW_MidiRtInterface> m_sequencerInterface;
+    AdlMIDI_UPtr<BW_MidiRtInterface, ADLMIDI_AllocDelete<BW_MidiRtInterface> > m_sequencerInterface;
 
     /**
      * @brief Initialize MIDI sequencer interface
+     * @return false when out of memory
+     */
+    bool initSequencerInterface();
+
+    /**
+     * @brief Song which plays along with the main one on the same chips
+     */
+    struct SongSlot
+    {
+        //! Owner of the slot, the context of the sequencer interface calls
+        OPNMIDIplay *player;
+        //! Sequencer of the song, NULL when the slot is empty
+        AdlMIDI_UPtr<MidiSequencer, ADLMIDI_AllocDelete<MidiSequencer> > sequencer;
+        //! Interface between the slot sequencer and this library
+        AdlMIDI_UPtr<BW_MidiRtInterface, ADLMIDI_AllocDelete<BW_MidiRtInterface> > rtInterface;
+        //! First MIDI channel of the block used by the song
+        size_t channelBase;
+        //! Playback is paused
+        bool paused;
+        //! Volume level of the song (0...127)
+        uint8_t volume;
+        //! Priority of song notes on allocation of chip channels
+        int priority;
+    };
+
+    //! Songs playing along with the main one
+    SongSlot m_songSlots[OPNMIDI_SONG_SLOTS];
+    //! Count of loaded song slots
+    size_t m_songSlotsUsed;
+
+    /**
+     * @brief Initialize MIDI sequencer interface of the song slot
+     * @param slot Index of the slot
+     * @return false when out of memory
      */
-    void initSequencerInterface();
+    bool initSlotInterface(size_t slot);
+
+    /**
+     * @brief Pass durations of notes from sequencers only when the look-ahead allocation needs them
+     *
+     * Builds the tables of durations of loaded songs when the mode gets selected
+     * and frees them when it gets unselected
+     */
+    void updateNoteDurations();
 #endif //OPNMIDI_DISABLE_MIDI_SEQUENCER
 
     struct Setup
     {
         int     emulator;
         bool    runAtPcmRate;
+        //! Use SSG and rhythm parts of OPNA chips as extra channels
+        bool    extraChannels;
+        //! Play percussion notes by prerendered PCM samples
+        bool    dacDrums;
         unsigned int OpnBank;
         unsigned int numChips;
+        //! Highest count of chips chosen by the song polyphony, 0 when automatic count is disabled
+        unsigned int autoNumChipsMax;
+        //! Count of chips chosen for the current song, 0 when not chosen
+        unsigned int autoNumChips;
         unsigned int LogarithmicVolumes;
         int     VolumeModel;
         int     lfoEnable;
@@ -566,17 +673,19 @@ public:
         int     ScaleModulators;
         bool    fullRangeBrightnessCC74;
         bool    enableAutoArpeggio;
+        bool    sparseBanks;
 
-        double delay;
-        double carry;
+        OpnTickTime delay;
+        OpnTickTime carry;
 
         /* The lag between visual content and audio content equals */
         /* the sum of these two buffers. */
-        double mindelay;
-        double maxdelay;
+        OpnTickTime mindelay;
+        OpnTickTime maxdelay;
 
         /* For internal usage */
         ssize_t tick_skip_samples_delay; /* Skip tick processing after samples count. */
+        OpnTickTime tick_skip_delay; /* Time to tick once the skipped samples are rendered. */
         /* For internal usage */
 
         unsigned long PCM_RATE;
@@ -623,6 +732,8 @@ private:
     {
         char name[100];
         size_t track;
+        //! Block of channels was left by the previous song, any new device may take it
+        bool free;
     } m_midiDevices[127];
     static const size_t m_midiDevicesSize = 127;
 
@@ -637,6 +748,8 @@ private:
     std::vector<OpnChannel> m_chipChannels;
     //! Counter of arpeggio processing
     size_t m_arpeggioCounter;
+    //! Minimum life time of percussion notes (see OpnTickTime)
+    OpnTickTime m_drumNoteMinTime;
 
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
     //! Audio tick counter
@@ -646,12 +759,12 @@ private:
     //! Local error string
     std::string errorStringOut;
 
-    //! Missing instruments catches
-    std::set<size_t> caugh_missing_instruments;
+    //! Missing instruments catches (bounded to never allocate while playing)
+    std::bitset<256> caugh_missing_instruments;
     //! Missing melodic banks catches
-    std::set<size_t> caugh_missing_banks_melodic;
+    std::bitset<65536> caugh_missing_banks_melodic;
     //! Missing percussion banks catches
-    std::set<size_t> caugh_missing_banks_percussion;
+    std::bitset<65536> caugh_missing_banks_percussion;
 
 public:
 
@@ -659,7 +772,7 @@ public:
     void setErrorString(const std::string &err);
 
     //! OPN2 Chip manager
-    AdlMIDI_UPtr<Synth> m_synth;
+    AdlMIDI_UPtr<Synth, ADLMIDI_AllocDelete<Synth> > m_synth;
 
     //! Generator output buffer
     int32_t m_outBuf[1024];
@@ -667,6 +780,49 @@ public:
     //! Synthesizer setup
     Setup m_setup;
 
+    /**
+     * @brief Statistics of the chip channels allocation
+     */
+    struct VoiceStats
+    {
+        //! Voices placed onto chip channels
+        uint64_t placed;
+        //! Playing notes killed to free a chip channel for a new note
+        uint64_t steals;
+        //! Playing notes moved onto another chip channel to free one for a new note
+        uint64_t evacuations;
+        //! Voices not played because no chip channel was available
+        uint64_t drops;
+        //! Chip channels re-used in the release phase, per allocation mode
+        uint64_t releaseReuses[OPNMIDI_ChanAlloc_Count];
+        //! Highest count of simultaneously busy chip channels
+        size_t peakChannels;
+        //! Highest count of simultaneously playing voices
+        size_t peakVoices;
+
+        VoiceStats()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            placed = steals = evacuations = drops = 0;
+            for(size_t i = 0; i < OPNMIDI_ChanAlloc_Count; ++i)
+                releaseReuses[i] = 0;
+            peakChannels = peakVoices = 0;
+        }
+    };
+
+    //! Statistics of the chip channels allocation
+    VoiceStats m_voiceStats;
+
+    //! Remaining duration of the next Note-On reported by the sequencer, -1 if unknown
+    int64_t m_noteDurationUs;
+
+    //! Render thread of the render-ahead mode, NULL when it's not running
+    OpnRenderAhead *m_renderAhead;
+
     /**
      * @brief Load bank from file
      * @param filename Path to bank file
@@ -689,6 +845,242 @@ public:
      */
     bool LoadBank(FileAndMemReader &fr);
 
+    /**
+     * @brief Parse the bank from opened FileAndMemReader class, throws std::bad_alloc when out of memory
+     * @param fr Instance with opened file
+     * @return true on succes
+     */
+    bool LoadBankData(FileAndMemReader &fr);
+
+    /**
+     * @brief Keep the raw bank file data from opened FileAndMemReader class for the sparse loading
+     * @param fr Instance with opened file
+     * @param fsize Size of the file
+     * @return true on succes
+     */
+    bool LoadBankSparse(FileAndMemReader &fr, size_t fsize);
+
+    /**
+     * @brief Apply the bank-wide setup from the loaded bank file
+     * @param wopn Bank file data
+     */
+    void setBankSetup(const WOPNFile *wopn);
+
+    /**
+     * @brief Set the error string for the bank loading error
+     * @param err Error code (WOPN_ErrorCodes)
+     */
+    void setBankErrorString(int err);
+
+    /**
+     * @brief Bank entry of the bank file kept by the sparse loading mode
+     */
+    struct SparseBank
+    {
+        //! Offset of the first instrument record of the bank in m_sparseBankData
+        size_t   offset;
+        //! Bit-mask of instruments already converted into the synth's bank or set by the user
+        uint8_t  loaded[16];
+        //! The synth's bank was made by the sparse loading
+        bool     created;
+        //! Instruments of the bank are used by loaded songs
+        bool     used;
+        //! The user has changed instruments of the bank, it's never dropped
+        bool     keep;
+    };
+    typedef BasicBankMap<SparseBank> SparseBankMap;
+
+    //! Count of spare bank slots reserved for banks first requested by real-time events
+    enum { SparseSpareBanks = 4 };
+
+    //! Instrument records of the bank file kept by the sparse loading mode (empty when a bank was loaded completely)
+    std::vector<char> m_sparseBankData;
+    //! Version of the kept bank file
+    uint16_t m_sparseBankVersion;
+    //! Size of one instrument record in m_sparseBankData
+    size_t m_sparseInsSize;
+    //! Banks available in the kept bank file
+    SparseBankMap m_sparseBanks;
+
+    /**
+     * @brief Find the instrument in banks, and load it when the sparse loading mode is used
+     * @param bankno Bank number (PercussionTag is set for percussion banks)
+     * @param ins Instrument number in the bank
+     * @return Pointer to the instrument, or NULL if bank is not exists
+     */
+    const OpnInstMeta *findInstrument(size_t bankno, size_t ins);
+
+    /**
+     * @brief Find the instrument in banks without loading it from the sparse bank
+     * @param bankno Bank number (PercussionTag is set for percussion banks)
+     * @param ins Instrument number in the bank
+     * @return Pointer to the instrument, or NULL if bank is not exists
+     */
+    const OpnInstMeta *findLoadedInstrument(size_t bankno, size_t ins) const;
+
+    /**
+     * @brief Load the instrument from the kept bank file if it wasn't loaded yet
+     *
+     * Banks made by the user are never changed.
+     * @param bankno Bank number (PercussionTag is set for percussion banks)
+     * @param ins Instrument number in the bank
+     * @param mayAllocate Allow the bank map to grow, otherwise only reserved slots are used
+     * @return true if instrument is available
+     */
+    bool sparseLoadInstrument(size_t bankno, size_t ins, bool mayAllocate);
+
+    /**
+     * @brief Load instruments of all loaded songs, drop banks no longer used by them,
+     * and reserve slots for banks requested by real-time events
+     */
+    void sparseUpdateBanks();
+
+    /**
+     * @brief Reserve spare slots of the bank map for the real-time events
+     */
+    void sparseReserveBanks();
+
+    /**
+     * @brief Protect the instrument set by the user from the sparse loading
+     * @param bankno Bank number (PercussionTag is set for percussion banks)
+     * @param ins Instrument number in the bank
+     */
+    void sparseKeepInstrument(size_t bankno, size_t ins);
+
+    /**
+     * @brief Forget the bank removed by the user
+     * @param bankno Bank number (PercussionTag is set for percussion banks)
+     */
+    void sparseForgetBank(size_t bankno);
+
+#ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
+    /**
+     * @brief Load all instruments referenced by the song from the kept raw bank file
+     * @param seq Sequencer with the loaded song
+     */
+    void sparseLoadSongInstruments(const MidiSequencer &seq);
+
+    /**
+     * @brief Find the smallest count of chips which plays all notes of the loaded song at once
+     *
+     * Durations of notes are extended by release tails of their instruments,
+     * notes are counted against FM, SSG and rhythm channels they may use.
+     * @param maxChips Highest allowed count of chips
+     * @return Count of chips
+     */
+    unsigned int estimateNumChips(unsigned int maxChips);
+
+    /**
+     * @brief Find the instrument which plays the note of the loaded song
+     *
+     * Instruments of the song are loaded from sparse banks on the song load,
+     * so, the lookup never loads them.
+     * @param channel MIDI channel of the note
+     * @param note Note key
+     * @param patch Patch set on the channel
+     * @param bankMsb Bank MSB set on the channel
+     * @param bankLsb Bank LSB set on the channel
+     * @param [out] isPercussion Is the note on the percussion channel
+     * @param [out] insBank Bank which the instrument was taken from
+     * @return Instrument, or NULL if the note is blank
+     */
+    const OpnInstMeta *findSpanInstrument(uint8_t channel, uint8_t note, uint8_t patch,
+                                          uint8_t bankMsb, uint8_t bankLsb, bool &isPercussion,
+                                          size_t &insBank) const;
+
+    /**
+     * @brief Render percussion samples of all drum notes of the song
+     * @param seq Sequencer with the loaded song
+     */
+    void prerenderDacDrums(const MidiSequencer &seq);
+
+    /**
+     * @brief Render percussion samples of the main song and of all song slots
+     *
+     * Called on the load, and after changes of setup or instruments dropped the samples
+     */
+    void prerenderDacDrums();
+#endif
+
+    /**
+     * @brief Register log played into chips directly, without the MIDI layer
+     */
+    struct RegLog
+    {
+        //! Register writes, sample offsets are in units of the source rate
+        std::vector<OPN2_RegWrite> events;
+        //! Sample rate of event offsets
+        unsigned long rate;
+        //! Length of the log in units of the source rate
+        uint64_t length;
+        //! Index of the next event to write
+        size_t pos;
+        //! Count of output sample frames generated since the log start
+        uint64_t frames;
+        //! Register log is playing instead of the MIDI sequencer
+        bool active;
+        //! Chips were changed for the log and must be restored at its end
+        bool chipsChanged;
+        //! Count of chips before the log start
+        unsigned int savedChips;
+        //! Chip family before the log start
+        OPNFamily savedFamily;
+    };
+
+    //! Register log playback state
+    RegLog m_regLog;
+
+    /**
+     * @brief Start playback of the register log
+     * @param events Register writes, sorted by sample offset
+     * @param count Count of register writes
+     * @param rate Sample rate of sample offsets
+     * @return true on success, false on failure
+     */
+    bool LoadRegLog(const OPN2_RegWrite *events, size_t count, unsigned long rate);
+
+    /**
+     * @brief Start playback of the VGM file with YM2612 or YM2608 commands
+     * @param filename Path to the VGM file
+     * @return true on success, false on failure
+     */
+    bool LoadVGM(const std::string &filename);
+
+    /**
+     * @brief Start playback of the VGM file data with YM2612 or YM2608 commands
+     * @param data pointer to the memory block
+     * @param size size of memory block
+     * @return true on success, false on failure
+     */
+    bool LoadVGM(const void *data, size_t size);
+
+    /**
+     * @brief Start playback of the VGM from opened FileAndMemReader class
+     * @param fr Instance with opened file
+     * @return true on success, false on failure
+     */
+    bool LoadVGM(FileAndMemReader &fr);
+
+    /**
+     * @brief Reset chips for the register log playback
+     * @param family Chip family required by the log
+     * @param chips Count of chips required by the log
+     * @return false when chips can't be allocated
+     */
+    bool regLogStart(OPNFamily family, size_t chips);
+
+    /**
+     * @brief Write all register log events which are due at the current output frame
+     * @return Count of sample frames until the next event or the log end, 0 when the log is ended
+     */
+    uint64_t regLogProcess();
+
+    /**
+     * @brief Restore the count of chips and the chip family changed by the register log
+     * @return false when chips can't be allocated
+     */
+    bool regLogFinish();
+
 #ifndef OPNMIDI_DISABLE_MIDI_SEQUENCER
     /**
      * @brief MIDI file loading pre-process
@@ -702,6 +1094,13 @@ public:
      */
     bool LoadMIDI_post();
 
+    /**
+     * @brief Check is format of the loaded song supported
+     * @param seq Sequencer with the loaded song
+     * @return true if supported, false with the error string set if not
+     */
+    bool checkSongFormat(MidiSequencer &seq);
+
     /**
      * @brief Load music file from a file
      * @param filename Path to music file
@@ -720,18 +1119,140 @@ public:
 
     /**
      * @brief Periodic tick handler.
-     * @param s seconds since last call
-     * @param granularity don't expect intervals smaller than this, in seconds
-     * @return desired number of seconds until next call
+     * @param s time since last call (see OpnTickTime)
+     * @param granularity don't expect intervals smaller than this (see OpnTickTime)
+     * @return desired time until next call (see OpnTickTime)
      */
-    double Tick(double s, double granularity);
+    OpnTickTime Tick(OpnTickTime s, OpnTickTime granularity);
+
+    /**
+     * @brief Load music file into the song slot from a file
+     * @param slot Index of the slot
+     * @param filename Path to music file
+     * @return true on success, false on failure
+     */
+    bool LoadSlotMIDI(size_t slot, const std::string &filename);
+
+    /**
+     * @brief Load music file into the song slot from the memory block
+     * @param slot Index of the slot
+     * @param data pointer to the memory block
+     * @param size size of memory block
+     * @return true on success, false on failure
+     */
+    bool LoadSlotMIDI(size_t slot, const void *data, size_t size);
+
+    /**
+     * @brief Load music file into the song slot from opened FileAndMemReader class
+     * @param slot Index of the slot
+     * @param fr Instance with opened file
+     * @return true on success, false on failure
+     */
+    bool LoadSlotMIDI(size_t slot, FileAndMemReader &fr);
+
+    /**
+     * @brief Stop the song of the slot and unload it
+     * @param slot Index of the slot
+     */
+    void closeSlot(size_t slot);
+
+    /**
+     * @brief Release all notes played by the song of the slot
+     * @param slot Index of the slot
+     */
+    void releaseSlotNotes(size_t slot);
+
+    /**
+     * @brief Release notes of all song slots before chips are reset, songs keep playing
+     */
+    void releaseSlotNotes();
+
+    /**
+     * @brief Reset MIDI channels and devices of the main song, blocks of song slots are kept
+     */
+    void resetMainSongDevices();
+
+    /**
+     * @brief Change the volume of the slot song and update playing notes
+     * @param slot Index of the slot
+     * @param volume Volume level (0...127)
+     */
+    void setSlotVolume(size_t slot, uint8_t volume);
+
+    /**
+     * @brief Reset state of MIDI channels used by the song of the slot
+     * @param slot Index of the slot
+     */
+    void resetSlotState(size_t slot);
+
+    /**
+     * @brief Reset state of MIDI channels at the begin of the main song, channels of song slots are kept
+     */
+    void resetMainSongState();
+
+    /**
+     * @brief Have the main song and every loaded song slot reached their ends?
+     * @return true when there is nothing to play
+     */
+    bool songsAtEnd() const;
+
+    /**
+     * @brief Find the song slot which uses the MIDI channel
+     * @param midCh MIDI channel
+     * @return Song slot, or NULL if channel belongs to the main song
+     */
+    const SongSlot *findChannelSlot(size_t midCh) const;
+
+    /**
+     * @brief Take the block of MIDI channels for the song slot
+     * @param slot Index of the slot
+     * @return Offset of the MIDI Channels, multiple to 16
+     */
+    size_t chooseSlotDevice(size_t slot);
 #endif //OPNMIDI_DISABLE_MIDI_SEQUENCER
 
+    /**
+     * @brief Priority of notes of the MIDI channel on allocation of chip channels
+     * @param midCh MIDI channel
+     * @return Priority of the song slot, 0 for the main song
+     */
+    int channelPriority(size_t midCh) const;
+
+    /**
+     * @brief Volume of the MIDI channel scaled by the volume of its song slot
+     * @param midCh MIDI channel
+     * @return Volume level (0...127)
+     */
+    uint8_t channelVolume(size_t midCh) const;
+
+    /**
+     * @brief Chip group which plays notes of the MIDI channel
+     *
+     * Every MIDI port (a block of 16 channels) has fixed affinity to one group.
+     * @param midCh MIDI channel
+     * @return Index of the chip group
+     */
+    uint32_t channelChipGroup(size_t midCh) const;
+
     /**
      * @brief Process extra iterators like vibrato or arpeggio
-     * @param s seconds since last call
+     * @param s time since last call (see OpnTickTime)
+     */
+    void   TickIterators(OpnTickTime s);
+
+    /**
+     * @brief Convert time in seconds into the control path time value
+     * @param seconds Time in seconds
+     * @return Time value (see OpnTickTime)
+     */
+    OpnTickTime secondsToTickTime(double seconds) const;
+
+    /**
+     * @brief Convert the control path time value into seconds
+     * @param t Time value (see OpnTickTime)
+     * @return Time in seconds
      */
-    void   TickIterators(double s);
+    double tickTimeToSeconds(OpnTickTime t) const;
 
 
     /* RealTime event triggers */
@@ -740,6 +1261,12 @@ public:
      */
     void realTime_ResetState();
 
+    /**
+     * @brief Reset state of one MIDI channel
+     * @param ch MIDI channel
+     */
+    void resetChannelState(size_t ch);
+
     /**
      * @brief Note On event
      * @param channel MIDI channel
@@ -747,14 +1274,14 @@ public:
      * @param velocity Velocity level (from 0 to 127)
      * @return true if Note On event was accepted
      */
-    bool realTime_NoteOn(uint8_t channel, uint8_t note, uint8_t velocity);
+    bool realTime_NoteOn(size_t channel, uint8_t note, uint8_t velocity);
 
     /**
      * @brief Note Off event
      * @param channel MIDI channel
      * @param note Note key (from 0 to 127)
      */
-    void realTime_NoteOff(uint8_t channel, uint8_t note);
+    void realTime_NoteOff(size_t channel, uint8_t note);
 
     /**
      * @brief Note aftertouch event
@@ -762,14 +1289,14 @@ public:
      * @param note Note key (from 0 to 127)
      * @param atVal After-Touch level (from 0 to 127)
      */
-    void realTime_NoteAfterTouch(uint8_t channel, uint8_t note, uint8_t atVal);
+    void realTime_NoteAfterTouch(size_t channel, uint8_t note, uint8_t atVal);
 
     /**
      * @brief Channel aftertouch event
      * @param channel MIDI channel
      * @param atVal After-Touch level (from 0 to 127)
      */
-    void realTime_ChannelAfterTouch(uint8_t channel, uint8_t atVal);
+    void realTime_ChannelAfterTouch(size_t channel, uint8_t atVal);
 
     /**
      * @brief Controller Change event
@@ -777,21 +1304,21 @@ public:
      * @param type Type of controller
      * @param value Value of the controller (from 0 to 127)
      */
-    void realTime_Controller(uint8_t channel, uint8_t type, uint8_t value);
+    void realTime_Controller(size_t channel, uint8_t type, uint8_t value);
 
     /**
      * @brief Patch change
      * @param channel MIDI channel
      * @param patch Patch Number (from 0 to 127)
      */
-    void realTime_PatchChange(uint8_t channel, uint8_t patch);
+    void realTime_PatchChange(size_t channel, uint8_t patch);
 
     /**
      * @brief Pitch bend change
      * @param channel MIDI channel
      * @param pitch Concoctated raw pitch value
      */
-    void realTime_PitchBend(uint8_t channel, uint16_t pitch);
+    void realTime_PitchBend(size_t channel, uint16_t pitch);
 
     /**
      * @brief Pitch bend change
@@ -799,28 +1326,28 @@ public:
      * @param msb MSB of pitch value
      * @param lsb LSB of pitch value
      */
-    void realTime_PitchBend(uint8_t channel, uint8_t msb, uint8_t lsb);
+    void realTime_PitchBend(size_t channel, uint8_t msb, uint8_t lsb);
 
     /**
      * @brief LSB Bank Change CC
      * @param channel MIDI channel
      * @param lsb LSB value of bank number
      */
-    void realTime_BankChangeLSB(uint8_t channel, uint8_t lsb);
+    void realTime_BankChangeLSB(size_t channel, uint8_t lsb);
 
     /**
      * @brief MSB Bank Change CC
      * @param channel MIDI channel
      * @param lsb MSB value of bank number
      */
-    void realTime_BankChangeMSB(uint8_t channel, uint8_t msb);
+    void realTime_BankChangeMSB(size_t channel, uint8_t msb);
 
     /**
      * @brief Bank Change (united value)
      * @param channel MIDI channel
      * @param bank Bank number value
      */
-    void realTime_BankChange(uint8_t channel, uint16_t bank);
+    void realTime_BankChange(size_t channel, uint16_t bank);
 
     /**
      * @brief Sets the Device identifier
@@ -936,6 +1463,14 @@ private:
         Upd_OffMute = Upd_Off + Upd_Mute
     };
 
+    /**
+     * @brief Get chip voices of the note, the second voice takes its own chip channel when it differs
+     * @param ains Instrument of the note
+     * @param [out] voices Voices of the note
+     * @return Count of chip channels taken by the note
+     */
+    static size_t noteVoices(const OpnInstMeta *ains, MIDIchannel::NoteInfo::Phys voices[MIDIchannel::NoteInfo::MaxNumPhysChans]);
+
     void noteUpdPatch(const OpnChannel::Location &loc, const MIDIchannel::NoteInfo::Phys &ins, const OpnInstMeta *ains);
 
     void noteUpdOff(size_t midCh,
@@ -970,6 +1505,17 @@ private:
      */
     int64_t calculateChipChannelGoodness(size_t c, const MIDIchannel::NoteInfo::Phys &ins) const;
 
+    /**
+     * @brief Get the channel allocation mode with the AUTO mode resolved
+     * @return Effective channel allocation mode
+     */
+    OPNMIDI_ChannelAlloc effectiveChannelAlloc() const;
+
+    /**
+     * @brief Update peak counts of busy chip channels and playing voices
+     */
+    void updateVoicePeaks();
+
     /**
      * @brief A new note will be played on this channel using this instrument.
      * @param c Wanted chip channel
@@ -1032,22 +1578,22 @@ private:
     void noteOff(size_t midCh, uint8_t note, bool forceNow = false);
 
     /**
-     * @brief Update processing of vibrato to amount of seconds
-     * @param amount Amount value in seconds
+     * @brief Update processing of vibrato to amount of time
+     * @param amount Amount value (see OpnTickTime)
      */
-    void updateVibrato(double amount);
+    void updateVibrato(OpnTickTime amount);
 
     /**
      * @brief Update auto-arpeggio
-     * @param amount Amount value in seconds [UNUSED]
+     * @param amount Amount value (see OpnTickTime) [UNUSED]
      */
-    void updateArpeggio(double /*amount*/);
+    void updateArpeggio(OpnTickTime /*amount*/);
 
     /**
-     * @brief Update Portamento gliding to amount of seconds
-     * @param amount Amount value in seconds
+     * @brief Update Portamento gliding to amount of time
+     * @param amount Amount value (see OpnTickTime)
      */
-    void updateGlide(double amount);
+    void updateGlide(OpnTickTime amount);
 
 public:
     /**
@@ -1058,6 +1604,14 @@ public:
      */
     size_t chooseDevice(const char *name, size_t len);
 
+    /**
+     * @brief Allocate MIDI channels for the given count of devices ahead of playback
+     * @param count Count of devices (MIDI ports) expected to be used
+     *
+     * Device switch events don't allocate memory when all devices were reserved
+     */
+    void reserveMidiDevices(size_t count);
+
     /**
      * @brief Gets a textual description of the state of chip channels
      * @param text character pointer for text
@@ -1065,6 +1619,12 @@ public:
      * @param size number of characters available to write
      */
     void describeChannels(char *text, char *attr, size_t size);
+
+    /**
+     * @brief Fill the structured snapshot of chip and MIDI channels state
+     * @param snapshot Destination snapshot with caller-owned arrays
+     */
+    void getChannelsSnapshot(OPN2_ChannelsSnapshot &snapshot);
 };
 
 #endif // OPNMIDI_MIDIPLAY_HPP
@@ -23,6 +23,7 @@
 
 #include "opnmidi_opn2.hpp"
 #include "opnmidi_private.hpp"
+#include "opnmidi_atomic.hpp"
 
 #include "models/opn_models.h"
 
@@ -170,6 +171,53 @@ const struct OpnTimbre c_defaultInsCache =
 
 static const uint32_t g_noteChannelsMap[6] = { 0, 1, 2, 4, 5, 6 };
 
+//! Carrier operators of every algorithm
+static const bool g_algCarriers[8][4] =
+{
+    /*
+     * Yeah, Operator 2 and 3 are seems swapped
+     * which we can see in the algorithm 4
+     */
+    //OP1   OP3   OP2    OP4
+    //30    34    38     3C
+    {false,false,false,true},//Algorithm #0:  W = 1 * 2 * 3 * 4
+    {false,false,false,true},//Algorithm #1:  W = (1 + 2) * 3 * 4
+    {false,false,false,true},//Algorithm #2:  W = (1 + (2 * 3)) * 4
+    {false,false,false,true},//Algorithm #3:  W = ((1 * 2) + 3) * 4
+    {false,false,true, true},//Algorithm #4:  W = (1 * 2) + (3 * 4)
+    {false,true ,true ,true},//Algorithm #5:  W = (1 * (2 + 3 + 4)
+    {false,true ,true ,true},//Algorithm #6:  W = (1 * 2) + 3 + 4
+    {true ,true ,true ,true},//Algorithm #7:  W = 1 + 2 + 3 + 4
+};
+
+/*! Gain of the attenuation in 0.75 dB steps, scaled by 32768. Result of:
+    ```
+    min(32767, round(32768.0 * pow(10.0, -0.0375 * i)))
+    ```
+*/
+static const int32_t g_attenuationGain[128] =
+{
+    32767, 30057, 27571, 25290, 23198, 21279, 19519, 17904,
+    16423, 15064, 13818, 12675, 11627, 10665,  9783,  8973,
+     8231,  7550,  6925,  6353,  5827,  5345,  4903,  4497,
+     4125,  3784,  3471,  3184,  2920,  2679,  2457,  2254,
+     2068,  1896,  1740,  1596,  1464,  1343,  1232,  1130,
+     1036,   950,   872,   800,   734,   673,   617,   566,
+      519,   476,   437,   401,   368,   337,   309,   284,
+      260,   239,   219,   201,   184,   169,   155,   142,
+      130,   120,   110,   101,    92,    85,    78,    71,
+       65,    60,    55,    50,    46,    42,    39,    36,
+       33,    30,    28,    25,    23,    21,    20,    18,
+       16,    15,    14,    13,    12,    11,    10,     9,
+        8,     8,     7,     6,     6,     5,     5,     4,
+        4,     4,     3,     3,     3,     3,     2,     2,
+        2,     2,     2,     2,     1,     1,     1,     1,
+        1,     1,     1,     1,     1,     1,     1,     1
+};
+
+//! Longest key-on and release parts of prerendered percussion samples, in milliseconds
+static const uint32_t g_dacDrumMaxPartMs = 1000;
+
 static inline void getOpnChannel(size_t     in_channel,
                                  size_t     &out_chip,
                                  uint8_t    &out_port,
@@ -204,23 +252,46 @@ static OpnInstMeta makeEmptyInstrument()
 
 const OpnInstMeta OPN2::m_emptyInstrument = makeEmptyInstrument();
 
-OPN2::OPN2() :
+OPN2::OPN2(const ADLMIDI_Allocator *allocator) :
+    m_numChannels(0),
+    m_numFmChannels(0),
+    m_regCapture(NULL),
+    m_regCaptureOffset(0),
     m_regLFOSetup(0),
     m_softPanningSup(false),
+    m_insBanks(allocator),
     m_numChips(1),
+    m_numChipGroups(1),
     m_scaleModulators(false),
     m_runAtPcmRate(false),
     m_softPanning(false),
+    m_extraChannels(false),
+    m_dacDrums(false),
     m_masterVolume(MasterVolumeDefault),
     m_musicMode(MODE_MIDI),
     m_volumeScale(VOLUME_Generic),
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    m_getFreq(&opnModel_genericFreqOPN2Fx),
+#else
     m_getFreq(&opnModel_genericFreqOPN2),
+#endif
     m_getVolume(&opnModel_genericVolume),
     m_channelAlloc(OPNMIDI_ChanAlloc_AUTO),
     m_lfoEnable(false),
     m_lfoFrequency(0),
     m_chipFamily(OPNChip_OPN2)
 {
+    std::memset(m_dacDrumVoices, 0, sizeof(m_dacDrumVoices));
+
+    if(allocator)
+        m_allocator = *allocator;
+    else
+    {
+        m_allocator.allocate = NULL;
+        m_allocator.release = NULL;
+        m_allocator.userData = NULL;
+    }
+
     m_insBankSetup.volumeModel = OPN2::VOLUME_Generic;
     m_insBankSetup.lfoEnable = false;
     m_insBankSetup.lfoFrequency = 0;
@@ -276,25 +347,64 @@ void OPN2::resetInstCache()
     // Reset caches once bank is changed
     opn2_fill_vector<const OpnTimbre*>(m_insCache, &c_defaultInsCache);
     opn2_fill_vector<bool>(m_insCacheModified, false);
+    clearDacDrums();
 }
 
 void OPN2::writeReg(size_t chip, uint8_t port, uint8_t index, uint8_t value)
 {
+    OPN_PERF_SAMPLED_SCOPE2(perf, m_perf, m_perf.chipRegs[chip], &m_perf.regWrites);
+    if(m_regCapture)
+        captureReg(chip, port, index, value);
     m_chips[chip]->writeReg(port, index, value);
 }
 
 void OPN2::writeRegI(size_t chip, uint8_t port, uint32_t index, uint32_t value)
 {
+    OPN_PERF_SAMPLED_SCOPE2(perf, m_perf, m_perf.chipRegs[chip], &m_perf.regWrites);
+    if(m_regCapture)
+        captureReg(chip, port, static_cast<uint8_t>(index), static_cast<uint8_t>(value));
     m_chips[chip]->writeReg(port, static_cast<uint8_t>(index), static_cast<uint8_t>(value));
 }
 
 void OPN2::writePan(size_t chip, uint32_t index, uint32_t value)
 {
+    OPN_PERF_SAMPLED_SCOPE2(perf, m_perf, m_perf.chipRegs[chip], &m_perf.regWrites);
+    if(m_regCapture)
+        captureReg(chip, OPNMIDI_RegCapture_PanPort, static_cast<uint16_t>(index), static_cast<uint8_t>(value));
     m_chips[chip]->writePan(static_cast<uint16_t>(index), static_cast<uint8_t>(value));
 }
 
+void OPN2::captureReg(size_t chip, uint8_t port, uint16_t addr, uint8_t value)
+{
+    OPN2_RegCaptureRing &ring = *m_regCapture;
+    if(!ring.records || ring.capacity == 0)
+        return;
+
+    const size_t head = ring.head % ring.capacity; // Only the library writes the head
+    const size_t next = (head + 1) % ring.capacity;
+    if(next == opn2_atomicLoad(&ring.tail) % ring.capacity)
+    {
+        ++ring.dropped;
+        return;
+    }
+
+    OPN2_RegWrite &rec = ring.records[head];
+    rec.sampleOffset = m_regCaptureOffset;
+    rec.chip = static_cast<OPN2_UInt8>(chip);
+    rec.port = port;
+    rec.addr = addr;
+    rec.value = value;
+    opn2_atomicStore(&ring.head, next);
+}
+
 void OPN2::noteOff(size_t c)
 {
+    if(m_channelCategory[c] != ChanCat_Regular)
+    {
+        extraNoteOff(c);
+        return;
+    }
+
     size_t      chip;
     uint8_t     port;
     uint32_t    cc;
@@ -303,7 +413,7 @@ void OPN2::noteOff(size_t c)
     writeRegI(chip, 0, 0x28, g_noteChannelsMap[ch4]);
 }
 
-void OPN2::noteOn(size_t c, double tone)
+void OPN2::noteOn(size_t c, OpnTone tone)
 {
     size_t      chip;
     uint8_t     port;
@@ -313,10 +423,16 @@ void OPN2::noteOn(size_t c, double tone)
     const OpnTimbre *adli = m_insCache[c];
     bool        cacheModded = m_insCacheModified[c];
 
+    if(m_channelCategory[c] != ChanCat_Regular)
+    {
+        extraNoteOn(c, tone);
+        return;
+    }
+
     getOpnChannel(c, chip, port, cc);
 
-    if(tone < 0.0)
-        tone = 0.0; // Lower than 0 is impossible!
+    if(tone < 0)
+        tone = 0; // Lower than 0 is impossible!
 
     ftone = m_getFreq(tone, &mul_offset);
 
@@ -366,24 +482,10 @@ void OPN2::touchNote(size_t c,
     const OpnTimbre *adli = m_insCache[c];
     uint8_t alg = adli->fbalg & 0x07;
     bool doBrightness = false;
+    bool isExtra = (m_channelCategory[c] != ChanCat_Regular);
 
-    const bool alg_do[8][4] =
-    {
-        /*
-         * Yeah, Operator 2 and 3 are seems swapped
-         * which we can see in the algorithm 4
-         */
-        //OP1   OP3   OP2    OP4
-        //30    34    38     3C
-        {false,false,false,true},//Algorithm #0:  W = 1 * 2 * 3 * 4
-        {false,false,false,true},//Algorithm #1:  W = (1 + 2) * 3 * 4
-        {false,false,false,true},//Algorithm #2:  W = (1 + (2 * 3)) * 4
-        {false,false,false,true},//Algorithm #3:  W = ((1 * 2) + 3) * 4
-        {false,false,true, true},//Algorithm #4:  W = (1 * 2) + (3 * 4)
-        {false,true ,true ,true},//Algorithm #5:  W = (1 * (2 + 3 + 4)
-        {false,true ,true ,true},//Algorithm #6:  W = (1 * 2) + 3 + 4
-        {true ,true ,true ,true},//Algorithm #7:  W = 1 + 2 + 3 + 4
-    };
+    if(isExtra)
+        alg = 7; // Level of extra channels is computed like for a single carrier
 
     OPNVolume_t vol =
     {
@@ -393,34 +495,48 @@ void OPN2::touchNote(size_t c,
         (uint_fast8_t)(m_masterVolume & 0x7F),
         (uint_fast8_t)alg,
         {
-            adli->OPS[OPERATOR1].data[1],
-            adli->OPS[OPERATOR2].data[1],
-            adli->OPS[OPERATOR3].data[1],
-            adli->OPS[OPERATOR4].data[1]
+            (uint_fast8_t)(isExtra ? 0 : adli->OPS[OPERATOR1].data[1]),
+            (uint_fast8_t)(isExtra ? 0 : adli->OPS[OPERATOR2].data[1]),
+            (uint_fast8_t)(isExtra ? 0 : adli->OPS[OPERATOR3].data[1]),
+            (uint_fast8_t)(isExtra ? 0 : adli->OPS[OPERATOR4].data[1])
         },
         {
-            alg_do[alg][0] || m_scaleModulators,
-            alg_do[alg][1] || m_scaleModulators,
-            alg_do[alg][2] || m_scaleModulators,
-            alg_do[alg][3] || m_scaleModulators
+            g_algCarriers[alg][0] || m_scaleModulators,
+            g_algCarriers[alg][1] || m_scaleModulators,
+            g_algCarriers[alg][2] || m_scaleModulators,
+            g_algCarriers[alg][3] || m_scaleModulators
         }
     };
 
     m_getVolume(&vol);
 
+    if(isExtra)
+    {
+        m_carrierTL[c] = vol.tlOp[OPERATOR4] & 127;
+        extraWriteLevel(c);
+        return;
+    }
+
     if(brightness != 127 && !isDrum)
     {
         brightness = opnModels_xgBrightnessToOPN(brightness);
         doBrightness = true;
     }
 
+    uint8_t carrierTL = 127;
+
     for(uint8_t op = 0; op < 4; op++)
     {
         if(doBrightness && !vol.doOp[op])
             vol.tlOp[op] = (127 - (brightness * (127 - (static_cast<uint32_t>(vol.tlOp[op]) & 127))) / 127);
 
+        if(g_algCarriers[alg][op] && (vol.tlOp[op] & 127) < carrierTL)
+            carrierTL = vol.tlOp[op] & 127;
+
         writeRegI(chip, port, 0x40 + cc + (4 * op), vol.tlOp[op]);
     }
+
+    m_carrierTL[c] = carrierTL;
 }
 
 void OPN2::setPatch(size_t c, const OpnTimbre *instrument)
@@ -436,6 +552,9 @@ void OPN2::setPatch(size_t c, const OpnTimbre *instrument)
     m_insCache[c] = instrument;
     m_insCacheModified[c] = false;
 
+    if(m_channelCategory[c] != ChanCat_Regular)
+        return; // Extra channels have fixed sounds
+
     for(uint8_t d = 0; d < 7; d++)
     {
         for(uint8_t op = 0; op < 4; op++)
@@ -449,6 +568,13 @@ void OPN2::setPatch(size_t c, const OpnTimbre *instrument)
 
 void OPN2::setPan(size_t c, uint8_t value)
 {
+    if(m_channelCategory[c] != ChanCat_Regular)
+    {
+        m_chanPan[c] = value;
+        extraWriteLevel(c);
+        return;
+    }
+
     size_t      chip;
     uint8_t     port;
     uint32_t    cc;
@@ -473,6 +599,7 @@ void OPN2::setPan(size_t c, uint8_t value)
     }
 
     m_regLFOSens[c] = val;
+    m_chanPan[c] = value;
 }
 
 void OPN2::silenceAll() // Silence all OPL channels.
@@ -483,11 +610,17 @@ void OPN2::silenceAll() // Silence all OPL channels.
 
     for(size_t c = 0; c < m_numChannels; ++c)
     {
-        getOpnChannel(c, chip, port, cc);
-
         noteOff(c);
         touchNote(c, 0);
 
+        if(m_channelCategory[c] != ChanCat_Regular)
+        {
+            m_insCache[c] = &c_defaultInsCache;
+            continue;
+        }
+
+        getOpnChannel(c, chip, port, cc);
+
         for(uint8_t op = 0; op < 4; op++)
         {
             writeRegI(chip, port, 0x30 + (0x10 * 1) + (op * 4) + cc, 0x7F);
@@ -496,6 +629,8 @@ void OPN2::silenceAll() // Silence all OPL channels.
 
         m_insCache[c] = &c_defaultInsCache;
     }
+
+    dacDrumsSilence();
 }
 
 void OPN2::commitLFOSetup()
@@ -559,11 +694,119 @@ void OPN2::clearChips()
     for(size_t i = 0; i < m_chips.size(); i++)
         m_chips[i].reset(NULL);
     m_chips.clear();
+    m_chipsArena.reset(NULL);
 }
 
-void OPN2::reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *audioTickHandler)
+// Constructs the chip in the given place, or only reports the size of it when place is NULL.
+// The size includes the emulator core placed after the wrapper, see OPN_CHIP_CORE.
+#define OPN_CHIP_CREATE(Type, args) \
+    size = opn_chipBlockSize<Type>(); \
+    if(place) \
+        chip = new(place) Type args
+
+// Storage of the emulator core in the given place
+#define OPN_CHIP_CORE(Type) opn_chipCore<Type>(place)
+
+OPNChipBase *OPN2::createChip(int emulator, OPNFamily family, size_t index, void *place, size_t &size)
+{
+    OPNChipBase *chip = NULL;
+#if !defined(OPNMIDI_MIDI2VGM)
+    ADL_UNUSED(index);
+#endif
+
+    switch(emulator)
+    {
+    default:
+        assert(false);
+        abort();
+#ifndef OPNMIDI_DISABLE_MAME_EMULATOR
+    case OPNMIDI_EMU_MAME:
+        OPN_CHIP_CREATE(MameOPN2, (family));
+        break;
+#endif
+#ifndef OPNMIDI_DISABLE_NUKED_EMULATOR
+    case OPNMIDI_EMU_NUKED_YM3438:
+        OPN_CHIP_CREATE(NukedOPN2, (family, true, OPN_CHIP_CORE(NukedOPN2)));
+        break;
+    case OPNMIDI_EMU_NUKED_YM2612:
+        OPN_CHIP_CREATE(NukedOPN2, (family, false, OPN_CHIP_CORE(NukedOPN2)));
+        break;
+#endif
+#ifndef OPNMIDI_DISABLE_GENS_EMULATOR
+    case OPNMIDI_EMU_GENS:
+        OPN_CHIP_CREATE(GensOPN2, (family, OPN_CHIP_CORE(GensOPN2)));
+        break;
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+    case OPNMIDI_EMU_YMFM_OPN2:
+        OPN_CHIP_CREATE(YmFmOPN2, (family, OPN_CHIP_CORE(YmFmOPN2)));
+        break;
+#endif
+//#ifndef OPNMIDI_DISABLE_GX_EMULATOR
+//    case OPNMIDI_EMU_GX:
+//        OPN_CHIP_CREATE(GXOPN2, (family));
+//        break;
+//#endif
+#ifndef OPNMIDI_DISABLE_NP2_EMULATOR
+    case OPNMIDI_EMU_NP2:
+        OPN_CHIP_CREATE(NP2OPNA<>, (family, OPN_CHIP_CORE(NP2OPNA<>)));
+        break;
+#endif
+#ifndef OPNMIDI_DISABLE_MAME_2608_EMULATOR
+    case OPNMIDI_EMU_MAME_2608:
+        OPN_CHIP_CREATE(MameOPNA, (family, OPN_CHIP_CORE(MameOPNA)));
+        break;
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+    case OPNMIDI_EMU_YMFM_OPNA:
+        OPN_CHIP_CREATE(YmFmOPNA, (family, OPN_CHIP_CORE(YmFmOPNA)));
+        break;
+#endif
+#ifdef OPNMIDI_ENABLE_OPN2_LLE_EMULATOR
+    case OPNMIDI_EMU_NUKED_YM2612_LLE:
+        OPN_CHIP_CREATE(Ym2612LLEOPN2, (family));
+        break;
+    case OPNMIDI_EMU_NUKED_YM3438_LLE:
+        OPN_CHIP_CREATE(Ymf276LLEOPN2, (family, false));
+        break;
+    case OPNMIDI_EMU_NUKED_YMF276_LLE:
+        OPN_CHIP_CREATE(Ymf276LLEOPN2, (family, true));
+        break;
+#endif
+#ifdef OPNMIDI_ENABLE_OPNA_LLE_EMULATOR
+    case OPNMIDI_EMU_NUKED_YM2608_LLE:
+        OPN_CHIP_CREATE(Ym2608LLEOPNA, (family));
+        break;
+#endif
+//#ifndef OPNMIDI_DISABLE_PMDWIN_EMULATOR
+//    case OPNMIDI_EMU_PMDWIN:
+//        OPN_CHIP_CREATE(PMDWinOPNA, (family, OPN_CHIP_CORE(PMDWinOPNA)));
+//        break;
+//#endif
+#ifdef OPNMIDI_MIDI2VGM
+    case OPNMIDI_VGM_DUMPER:
+        OPN_CHIP_CREATE(VGMFileDumper, (family, index, (index == 0 ? NULL : m_chips[0].get()), &m_vgmOutput));
+        if(chip && index == 0)//Set hooks for first chip only
+        {
+            m_loopStartHook = &VGMFileDumper::loopStartHook;
+            m_loopStartHookData = chip;
+            m_loopEndHook  = &VGMFileDumper::loopEndHook;
+            m_loopEndHookData = chip;
+        }
+        break;
+#endif
+    }
+
+    return chip;
+}
+
+#undef OPN_CHIP_CREATE
+#undef OPN_CHIP_CORE
+
+bool OPN2::reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *audioTickHandler)
 {
     bool rebuild_needed = m_curState.cmp(emulator, m_numChips, family);
+    bool ok = true;
 
     if(rebuild_needed)
         clearChips();
@@ -582,14 +825,20 @@ void OPN2::reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *a
         m_insCache.clear();
         m_insCacheModified.clear();
         m_regLFOSens.clear();
+        m_carrierTL.clear();
+        m_chanPan.clear();
+        m_extraKeyOn.clear();
         m_chips.clear();
-        m_chips.resize(m_numChips, AdlMIDI_SPtr<OPNChipBase>());
+        m_chips.resize(m_numChips);
     }
     else
     {
         opn2_fill_vector<const OpnTimbre*>(m_insCache, &c_defaultInsCache);
         opn2_fill_vector<bool>(m_insCacheModified, false);
         opn2_fill_vector<uint8_t>(m_regLFOSens, 0);
+        opn2_fill_vector<uint8_t>(m_carrierTL, 127);
+        opn2_fill_vector<uint8_t>(m_chanPan, 64);
+        opn2_fill_vector<bool>(m_extraKeyOn, false);
     }
 
 #ifdef OPNMIDI_MIDI2VGM
@@ -599,132 +848,112 @@ void OPN2::reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *a
     m_loopEndHookData = NULL;
 #endif
 
+    bool newRate = m_curState.cmp_rate(PCM_RATE);
+
+    // Percussion samples are made by the emulator at the output rate
+    if(rebuild_needed || newRate)
+        clearDacDrums();
+
     if(!rebuild_needed)
     {
-        bool newRate = m_curState.cmp_rate(PCM_RATE);
-
         for(size_t i = 0; i < m_numChips; ++i)
         {
             if(newRate)
                 m_chips[i]->setRate(PCM_RATE, m_chips[i]->nativeClockRate());
 
+            // Chips are kept, but the PCM rate mode could be toggled since they were made
+            m_chips[i]->setRunningAtPcmRate(m_runAtPcmRate);
+
             initChip(i);
         }
     }
-    else for(size_t i = 0; i < m_chips.size(); i++)
+    else if(!m_chips.empty())
     {
-        OPNChipBase *chip = NULL;
-
-        switch(emulator)
+        size_t chipSize = 0;
+        createChip(emulator, family, 0, NULL, chipSize);
+
+        // All chips share one block: better cache locality, and a single allocation to release
+        const size_t coreAlign = opn_chipCoreAlign;
+        const size_t align = sizeof(ADLMIDI_AllocHeader) > coreAlign ? sizeof(ADLMIDI_AllocHeader) : coreAlign;
+        size_t stride = ((chipSize + align - 1) / align) * align;
+        m_chipsArena.reset(static_cast<char *>(adlmidi_allocMem(&m_allocator, stride * m_chips.size())));
+        if(!m_chipsArena.get())
         {
-        default:
-            assert(false);
-            abort();
-#ifndef OPNMIDI_DISABLE_MAME_EMULATOR
-        case OPNMIDI_EMU_MAME:
-            chip = new MameOPN2(family);
-            break;
-#endif
-#ifndef OPNMIDI_DISABLE_NUKED_EMULATOR
-        case OPNMIDI_EMU_NUKED_YM3438:
-            chip = new NukedOPN2(family, true);
-            break;
-        case OPNMIDI_EMU_NUKED_YM2612:
-            chip = new NukedOPN2(family, false);
-            break;
-#endif
-#ifndef OPNMIDI_DISABLE_GENS_EMULATOR
-        case OPNMIDI_EMU_GENS:
-            chip = new GensOPN2(family);
-            break;
-#endif
-#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
-        case OPNMIDI_EMU_YMFM_OPN2:
-            chip = new YmFmOPN2(family);
-            break;
-#endif
-//#ifndef OPNMIDI_DISABLE_GX_EMULATOR
-//        case OPNMIDI_EMU_GX:
-//            chip = new GXOPN2(family);
-//            break;
-//#endif
-#ifndef OPNMIDI_DISABLE_NP2_EMULATOR
-        case OPNMIDI_EMU_NP2:
-            chip = new NP2OPNA<>(family);
-            break;
-#endif
-#ifndef OPNMIDI_DISABLE_MAME_2608_EMULATOR
-        case OPNMIDI_EMU_MAME_2608:
-            chip = new MameOPNA(family);
-            break;
-#endif
-#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
-        case OPNMIDI_EMU_YMFM_OPNA:
-            chip = new YmFmOPNA(family);
-            break;
-#endif
-#ifdef OPNMIDI_ENABLE_OPN2_LLE_EMULATOR
-        case OPNMIDI_EMU_NUKED_YM2612_LLE:
-            chip = new Ym2612LLEOPN2(family);
-            break;
-        case OPNMIDI_EMU_NUKED_YM3438_LLE:
-            chip = new Ymf276LLEOPN2(family, false);
-            break;
-        case OPNMIDI_EMU_NUKED_YMF276_LLE:
-            chip = new Ymf276LLEOPN2(family, true);
-            break;
-#endif
-#ifdef OPNMIDI_ENABLE_OPNA_LLE_EMULATOR
-        case OPNMIDI_EMU_NUKED_YM2608_LLE:
-            chip = new Ym2608LLEOPNA(family);
-            break;
-#endif
-//#ifndef OPNMIDI_DISABLE_PMDWIN_EMULATOR
-//        case OPNMIDI_EMU_PMDWIN:
-//            chip = new PMDWinOPNA(family);
-//            break;
-//#endif
-#ifdef OPNMIDI_MIDI2VGM
-        case OPNMIDI_VGM_DUMPER:
-            chip = new VGMFileDumper(family, i, (i == 0 ? NULL : m_chips[0].get()));
-            if(i == 0)//Set hooks for first chip only
-            {
-                m_loopStartHook = &VGMFileDumper::loopStartHook;
-                m_loopStartHookData = chip;
-                m_loopEndHook  = &VGMFileDumper::loopEndHook;
-                m_loopEndHookData = chip;
-            }
-            break;
-#endif
+            // Stay without chips, the next reset will try to make them again
+            m_chips.clear();
+            m_numChips = 0;
+            m_curState.clear();
+            ok = false;
         }
 
-        m_chips[i].reset(chip);
-        chip->setChipId(static_cast<uint32_t>(i));
-        chip->setRate(static_cast<uint32_t>(PCM_RATE), chip->nativeClockRate());
+        for(size_t i = 0; i < m_chips.size(); i++)
+        {
+            OPNChipBase *chip = createChip(emulator, family, i, m_chipsArena.get() + stride * i, chipSize);
+            m_chips[i].reset(chip);
+            chip->setChipId(static_cast<uint32_t>(i));
+            chip->setRate(static_cast<uint32_t>(PCM_RATE), chip->nativeClockRate());
 
-        if(m_runAtPcmRate)
-            chip->setRunningAtPcmRate(true);
+            if(m_runAtPcmRate)
+                chip->setRunningAtPcmRate(true);
 
 #if defined(ADLMIDI_AUDIO_TICK_HANDLER)
-        chip->setAudioTickHandlerInstance(audioTickHandler);
+            chip->setAudioTickHandlerInstance(audioTickHandler);
 #endif
-        family = chip->family();
+            family = chip->family();
+        }
     }
 
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    m_perf.setChips(m_chips.size());
+#endif
+    m_groupRenderer.prepare(*this);
+
     m_chipFamily = family;
-    m_numChannels = m_numChips * 6;
+    m_numFmChannels = m_numChips * FmChannelsPerChip;
+    m_numChannels = m_numFmChannels;
+
+    // The SSG and the rhythm unit of OPNA chips are following all FM channels
+    if(m_extraChannels && m_chipFamily == OPNChip_OPNA)
+        m_numChannels += m_numChips * ExtraChannelsPerChip;
+
     m_insCache.resize(m_numChannels, &c_defaultInsCache);
     m_insCacheModified.resize(m_numChannels, false);
     m_regLFOSens.resize(m_numChannels,    0);
+    m_carrierTL.resize(m_numChannels,     127);
+    m_chanPan.resize(m_numChannels,       64);
+    m_extraKeyOn.resize(m_numChannels,    false);
+
+    m_channelCategory.resize(m_numChannels);
+    for(size_t c = 0; c < m_numChannels; ++c)
+    {
+        if(c < m_numFmChannels)
+            m_channelCategory[c] = ChanCat_Regular;
+        else
+        {
+            uint32_t index = static_cast<uint32_t>((c - m_numFmChannels) % ExtraChannelsPerChip);
+            if(index < SsgChannelsPerChip)
+                m_channelCategory[c] = ChanCat_SSG;
+            else
+                m_channelCategory[c] = static_cast<char>(ChanCat_Rhythm_Bass + (index - SsgChannelsPerChip));
+        }
+    }
 
     switch(m_chipFamily)
     {
     default:
     case OPNChip_OPN2:
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        m_getFreq = &opnModel_genericFreqOPN2Fx;
+#else
         m_getFreq = &opnModel_genericFreqOPN2;
+#endif
         break;
     case OPNChip_OPNA:
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        m_getFreq = &opnModel_genericFreqOPNAFx;
+#else
         m_getFreq = &opnModel_genericFreqOPNA;
+#endif
         break;
     }
 
@@ -739,6 +968,7 @@ void OPN2::reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *a
     if(m_loopStartHook) // Post-initialization Loop Start hook (fix for loop edge passing clicks)
         m_loopStartHook(m_loopStartHookData);
 #endif
+    return ok;
 }
 
 void OPN2::initChip(size_t chip)
@@ -756,9 +986,367 @@ void OPN2::initChip(size_t chip)
     writeReg(chip, 0, 0x28, 0x04); //Note Off 3 channel
     writeReg(chip, 0, 0x28, 0x05); //Note Off 4 channel
     writeReg(chip, 0, 0x28, 0x06); //Note Off 5 channel
+
+    if(hasExtraChannels())
+    {
+        writeReg(chip, 0, 0x07, 0x38);  //SSG: tones on, noises off
+        writeReg(chip, 0, 0x08, 0x00);  //SSG: Mute A channel
+        writeReg(chip, 0, 0x09, 0x00);  //SSG: Mute B channel
+        writeReg(chip, 0, 0x0A, 0x00);  //SSG: Mute C channel
+        writeReg(chip, 0, 0x10, 0xBF);  //Rhythm: dump all voices
+        writeReg(chip, 0, 0x11, 0x3F);  //Rhythm: total level
+    }
+}
+
+size_t OPN2::getExtraChannel(size_t c, uint32_t &index) const
+{
+    size_t extra = c - m_numFmChannels;
+    index = static_cast<uint32_t>(extra % ExtraChannelsPerChip);
+    return extra / ExtraChannelsPerChip;
+}
+
+void OPN2::extraNoteOff(size_t c)
+{
+    uint32_t index;
+    size_t chip = getExtraChannel(c, index);
+
+    if(!m_extraKeyOn[c])
+        return;
+
+    m_extraKeyOn[c] = false;
+
+    // Rhythm voices are one-shot and fade by itself, so, only the SSG gets muted
+    if(m_channelCategory[c] == ChanCat_SSG)
+        writeRegI(chip, 0, 0x08 + index, 0x00);
+}
+
+void OPN2::extraNoteOn(size_t c, OpnTone tone)
+{
+    uint32_t index;
+    size_t chip = getExtraChannel(c, index);
+
+    if(m_channelCategory[c] == ChanCat_SSG)
+    {
+        uint32_t clock = m_chips[chip]->clockRate();
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        uint16_t period = opnModel_genericPeriodSSGFx(tone, clock);
+#else
+        uint16_t period = opnModel_genericPeriodSSG(tone, clock);
+#endif
+        writeRegI(chip, 0, 0x00 + (index * 2), period & 0xFF);
+        writeRegI(chip, 0, 0x01 + (index * 2), (period >> 8) & 0x0F);
+
+        if(!m_extraKeyOn[c])
+        {
+            m_extraKeyOn[c] = true;
+            extraWriteLevel(c);
+        }
+    }
+    else if(!m_extraKeyOn[c]) // Pitch updates must not re-trigger the drum
+    {
+        m_extraKeyOn[c] = true;
+        extraWriteLevel(c);
+        writeRegI(chip, 0, 0x10, 1 << (index - SsgChannelsPerChip));
+    }
+}
+
+void OPN2::extraWriteLevel(size_t c)
+{
+    uint32_t index;
+    size_t chip = getExtraChannel(c, index);
+    int level = m_carrierTL[c];
+
+    if(m_channelCategory[c] == ChanCat_SSG)
+    {
+        // SSG has 4-bit volume with ~3 dB steps, TL has 0.75 dB steps.
+        // Square wave is much louder than FM sine, so, attenuate it by 6 dB.
+        level = 13 - (level / 4);
+        if(level < 0)
+            level = 0;
+        if(m_extraKeyOn[c])
+            writeRegI(chip, 0, 0x08 + index, static_cast<uint32_t>(level));
+    }
+    else
+    {
+        // Rhythm instrument level has 5 bits with 0.75 dB steps
+        uint8_t value = m_chanPan[c];
+        uint32_t panning = 0;
+        level = 31 - level;
+        if(level < 0)
+            level = 0;
+        if(value  < 64 + 16) panning |= OPN_PANNING_LEFT;
+        if(value >= 64 - 16) panning |= OPN_PANNING_RIGHT;
+        writeRegI(chip, 0, 0x18 + (index - SsgChannelsPerChip), panning | static_cast<uint32_t>(level));
+    }
 }
 
 OPNFamily OPN2::chipFamily() const
 {
     return m_chipFamily;
 }
+
+bool OPN2::dacDrumsActive() const
+{
+#ifdef OPNMIDI_MIDI2VGM
+    if(m_curState.emulator == OPNMIDI_VGM_DUMPER)
+        return false; // Dumper produces no sound to render
+#endif
+    return m_dacDrums && !m_chips.empty();
+}
+
+bool OPN2::renderDacDrum(const OpnInstMeta *ins, int32_t tone, uint8_t velocity, std::vector<int16_t> &pcm)
+{
+    const OpnTimbre *adli = &ins->op[0];
+    const uint32_t rate = static_cast<uint32_t>(m_curState.pcm_rate);
+    size_t chipSize = 0;
+
+    pcm.clear();
+
+    createChip(m_curState.emulator, m_chipFamily, 0, NULL, chipSize);
+    AdlMIDI_UPtr<char, ADLMIDI_AllocFree> place(static_cast<char *>(adlmidi_allocMem(&m_allocator, chipSize)));
+    if(!place.get())
+        return false;
+
+    AdlMIDI_UPtr<OPNChipBase, ADLMIDI_DestructOnly<OPNChipBase> > chip(createChip(m_curState.emulator, m_chipFamily, 0, place.get(), chipSize));
+    chip->setRate(rate, chip->nativeClockRate());
+    if(m_runAtPcmRate)
+        chip->setRunningAtPcmRate(true);
+
+    chip->writeReg(0, 0x22, m_regLFOSetup);
+    chip->writeReg(0, 0x27, 0x00);
+    chip->writeReg(0, 0x2B, 0x00);
+    chip->writeReg(0, 0x28, 0x00);
+
+    for(uint8_t d = 0; d < 7; d++)
+    {
+        for(uint8_t op = 0; op < 4; op++)
+            chip->writeReg(0, 0x30 + (0x10 * d) + (op * 4), adli->OPS[op].data[d]);
+    }
+
+    chip->writeReg(0, 0xB0, adli->fbalg);
+    chip->writeReg(0, 0xB4, OPN_PANNING_BOTH | (adli->lfosens & 0x3F));
+
+    // Level of the band, channel and master volumes are applied while mixing
+    uint8_t alg = adli->fbalg & 0x07;
+    OPNVolume_t vol =
+    {
+        (uint_fast8_t)(velocity & 0x7F), 127, 127, 127,
+        (uint_fast8_t)alg,
+        {
+            adli->OPS[OPERATOR1].data[1],
+            adli->OPS[OPERATOR2].data[1],
+            adli->OPS[OPERATOR3].data[1],
+            adli->OPS[OPERATOR4].data[1]
+        },
+        {
+            g_algCarriers[alg][0] || m_scaleModulators,
+            g_algCarriers[alg][1] || m_scaleModulators,
+            g_algCarriers[alg][2] || m_scaleModulators,
+            g_algCarriers[alg][3] || m_scaleModulators
+        }
+    };
+    m_getVolume(&vol);
+
+    for(uint8_t op = 0; op < 4; op++)
+        chip->writeReg(0, 0x40 + (4 * op), vol.tlOp[op]);
+
+    uint32_t mul_offset = 0;
+    OpnTone noteTone = OPN_NOTE_TONE(tone + adli->noteOffset);
+    if(noteTone < 0)
+        noteTone = 0;
+    uint16_t ftone = m_getFreq(noteTone, &mul_offset);
+
+    for(uint8_t op = 0; op < 4 && mul_offset > 0; op++)
+    {
+        uint32_t reg = adli->OPS[op].data[0];
+        uint32_t mul = (reg & 0x0F) + mul_offset;
+        chip->writeReg(0, 0x30 + (op * 4), static_cast<uint8_t>((reg & 0xF0) | (mul > 0x0F ? 0x0F : mul)));
+    }
+
+    chip->writeReg(0, 0xA4, (ftone >> 8) & 0xFF);
+    chip->writeReg(0, 0xA0, ftone & 0xFF);
+    chip->writeReg(0, 0x28, 0xF0);
+
+    uint32_t keyOnMs = (ins->soundKeyOnMs > 0 && ins->soundKeyOnMs < g_dacDrumMaxPartMs) ? ins->soundKeyOnMs : g_dacDrumMaxPartMs;
+    uint32_t keyOffMs = (ins->soundKeyOffMs < g_dacDrumMaxPartMs) ? ins->soundKeyOffMs : g_dacDrumMaxPartMs;
+    size_t keyOnFrames = (static_cast<size_t>(rate) * keyOnMs) / 1000;
+    size_t totalFrames = keyOnFrames + (static_cast<size_t>(rate) * keyOffMs) / 1000;
+
+    // The drum that faded out is not rendered further
+    size_t silenceFrames = rate / 20;
+    size_t loudEnd = 0;
+
+    pcm.resize(totalFrames);
+
+    int32_t buf[2 * 256];
+    for(size_t pos = 0; pos < totalFrames && pos - loudEnd < silenceFrames;)
+    {
+        size_t block = totalFrames - pos;
+        if(block > 256)
+            block = 256;
+        if(pos < keyOnFrames && pos + block > keyOnFrames)
+            block = keyOnFrames - pos;
+        if(pos == keyOnFrames)
+            chip->writeReg(0, 0x28, 0x00);
+
+        std::memset(buf, 0, sizeof(buf));
+        chip->generate32(buf, block);
+        for(size_t i = 0; i < block; ++i)
+        {
+            int16_t frame = static_cast<int16_t>(opn2_cvtS16((buf[2 * i] + buf[(2 * i) + 1]) / 2));
+            pcm[pos + i] = frame;
+            if(frame <= -4 || frame >= 4)
+                loudEnd = pos + i + 1;
+        }
+        pos += block;
+    }
+
+    // Cut the silent tail
+    pcm.resize(loudEnd);
+    return true;
+}
+
+bool OPN2::prerenderDacDrum(size_t bank, size_t insNo, const OpnInstMeta *ins, int32_t tone, uint8_t velocity)
+{
+    DacDrumKey key;
+    key.bank = bank;
+    key.ins = insNo;
+    key.tone = tone;
+    key.velBand = (velocity & 0x7F) >> 5;
+
+    if(m_dacDrumCache.find(key) != m_dacDrumCache.end())
+        return true;
+
+    std::vector<int16_t> pcm;
+    try
+    {
+        // Render with the loudest velocity of the band, the rest is attenuated while mixing
+        if(!renderDacDrum(ins, tone, static_cast<uint8_t>((key.velBand << 5) | 0x1F), pcm))
+            return false;
+        // Failed drums are not cached, the next load will try again
+        m_dacDrumCache[key].swap(pcm);
+    }
+    catch(const std::bad_alloc &)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool OPN2::dacDrumOn(size_t bank, size_t insNo, int32_t tone, uint8_t velocity,
+                     uint8_t channelVolume, uint8_t channelExpression, uint8_t pan)
+{
+    DacDrumKey key;
+    key.bank = bank;
+    key.ins = insNo;
+    key.tone = tone;
+    key.velBand = (velocity & 0x7F) >> 5;
+
+    DacDrumCache::const_iterator it = m_dacDrumCache.find(key);
+    if(it == m_dacDrumCache.end())
+        return false;
+
+    const std::vector<int16_t> &pcm = it->second;
+    if(pcm.empty())
+        return true; // The drum is silent
+
+    // Difference between the levels of the note and of the rendered sample
+    OPNVolume_t vol = {(uint_fast8_t)(velocity & 0x7F), (uint_fast8_t)(channelVolume & 0x7F),
+                       (uint_fast8_t)(channelExpression & 0x7F), (uint_fast8_t)(m_masterVolume & 0x7F),
+                       7, {0, 0, 0, 0}, {1, 1, 1, 1}};
+    OPNVolume_t ref = {(uint_fast8_t)((velocity & 0x60) | 0x1F), 127, 127, 127,
+                       7, {0, 0, 0, 0}, {1, 1, 1, 1}};
+    m_getVolume(&vol);
+    m_getVolume(&ref);
+
+    int att = static_cast<int>(vol.tlOp[OPERATOR4] & 127) - static_cast<int>(ref.tlOp[OPERATOR4] & 127);
+    if(att < 0)
+        att = 0;
+    int32_t gain = g_attenuationGain[att];
+
+    // Oldest sample gets replaced when all voices are busy
+    DacDrumVoice *voice = &m_dacDrumVoices[0];
+    for(size_t i = 0; i < DacDrumVoices; ++i)
+    {
+        DacDrumVoice &v = m_dacDrumVoices[i];
+        if(!v.pcm)
+        {
+            voice = &v;
+            break;
+        }
+        if(v.pos > voice->pos)
+            voice = &v;
+    }
+
+    voice->pcm = &pcm[0];
+    voice->size = pcm.size();
+    voice->pos = 0;
+
+    if(m_softPanning)
+    {
+        int32_t l = ((127 - static_cast<int32_t>(pan & 0x7F)) * 32767) / 63;
+        int32_t r = (static_cast<int32_t>(pan & 0x7F) * 32767) / 63;
+        voice->gainL = (gain * (l > 32767 ? 32767 : l)) >> 15;
+        voice->gainR = (gain * (r > 32767 ? 32767 : r)) >> 15;
+    }
+    else
+    {
+        voice->gainL = (pan  < 64 + 16) ? gain : 0;
+        voice->gainR = (pan >= 64 - 16) ? gain : 0;
+    }
+
+    return true;
+}
+
+void OPN2::dacDrumsSilence()
+{
+    for(size_t i = 0; i < DacDrumVoices; ++i)
+        m_dacDrumVoices[i].pcm = NULL;
+}
+
+void OPN2::clearDacDrums()
+{
+    dacDrumsSilence();
+    m_dacDrumCache.clear();
+}
+
+void OPN2::clearDacDrums(size_t bank, size_t insNo)
+{
+    // Playing voices may point to the dropped samples
+    dacDrumsSilence();
+
+    DacDrumCache::iterator it = m_dacDrumCache.begin();
+    while(it != m_dacDrumCache.end())
+    {
+        if(it->first.bank == bank && it->first.ins == insNo)
+            m_dacDrumCache.erase(it++);
+        else
+            ++it;
+    }
+}
+
+void OPN2::mixDacDrums(int32_t *out, size_t frames)
+{
+    for(size_t i = 0; i < DacDrumVoices; ++i)
+    {
+        DacDrumVoice &v = m_dacDrumVoices[i];
+        if(!v.pcm)
+            continue;
+
+        size_t count = v.size - v.pos;
+        if(count > frames)
+            count = frames;
+
+        const int16_t *src = v.pcm + v.pos;
+        for(size_t f = 0; f < count; ++f)
+        {
+            out[2 * f]       += (src[f] * v.gainL) >> 15;
+            out[(2 * f) + 1] += (src[f] * v.gainR) >> 15;
+        }
+
+        v.pos += count;
+        if(v.pos >= v.size)
+            v.pcm = NULL;
+    }
+}
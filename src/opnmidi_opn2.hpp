@@ -29,6 +29,11 @@
 #include "opnmidi_private.hpp"
 #include "opnmidi_bankmap.h"
 #include "chips/opn_chip_family.h"
+#include "opnmidi_perf.hpp"
+#include "opnmidi_chipgroups.hpp"
+#ifdef OPNMIDI_MIDI2VGM
+#include "chips/vgm_file_dumper.h"
+#endif
 
 /**
  * @brief OPN2 Chip management class
@@ -39,12 +44,63 @@ class OPN2
 public:
     enum { PercussionTag = 1 << 15 };
 
+    /**
+     * @brief Category of the chip channel
+     */
+    enum ChanCat
+    {
+        //! FM channel
+        ChanCat_Regular     = 0,
+        //! DAC channel
+        ChanCat_DAC         = 1,
+        //! SSG square channel of OPNA
+        ChanCat_SSG         = 2,
+        //! Bass drum voice of the OPNA rhythm unit
+        ChanCat_Rhythm_Bass = 3,
+        //! Snare drum voice of the OPNA rhythm unit
+        ChanCat_Rhythm_Snare,
+        //! Top cymbal voice of the OPNA rhythm unit
+        ChanCat_Rhythm_Top,
+        //! Hi-hat voice of the OPNA rhythm unit
+        ChanCat_Rhythm_HiHat,
+        //! Tom-tom voice of the OPNA rhythm unit
+        ChanCat_Rhythm_Tom,
+        //! Rim shot voice of the OPNA rhythm unit
+        ChanCat_Rhythm_Rim
+    };
+
+    enum
+    {
+        //! Count of FM channels per chip
+        FmChannelsPerChip = 6,
+        //! Count of SSG channels per OPNA chip
+        SsgChannelsPerChip = 3,
+        //! Count of rhythm voices per OPNA chip
+        RhythmChannelsPerChip = 6,
+        //! Count of extra (non-FM) channels per OPNA chip
+        ExtraChannelsPerChip = SsgChannelsPerChip + RhythmChannelsPerChip
+    };
+
     //! Total number of chip channels between all running emulators
     uint32_t m_numChannels;
+    //! Number of FM channels, extra OPNA channels (if enabled) are following them
+    uint32_t m_numFmChannels;
     //! Just a padding. Reserved.
     char _padding[4];
-    //! Running chip emulators
-    std::vector<AdlMIDI_SPtr<OPNChipBase > > m_chips;
+    //! Running chip emulators, placed into m_chipsArena
+    std::vector<AdlMIDI_SPtr<OPNChipBase, ADLMIDI_DestructOnly<OPNChipBase> > > m_chips;
+    //! One contiguous block holding all chip emulator objects
+    AdlMIDI_UPtr<char, ADLMIDI_AllocFree> m_chipsArena;
+    //! Allocator of the player memory
+    ADLMIDI_Allocator m_allocator;
+    //! Register writes capture ring (owned by the caller), NULL when disabled
+    OPN2_RegCaptureRing *m_regCapture;
+    //! Count of sample frames generated since the capture start
+    uint64_t m_regCaptureOffset;
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+    //! Per-stage performance counters
+    OpnPerfCounters m_perf;
+#endif
 #ifdef OPNMIDI_MIDI2VGM
     //! Loop Start hook
     void (*m_loopStartHook)(void*);
@@ -54,6 +110,8 @@ public:
     void (*m_loopEndHook)(void*);
     //! Loop End hook data
     void *m_loopEndHookData;
+    //! Destination of the VGM dumper output
+    VGMFileDumper::Output m_vgmOutput;
 #endif
 private:
     //! Cached patch data, needed by Touch()
@@ -61,9 +119,89 @@ private:
     std::vector<bool> m_insCacheModified;
     //! Cached per-channel LFO sensitivity flags
     std::vector<uint8_t>        m_regLFOSens;
+    //! Cached per-channel total level of the loudest carrier operator
+    std::vector<uint8_t>        m_carrierTL;
+    //! Cached per-channel panning position
+    std::vector<uint8_t>        m_chanPan;
+    //! Is the note on at the extra (SSG or rhythm) channel?
+    std::vector<bool>           m_extraKeyOn;
     //! LFO setup registry cache
     uint8_t                     m_regLFOSetup;
 
+    /**
+     * @brief Get the chip and the index of the extra channel
+     * @param c Channel of chip (must be the extra channel)
+     * @param [out] index Index of SSG channel or the rhythm voice
+     * @return Index of the chip
+     */
+    size_t getExtraChannel(size_t c, uint32_t &index) const;
+
+    //! Key off the note at the extra channel
+    void extraNoteOff(size_t c);
+    //! Key on the note at the extra channel
+    void extraNoteOn(size_t c, OpnTone tone);
+    //! Write the level (and panning) of the extra channel
+    void extraWriteLevel(size_t c);
+
+    /**
+     * @brief Key of the prerendered percussion sample
+     */
+    struct DacDrumKey
+    {
+        //! Bank of the drum instrument (with the percussion tag)
+        size_t bank;
+        //! Number of the drum instrument in the bank
+        size_t ins;
+        //! Key of the drum note
+        int32_t tone;
+        //! Velocity band (velocity / 32)
+        uint32_t velBand;
+
+        bool operator<(const DacDrumKey &o) const
+        {
+            if(bank != o.bank)
+                return bank < o.bank;
+            if(ins != o.ins)
+                return ins < o.ins;
+            if(tone != o.tone)
+                return tone < o.tone;
+            return velBand < o.velBand;
+        }
+    };
+    typedef std::map<DacDrumKey, std::vector<int16_t> > DacDrumCache;
+    //! Mono percussion samples, rendered once by the same emulator at the output rate
+    DacDrumCache m_dacDrumCache;
+
+    /**
+     * @brief Playing percussion sample
+     */
+    struct DacDrumVoice
+    {
+        //! Sample data, NULL when the voice is free
+        const int16_t *pcm;
+        //! Count of frames in the sample
+        size_t size;
+        //! Current position in the sample
+        size_t pos;
+        //! Left gain in 1/32768 units
+        int32_t gainL;
+        //! Right gain in 1/32768 units
+        int32_t gainR;
+    };
+    enum { DacDrumVoices = 16 };
+    //! Percussion samples being played
+    DacDrumVoice m_dacDrumVoices[DacDrumVoices];
+
+    /**
+     * @brief Render the percussion note using the separate instance of the current emulator
+     * @param ins Instrument of the drum
+     * @param tone Key of the drum note
+     * @param velocity Note velocity
+     * @param [out] pcm Rendered mono sample
+     * @return false when out of memory
+     */
+    bool renderDacDrum(const OpnInstMeta *ins, int32_t tone, uint8_t velocity, std::vector<int16_t> &pcm);
+
     //! Does loaded emulator supports soft panning?
     bool m_softPanningSup;
 
@@ -136,17 +274,25 @@ public:
 
     //! Total number of running concurrent emulated chips
     uint32_t m_numChips;
+    //! Requested number of chip groups, every group has own MIDI ports and is rendered separately
+    uint32_t m_numChipGroups;
+    //! Renderer of the chip groups
+    OpnChipGroupRenderer m_groupRenderer;
     //! Carriers-only are scaled by default by volume level. This flag will tell to scale modulators too.
     bool m_scaleModulators;
     //! Run emulator at PCM rate if that possible. Reduces sounding accuracy, but decreases CPU usage on lower rates.
     bool m_runAtPcmRate;
     //! Enable soft panning
     bool m_softPanning;
+    //! Use SSG and rhythm parts of OPNA chips as extra channels
+    bool m_extraChannels;
+    //! Play percussion notes by prerendered PCM samples instead of FM channels
+    bool m_dacDrums;
     //! Master volume, controlled via SysEx (0...127)
     uint8_t m_masterVolume;
 
     //! Just a padding. Reserved.
-    char _padding2[3];
+    char _padding2[1];
 
     /**
      * @brief Music playing mode
@@ -183,7 +329,7 @@ public:
     } m_volumeScale;
 
     //! Frequency computation function
-    uint16_t (*m_getFreq)(double tone, uint32_t *mul_offset);
+    uint16_t (*m_getFreq)(OpnTone tone, uint32_t *mul_offset);
     //! OPL Volume computation function
     void (*m_getVolume)(struct OPNVolume_t *v);
 
@@ -194,9 +340,7 @@ public:
     bool m_lfoEnable;
     uint8_t m_lfoFrequency;
 
-    //! Category of the channel
-    /*! 1 = DAC, 0 = regular
-    */
+    //! Category of the channel (see ChanCat)
     std::vector<char> m_channelCategory;
 
     //! Chip family
@@ -204,8 +348,9 @@ public:
 
     /**
      * @brief C.O. Constructor
+     * @param allocator Allocator of the chips and banks memory, NULL to use the default heap
      */
-    OPN2();
+    explicit OPN2(const ADLMIDI_Allocator *allocator = NULL);
 
     /**
      * @brief C.O. Destructor
@@ -252,6 +397,15 @@ public:
      */
     void writePan(size_t chip, uint32_t index, uint32_t value);
 
+    /**
+     * @brief Append the register write into the capture ring
+     * @param chip Index of emulated chip
+     * @param port Port of the chip, or OPNMIDI_RegCapture_PanPort for soft panning
+     * @param addr Register address to write
+     * @param value Value to write
+     */
+    void captureReg(size_t chip, uint8_t port, uint16_t addr, uint8_t value);
+
     /**
      * @brief Off the note in specified chip channel
      * @param c Channel of chip (Emulated chip choosing by next formula: [c = ch + (chipId * 23)])
@@ -261,9 +415,9 @@ public:
     /**
      * @brief On the note in specified chip channel with specified frequency of the tone
      * @param c Channel of chip (Emulated chip choosing by next formula: [c = ch + (chipId * 23)])
-     * @param tone The tone to play (integer part - MIDI halftone, decimal part - relative bend offset)
+     * @param tone The tone to play (integer part - MIDI halftone, decimal part - relative bend offset, see OpnTone)
      */
-    void noteOn(size_t c, double tone);
+    void noteOn(size_t c, OpnTone tone);
 
     /**
      * @brief Change setup of instrument in specified chip channel
@@ -292,6 +446,26 @@ public:
      */
     void setPan(size_t c, uint8_t value);
 
+    /**
+     * @brief Get the total level of the loudest carrier operator set by the last touchNote() call
+     * @param c Channel of chip
+     * @return Attenuation level (0 is the loudest, 127 is silence)
+     */
+    uint8_t carrierLevel(size_t c) const
+    {
+        return m_carrierTL[c];
+    }
+
+    /**
+     * @brief Get the panning position set by the last setPan() call
+     * @param c Channel of chip
+     * @return Panning position (0 is left, 64 is center, 127 is right)
+     */
+    uint8_t panning(size_t c) const
+    {
+        return m_chanPan[c];
+    }
+
     /**
      * @brief Shut up all chip channels
      */
@@ -318,21 +492,134 @@ public:
      */
     void clearChips();
 
+    /**
+     * @brief Construct the chip emulator in the given place
+     * @param emulator Type of chip emulator
+     * @param family Chip family
+     * @param index Index of the chip
+     * @param place Memory for the chip object, or NULL to only get the size of it
+     * @param [out] size Size of the chip object
+     * @return Constructed chip, or NULL when place is NULL
+     */
+    OPNChipBase *createChip(int emulator, OPNFamily family, size_t index, void *place, size_t &size);
+
     /**
      * @brief Reset chip properties and initialize them
      * @param emulator Type of chip emulator
      * @param PCM_RATE Output sample rate to generate on output
      * @param audioTickHandler PCM-accurate clock hook
+     * @return false when chips can't be allocated, there are no chips left then
      */
-    void reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *audioTickHandler);
+    bool reset(int emulator, unsigned long PCM_RATE, OPNFamily family, void *audioTickHandler);
 
     void initChip(size_t chip);
 
+    /**
+     * @brief Are there SSG and rhythm channels following the FM channels?
+     * @return true if extra channels are in use
+     */
+    bool hasExtraChannels() const
+    {
+        return m_numChannels > m_numFmChannels;
+    }
+
+    /**
+     * @brief Get the chip which owns the channel
+     * @param c Channel number
+     * @return Index of the chip
+     */
+    size_t channelChip(size_t c) const
+    {
+        if(c < m_numFmChannels)
+            return c / FmChannelsPerChip;
+        return (c - m_numFmChannels) / ExtraChannelsPerChip;
+    }
+
+    /**
+     * @brief Get the count of chip groups in use
+     * @return Count of groups, never more than chips
+     */
+    uint32_t chipGroupsCount() const
+    {
+        uint32_t groups = m_numChipGroups;
+        if(groups > m_numChips)
+            groups = m_numChips;
+        return (groups > 0) ? groups : 1;
+    }
+
+    /**
+     * @brief Get the group of the chip, chips are split into groups by contiguous ranges
+     * @param chip Index of the chip
+     * @return Index of the group
+     */
+    uint32_t chipGroup(size_t chip) const
+    {
+        return static_cast<uint32_t>((chip * chipGroupsCount()) / m_numChips);
+    }
+
     /**
      * @brief Gets the family of current chips
      * @return the chip family
      */
     OPNFamily chipFamily() const;
+
+    /**
+     * @brief Are percussion notes played by prerendered samples?
+     * @return true if enabled and the current emulator can render them
+     */
+    bool dacDrumsActive() const;
+
+    /**
+     * @brief Render the sample of the percussion note unless it is cached already
+     *
+     * Rendering allocates memory and runs the emulator, so, it is done on the load only.
+     *
+     * @param bank Bank of the drum instrument (with the percussion tag)
+     * @param insNo Number of the drum instrument in the bank
+     * @param ins Instrument of the drum
+     * @param tone Key of the drum note (with drumTone applied)
+     * @param velocity Note velocity
+     * @return false when out of memory, nothing gets cached then
+     */
+    bool prerenderDacDrum(size_t bank, size_t insNo, const OpnInstMeta *ins, int32_t tone, uint8_t velocity);
+
+    /**
+     * @brief Start playing of the prerendered percussion sample
+     * @param bank Bank of the drum instrument (with the percussion tag)
+     * @param insNo Number of the drum instrument in the bank
+     * @param tone Key of the drum note (with drumTone applied)
+     * @param velocity Note velocity
+     * @param channelVolume Channel volume level
+     * @param channelExpression Channel expression level
+     * @param pan Channel panning (0...127)
+     * @return false when the sample was not prerendered, the note should be played by FM then
+     */
+    bool dacDrumOn(size_t bank, size_t insNo, int32_t tone, uint8_t velocity,
+                   uint8_t channelVolume, uint8_t channelExpression, uint8_t pan);
+
+    /**
+     * @brief Stop all playing percussion samples
+     */
+    void dacDrumsSilence();
+
+    /**
+     * @brief Drop all prerendered percussion samples
+     */
+    void clearDacDrums();
+
+    /**
+     * @brief Drop prerendered samples of the single drum instrument
+     * @param bank Bank of the drum instrument (with the percussion tag)
+     * @param insNo Number of the drum instrument in the bank
+     */
+    void clearDacDrums(size_t bank, size_t insNo);
+
+    /**
+     * @brief Mix playing percussion samples into the output
+     * @param out Interleaved stereo output
+     * @param frames Count of frames
+     */
+    void mixDacDrums(int32_t *out, size_t frames);
 };
 
 /**
@@ -0,0 +1,215 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPNMIDI_PERF_HPP
+#define OPNMIDI_PERF_HPP
+
+/*
+ * Optional per-stage performance counters.
+ *
+ * Compiled in only when OPNMIDI_ENABLE_PERF_COUNTERS is defined. Otherwise
+ * every OPN_PERF_* macro expands to nothing, so the rendering path stays
+ * exactly as it was.
+ */
+
+#ifdef OPNMIDI_ENABLE_PERF_COUNTERS
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Current monotonic time in nanoseconds
+ */
+extern uint64_t opn2_perfNow();
+
+/**
+ * @brief Accumulated time and call count of one stage
+ */
+struct OpnPerfCounter
+{
+    //! Time spent in the timed calls
+    uint64_t ns;
+    //! Count of all calls
+    uint64_t calls;
+    //! Count of calls which were timed, less than `calls` for sampled counters
+    uint64_t timed;
+
+    //! Time of all calls, extrapolated from the timed ones
+    double totalNs() const
+    {
+        if(timed == 0 || timed == calls)
+            return static_cast<double>(ns);
+        return static_cast<double>(ns) * static_cast<double>(calls) / static_cast<double>(timed);
+    }
+};
+
+/**
+ * @brief All counters of one player instance
+ */
+struct OpnPerfCounters
+{
+    //! Counters are accumulated only while this is set
+    bool enabled;
+    //! MIDI sequencer, including the event handlers it dispatches
+    OpnPerfCounter sequencer;
+    //! Synth logic between events: envelopes, vibrato, arpeggio, glide
+    OpnPerfCounter synth;
+    //! Chip emulation, all chips together
+    OpnPerfCounter chips;
+    //! Conversion into the output sample format
+    OpnPerfCounter output;
+    //! Register writes, all chips together
+    OpnPerfCounter regWrites;
+    //! Count of sample frames rendered
+    uint64_t frames;
+    //! Chip emulation per chip
+    std::vector<OpnPerfCounter> chipGen;
+    //! Register writes per chip
+    std::vector<OpnPerfCounter> chipRegs;
+
+    OpnPerfCounters() : enabled(false)
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        const OpnPerfCounter zero = {0, 0, 0};
+        sequencer = zero;
+        synth = zero;
+        chips = zero;
+        output = zero;
+        regWrites = zero;
+        frames = 0;
+        chipGen.assign(chipGen.size(), zero);
+        chipRegs.assign(chipRegs.size(), zero);
+    }
+
+    void setChips(size_t count)
+    {
+        const OpnPerfCounter zero = {0, 0, 0};
+        chipGen.resize(count, zero);
+        chipRegs.resize(count, zero);
+    }
+};
+
+/**
+ * @brief Adds the time of its own lifetime to a counter
+ */
+class OpnPerfScope
+{
+    OpnPerfCounter *m_counter;
+    OpnPerfCounter *m_extra;
+    uint64_t m_start;
+public:
+    OpnPerfScope(const OpnPerfCounters &perf, OpnPerfCounter &counter, OpnPerfCounter *extra = NULL) :
+        m_counter(perf.enabled ? &counter : NULL),
+        m_extra(extra),
+        m_start(perf.enabled ? opn2_perfNow() : 0)
+    {}
+
+    ~OpnPerfScope()
+    {
+        if(!m_counter)
+            return;
+        uint64_t ns = opn2_perfNow() - m_start;
+        m_counter->ns += ns;
+        ++m_counter->calls;
+        ++m_counter->timed;
+        if(m_extra)
+        {
+            m_extra->ns += ns;
+            ++m_extra->calls;
+            ++m_extra->timed;
+        }
+    }
+};
+
+/**
+ * @brief Counts every call, but times only one call of OpnPerfSampledScope::period
+ *
+ * Used for the short and frequent stages like the register writes where
+ * reading the clock twice per call would cost more than the call itself.
+ */
+class OpnPerfSampledScope
+{
+    OpnPerfCounter *m_counter;
+    OpnPerfCounter *m_extra;
+    uint64_t m_start;
+public:
+    enum { period = 64 };
+
+    OpnPerfSampledScope(const OpnPerfCounters &perf, OpnPerfCounter &counter, OpnPerfCounter *extra) :
+        m_counter(NULL),
+        m_extra(extra),
+        m_start(0)
+    {
+        if(!perf.enabled)
+            return;
+        if(((++counter.calls) % period) == 1)
+        {
+            m_counter = &counter;
+            m_start = opn2_perfNow();
+        }
+        if(m_extra)
+            ++m_extra->calls;
+    }
+
+    ~OpnPerfSampledScope()
+    {
+        if(!m_counter)
+            return;
+        uint64_t ns = opn2_perfNow() - m_start;
+        m_counter->ns += ns;
+        ++m_counter->timed;
+        if(m_extra)
+        {
+            m_extra->ns += ns;
+            ++m_extra->timed;
+        }
+    }
+};
+
+#define OPN_PERF_SCOPE(name, perf, counter) \
+    OpnPerfScope name((perf), (counter))
+#define OPN_PERF_SCOPE2(name, perf, counter, extra) \
+    OpnPerfScope name((perf), (counter), (extra))
+#define OPN_PERF_SAMPLED_SCOPE2(name, perf, counter, extra) \
+    OpnPerfSampledScope name((perf), (counter), (extra))
+#define OPN_PERF_FRAMES(perf, count) \
+    do { \
+        if((perf).enabled) \
+            (perf).frames += static_cast<uint64_t>(count); \
+    } while(0)
+
+#else /* OPNMIDI_ENABLE_PERF_COUNTERS */
+
+#define OPN_PERF_SCOPE(name, perf, counter)
+#define OPN_PERF_SCOPE2(name, perf, counter, extra)
+#define OPN_PERF_SAMPLED_SCOPE2(name, perf, counter, extra)
+#define OPN_PERF_FRAMES(perf, count) do {} while(0)
+
+#endif /* OPNMIDI_ENABLE_PERF_COUNTERS */
+
+#endif /* OPNMIDI_PERF_HPP */
@@ -65,6 +65,7 @@ typedef int32_t ssize_t;
 #include <string>
 #include <map>
 #include <set>
+#include <bitset>
 #include <new> // nothrow
 #include <cstdlib>
 #include <cstring>
@@ -138,6 +139,30 @@ class MIDIplay;
 #define OPN_MAX_CHIPS 100
 #define OPN_MAX_CHIPS_STR "100"
 
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+#include "models/opn_models.h" // OPN_TONE_FX_ONE
+
+//! Tone value in fixed-point cents, OPN_TONE_FX_ONE units per semi-tone
+typedef int32_t OpnTone;
+//! Time interval in 1/65536 fractions of the output PCM frame
+typedef int64_t OpnTickTime;
+//! Count of fraction bits in the OpnTickTime value
+#define OPN_TICK_TIME_SHIFT 16
+//! Tone value of the note number
+#define OPN_NOTE_TONE(note) (static_cast<OpnTone>(note) * OPN_TONE_FX_ONE)
+//! Gliding rate value of the disabled portamento
+#define OPN_GLIDE_NONE INT32_MAX
+#else
+//! Tone value in semi-tones, the decimal part is a detune
+typedef double OpnTone;
+//! Time interval in seconds
+typedef double OpnTickTime;
+//! Tone value of the note number
+#define OPN_NOTE_TONE(note) static_cast<OpnTone>(note)
+//! Gliding rate value of the disabled portamento
+#define OPN_GLIDE_NONE HUGE_VAL
+#endif
+
 extern std::string OPN2MIDI_ErrorString;
 
 /*
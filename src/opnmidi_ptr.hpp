@@ -25,6 +25,7 @@
 #define OPNMIDI_PTR_HPP_THING
 
 #include <algorithm>  // swap
+#include <new>        // placement new
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -46,6 +47,159 @@ struct ADLMIDI_CDelete
     void operator()(void *x) { free(x); }
 };
 
+/*
+    Allocation through the user-provided allocator
+ */
+struct ADLMIDI_Allocator
+{
+    void *(*allocate)(void *userData, size_t size);
+    void (*release)(void *userData, void *ptr);
+    void *userData;
+};
+
+/*
+    Prefix of every block, keeps the allocator to release the block
+    without knowing its owner. The union keeps the payload aligned as malloc() does.
+ */
+union ADLMIDI_AllocHeader
+{
+    struct Info
+    {
+        ADLMIDI_Allocator allocator;
+        size_t count;
+    } info;
+    long double alignLongDouble;
+    double      alignDouble;
+    void       *alignPointer;
+};
+
+/**
+ * @brief Allocate memory through the allocator, or with malloc() when allocator is NULL or unset
+ * @param allocator User allocator or NULL
+ * @param size Size of the memory block
+ * @param count Count of array elements to remember for the block
+ * @return Pointer to the block, NULL when out of memory
+ */
+inline void *adlmidi_allocMem(const ADLMIDI_Allocator *allocator, size_t size, size_t count = 1)
+{
+    ADLMIDI_AllocHeader *h;
+    size_t full = sizeof(ADLMIDI_AllocHeader) + size;
+
+    if(allocator && allocator->allocate)
+        h = reinterpret_cast<ADLMIDI_AllocHeader *>(allocator->allocate(allocator->userData, full));
+    else
+        h = reinterpret_cast<ADLMIDI_AllocHeader *>(malloc(full));
+
+    if(!h)
+        return NULL;
+
+    if(allocator && allocator->allocate)
+        h->info.allocator = *allocator;
+    else
+    {
+        h->info.allocator.allocate = NULL;
+        h->info.allocator.release = NULL;
+        h->info.allocator.userData = NULL;
+    }
+    h->info.count = count;
+
+    return h + 1;
+}
+
+/**
+ * @brief Release the memory allocated by adlmidi_allocMem()
+ */
+inline void adlmidi_freeMem(void *p)
+{
+    if(!p)
+        return;
+
+    ADLMIDI_AllocHeader *h = reinterpret_cast<ADLMIDI_AllocHeader *>(p) - 1;
+    if(h->info.allocator.release)
+        h->info.allocator.release(h->info.allocator.userData, h);
+    else
+        free(h);
+}
+
+/**
+ * @brief Construct an array of default-constructed elements through the allocator
+ */
+template <class T>
+T *adlmidi_allocArray(const ADLMIDI_Allocator *allocator, size_t count)
+{
+    T *p = reinterpret_cast<T *>(adlmidi_allocMem(allocator, sizeof(T) * count, count));
+    if(!p)
+        throw std::bad_alloc();
+    for(size_t i = 0; i < count; ++i)
+        new(p + i) T();
+    return p;
+}
+
+/**
+ * @brief Construct an object in the memory taken through the allocator
+ * @return Pointer to the object, NULL when out of memory
+ */
+template <class T>
+T *adlmidi_new(const ADLMIDI_Allocator *allocator)
+{
+    void *mem = adlmidi_allocMem(allocator, sizeof(T));
+    if(!mem)
+        return NULL;
+    try
+    {
+        return new(mem) T();
+    }
+    catch(...)
+    {
+        adlmidi_freeMem(mem);
+        throw;
+    }
+}
+
+template <class T, class Arg>
+T *adlmidi_new(const ADLMIDI_Allocator *allocator, Arg arg)
+{
+    void *mem = adlmidi_allocMem(allocator, sizeof(T));
+    if(!mem)
+        return NULL;
+    try
+    {
+        return new(mem) T(arg);
+    }
+    catch(...)
+    {
+        adlmidi_freeMem(mem);
+        throw;
+    }
+}
+
+template <class T>
+struct ADLMIDI_AllocDelete
+{
+    void operator()(T *x) { x->~T(); adlmidi_freeMem(x); }
+};
+template <class T>
+struct ADLMIDI_AllocArrayDelete
+{
+    void operator()(T *x)
+    {
+        size_t count = (reinterpret_cast<ADLMIDI_AllocHeader *>(x) - 1)->info.count;
+        for(size_t i = count; i-- > 0;)
+            x[i].~T();
+        adlmidi_freeMem(x);
+    }
+};
+struct ADLMIDI_AllocFree
+{
+    void operator()(void *x) { adlmidi_freeMem(x); }
+};
+//! For objects placed into a memory owned by someone else
+template <class T>
+struct ADLMIDI_DestructOnly
+{
+    void operator()(T *x) { x->~T(); }
+};
+
 /*
     Safe unique pointer for C++98, non-copyable but swappable.
 */
@@ -0,0 +1,301 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "opnmidi_renderahead.hpp"
+
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+
+#include <cstring>
+#include "opnmidi_atomic.hpp"
+
+#ifndef _WIN32
+#include <unistd.h> // usleep
+#endif
+
+static inline bool isAfter(size_t a, size_t b)
+{
+    // Positions are growing and may wrap around
+    return static_cast<ptrdiff_t>(a - b) > 0;
+}
+
+static void sleepShortly()
+{
+#ifdef _WIN32
+    Sleep(1);
+#else
+    usleep(1000);
+#endif
+}
+
+OpnRenderAhead::OpnRenderAhead(const ADLMIDI_Allocator *allocator) :
+    m_device(NULL),
+    m_outOffset(0),
+    m_frameSize(0),
+    m_blockFrames(0),
+    m_ringSize(0),
+    m_ringMask(0),
+    m_aheadBytes(0),
+    m_writePos(0),
+    m_readPos(0),
+    m_discardPos(0),
+    m_running(0),
+    m_ended(0)
+{
+    std::memset(&m_format, 0, sizeof(m_format));
+    if(allocator)
+        m_allocator = *allocator;
+    else
+        std::memset(&m_allocator, 0, sizeof(m_allocator));
+#ifdef _WIN32
+    m_thread = NULL;
+    InitializeCriticalSection(&m_lock);
+#else
+    pthread_mutex_init(&m_lock, NULL);
+#endif
+}
+
+OpnRenderAhead::~OpnRenderAhead()
+{
+    stop();
+#ifdef _WIN32
+    DeleteCriticalSection(&m_lock);
+#else
+    pthread_mutex_destroy(&m_lock);
+#endif
+}
+
+bool OpnRenderAhead::start(OPN2_MIDIPlayer *device, size_t aheadFrames, const OPNMIDI_AudioFormat &format)
+{
+    stop();
+
+    m_device = device;
+    m_format = format;
+    m_outOffset = format.sampleOffset;
+    m_format.sampleOffset = 2 * format.containerSize; // The ring keeps interleaved frames
+    m_frameSize = 2 * format.containerSize;
+    m_blockFrames = aheadFrames / 4;
+    if(m_blockFrames > 512)
+        m_blockFrames = 512;
+    else if(m_blockFrames < 32)
+        m_blockFrames = 32;
+
+    const size_t blockBytes = m_blockFrames * m_frameSize;
+    m_aheadBytes = aheadFrames * m_frameSize;
+    if(m_aheadBytes < blockBytes)
+        m_aheadBytes = blockBytes;
+
+    // Leave the space for one more full queue to refill it right after the flush
+    size_t ringSize = 1;
+    while(ringSize < (2 * m_aheadBytes + blockBytes))
+        ringSize <<= 1;
+
+    m_ring.reset(static_cast<uint8_t *>(adlmidi_allocMem(&m_allocator, ringSize)));
+    m_block.reset(static_cast<uint8_t *>(adlmidi_allocMem(&m_allocator, blockBytes)));
+    if(!m_ring.get() || !m_block.get())
+        return false;
+    m_ringSize = ringSize;
+    m_ringMask = ringSize - 1;
+    m_writePos = 0;
+    m_readPos = 0;
+    m_discardPos = 0;
+    m_ended = 0;
+    m_running = 1;
+
+#ifdef _WIN32
+    m_thread = CreateThread(NULL, 0, &renderThread, this, 0, NULL);
+    if(m_thread == NULL)
+#else
+    if(pthread_create(&m_thread, NULL, &renderThread, this) != 0)
+#endif
+    {
+        m_running = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void OpnRenderAhead::stop()
+{
+    if(!m_running)
+        return;
+
+    lock();
+    m_running = 0;
+    unlock(true);
+
+#ifdef _WIN32
+    WaitForSingleObject(m_thread, INFINITE);
+    CloseHandle(m_thread);
+    m_thread = NULL;
+#else
+    pthread_join(m_thread, NULL);
+#endif
+}
+
+size_t OpnRenderAhead::read(size_t frames, uint8_t *left, uint8_t *right)
+{
+    size_t r = m_readPos;
+    size_t d = opn2_atomicLoad(&m_discardPos);
+    if(isAfter(d, r))
+        r = d;
+
+    size_t w = opn2_atomicLoad(&m_writePos);
+    size_t got = (w - r) / m_frameSize;
+    if(got > frames)
+        got = frames;
+
+    const size_t cs = m_format.containerSize;
+    const uint8_t *ring = m_ring.get();
+
+    if(right == left + cs && m_outOffset == m_frameSize)
+    {
+        // Interleaved output, copy by two pieces at most
+        size_t bytes = got * m_frameSize;
+        size_t at = r & m_ringMask;
+        size_t first = m_ringSize - at;
+        if(first > bytes)
+            first = bytes;
+        std::memcpy(left, ring + at, first);
+        std::memcpy(left + first, ring, bytes - first);
+    }
+    else
+    {
+        size_t pos = r;
+        for(size_t i = 0; i < got; ++i)
+        {
+            uint8_t *dst[2] = {left + (i * m_outOffset), right + (i * m_outOffset)};
+            for(size_t c = 0; c < 2; ++c)
+            {
+                for(size_t b = 0; b < cs; ++b)
+                    dst[c][b] = ring[(pos++) & m_ringMask];
+            }
+        }
+    }
+
+    opn2_atomicStore(&m_readPos, r + (got * m_frameSize));
+    return got;
+}
+
+size_t OpnRenderAhead::queuedFrames() const
+{
+    size_t r = opn2_atomicLoad(&m_readPos);
+    size_t d = opn2_atomicLoad(&m_discardPos);
+    if(isAfter(d, r))
+        r = d;
+    return (opn2_atomicLoad(&m_writePos) - r) / m_frameSize;
+}
+
+bool OpnRenderAhead::atEnd() const
+{
+    return opn2_atomicLoad(&m_ended) != 0 && queuedFrames() == 0;
+}
+
+void OpnRenderAhead::lock()
+{
+#ifdef _WIN32
+    EnterCriticalSection(&m_lock);
+#else
+    pthread_mutex_lock(&m_lock);
+#endif
+}
+
+void OpnRenderAhead::unlock(bool flush)
+{
+    if(flush)
+    {
+        opn2_atomicStore(&m_discardPos, m_writePos);
+        opn2_atomicStore(&m_ended, 0); // The transport change may give more to play
+    }
+#ifdef _WIN32
+    LeaveCriticalSection(&m_lock);
+#else
+    pthread_mutex_unlock(&m_lock);
+#endif
+}
+
+#ifdef _WIN32
+DWORD WINAPI OpnRenderAhead::renderThread(LPVOID arg)
+{
+    static_cast<OpnRenderAhead *>(arg)->run();
+    return 0;
+}
+#else
+void *OpnRenderAhead::renderThread(void *arg)
+{
+    static_cast<OpnRenderAhead *>(arg)->run();
+    return NULL;
+}
+#endif
+
+void OpnRenderAhead::run()
+{
+    const size_t blockBytes = m_blockFrames * m_frameSize;
+    uint8_t *block = m_block.get();
+
+    for(;;)
+    {
+        lock();
+
+        if(!m_running)
+        {
+            unlock(false);
+            break;
+        }
+
+        size_t w = m_writePos;
+        size_t r = opn2_atomicLoad(&m_readPos);
+        size_t head = isAfter(m_discardPos, r) ? static_cast<size_t>(m_discardPos) : r;
+
+        // Queue is full, or the reader still didn't release the space
+        if((w - head) + blockBytes > m_aheadBytes || (w - r) + blockBytes > m_ringSize)
+        {
+            unlock(false);
+            sleepShortly();
+            continue;
+        }
+
+        int got = opn2_playFormat(m_device, static_cast<int>(m_blockFrames * 2),
+                                  block, block + m_format.containerSize, &m_format);
+        if(got > 0)
+        {
+            size_t bytes = static_cast<size_t>(got / 2) * m_frameSize;
+            size_t at = w & m_ringMask;
+            size_t first = m_ringSize - at;
+            if(first > bytes)
+                first = bytes;
+            std::memcpy(m_ring.get() + at, block, first);
+            std::memcpy(m_ring.get(), block + first, bytes - first);
+            opn2_atomicStore(&m_writePos, w + bytes);
+        }
+        else
+            opn2_atomicStore(&m_ended, 1);
+
+        unlock(false);
+
+        if(got <= 0)
+            sleepShortly(); // Song has ended, wait for the transport change
+    }
+}
+
+#endif /* OPNMIDI_ENABLE_RENDER_AHEAD */
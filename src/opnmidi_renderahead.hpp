@@ -0,0 +1,158 @@
+/*
+ * libOPNMIDI is a free Software MIDI synthesizer library with OPN2 (YM2612) emulation
+ *
+ * MIDI parser and player (Original code from ADLMIDI): Copyright (c) 2010-2014 Joel Yliluoma <bisqwit@iki.fi>
+ * OPNMIDI Library and YM2612 support:   Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Library is based on the ADLMIDI, a MIDI player for Linux and Windows with OPL3 emulation:
+ * http://iki.fi/bisqwit/source/adlmidi.html
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OPNMIDI_RENDERAHEAD_HPP
+#define OPNMIDI_RENDERAHEAD_HPP
+
+/*
+ * Asynchronous render-ahead mode.
+ *
+ * Compiled in only when OPNMIDI_ENABLE_RENDER_AHEAD is defined. The render
+ * thread plays the song by opn2_playFormat() and keeps the output ring filled.
+ * The ring has one producer (the render thread) and one consumer (the audio
+ * callback), the consumer never waits and never takes any locks.
+ *
+ * The render thread holds the transport lock while it renders a block and
+ * pushes it into the ring. Transport calls take the same lock, so, they never
+ * run together with rendering, and then discard everything queued before.
+ */
+
+#ifdef OPNMIDI_ENABLE_RENDER_AHEAD
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#endif
+
+#include "opnmidi.h"
+#include "opnmidi_ptr.hpp"
+
+class OpnRenderAhead
+{
+public:
+    /**
+     * @param allocator Allocator of the queue memory, NULL to use the default heap
+     */
+    explicit OpnRenderAhead(const ADLMIDI_Allocator *allocator);
+    ~OpnRenderAhead();
+
+    /**
+     * @brief Start the render thread
+     * @param device Instance of the library to play
+     * @param aheadFrames Count of frames to keep queued
+     * @param format Output sample format
+     * @return true on success, false when out of memory or the thread can't be made
+     */
+    bool start(OPN2_MIDIPlayer *device, size_t aheadFrames, const OPNMIDI_AudioFormat &format);
+
+    /**
+     * @brief Stop the render thread and drop all queued audio
+     */
+    void stop();
+
+    /**
+     * @brief Take queued audio, never blocks
+     * @param frames Count of frames to take
+     * @param left Left channel output
+     * @param right Right channel output
+     * @return Count of frames actually taken
+     */
+    size_t read(size_t frames, uint8_t *left, uint8_t *right);
+
+    /**
+     * @brief Count of frames ready to be taken
+     */
+    size_t queuedFrames() const;
+
+    /**
+     * @brief Has the song reached its end and was all its audio taken?
+     */
+    bool atEnd() const;
+
+    /**
+     * @brief Stop rendering until unlock() call
+     */
+    void lock();
+
+    /**
+     * @brief Resume rendering
+     * @param flush Drop everything queued before, so that the transport change is heard immediately
+     */
+    void unlock(bool flush);
+
+private:
+    OPN2_MIDIPlayer *m_device;
+    //! Format of rendering into the ring, always interleaved
+    OPNMIDI_AudioFormat m_format;
+    //! Distance between samples in the reader output
+    size_t m_outOffset;
+    //! Size of one frame in bytes
+    size_t m_frameSize;
+    //! Count of frames rendered at once
+    size_t m_blockFrames;
+
+    //! Allocator of the ring and the block
+    ADLMIDI_Allocator m_allocator;
+    //! Output ring, the size is a power of two
+    AdlMIDI_UPtr<uint8_t, ADLMIDI_AllocFree> m_ring;
+    size_t m_ringSize;
+    size_t m_ringMask;
+    //! Amount of bytes to keep queued, may be less than the ring fits
+    size_t m_aheadBytes;
+    //! Total count of bytes written, changed by the render thread only
+    volatile size_t m_writePos;
+    //! Total count of bytes read, changed by the reader only
+    volatile size_t m_readPos;
+    //! Everything before this position is dropped by the reader
+    volatile size_t m_discardPos;
+    //! Render thread keeps working while this flag is set
+    volatile int m_running;
+    //! The song has reached its end, nothing gets rendered anymore
+    volatile size_t m_ended;
+
+    //! Block rendered by the render thread
+    AdlMIDI_UPtr<uint8_t, ADLMIDI_AllocFree> m_block;
+
+#ifdef _WIN32
+    CRITICAL_SECTION m_lock;
+    HANDLE m_thread;
+    static DWORD WINAPI renderThread(LPVOID arg);
+#else
+    pthread_mutex_t m_lock;
+    pthread_t m_thread;
+    static void *renderThread(void *arg);
+#endif
+
+    void run();
+
+    OpnRenderAhead(const OpnRenderAhead &);
+    OpnRenderAhead &operator=(const OpnRenderAhead &);
+};
+
+#endif /* OPNMIDI_ENABLE_RENDER_AHEAD */
+
+#endif /* OPNMIDI_RENDERAHEAD_HPP */
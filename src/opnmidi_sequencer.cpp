@@ -29,6 +29,7 @@
 #include "midiseq/midi_sequencer_impl.hpp"
 
 #include "opnmidi_midiplay.hpp"
+#include "opnmidi_opn2.hpp"
 #include "opnmidi_private.hpp"
 
 /****************************************************
@@ -39,6 +40,15 @@ static void rtNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velo
 {
     OPNMIDIplay *context = reinterpret_cast<OPNMIDIplay *>(userdata);
     context->realTime_NoteOn(channel, note, velocity);
+    context->m_noteDurationUs = -1;
+}
+
+static void rtNoteDuration(void *userdata, uint8_t channel, uint8_t note, double seconds)
+{
+    OPNMIDIplay *context = reinterpret_cast<OPNMIDIplay *>(userdata);
+    ADL_UNUSED(channel);
+    ADL_UNUSED(note);
+    context->m_noteDurationUs = (seconds >= 0.0) ? static_cast<int64_t>(seconds * 1000000.0) : -1;
 }
 
 static void rtNoteOff(void *userdata, uint8_t channel, uint8_t note)
@@ -100,14 +110,92 @@ static size_t rtCurrentDevice(void *userdata, size_t track)
 static void rtSongBegin(void *userdata)
 {
     OPNMIDIplay *context = reinterpret_cast<OPNMIDIplay *>(userdata);
-    return context->realTime_ResetState();
+    return context->resetMainSongState();
 }
 /* NonStandard calls End */
 
 
-void OPNMIDIplay::initSequencerInterface()
+/****************************************************
+ *        Real-Time MIDI calls of song slots        *
+ ****************************************************/
+
+static size_t slotChannel(const OPNMIDIplay::SongSlot *slot, uint8_t channel)
+{
+    // All ports of the song are played by the same block of channels, it may be
+    // placed beyond the 8-bit channel number, so the sequencer gets no device offset
+    return static_cast<size_t>(channel % 16) + slot->channelBase;
+}
+
+static void rtSlotNoteOn(void *userdata, uint8_t channel, uint8_t note, uint8_t velocity)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_NoteOn(slotChannel(slot, channel), note, velocity);
+    slot->player->m_noteDurationUs = -1;
+}
+
+static void rtSlotNoteDuration(void *userdata, uint8_t channel, uint8_t note, double seconds)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    rtNoteDuration(slot->player, channel, note, seconds);
+}
+
+static void rtSlotNoteOff(void *userdata, uint8_t channel, uint8_t note)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_NoteOff(slotChannel(slot, channel), note);
+}
+
+static void rtSlotNoteAfterTouch(void *userdata, uint8_t channel, uint8_t note, uint8_t atVal)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_NoteAfterTouch(slotChannel(slot, channel), note, atVal);
+}
+
+static void rtSlotChannelAfterTouch(void *userdata, uint8_t channel, uint8_t atVal)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_ChannelAfterTouch(slotChannel(slot, channel), atVal);
+}
+
+static void rtSlotControllerChange(void *userdata, uint8_t channel, uint8_t type, uint8_t value)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_Controller(slotChannel(slot, channel), type, value);
+}
+
+static void rtSlotPatchChange(void *userdata, uint8_t channel, uint8_t patch)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_PatchChange(slotChannel(slot, channel), patch);
+}
+
+static void rtSlotPitchBend(void *userdata, uint8_t channel, uint8_t msb, uint8_t lsb)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->realTime_PitchBend(slotChannel(slot, channel), msb, lsb);
+}
+
+static void rtSlotSysEx(void *userdata, const uint8_t *msg, size_t size)
+{
+    // SysEx messages are not passed: they affect the whole synthesizer
+    ADL_UNUSED(userdata);
+    ADL_UNUSED(msg);
+    ADL_UNUSED(size);
+}
+
+static void rtSlotSongBegin(void *userdata)
+{
+    OPNMIDIplay::SongSlot *slot = reinterpret_cast<OPNMIDIplay::SongSlot *>(userdata);
+    slot->player->resetSlotState(static_cast<size_t>(slot - slot->player->m_songSlots));
+}
+/* Song slots calls End */
+
+
+bool OPNMIDIplay::initSequencerInterface()
 {
-    BW_MidiRtInterface *seq = new BW_MidiRtInterface;
+    BW_MidiRtInterface *seq = adlmidi_new<BW_MidiRtInterface>(&m_synth->m_allocator);
+    if(!seq)
+        return false;
     m_sequencerInterface.reset(seq);
 
     std::memset(seq, 0, sizeof(BW_MidiRtInterface));
@@ -129,6 +217,8 @@ void OPNMIDIplay::initSequencerInterface()
     /* NonStandard calls */
     seq->rt_deviceSwitch = rtDeviceSwitch;
     seq->rt_currentDevice = rtCurrentDevice;
+    if(m_synth->m_channelAlloc == OPNMIDI_ChanAlloc_LookAhead)
+        seq->rt_noteDuration = rtNoteDuration;
 
     seq->onSongStart = rtSongBegin;
     seq->onSongStart_userData = this;
@@ -138,15 +228,114 @@ void OPNMIDIplay::initSequencerInterface()
     seq->onloopEnd_userData = hooks.onLoopEnd_userData;
     /* NonStandard calls End */
 
+    /* Output stream format, also the time base of the sequencer */
+    seq->pcmSampleRate = static_cast<uint32_t>(m_setup.PCM_RATE);
+    seq->pcmFrameSize = 2 /*channels*/ * 2 /*size of one sample*/;
+
     m_sequencer->setInterface(seq);
+    return true;
+}
+
+bool OPNMIDIplay::initSlotInterface(size_t slot)
+{
+    SongSlot &s = m_songSlots[slot];
+    BW_MidiRtInterface *seq = adlmidi_new<BW_MidiRtInterface>(&m_synth->m_allocator);
+    if(!seq)
+        return false;
+    s.rtInterface.reset(seq);
+
+    std::memset(seq, 0, sizeof(BW_MidiRtInterface));
+
+    seq->onDebugMessage             = hooks.onDebugMessage;
+    seq->onDebugMessage_userData    = hooks.onDebugMessage_userData;
+
+    /* MIDI Real-Time calls */
+    seq->rtUserData = &s;
+    seq->rt_noteOn  = rtSlotNoteOn;
+    seq->rt_noteOff = rtSlotNoteOff;
+    seq->rt_noteAfterTouch = rtSlotNoteAfterTouch;
+    seq->rt_channelAfterTouch = rtSlotChannelAfterTouch;
+    seq->rt_controllerChange = rtSlotControllerChange;
+    seq->rt_patchChange = rtSlotPatchChange;
+    seq->rt_pitchBend = rtSlotPitchBend;
+    seq->rt_systemExclusive = rtSlotSysEx;
+
+    if(m_synth->m_channelAlloc == OPNMIDI_ChanAlloc_LookAhead)
+        seq->rt_noteDuration = rtSlotNoteDuration;
+
+    seq->onSongStart = rtSlotSongBegin;
+    seq->onSongStart_userData = &s;
+
+    seq->pcmSampleRate = static_cast<uint32_t>(m_setup.PCM_RATE);
+    seq->pcmFrameSize = 2 /*channels*/ * 2 /*size of one sample*/;
+
+    s.sequencer->setInterface(seq);
+    return true;
 }
 
-double OPNMIDIplay::Tick(double s, double granularity)
+void OPNMIDIplay::updateNoteDurations()
+{
+    // Only the look-ahead allocation uses durations of notes
+    bool lookAhead = (m_synth->m_channelAlloc == OPNMIDI_ChanAlloc_LookAhead);
+
+    if(m_sequencerInterface.get())
+    {
+        m_sequencerInterface->rt_noteDuration = lookAhead ? rtNoteDuration : NULL;
+        m_sequencer->updateNoteDurations();
+    }
+
+    for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+    {
+        SongSlot &s = m_songSlots[i];
+        if(!s.rtInterface.get())
+            continue;
+        s.rtInterface->rt_noteDuration = lookAhead ? rtSlotNoteDuration : NULL;
+        s.sequencer->updateNoteDurations();
+    }
+
+    m_noteDurationUs = -1;
+}
+
+OpnTickTime OPNMIDIplay::Tick(OpnTickTime s, OpnTickTime granularity)
 {
     MidiSequencer &seqr = *m_sequencer;
-    double ret = seqr.Tick(s, granularity);
+    OpnTickTime ret;
+    {
+        OPN_PERF_SCOPE(perfSeq, m_synth->m_perf, m_synth->m_perf.sequencer);
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+        ret = seqr.TickFrames(s, granularity);
+#else
+        ret = seqr.Tick(s, granularity);
+#endif
+
+        if(m_songSlotsUsed > 0)
+        {
+            // The nearest event of all playing songs
+            bool hasDelay = !seqr.positionAtEnd();
+
+            for(size_t i = 0; i < OPNMIDI_SONG_SLOTS; ++i)
+            {
+                SongSlot &slot = m_songSlots[i];
+                if(!slot.sequencer.get() || slot.paused || slot.sequencer->positionAtEnd())
+                    continue;
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+                OpnTickTime r = slot.sequencer->TickFrames(s, granularity);
+#else
+                OpnTickTime r = slot.sequencer->Tick(s, granularity);
+#endif
+                if(slot.sequencer->positionAtEnd())
+                    continue;
+                ret = hasDelay ? std::min(ret, r) : r;
+                hasDelay = true;
+            }
+        }
+    }
 
+#ifdef OPNMIDI_FIXED_POINT_CONTROL
+    s = static_cast<OpnTickTime>((static_cast<uint64_t>(s) * seqr.getTempoMultiplierFx()) >> OPN_TICK_TIME_SHIFT);
+#else
     s *= seqr.getTempoMultiplier();
+#endif
     TickIterators(s);
 
     return ret;
@@ -417,6 +417,117 @@ int WOPN_LoadInstFromMem(OPNIFile *file, void *mem, size_t length)
 #undef GO_FORWARD
 }
 
+/* Parse the bank file header and find offsets of the bank IDs and instruments data */
+static int WOPN_parseBankHead(WOPNFile *head, const uint8_t *mem, size_t length,
+                              size_t *ids_offset, size_t *ins_offset)
+{
+    uint16_t version = 0;
+    size_t offset = 0;
+    size_t banks_total;
+    uint16_t ins_size;
+
+    if(!mem)
+        return WOPN_ERR_NULL_POINTER;
+
+    {/* Magic number */
+        if(length < 11)
+            return WOPN_ERR_UNEXPECTED_ENDING;
+        if(memcmp(mem, wopn2_magic1, 11) == 0)
+            version = 1;
+        else if(memcmp(mem, wopn2_magic2, 11) != 0)
+            return WOPN_ERR_BAD_MAGIC;
+        offset += 11;
+    }
+
+    if(version == 0)
+    {/* Version code */
+        if(length < offset + 2)
+            return WOPN_ERR_UNEXPECTED_ENDING;
+        version = toUint16LE(mem + offset);
+        if(version > wopn_latest_version)
+            return WOPN_ERR_NEWER_VERSION;
+        offset += 2;
+    }
+
+    {/* Header of WOPN */
+        if(length < offset + 5)
+            return WOPN_ERR_UNEXPECTED_ENDING;
+        head->version = version;
+        head->banks_count_melodic = toUint16BE(mem + offset);
+        head->banks_count_percussion = toUint16BE(mem + offset + 2);
+        head->lfo_freq = mem[offset + 4] & 0xf;
+        head->chip_type = 0;
+        if(version >= 2)
+            head->chip_type = (mem[offset + 4] >> 4) & 1;
+        head->volume_model = 0;
+        head->banks_melodic = NULL;
+        head->banks_percussive = NULL;
+        offset += 5;
+    }
+
+    banks_total = (size_t)head->banks_count_melodic + head->banks_count_percussion;
+    *ids_offset = offset;
+    if(version >= 2)
+        offset += banks_total * 34;
+    *ins_offset = offset;
+
+    ins_size = (version > 1) ? WOPN_INST_SIZE_V2 : WOPN_INST_SIZE_V1;
+    if(length < offset + (banks_total * ins_size * 128))
+        return WOPN_ERR_UNEXPECTED_ENDING;
+
+    return WOPN_ERR_OK;
+}
+
+int WOPN_LoadBankInfoFromMem(WOPNFile *file, void *mem, size_t length, size_t *ins_offset)
+{
+    size_t ids_offset;
+    return WOPN_parseBankHead(file, (const uint8_t *)mem, length, &ids_offset, ins_offset);
+}
+
+int WOPN_LoadBankIdFromMem(void *mem, size_t length,
+                           uint8_t is_percussion, uint16_t bank_index,
+                           uint8_t *midi_msb, uint8_t *midi_lsb)
+{
+    WOPNFile head;
+    size_t ids_offset, ins_offset;
+    const uint8_t *cursor;
+    int err = WOPN_parseBankHead(&head, (const uint8_t *)mem, length, &ids_offset, &ins_offset);
+
+    if(err != WOPN_ERR_OK)
+        return err;
+
+    if(bank_index >= (is_percussion ? head.banks_count_percussion : head.banks_count_melodic))
+        return WOPN_ERR_INVALID_BANKS_COUNT;
+
+    if(head.version < 2)
+    {
+        /* Version 1 has no bank IDs, everything is zero */
+        *midi_msb = 0;
+        *midi_lsb = 0;
+        return WOPN_ERR_OK;
+    }
+
+    if(is_percussion)
+        bank_index += head.banks_count_melodic;
+
+    cursor = (const uint8_t *)mem + ids_offset + ((size_t)bank_index * 34);
+    *midi_lsb = cursor[32];
+    *midi_msb = cursor[33];
+
+    return WOPN_ERR_OK;
+}
+
+size_t WOPN_BankInstRecordSize(uint16_t version)
+{
+    return (version > 1) ? WOPN_INST_SIZE_V2 : WOPN_INST_SIZE_V1;
+}
+
+void WOPN_LoadBankInstRecord(WOPNInstrument *ins, const void *record, uint16_t version)
+{
+    memset(ins, 0, sizeof(WOPNInstrument));
+    WOPN_parseInstrument(ins, (uint8_t *)record, version, 1);
+}
+
 size_t WOPN_CalculateBankFileSize(WOPNFile *file, uint16_t version)
 {
     size_t final_size = 0;
@@ -231,6 +231,48 @@ extern WOPNFile *WOPN_LoadBankFromMem(void *mem, size_t length, int *error);
  */
 extern int WOPN_LoadInstFromMem(OPNIFile *file, void *mem, size_t length);
 
+/**
+ * @brief Load the header of WOPN bank file from the memory without parsing of the instruments data.
+ * Banks arrays of the destination structure are not allocated and will be set to NULL.
+ * @param file Pointer to destination WOPNFile structure to fill it with parsed header data.
+ * @param mem Pointer to memory block contains raw WOPN bank file data
+ * @param length Length of given memory block
+ * @param ins_offset Pointer to destination of the offset of the first instrument record in the memory block
+ * @return 0 if no errors occouped, or an error code of WOPN_ErrorCodes enumeration
+ */
+extern int WOPN_LoadBankInfoFromMem(WOPNFile *file, void *mem, size_t length, size_t *ins_offset);
+
+/**
+ * @brief Read MIDI bank number of the single bank from the WOPN bank file in the memory
+ * @param mem Pointer to memory block contains raw WOPN bank file data
+ * @param length Length of given memory block
+ * @param is_percussion Take the bank from percussion banks array
+ * @param bank_index Index of the bank entry in the array
+ * @param midi_msb Pointer to destination of MIDI Bank MSB code
+ * @param midi_lsb Pointer to destination of MIDI Bank LSB code
+ * @return 0 if no errors occouped, or an error code of WOPN_ErrorCodes enumeration
+ */
+extern int WOPN_LoadBankIdFromMem(void *mem, size_t length,
+                                  uint8_t is_percussion, uint16_t bank_index,
+                                  uint8_t *midi_msb, uint8_t *midi_lsb);
+
+/**
+ * @brief Get the size of one instrument record in the WOPN bank file.
+ * Records of all melodic banks and then of all percussion banks are following
+ * each other from the offset given by WOPN_LoadBankInfoFromMem(), 128 records per bank.
+ * @param version Version of the bank file
+ * @return Size of the record in bytes
+ */
+extern size_t WOPN_BankInstRecordSize(uint16_t version);
+
+/**
+ * @brief Parse the single instrument record of the WOPN bank file
+ * @param ins Pointer to destination instrument structure
+ * @param record Pointer to the instrument record of WOPN_BankInstRecordSize() bytes
+ * @param version Version of the bank file
+ */
+extern void WOPN_LoadBankInstRecord(WOPNInstrument *ins, const void *record, uint16_t version);
+
 /**
  * @brief Calculate the size of the output memory block
  * @param file Heap-allocated WOPN file data structure
@@ -0,0 +1,681 @@
+/*
+ * Checks that the audio path of the library does no heap allocations:
+ * once the song and the bank are loaded, opn2_play*, opn2_generate* and
+ * opn2_rt_* calls must never reach the global allocator.
+ * Also checks that a player made by opn2_initEx() returns all memory
+ * to the user allocator.
+ */
+
+#include <catch.hpp>
+#include <new>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#define OPNMIDI_UNSTABLE_API
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+static bool          s_counting = false;
+static unsigned long s_allocations = 0;
+
+static inline void countAllocation()
+{
+    if(s_counting)
+        s_allocations++;
+}
+
+#if defined(__GLIBC__)
+// Catch allocations made by C code (chip emulators, file readers) too
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+extern "C" void *malloc(size_t size)
+{
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    countAllocation();
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    countAllocation();
+    return __libc_realloc(ptr, size);
+}
+
+static inline void *rawAlloc(size_t size)
+{
+    return __libc_malloc(size);
+}
+
+static inline void rawRelease(void *p)
+{
+    __libc_free(p);
+}
+#else
+static void *rawAlloc(size_t size)
+{
+    return std::malloc(size);
+}
+
+static void rawRelease(void *p)
+{
+    std::free(p);
+}
+#endif
+
+/*
+ * Every replaced allocation function has its matching release function,
+ * all of them are going through rawAlloc() and rawRelease()
+ */
+static void *countedNew(std::size_t size)
+{
+    countAllocation();
+    return rawAlloc(size ? size : 1);
+}
+
+void *operator new(std::size_t size)
+{
+    void *p = countedNew(size);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    void *p = countedNew(size);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedNew(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedNew(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    rawRelease(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    rawRelease(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    rawRelease(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    rawRelease(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    rawRelease(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    rawRelease(p);
+}
+
+struct AllocationCounter
+{
+    AllocationCounter()
+    {
+        s_allocations = 0;
+        s_counting = true;
+    }
+
+    ~AllocationCounter()
+    {
+        s_counting = false;
+    }
+
+    unsigned long count() const
+    {
+        return s_allocations;
+    }
+};
+
+/*
+ * Song which touches most of the event handlers: meta texts, SysEx, missing banks
+ * and instruments, percussion, pedals, controllers, pitch bends and a loop
+ */
+static std::vector<uint8_t> makeSong()
+{
+    static const uint8_t gsReset[] = {0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7};
+    static const char text[] = "Allocation test";
+    std::vector<uint8_t> trk;
+
+    putMeta(trk, 0, 0x01, text, sizeof(text) - 1);
+
+    putVarLen(trk, 0);
+    trk.push_back(0xF0);
+    putVarLen(trk, sizeof(gsReset) - 1);
+    trk.insert(trk.end(), gsReset + 1, gsReset + sizeof(gsReset));
+
+    putEvent(trk, 0, 0xB0, 111, 0); // loopStart
+    for(uint8_t round = 0; round < 4; ++round)
+    {
+        // Switch between two MIDI ports
+        putPort(trk, (round & 1) ? "Port B" : "Port A");
+
+        for(uint8_t ch = 0; ch < 16; ++ch)
+        {
+            putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 0, static_cast<uint8_t>(round * 33));
+            putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 32, round);
+            putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(ch * 8 + round), 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 64, (round & 1) ? 127 : 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 10, static_cast<uint8_t>(ch * 8));
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(36 + ch * 3 + round), 100);
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(48 + ch * 3 + round), 90);
+        }
+        for(uint8_t ch = 0; ch < 16; ++ch)
+        {
+            putEvent(trk, 24, static_cast<uint8_t>(0xE0 | ch), 0, static_cast<uint8_t>(ch * 8));
+            putEvent(trk, 0, static_cast<uint8_t>(0xA0 | ch), static_cast<uint8_t>(36 + ch * 3 + round), 50);
+            putEvent(trk, 0, static_cast<uint8_t>(0xD0 | ch), 60, 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 1, 64);
+        }
+        for(uint8_t ch = 0; ch < 16; ++ch)
+        {
+            putEvent(trk, 24, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(36 + ch * 3 + round), 64);
+            putEvent(trk, 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(48 + ch * 3 + round), 64);
+        }
+    }
+    putEvent(trk, 96, 0xB0, 116, 0); // loopEnd
+
+    putEndOfTrack(trk, 0);
+
+    return makeMidiFile(std::vector<std::vector<uint8_t> >(1, trk));
+}
+
+static unsigned long s_debugMessages = 0;
+
+static void debugMessageHook(void *, const char *, ...)
+{
+    // Formatting the message is the business of the user, only count them
+    s_debugMessages++;
+}
+
+static OPN2_MIDIPlayer *openHookedPlayer(int emulator)
+{
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    // Missing banks and instruments get remembered only when a debug hook is set
+    opn2_setDebugMessageHook(device, debugMessageHook, NULL);
+    REQUIRE(opn2_switchEmulator(device, emulator) == 0);
+    REQUIRE(opn2_setNumChips(device, 2) == 0);
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+    return device;
+}
+
+TEST_CASE("MIDI file playback does not allocate", "[alloc-free]")
+{
+    OPN2_MIDIPlayer *device = openHookedPlayer(OPNMIDI_EMU_MAME);
+    std::vector<uint8_t> song = makeSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    opn2_setLoopEnabled(device, 1);
+
+    std::vector<short> buf(2048);
+    std::vector<float> fbuf(2048);
+    OPNMIDI_AudioFormat fmt;
+    fmt.type = OPNMIDI_SampleType_F32;
+    fmt.containerSize = sizeof(float);
+    fmt.sampleOffset = sizeof(float) * 2;
+
+    unsigned long allocations;
+    {
+        AllocationCounter counter;
+        // Long enough to pass the loop point several times
+        for(int i = 0; i < 400; ++i)
+            opn2_play(device, static_cast<int>(buf.size()), buf.data());
+        for(int i = 0; i < 100; ++i)
+            opn2_playFormat(device, static_cast<int>(fbuf.size()),
+                            reinterpret_cast<OPN2_UInt8 *>(fbuf.data()),
+                            reinterpret_cast<OPN2_UInt8 *>(fbuf.data() + 1), &fmt);
+        allocations = counter.count();
+    }
+    REQUIRE(allocations == 0);
+    REQUIRE(s_debugMessages > 0);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Real-time MIDI does not allocate", "[alloc-free]")
+{
+    OPN2_MIDIPlayer *device = openHookedPlayer(OPNMIDI_EMU_MAME);
+    static const OPN2_UInt8 gsReset[] = {0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7};
+    static const OPN2_UInt8 xgReset[] = {0xF0, 0x43, 0x10, 0x4C, 0x00, 0x00, 0x7E, 0x00, 0xF7};
+    static const OPN2_UInt8 gmReset[] = {0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7};
+    static const OPN2_UInt8 masterVolume[] = {0xF0, 0x7F, 0x7F, 0x04, 0x01, 0x00, 0x50, 0xF7};
+
+    std::vector<short> buf(512);
+    unsigned long allocations;
+    {
+        AllocationCounter counter;
+        opn2_rt_systemExclusive(device, gsReset, sizeof(gsReset));
+        opn2_rt_systemExclusive(device, xgReset, sizeof(xgReset));
+        opn2_rt_systemExclusive(device, gmReset, sizeof(gmReset));
+        opn2_rt_systemExclusive(device, masterVolume, sizeof(masterVolume));
+
+        for(int round = 0; round < 8; ++round)
+        {
+            for(OPN2_UInt8 ch = 0; ch < 16; ++ch)
+            {
+                // Missing banks and instruments get reported once
+                opn2_rt_bankChange(device, ch, static_cast<OPN2_SInt16>(round * 300 + ch));
+                opn2_rt_bankChangeMSB(device, ch, static_cast<OPN2_UInt8>(round * 10));
+                opn2_rt_bankChangeLSB(device, ch, static_cast<OPN2_UInt8>(round));
+                opn2_rt_patchChange(device, ch, static_cast<OPN2_UInt8>(ch * 8 + round));
+                opn2_rt_controllerChange(device, ch, 7, 100);
+                opn2_rt_controllerChange(device, ch, 64, (round & 1) ? 127 : 0);
+                for(OPN2_UInt8 n = 0; n < 12; ++n)
+                    opn2_rt_noteOn(device, ch, static_cast<OPN2_UInt8>(30 + n * 5 + round), 100);
+                opn2_rt_pitchBend(device, ch, static_cast<OPN2_UInt16>(round * 2000));
+                opn2_rt_pitchBendML(device, ch, 0x40, 0x00);
+                opn2_rt_noteAfterTouch(device, ch, 40, 50);
+                opn2_rt_channelAfterTouch(device, ch, 60);
+            }
+            opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+            for(OPN2_UInt8 ch = 0; ch < 16; ++ch)
+            {
+                for(OPN2_UInt8 n = 0; n < 12; ++n)
+                    opn2_rt_noteOff(device, ch, static_cast<OPN2_UInt8>(30 + n * 5 + round));
+            }
+            opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+        }
+
+        opn2_panic(device);
+        opn2_rt_resetState(device);
+        opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+        allocations = counter.count();
+    }
+    REQUIRE(allocations == 0);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Prerendered drums do not allocate", "[alloc-free]")
+{
+    OPN2_MIDIPlayer *device = openHookedPlayer(OPNMIDI_EMU_MAME);
+    REQUIRE(opn2_setDacDrums(device, 1) == 0);
+    std::vector<uint8_t> song = makeSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+
+    std::vector<short> buf(2048);
+    unsigned long allocations;
+    {
+        AllocationCounter counter;
+        for(int i = 0; i < 100; ++i)
+            opn2_play(device, static_cast<int>(buf.size()), buf.data());
+        // Drums of the song and the unknown ones
+        for(OPN2_UInt8 n = 27; n < 88; ++n)
+            opn2_rt_noteOn(device, 9, n, static_cast<OPN2_UInt8>(n + 30));
+        opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+        allocations = counter.count();
+    }
+    REQUIRE(allocations == 0);
+
+    opn2_close(device);
+}
+
+static size_t countBanks(OPN2_MIDIPlayer *device)
+{
+    size_t count = 0;
+    OPN2_Bank bank;
+    for(int r = opn2_getFirstBank(device, &bank); r == 0; r = opn2_getNextBank(device, &bank))
+        count++;
+    return count;
+}
+
+TEST_CASE("Sparse bank loading does not allocate", "[alloc-free]")
+{
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_switchEmulator(device, OPNMIDI_EMU_MAME) == 0);
+    REQUIRE(opn2_setNumChips(device, 2) == 0);
+    opn2_setSparseBankLoading(device, 1);
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+
+    // The bank made by the user must never get instruments of the bank file
+    OPN2_BankId userId = {0, 0, 17};
+    OPN2_Bank userBank;
+    REQUIRE(opn2_getBank(device, &userId, OPNMIDI_Bank_Create, &userBank) == 0);
+
+    std::vector<uint8_t> song = makeSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    const size_t songBanks = countBanks(device);
+
+    std::vector<short> buf(512);
+    unsigned long allocations;
+    {
+        AllocationCounter counter;
+        for(int i = 0; i < 50; ++i)
+            opn2_play(device, static_cast<int>(buf.size()), buf.data());
+
+        // Melodic banks of the file which aren't used by the song, and the user's bank
+        static const OPN2_UInt8 lsbs[] = {6, 8, 12, 14, 16, 17};
+        for(size_t b = 0; b < sizeof(lsbs); ++b)
+        {
+            OPN2_UInt8 ch = static_cast<OPN2_UInt8>(b);
+            opn2_rt_bankChangeMSB(device, ch, 0);
+            opn2_rt_bankChangeLSB(device, ch, lsbs[b]);
+            opn2_rt_patchChange(device, ch, static_cast<OPN2_UInt8>(b * 10));
+            opn2_rt_noteOn(device, ch, 60, 100);
+            opn2_rt_noteOn(device, ch, 64, 100);
+        }
+        opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+        opn2_panic(device);
+        allocations = counter.count();
+    }
+    REQUIRE(allocations == 0);
+    REQUIRE(countBanks(device) > songBanks);
+
+    OPN2_Instrument ins;
+    REQUIRE(opn2_getInstrument(device, &userBank, 70, &ins) == 0);
+    REQUIRE((ins.inst_flags & OPNMIDI_Ins_IsBlank) != 0);
+
+    // Banks used by real-time events only are dropped by the next song
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(countBanks(device) == songBanks);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Emulators do not allocate while rendering", "[alloc-free]")
+{
+    static const int emulators[] =
+    {
+        OPNMIDI_EMU_NUKED, OPNMIDI_EMU_GENS, OPNMIDI_EMU_YMFM_OPN2,
+        OPNMIDI_EMU_NP2, OPNMIDI_EMU_MAME_2608, OPNMIDI_EMU_YMFM_OPNA
+    };
+    std::vector<short> buf(512);
+
+    for(size_t e = 0; e < sizeof(emulators) / sizeof(int); ++e)
+    {
+        OPN2_MIDIPlayer *device = opn2_init(44100);
+        REQUIRE(device != NULL);
+        if(opn2_switchEmulator(device, emulators[e]) != 0)
+        {
+            opn2_close(device); // Not a part of this build
+            continue;
+        }
+        REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+
+        unsigned long allocations;
+        {
+            AllocationCounter counter;
+            for(OPN2_UInt8 ch = 0; ch < 16; ++ch)
+                opn2_rt_noteOn(device, ch, static_cast<OPN2_UInt8>(40 + ch), 100);
+            for(int i = 0; i < 8; ++i)
+                opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+            opn2_panic(device);
+            opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+            allocations = counter.count();
+        }
+        INFO("Emulator " << emulators[e]);
+        REQUIRE(allocations == 0);
+
+        opn2_close(device);
+    }
+}
+
+TEST_CASE("OPNA SSG and rhythm parts do not allocate", "[alloc-free]")
+{
+    static const int emulators[] =
+    {
+        OPNMIDI_EMU_MAME_2608, OPNMIDI_EMU_NP2, OPNMIDI_EMU_YMFM_OPNA
+    };
+    std::vector<short> buf(512);
+
+    for(size_t e = 0; e < sizeof(emulators) / sizeof(int); ++e)
+    {
+        OPN2_MIDIPlayer *device = opn2_init(44100);
+        REQUIRE(device != NULL);
+        if(opn2_switchEmulator(device, emulators[e]) != 0)
+        {
+            opn2_close(device); // Not a part of this build
+            continue;
+        }
+        REQUIRE(opn2_setOpnaExtraChannels(device, 1) == 0);
+        REQUIRE(opn2_setNumChips(device, 1) == 0);
+        REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+        opn2_setChipType(device, OPNMIDI_ChipType_OPNA);
+
+        // Let the piano to take SSG channels once FM ones are busy
+        OPN2_BankId id = {0, 0, 0};
+        OPN2_Bank bank;
+        OPN2_Instrument ins;
+        REQUIRE(opn2_getBank(device, &id, 0, &bank) == 0);
+        REQUIRE(opn2_getInstrument(device, &bank, 0, &ins) == 0);
+        ins.inst_flags |= OPNMIDI_Ins_SSG;
+        REQUIRE(opn2_setInstrument(device, &bank, 0, &ins) == 0);
+
+        unsigned long allocations;
+        {
+            AllocationCounter counter;
+            for(OPN2_UInt8 n = 0; n < 24; ++n)
+                opn2_rt_noteOn(device, 0, static_cast<OPN2_UInt8>(40 + n), 100);
+            for(OPN2_UInt8 n = 35; n < 60; ++n)
+                opn2_rt_noteOn(device, 9, n, 100);
+            for(int i = 0; i < 8; ++i)
+                opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+            opn2_panic(device);
+            opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+            allocations = counter.count();
+        }
+        INFO("Emulator " << emulators[e]);
+        REQUIRE(allocations == 0);
+
+        opn2_close(device);
+    }
+}
+
+struct ArenaStats
+{
+    unsigned long allocations;
+    unsigned long releases;
+    size_t bytes;
+};
+
+static void *arenaAllocate(void *userData, size_t size)
+{
+    ArenaStats *stats = reinterpret_cast<ArenaStats *>(userData);
+    stats->allocations++;
+    stats->bytes += size;
+    return std::malloc(size);
+}
+
+static void arenaRelease(void *userData, void *ptr)
+{
+    ArenaStats *stats = reinterpret_cast<ArenaStats *>(userData);
+    stats->releases++;
+    std::free(ptr);
+}
+
+TEST_CASE("Player memory comes from the user allocator", "[allocator]")
+{
+    ArenaStats stats = {0, 0, 0};
+    OPN2_Allocator allocator;
+    allocator.allocate = arenaAllocate;
+    allocator.release = arenaRelease;
+    allocator.userData = &stats;
+
+    OPN2_MIDIPlayer *device = opn2_initEx(44100, &allocator);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_switchEmulator(device, OPNMIDI_EMU_MAME) == 0);
+    REQUIRE(opn2_setNumChips(device, 4) == 0);
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+
+    std::vector<uint8_t> song = makeSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+
+    std::vector<short> buf(2048);
+    for(int i = 0; i < 20; ++i)
+        opn2_play(device, static_cast<int>(buf.size()), buf.data());
+
+    // Handle, player, synthesizer, sequencer, bank storage and the chips block
+    REQUIRE(stats.allocations >= 6);
+    REQUIRE(stats.releases < stats.allocations);
+
+    opn2_close(device);
+    REQUIRE(stats.releases == stats.allocations);
+
+    // Both functions are required
+    allocator.release = NULL;
+    REQUIRE(opn2_initEx(44100, &allocator) == NULL);
+}
+
+/*
+ * Bytes taken from the user allocator by switching to the emulator with
+ * the given count of chips, or 0 when the emulator is not a part of this build
+ */
+static size_t chipsBlockBytes(int emulator, int chips)
+{
+    ArenaStats stats = {0, 0, 0};
+    OPN2_Allocator allocator;
+    allocator.allocate = arenaAllocate;
+    allocator.release = arenaRelease;
+    allocator.userData = &stats;
+
+    OPN2_MIDIPlayer *device = opn2_initEx(44100, &allocator);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_setNumChips(device, chips) == 0);
+
+    stats.bytes = 0;
+    bool supported = opn2_switchEmulator(device, emulator) == 0;
+    size_t bytes = stats.bytes;
+    opn2_close(device);
+    return supported ? bytes : 0;
+}
+
+TEST_CASE("Emulator cores are placed into the chips block", "[allocator]")
+{
+    // Every of these cores keeps kilobytes of state
+    static const int emulators[] =
+    {
+        OPNMIDI_EMU_NUKED, OPNMIDI_EMU_YMFM_OPN2, OPNMIDI_EMU_NP2,
+        OPNMIDI_EMU_MAME_2608, OPNMIDI_EMU_YMFM_OPNA
+    };
+
+    for(size_t e = 0; e < sizeof(emulators) / sizeof(int); ++e)
+    {
+        size_t one = chipsBlockBytes(emulators[e], 1);
+        if(one == 0)
+            continue; // Not a part of this build
+        size_t many = chipsBlockBytes(emulators[e], 8);
+
+        INFO("Emulator " << emulators[e]);
+        REQUIRE(many > one);
+        REQUIRE((many - one) / 7 >= 2048);
+    }
+}
+
+struct LimitedArena
+{
+    ArenaStats stats;
+    //! Count of allocations to pass before all following ones fail
+    unsigned long limit;
+};
+
+static void *limitedAllocate(void *userData, size_t size)
+{
+    LimitedArena *arena = reinterpret_cast<LimitedArena *>(userData);
+    if(arena->stats.allocations >= arena->limit)
+        return NULL;
+    return arenaAllocate(&arena->stats, size);
+}
+
+static void limitedRelease(void *userData, void *ptr)
+{
+    LimitedArena *arena = reinterpret_cast<LimitedArena *>(userData);
+    arenaRelease(&arena->stats, ptr);
+}
+
+TEST_CASE("Allocator failures are reported and leak nothing", "[allocator]")
+{
+    LimitedArena arena;
+    OPN2_Allocator allocator;
+    allocator.allocate = limitedAllocate;
+    allocator.release = limitedRelease;
+    allocator.userData = &arena;
+
+    // Fail every allocation of the initialization one by one
+    OPN2_MIDIPlayer *device = NULL;
+    for(unsigned long limit = 0; !device; ++limit)
+    {
+        REQUIRE(limit < 1000);
+        std::memset(&arena.stats, 0, sizeof(arena.stats));
+        arena.limit = limit;
+        device = opn2_initEx(44100, &allocator);
+        if(!device)
+        {
+            INFO("Failed after " << limit << " allocations");
+            REQUIRE(arena.stats.releases == arena.stats.allocations);
+        }
+    }
+
+    REQUIRE(opn2_switchEmulator(device, OPNMIDI_EMU_MAME) == 0);
+
+    // Bank storage can't grow
+    arena.limit = arena.stats.allocations;
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == -1);
+    REQUIRE(opn2_reserveBanks(device, 1000) == -1);
+
+    arena.limit = ~0ul;
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+
+    // New chips can't be made: the call fails, the player stays usable and silent
+    arena.limit = arena.stats.allocations;
+    REQUIRE(opn2_setNumChips(device, 4) == -1);
+    REQUIRE(opn2_getNumChipsObtained(device) == 0);
+
+    std::vector<short> buf(2048, 1);
+    opn2_rt_noteOn(device, 0, 60, 127);
+    REQUIRE(opn2_generate(device, static_cast<int>(buf.size()), buf.data()) == static_cast<int>(buf.size()));
+    for(size_t i = 0; i < buf.size(); ++i)
+        REQUIRE(buf[i] == 0);
+    opn2_rt_noteOff(device, 0, 60);
+
+    std::vector<uint8_t> song = makeSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) < 0);
+
+    // Chips are made again once the memory is there
+    arena.limit = ~0ul;
+    REQUIRE(opn2_setNumChips(device, 2) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 2);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+
+    bool sound = false;
+    for(int i = 0; i < 20 && !sound; ++i)
+    {
+        opn2_play(device, static_cast<int>(buf.size()), buf.data());
+        for(size_t j = 0; j < buf.size() && !sound; ++j)
+            sound = buf[j] != 0;
+    }
+    REQUIRE(sound);
+
+    opn2_close(device);
+    REQUIRE(arena.stats.releases == arena.stats.allocations);
+}
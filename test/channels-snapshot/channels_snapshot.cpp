@@ -0,0 +1,164 @@
+/*
+ * Checks the snapshot of channels: counts are reported for any capacity of
+ * the caller's arrays, and states of chip and MIDI channels follow notes
+ * through key-on, sustain, release and the end of their sounding.
+ */
+
+#include <catch.hpp>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+static void generate(OPN2_MIDIPlayer *device, int frames)
+{
+    std::vector<short> buf(1024);
+    while(frames > 0)
+    {
+        opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+        frames -= static_cast<int>(buf.size() / 2);
+    }
+}
+
+struct Snapshot
+{
+    std::vector<OPN2_ChipChannelState> chip;
+    std::vector<OPN2_MidiChannelState> midi;
+
+    explicit Snapshot(OPN2_MIDIPlayer *device) :
+        chip(64), midi(16)
+    {
+        OPN2_ChannelsSnapshot s;
+        s.chipChannels = chip.data();
+        s.chipChannelsCapacity = chip.size();
+        s.midiChannels = midi.data();
+        s.midiChannelsCapacity = midi.size();
+        REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+        chip.resize(std::min(s.chipChannelsCount, chip.size()));
+        midi.resize(std::min(s.midiChannelsCount, midi.size()));
+    }
+
+    //! Find the only chip channel in the given state
+    const OPN2_ChipChannelState &only(int state) const
+    {
+        const OPN2_ChipChannelState *found = NULL;
+        for(size_t c = 0; c < chip.size(); ++c)
+        {
+            if(chip[c].state != state)
+                continue;
+            REQUIRE(found == NULL);
+            found = &chip[c];
+        }
+        REQUIRE(found != NULL);
+        return *found;
+    }
+};
+
+TEST_CASE("Counts are reported for any capacity", "[snapshot]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 2);
+
+    OPN2_ChannelsSnapshot s;
+    s.chipChannels = NULL;
+    s.chipChannelsCapacity = 0;
+    s.midiChannels = NULL;
+    s.midiChannelsCapacity = 0;
+    REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+    REQUIRE(s.chipChannelsCount == 12);
+    REQUIRE(s.midiChannelsCount == 16);
+
+    // Elements past the capacity are never touched
+    std::vector<OPN2_ChipChannelState> chip(4);
+    std::vector<OPN2_MidiChannelState> midi(3);
+    std::memset(chip.data(), 0xAA, chip.size() * sizeof(chip[0]));
+    std::memset(midi.data(), 0xAA, midi.size() * sizeof(midi[0]));
+    s.chipChannels = chip.data();
+    s.chipChannelsCapacity = 3;
+    s.midiChannels = midi.data();
+    s.midiChannelsCapacity = 2;
+    REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+    REQUIRE(s.chipChannelsCount == 12);
+    REQUIRE(s.midiChannelsCount == 16);
+    REQUIRE(chip[2].state == OPNMIDI_ChipChan_Free);
+    REQUIRE(chip[3].state == 0xAA);
+    REQUIRE(midi[1].volume == 100);
+    REQUIRE(midi[2].volume == 0xAA);
+
+    REQUIRE(opn2_getChannelsSnapshot(device, NULL) < 0);
+    opn2_close(device);
+}
+
+TEST_CASE("Chip channels follow the note", "[snapshot]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 2);
+
+    opn2_rt_patchChange(device, 2, 5);
+    opn2_rt_controllerChange(device, 2, 64, 127);
+    opn2_rt_noteOn(device, 2, 60, 100);
+    generate(device, 512);
+
+    {
+        Snapshot s(device);
+        const OPN2_ChipChannelState &c = s.only(OPNMIDI_ChipChan_KeyOn);
+        REQUIRE(c.midiChannel == 2);
+        REQUIRE(c.note == 60);
+        REQUIRE(c.instrument == 5);
+        REQUIRE(c.isPercussion == 0);
+        REQUIRE(c.notesCount == 1);
+        REQUIRE(s.midi[2].activeNotes == 1);
+        REQUIRE(s.midi[2].chipChannels == 1);
+        REQUIRE(s.midi[2].patch == 5);
+        REQUIRE(s.midi[2].sustain == 1);
+    }
+
+    // Held by the pedal
+    opn2_rt_noteOff(device, 2, 60);
+    {
+        Snapshot s(device);
+        const OPN2_ChipChannelState &c = s.only(OPNMIDI_ChipChan_Sustained);
+        REQUIRE(c.midiChannel == 2);
+        REQUIRE(c.note == 60);
+    }
+
+    // Released, the channel keeps reporting the recent note
+    opn2_rt_controllerChange(device, 2, 64, 0);
+    opn2_rt_noteOn(device, 2, 60, 100);
+    opn2_rt_noteOff(device, 2, 60);
+    {
+        Snapshot s(device);
+        const OPN2_ChipChannelState &c = s.only(OPNMIDI_ChipChan_Releasing);
+        REQUIRE(c.midiChannel == 2);
+        REQUIRE(c.note == 60);
+        REQUIRE(c.instrument == 5);
+        REQUIRE(s.midi[2].activeNotes == 0);
+        REQUIRE(s.midi[2].chipChannels == 0);
+    }
+
+    generate(device, 44100 * 10);
+    {
+        Snapshot s(device);
+        for(size_t c = 0; c < s.chip.size(); ++c)
+            REQUIRE(s.chip[c].state == OPNMIDI_ChipChan_Free);
+    }
+
+    opn2_close(device);
+}
+
+TEST_CASE("Percussion notes are reported by their keys", "[snapshot]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 2);
+
+    opn2_rt_noteOn(device, 9, 38, 100);
+    Snapshot s(device);
+    const OPN2_ChipChannelState &c = s.only(OPNMIDI_ChipChan_KeyOn);
+    REQUIRE(c.midiChannel == 9);
+    REQUIRE(c.instrument == 38);
+    REQUIRE(c.isPercussion == 1);
+    REQUIRE(s.midi[9].isPercussion == 1);
+    REQUIRE(s.midi[0].isPercussion == 0);
+
+    opn2_close(device);
+}
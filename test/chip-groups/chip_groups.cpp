@@ -0,0 +1,149 @@
+/*
+ * Checks chip groups: notes of every MIDI port are played only by chips
+ * of the group of this port, and groups rendered separately (by worker
+ * threads when they are built in) are mixed into the same output as all
+ * chips rendered together.
+ */
+
+#include <catch.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+/*
+ * Track of one MIDI port: the device name event, then one note with its own
+ * program on each of the given count of channels, held for two beats
+ */
+static std::vector<uint8_t> makeTrack(const char *port, uint8_t channels, uint8_t baseKey)
+{
+    std::vector<uint8_t> trk;
+
+    putPort(trk, port);
+
+    for(uint8_t ch = 0; ch < channels; ++ch)
+    {
+        putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(ch * 5), 0);
+        putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(baseKey + ch * 3), 100);
+    }
+    for(uint8_t ch = 0; ch < channels; ++ch)
+        putEvent(trk, ch == 0 ? 192 : 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(baseKey + ch * 3), 64);
+
+    putEndOfTrack(trk, 96);
+    return trk;
+}
+
+static std::vector<uint8_t> makeSong(uint8_t channels)
+{
+    std::vector<std::vector<uint8_t> > tracks;
+    tracks.push_back(makeTrack("Port A", channels, 48));
+    tracks.push_back(makeTrack("Port B", channels, 52));
+
+    return makeMidiFile(tracks);
+}
+
+static OPN2_MIDIPlayer *openSong(const std::vector<uint8_t> &song, int chips, int groups)
+{
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device);
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+    REQUIRE(opn2_setNumChips(device, chips) == 0);
+    REQUIRE(opn2_setChipGroups(device, groups) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    return device;
+}
+
+static std::vector<short> render(OPN2_MIDIPlayer *device, size_t frames)
+{
+    std::vector<short> out(frames * 2);
+    size_t done = 0;
+    while(done < out.size())
+    {
+        // Odd block size, so, renders are split into jobs of different sizes
+        int got = opn2_play(device, static_cast<int>(std::min<size_t>(1502, out.size() - done)), out.data() + done);
+        if(got <= 0)
+            break;
+        done += static_cast<size_t>(got);
+    }
+    out.resize(done);
+    return out;
+}
+
+static std::vector<OPN2_ChipChannelState> snapshot(OPN2_MIDIPlayer *device)
+{
+    std::vector<OPN2_ChipChannelState> chans(1024);
+    OPN2_ChannelsSnapshot snap = {};
+    snap.chipChannels = chans.data();
+    snap.chipChannelsCapacity = chans.size();
+    REQUIRE(opn2_getChannelsSnapshot(device, &snap) == 0);
+    chans.resize(std::min(snap.chipChannelsCount, chans.size()));
+    return chans;
+}
+
+TEST_CASE("Notes of the MIDI port stay on chips of its group", "[groups]")
+{
+    const int chips = 4, groups = 2;
+    const std::vector<uint8_t> song = makeSong(8);
+    OPN2_MIDIPlayer *device = openSong(song, chips, groups);
+    REQUIRE(opn2_getChipGroups(device) == groups);
+
+    render(device, 4410);
+    std::vector<OPN2_ChipChannelState> chans = snapshot(device);
+
+    size_t played[groups] = {0, 0};
+    for(size_t c = 0; c < static_cast<size_t>(chips) * 6 && c < chans.size(); ++c)
+    {
+        if(chans[c].state == OPNMIDI_ChipChan_Free)
+            continue;
+        const size_t chipGroup = (c / 6) * groups / chips;
+        const size_t portGroup = (chans[c].midiChannel / 16) % groups;
+        INFO("Chip channel " << c << ", MIDI channel " << int(chans[c].midiChannel));
+        REQUIRE(chipGroup == portGroup);
+        ++played[chipGroup];
+    }
+
+    // Both ports are playing all their notes
+    REQUIRE(played[0] == 8);
+    REQUIRE(played[1] == 8);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Output of chip groups matches one group", "[groups]")
+{
+    // Every port fits into the single chip, so, the allocation doesn't depend on groups
+    const std::vector<uint8_t> song = makeSong(6);
+
+    OPN2_MIDIPlayer *single = openSong(song, 2, 1);
+    OPN2_MIDIPlayer *split = openSong(song, 2, 2);
+    REQUIRE(opn2_getChipGroups(single) == 1);
+    REQUIRE(opn2_getChipGroups(split) == 2);
+
+    std::vector<short> a = render(single, 11025);
+    std::vector<short> b = render(split, 11025);
+
+    std::vector<OPN2_ChipChannelState> sa = snapshot(single);
+    std::vector<OPN2_ChipChannelState> sb = snapshot(split);
+    REQUIRE(sa.size() == sb.size());
+    for(size_t c = 0; c < sa.size(); ++c)
+    {
+        INFO("Chip channel " << c);
+        REQUIRE(sa[c].state == sb[c].state);
+        REQUIRE(sa[c].midiChannel == sb[c].midiChannel);
+        REQUIRE(sa[c].note == sb[c].note);
+    }
+
+    REQUIRE(std::count(a.begin(), a.end(), 0) < static_cast<std::ptrdiff_t>(a.size()));
+    REQUIRE(a == b);
+
+    // Rest of the song, after the change of groups while notes are playing
+    REQUIRE(opn2_setChipGroups(single, 2) == 0);
+    REQUIRE(opn2_setChipGroups(split, 1) == 0);
+    REQUIRE(render(single, 22050) == render(split, 22050));
+
+    opn2_close(single);
+    opn2_close(split);
+}
@@ -0,0 +1,131 @@
+/*
+ * Builds small Standard MIDI Files in memory for tests and benchmarks.
+ * When included after <catch.hpp> and <opnmidi.h>, also gives openPlayer()
+ * which makes a player with the default bank.
+ */
+
+#ifndef OPNMIDI_TEST_MIDI_BUILDER_HPP
+#define OPNMIDI_TEST_MIDI_BUILDER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#ifndef DEFAULT_BANK_PATH
+#define DEFAULT_BANK_PATH "fm_banks/xg.wopn"
+#endif
+
+static inline void putVarLen(std::vector<uint8_t> &out, uint32_t v)
+{
+    uint8_t buf[5];
+    int n = 0;
+    buf[n++] = static_cast<uint8_t>(v & 0x7F);
+    while((v >>= 7) != 0)
+        buf[n++] = static_cast<uint8_t>(0x80 | (v & 0x7F));
+    while(n > 0)
+        out.push_back(buf[--n]);
+}
+
+static inline void putBE32(std::vector<uint8_t> &out, uint32_t v)
+{
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+/*
+ * Channel event, program changes and channel pressures take one data byte
+ */
+static inline void putEvent(std::vector<uint8_t> &trk, uint32_t delta, uint8_t a, uint8_t b, uint8_t c)
+{
+    putVarLen(trk, delta);
+    trk.push_back(a);
+    trk.push_back(b);
+    if((a & 0xE0) != 0xC0)
+        trk.push_back(c);
+}
+
+static inline void putMeta(std::vector<uint8_t> &trk, uint32_t delta, uint8_t type, const void *data, size_t size)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    putVarLen(trk, delta);
+    trk.push_back(0xFF);
+    trk.push_back(type);
+    putVarLen(trk, static_cast<uint32_t>(size));
+    trk.insert(trk.end(), bytes, bytes + size);
+}
+
+//! Selects the MIDI port of the next events
+static inline void putPort(std::vector<uint8_t> &trk, const std::string &name)
+{
+    putMeta(trk, 0, 0x09, name.data(), name.size());
+}
+
+static inline void putTempo(std::vector<uint8_t> &trk, uint32_t delta, uint32_t usPerQuarter)
+{
+    const uint8_t tempo[3] =
+    {
+        static_cast<uint8_t>(usPerQuarter >> 16),
+        static_cast<uint8_t>(usPerQuarter >> 8),
+        static_cast<uint8_t>(usPerQuarter)
+    };
+    putMeta(trk, delta, 0x51, tempo, 3);
+}
+
+static inline void putEndOfTrack(std::vector<uint8_t> &trk, uint32_t delta)
+{
+    putMeta(trk, delta, 0x2F, NULL, 0);
+}
+
+/*
+ * Makes a file of given finished tracks, format 0 for a single track
+ * and format 1 otherwise. At the default tempo 96 ticks are 0.5 seconds.
+ */
+static inline std::vector<uint8_t> makeMidiFile(const std::vector<std::vector<uint8_t> > &tracks, uint16_t division = 96)
+{
+    std::vector<uint8_t> out;
+    const char hdr[] = "MThd";
+    out.insert(out.end(), hdr, hdr + 4);
+    putBE32(out, 6);
+    out.push_back(0); out.push_back(tracks.size() > 1 ? 1 : 0); // Format
+    out.push_back(static_cast<uint8_t>(tracks.size() >> 8));
+    out.push_back(static_cast<uint8_t>(tracks.size()));
+    out.push_back(static_cast<uint8_t>(division >> 8));
+    out.push_back(static_cast<uint8_t>(division));
+    for(size_t i = 0; i < tracks.size(); ++i)
+    {
+        const char mtrk[] = "MTrk";
+        out.insert(out.end(), mtrk, mtrk + 4);
+        putBE32(out, static_cast<uint32_t>(tracks[i].size()));
+        out.insert(out.end(), tracks[i].begin(), tracks[i].end());
+    }
+    return out;
+}
+
+//! Ends the single track 96 ticks after its last event and makes a format 0 file
+static inline std::vector<uint8_t> makeMidiFile(std::vector<uint8_t> trk, uint16_t division = 96)
+{
+    putEndOfTrack(trk, 96);
+    return makeMidiFile(std::vector<std::vector<uint8_t> >(1, trk), division);
+}
+
+#if defined(REQUIRE) && defined(OPNMIDI_H)
+/*
+ * Player at 44100 Hz with the default bank, the count of chips
+ * is left by default when it's zero
+ */
+static inline OPN2_MIDIPlayer *openPlayer(int emulator = OPNMIDI_EMU_MAME, int chips = 0)
+{
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_switchEmulator(device, emulator) == 0);
+    if(chips > 0)
+        REQUIRE(opn2_setNumChips(device, chips) == 0);
+    REQUIRE(opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0);
+    return device;
+}
+#endif
+
+#endif // OPNMIDI_TEST_MIDI_BUILDER_HPP
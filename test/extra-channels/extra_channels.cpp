@@ -0,0 +1,169 @@
+/*
+ * Allocation of OPNA extra channels: SSG channels are taken by notes of
+ * SSG instruments only, and GM percussion keys are played by the rhythm
+ * voices of the rhythm unit.
+ */
+
+#include <catch.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "opnmidi_midiplay.hpp"
+#include "opnmidi_opn2.hpp"
+#include "opnmidi_private.hpp"
+
+typedef std::vector<OPN2_ChipChannelState> ChipStates;
+
+//! Rhythm voices of GM percussion keys 35...59, 0 - played by FM
+static const int c_gmRhythm[25] =
+{
+    1, 1, 6, 2, 2, 2, 5, 4, 5, 4, 5, 4, 5, /* 35...47 */
+    5, 3, 5, 3, 3, 3, 4, 3, 6, 3, 0, 3     /* 48...59 */
+};
+
+static void setupOpna(OPNMIDIplay &play, unsigned chips)
+{
+    REQUIRE(play.LoadBank(DEFAULT_BANK_PATH));
+    play.m_setup.emulator = OPNMIDI_EMU_NUKED;
+    play.m_setup.chipType = OPNChip_OPNA;
+    play.m_setup.extraChannels = true;
+    play.m_setup.numChips = chips;
+    REQUIRE(play.applySetup());
+    REQUIRE(play.m_synth->hasExtraChannels());
+    REQUIRE(play.m_synth->m_numChannels == chips * (Synth::FmChannelsPerChip + Synth::ExtraChannelsPerChip));
+}
+
+static ChipStates chipStates(OPNMIDIplay &play)
+{
+    ChipStates chans(play.m_synth->m_numChannels);
+    OPN2_ChannelsSnapshot s;
+    s.chipChannels = chans.data();
+    s.chipChannelsCapacity = chans.size();
+    s.midiChannels = NULL;
+    s.midiChannelsCapacity = 0;
+    play.getChannelsSnapshot(s);
+    return chans;
+}
+
+//! Categories of chip channels which are playing notes
+static std::vector<int> busyCategories(OPNMIDIplay &play)
+{
+    ChipStates chans = chipStates(play);
+    std::vector<int> cats;
+    for(size_t c = 0; c < chans.size(); ++c)
+    {
+        if(chans[c].state == OPNMIDI_ChipChan_KeyOn)
+            cats.push_back(play.m_synth->m_channelCategory[c]);
+    }
+    return cats;
+}
+
+TEST_CASE("[OPNMIDIplay] Extra channels: layout of chip channels")
+{
+    OPNMIDIplay play(44100);
+    setupOpna(play, 2);
+
+    const Synth &synth = *play.m_synth;
+    const size_t fm = 2 * Synth::FmChannelsPerChip;
+    for(size_t c = 0; c < fm; ++c)
+        REQUIRE(synth.m_channelCategory[c] == Synth::ChanCat_Regular);
+
+    for(size_t chip = 0; chip < 2; ++chip)
+    {
+        const size_t base = fm + chip * Synth::ExtraChannelsPerChip;
+        for(size_t i = 0; i < Synth::SsgChannelsPerChip; ++i)
+        {
+            REQUIRE(synth.m_channelCategory[base + i] == Synth::ChanCat_SSG);
+            REQUIRE(synth.channelChip(base + i) == chip);
+        }
+        for(size_t i = 0; i < Synth::RhythmChannelsPerChip; ++i)
+        {
+            const size_t c = base + Synth::SsgChannelsPerChip + i;
+            REQUIRE(synth.m_channelCategory[c] == Synth::ChanCat_Rhythm_Bass + static_cast<int>(i));
+            REQUIRE(synth.channelChip(c) == chip);
+        }
+    }
+}
+
+TEST_CASE("[OPNMIDIplay] Extra channels: GM rhythm map")
+{
+    for(uint8_t key = 35; key <= 59; ++key)
+    {
+        OPNMIDIplay play(44100);
+        setupOpna(play, 1);
+
+        play.realTime_NoteOn(9, key, 100);
+        std::vector<int> cats = busyCategories(play);
+
+        const int rhythm = c_gmRhythm[key - 35];
+        const int expected = rhythm ? Synth::ChanCat_Rhythm_Bass + rhythm - 1 : Synth::ChanCat_Regular;
+        INFO("Percussion key " << int(key));
+        REQUIRE(cats.size() == 1);
+        REQUIRE(cats[0] == expected);
+    }
+}
+
+TEST_CASE("[OPNMIDIplay] Extra channels: rhythm voice of every chip")
+{
+    OPNMIDIplay play(44100);
+    setupOpna(play, 2);
+
+    // Both keys are played by the bass drum voice, one per chip
+    play.realTime_NoteOn(9, 35, 100);
+    play.realTime_NoteOn(9, 36, 100);
+
+    ChipStates chans = chipStates(play);
+    std::vector<size_t> chips;
+    for(size_t c = 0; c < chans.size(); ++c)
+    {
+        if(chans[c].state != OPNMIDI_ChipChan_KeyOn)
+            continue;
+        REQUIRE(play.m_synth->m_channelCategory[c] == Synth::ChanCat_Rhythm_Bass);
+        chips.push_back(play.m_synth->channelChip(c));
+    }
+
+    REQUIRE(chips.size() == 2);
+    REQUIRE(chips[0] != chips[1]);
+}
+
+TEST_CASE("[OPNMIDIplay] Extra channels: SSG channels")
+{
+    OPNMIDIplay play(44100);
+    setupOpna(play, 1);
+
+    // Program 1 stays FM-only, program 0 may be played by SSG channels
+    Synth::Bank &bank = play.m_synth->m_insBanks[0];
+    bank.ins[0].flags |= OpnInstMeta::Flag_SSG;
+    bank.ins[1].flags &= ~OpnInstMeta::Flag_SSG;
+
+    SECTION("FM-only notes never take SSG channels")
+    {
+        play.realTime_PatchChange(0, 1);
+        for(uint8_t n = 0; n < Synth::FmChannelsPerChip + 1; ++n)
+            play.realTime_NoteOn(0, static_cast<uint8_t>(48 + n * 2), 100);
+
+        std::vector<int> cats = busyCategories(play);
+        REQUIRE(cats.size() == Synth::FmChannelsPerChip);
+        for(size_t i = 0; i < cats.size(); ++i)
+            REQUIRE(cats[i] == Synth::ChanCat_Regular);
+    }
+
+    SECTION("SSG notes take SSG channels first, then FM channels")
+    {
+        play.realTime_PatchChange(0, 0);
+        for(uint8_t n = 0; n < Synth::SsgChannelsPerChip; ++n)
+            play.realTime_NoteOn(0, static_cast<uint8_t>(48 + n * 2), 100);
+
+        std::vector<int> cats = busyCategories(play);
+        REQUIRE(cats.size() == Synth::SsgChannelsPerChip);
+        for(size_t i = 0; i < cats.size(); ++i)
+            REQUIRE(cats[i] == Synth::ChanCat_SSG);
+
+        for(uint8_t n = 0; n < Synth::FmChannelsPerChip; ++n)
+            play.realTime_NoteOn(0, static_cast<uint8_t>(72 + n * 2), 100);
+
+        cats = busyCategories(play);
+        REQUIRE(cats.size() == Synth::SsgChannelsPerChip + Synth::FmChannelsPerChip);
+        REQUIRE(std::count(cats.begin(), cats.end(), static_cast<int>(Synth::ChanCat_SSG)) == Synth::SsgChannelsPerChip);
+    }
+}
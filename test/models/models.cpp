@@ -0,0 +1,84 @@
+#include <catch.hpp>
+#include <cmath>
+#include <cstdlib>
+
+#include "models/opn_models.h"
+
+typedef uint16_t (*FreqModel)(double tone, uint32_t *mul_offset);
+typedef uint16_t (*FreqModelFx)(int32_t tone, uint32_t *mul_offset);
+
+static void compareFreqModels(FreqModel model, FreqModelFx modelFx)
+{
+    // Every 1/100 of cent through the whole MIDI range and above
+    for(int32_t tone = 0; tone < 140 * OPN_TONE_FX_ONE; tone += 64)
+    {
+        uint32_t mul = 0, mulFx = 0;
+        uint16_t freq = model(static_cast<double>(tone) / OPN_TONE_FX_ONE, &mul);
+        uint16_t freqFx = modelFx(tone, &mulFx);
+
+        INFO("Tone " << tone);
+        REQUIRE(mul == mulFx);
+        // Block must match, FNum may differ by the rounding at the table step border
+        REQUIRE((freq & 0x3800) == (freqFx & 0x3800));
+        REQUIRE(std::abs(static_cast<int>(freq & 0x7FF) - static_cast<int>(freqFx & 0x7FF)) <= 1);
+    }
+
+    // Negative tones are clamped to zero
+    uint32_t mul = 0, mulFx = 0;
+    REQUIRE(model(-1.0, &mul) == modelFx(-OPN_TONE_FX_ONE, &mulFx));
+}
+
+TEST_CASE("Fixed-point frequency models", "[models]")
+{
+    SECTION("OPN2")
+    {
+        compareFreqModels(&opnModel_genericFreqOPN2, &opnModel_genericFreqOPN2Fx);
+    }
+
+    SECTION("OPNA")
+    {
+        compareFreqModels(&opnModel_genericFreqOPNA, &opnModel_genericFreqOPNAFx);
+    }
+}
+
+TEST_CASE("Generic volume model", "[models]")
+{
+    const double c1 = 11.541560327111707;
+    const double c2 = 1.601379199767093e+02;
+
+    for(unsigned vel = 0; vel < 128; vel += 3)
+    {
+        for(unsigned vol = 0; vol < 128; vol += 2)
+        {
+            for(unsigned expr = 0; expr < 128; expr += 7)
+            {
+                OPNVolume_t v;
+                v.vel = vel;
+                v.chVol = vol;
+                v.chExpr = expr;
+                v.masterVolume = 127;
+                v.algorithm = 0;
+                for(size_t i = 0; i < 4; ++i)
+                {
+                    v.tlOp[i] = 0;
+                    v.doOp[i] = 1;
+                }
+
+                opnModel_genericVolume(&v);
+
+                // Reference formula
+                uint32_t product = vel * 127 * vol * expr;
+                uint32_t expected = 0;
+                if(product > 1108075)
+                {
+                    expected = static_cast<uint32_t>(std::log(static_cast<double>(product)) * c1 - c2) * 2;
+                    if(expected > 127)
+                        expected = 127;
+                }
+
+                INFO("Velocity " << vel << ", volume " << vol << ", expression " << expr);
+                REQUIRE(v.tlOp[0] == 127 - expected);
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * Checks that players which are rendering at the same time from different
+ * threads are giving the same output as when each of them was rendered alone.
+ * Chip emulators are sharing their static tables between all chips, so the
+ * output of any built emulator must not depend on other players.
+ */
+
+#include <catch.hpp>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+/*
+ * Chords on all melodic channels with different programs, panning and
+ * pitch bends, and a drum pattern on the percussion channel
+ */
+static std::vector<uint8_t> makeSong()
+{
+    std::vector<uint8_t> trk;
+
+    for(uint8_t ch = 0; ch < 16; ++ch)
+    {
+        putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(ch * 7), 0);
+        putEvent(trk, 0, static_cast<uint8_t>(0xB0 | ch), 10, static_cast<uint8_t>(ch * 8));
+    }
+
+    for(uint8_t step = 0; step < 8; ++step)
+    {
+        for(uint8_t ch = 0; ch < 16; ++ch)
+        {
+            uint8_t key = (ch == 9) ? static_cast<uint8_t>(35 + step * 3) : static_cast<uint8_t>(40 + ch * 2 + step);
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), key, static_cast<uint8_t>(70 + ch));
+        }
+        for(uint8_t ch = 0; ch < 16; ++ch)
+            putEvent(trk, 0, static_cast<uint8_t>(0xE0 | ch), 0, static_cast<uint8_t>(64 + step * 4 - ch));
+        for(uint8_t ch = 0; ch < 16; ++ch)
+        {
+            uint8_t key = (ch == 9) ? static_cast<uint8_t>(35 + step * 3) : static_cast<uint8_t>(40 + ch * 2 + step);
+            putEvent(trk, ch == 0 ? 48 : 0, static_cast<uint8_t>(0x80 | ch), key, 64);
+        }
+    }
+
+    return makeMidiFile(trk);
+}
+
+static size_t framesFor(int emulator)
+{
+    // Low-level emulators are way too slow to render a whole second
+    return emulator >= OPNMIDI_EMU_NUKED_YM2612_LLE ? 2048 : 44100;
+}
+
+/*
+ * Renders the beginning of the song, returns an empty buffer
+ * when the emulator is not built
+ */
+static std::vector<short> render(const std::vector<uint8_t> &song, int emulator)
+{
+    std::vector<short> out;
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    if(!device)
+        return out;
+
+    if(opn2_switchEmulator(device, emulator) == 0 &&
+       opn2_openBankFile(device, DEFAULT_BANK_PATH) == 0 &&
+       opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0)
+    {
+        out.resize(framesFor(emulator) * 2);
+        size_t done = 0;
+        while(done < out.size())
+        {
+            int got = opn2_play(device, static_cast<int>(std::min<size_t>(1024, out.size() - done)), out.data() + done);
+            if(got <= 0)
+                break;
+            done += static_cast<size_t>(got);
+        }
+        out.resize(done);
+    }
+
+    opn2_close(device);
+    return out;
+}
+
+TEST_CASE("Parallel rendering matches sequential rendering", "[parallel]")
+{
+    const std::vector<uint8_t> song = makeSong();
+    std::vector<int> emulators;
+    std::vector<std::vector<short> > reference;
+
+    for(int emu = 0; emu < OPNMIDI_EMU_end; ++emu)
+    {
+        if(emu == OPNMIDI_VGM_DUMPER)
+            continue; // Writes a file instead of playing
+        std::vector<short> out = render(song, emu);
+        if(out.empty())
+            continue;
+        emulators.push_back(emu);
+        reference.push_back(out);
+    }
+
+    REQUIRE(!emulators.empty());
+
+    // Every emulator gets two players running at once, next to all others
+    const size_t jobs = emulators.size() * 2;
+    std::vector<std::vector<short> > result(jobs);
+    std::vector<std::thread> workers;
+
+    for(size_t i = 0; i < jobs; ++i)
+        workers.push_back(std::thread([&song, &emulators, &result, i]()
+        {
+            result[i] = render(song, emulators[i % emulators.size()]);
+        }));
+
+    for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    for(size_t i = 0; i < jobs; ++i)
+    {
+        INFO("Emulator " << emulators[i % emulators.size()] << ", job " << i);
+        REQUIRE(result[i] == reference[i % emulators.size()]);
+    }
+}
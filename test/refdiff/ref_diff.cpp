@@ -0,0 +1,530 @@
+/*
+ * Reference-diff accuracy harness: renders the same register stream through
+ * two emulator configurations and compares the output sample by sample.
+ *
+ * The input (a MIDI or VGM file, or the built-in test song) is played once
+ * with the first configuration while its register writes are captured. The
+ * captured stream is then replayed through both configurations: all chips
+ * together and every chip alone, so differences are reported per chip and
+ * per segment. Exits with a non-zero code when thresholds are exceeded.
+ */
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+
+#include <opnmidi.h>
+
+#ifndef DEFAULT_BANK_PATH
+#define DEFAULT_BANK_PATH "fm_banks/xg.wopn"
+#endif
+
+enum ExitCode
+{
+    EXIT_PASSED = 0,
+    EXIT_DIFFERS = 1,
+    EXIT_ERROR = 2
+};
+
+struct RenderConfig
+{
+    int emulator;
+    int pcmRate;
+    int chips;
+    std::string text;
+
+    RenderConfig() : emulator(OPNMIDI_EMU_MAME), pcmRate(0), chips(2) {}
+
+    bool parse(const char *s)
+    {
+        text = s;
+        std::string str(s);
+        size_t pos = 0;
+        while(pos < str.size())
+        {
+            size_t end = str.find(',', pos);
+            if(end == std::string::npos)
+                end = str.size();
+            std::string item = str.substr(pos, end - pos);
+            size_t eq = item.find('=');
+            if(eq == std::string::npos)
+                return false;
+            std::string key = item.substr(0, eq);
+            int value = std::atoi(item.c_str() + eq + 1);
+            if(key == "emu")
+                emulator = value;
+            else if(key == "pcmrate")
+                pcmRate = value;
+            else if(key == "chips")
+                chips = value;
+            else
+                return false;
+            pos = end + 1;
+        }
+        return chips >= 1;
+    }
+};
+
+static bool setupPlayer(OPN2_MIDIPlayer *p, const RenderConfig &cfg)
+{
+    if(opn2_switchEmulator(p, cfg.emulator) < 0)
+        return false;
+    if(opn2_setNumChips(p, cfg.chips) < 0)
+        return false;
+    opn2_setRunAtPcmRate(p, cfg.pcmRate);
+    return true;
+}
+
+/* ======== Built-in test song ======== */
+
+static void pushVarLen(std::vector<uint8_t> &out, uint32_t v)
+{
+    uint8_t buf[5];
+    int n = 0;
+    buf[n++] = static_cast<uint8_t>(v & 0x7F);
+    while((v >>= 7) != 0)
+        buf[n++] = static_cast<uint8_t>(0x80 | (v & 0x7F));
+    while(n > 0)
+        out.push_back(buf[--n]);
+}
+
+static void pushEvent(std::vector<uint8_t> &trk, uint32_t delta, uint8_t a, uint8_t b, uint8_t c)
+{
+    pushVarLen(trk, delta);
+    trk.push_back(a);
+    trk.push_back(b);
+    if((a & 0xF0) != 0xC0)
+        trk.push_back(c);
+}
+
+/**
+ * Eight seconds of chords on four melodic channels with pitch bends and
+ * modulation, plus a drum pattern, which keeps all chip channels busy.
+ */
+static void makeBuiltinSong(std::vector<uint8_t> &out)
+{
+    static const uint8_t programs[4] = {0, 33, 48, 80};
+    static const uint8_t chord[4][3] = {{60, 64, 67}, {57, 60, 64}, {53, 57, 60}, {55, 59, 62}};
+    std::vector<uint8_t> trk;
+
+    for(uint8_t ch = 0; ch < 4; ++ch)
+        pushEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), programs[ch], 0);
+
+    // 480 ticks per quarter, 120 BPM by default: 960 ticks per second
+    for(uint32_t bar = 0; bar < 8; ++bar)
+    {
+        const uint8_t *c = chord[bar % 4];
+        for(uint8_t ch = 0; ch < 4; ++ch)
+        {
+            for(int n = 0; n < 3; ++n)
+                pushEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(c[n] - 12 + ch * 6), static_cast<uint8_t>(70 + ch * 10));
+        }
+
+        for(int step = 0; step < 8; ++step)
+        {
+            uint16_t bend = static_cast<uint16_t>(0x2000 + ((step & 4) ? -1 : 1) * (step & 3) * 0x300);
+            pushEvent(trk, 0, 0x99, (step % 2) ? 38 : 36, 100);
+            pushEvent(trk, 0, 0xE1, static_cast<uint8_t>(bend & 0x7F), static_cast<uint8_t>(bend >> 7));
+            pushEvent(trk, 0, 0xB2, 1, static_cast<uint8_t>(step * 16));
+            pushEvent(trk, 120, 0x89, (step % 2) ? 38 : 36, 0);
+        }
+
+        for(uint8_t ch = 0; ch < 4; ++ch)
+        {
+            for(int n = 0; n < 3; ++n)
+                pushEvent(trk, 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(c[n] - 12 + ch * 6), 0);
+        }
+    }
+
+    // Let release tails ring
+    pushVarLen(trk, 960);
+    trk.push_back(0xFF);
+    trk.push_back(0x2F);
+    trk.push_back(0x00);
+
+    const uint8_t head[14] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xE0};
+    out.assign(head, head + 14);
+    out.push_back('M'); out.push_back('T'); out.push_back('r'); out.push_back('k');
+    uint32_t size = static_cast<uint32_t>(trk.size());
+    out.push_back(static_cast<uint8_t>(size >> 24));
+    out.push_back(static_cast<uint8_t>(size >> 16));
+    out.push_back(static_cast<uint8_t>(size >> 8));
+    out.push_back(static_cast<uint8_t>(size));
+    out.insert(out.end(), trk.begin(), trk.end());
+}
+
+/* ======== Capture and replay ======== */
+
+static const OPNMIDI_AudioFormat c_formatF32 =
+{
+    OPNMIDI_SampleType_F32,
+    sizeof(float),
+    sizeof(float) * 2
+};
+
+static void drainRing(OPN2_RegCaptureRing &ring, std::vector<OPN2_RegWrite> &dst)
+{
+    while(ring.tail != ring.head)
+    {
+        dst.push_back(ring.records[ring.tail]);
+        ring.tail = (ring.tail + 1) % ring.capacity;
+    }
+}
+
+static bool captureStream(const RenderConfig &cfg, long rate, const std::string &bank,
+                          const std::string &input, const std::vector<uint8_t> &builtin,
+                          std::vector<OPN2_RegWrite> &stream)
+{
+    OPN2_MIDIPlayer *p = opn2_init(rate);
+    if(!p)
+    {
+        std::fprintf(stderr, "Can't initialize the library: %s\n", opn2_errorString());
+        return false;
+    }
+
+    std::vector<OPN2_RegWrite> storage(65536);
+    OPN2_RegCaptureRing ring;
+    ring.records = &storage[0];
+    ring.capacity = storage.size();
+    ring.head = ring.tail = ring.dropped = 0;
+
+    bool isVgm = input.size() > 4 &&
+        (input.compare(input.size() - 4, 4, ".vgm") == 0 || input.compare(input.size() - 4, 4, ".vgz") == 0);
+
+    bool ok = setupPlayer(p, cfg) && opn2_setRegisterCapture(p, &ring) == 0;
+    if(ok && !isVgm)
+        ok = opn2_openBankFile(p, bank.c_str()) == 0;
+    if(ok)
+    {
+        if(isVgm)
+            ok = opn2_openVgmFile(p, input.c_str()) == 0;
+        else if(input.empty())
+            ok = opn2_openData(p, &builtin[0], static_cast<unsigned long>(builtin.size())) == 0;
+        else
+            ok = opn2_openFile(p, input.c_str()) == 0;
+    }
+
+    if(!ok)
+    {
+        std::fprintf(stderr, "Can't prepare the input: %s\n", opn2_errorInfo(p));
+        opn2_close(p);
+        return false;
+    }
+
+    std::vector<float> buf(4096 * 2);
+    while(opn2_playFormat(p, 4096 * 2,
+                          reinterpret_cast<OPN2_UInt8 *>(&buf[0]),
+                          reinterpret_cast<OPN2_UInt8 *>(&buf[1]),
+                          &c_formatF32) > 0)
+        drainRing(ring, stream);
+    drainRing(ring, stream);
+
+    opn2_setRegisterCapture(p, NULL);
+    opn2_close(p);
+
+    if(ring.dropped > 0)
+    {
+        std::fprintf(stderr, "Capture has lost %lu register writes\n", (unsigned long)ring.dropped);
+        return false;
+    }
+
+    return true;
+}
+
+static bool replayStream(const RenderConfig &cfg, long rate,
+                         const std::vector<OPN2_RegWrite> &stream, std::vector<float> &out)
+{
+    OPN2_MIDIPlayer *p = opn2_init(rate);
+    if(!p)
+        return false;
+
+    // Chips of the configuration are kept, the register log adds chips it misses only
+    if(!setupPlayer(p, cfg) || opn2_openRegisterLog(p, stream.empty() ? NULL : &stream[0], stream.size(), static_cast<unsigned long>(rate)) < 0)
+    {
+        std::fprintf(stderr, "Can't replay the register stream: %s\n", opn2_errorInfo(p));
+        opn2_close(p);
+        return false;
+    }
+
+    out.clear();
+    std::vector<float> buf(4096 * 2);
+    int got;
+    while((got = opn2_playFormat(p, 4096 * 2,
+                                 reinterpret_cast<OPN2_UInt8 *>(&buf[0]),
+                                 reinterpret_cast<OPN2_UInt8 *>(&buf[1]),
+                                 &c_formatF32)) > 0)
+        out.insert(out.end(), buf.begin(), buf.begin() + got);
+
+    opn2_close(p);
+    return true;
+}
+
+/* ======== Comparison ======== */
+
+struct DiffStats
+{
+    double signal;
+    double noise;
+    double peak;
+    size_t diffSamples;
+
+    DiffStats() : signal(0.0), noise(0.0), peak(0.0), diffSamples(0) {}
+
+    bool exact() const
+    {
+        return diffSamples == 0;
+    }
+
+    double snr() const
+    {
+        if(noise <= 0.0)
+            return HUGE_VAL;
+        if(signal <= 0.0)
+            return -HUGE_VAL;
+        return 10.0 * std::log10(signal / noise);
+    }
+
+    //! Peak error in 16-bit LSB units
+    double peakLsb() const
+    {
+        return peak * 32768.0;
+    }
+};
+
+struct Thresholds
+{
+    double minSnr;
+    double maxPeakLsb;
+};
+
+static bool passes(const DiffStats &d, const Thresholds &t)
+{
+    if(d.exact())
+        return true;
+    return d.snr() >= t.minSnr && d.peakLsb() <= t.maxPeakLsb;
+}
+
+static void printStats(const char *what, const DiffStats &d)
+{
+    if(d.exact())
+        std::printf("%s: bit-exact\n", what);
+    else
+        std::printf("%s: %lu samples differ, SNR %.2f dB, peak error %.2f LSB\n",
+                    what, (unsigned long)d.diffSamples, d.snr(), d.peakLsb());
+}
+
+/**
+ * Compare two renders, print per-segment stats of failed segments
+ * @return true when all segments and the whole render pass the thresholds
+ */
+static bool compare(const char *label, const std::vector<float> &a, const std::vector<float> &b,
+                    long rate, double segmentSec, const Thresholds &t, bool verbose)
+{
+    bool ok = true;
+    char what[128];
+
+    if(a.size() != b.size())
+    {
+        std::printf("%s: length differs, %lu vs %lu frames\n", label,
+                    (unsigned long)(a.size() / 2), (unsigned long)(b.size() / 2));
+        ok = false;
+    }
+
+    size_t len = a.size() < b.size() ? a.size() : b.size();
+    size_t segment = static_cast<size_t>(segmentSec * rate) * 2;
+    if(segment == 0)
+        segment = 2;
+
+    DiffStats total;
+    for(size_t begin = 0, index = 0; begin < len; begin += segment, ++index)
+    {
+        size_t end = begin + segment < len ? begin + segment : len;
+        DiffStats seg;
+        for(size_t i = begin; i < end; ++i)
+        {
+            double d = double(a[i]) - double(b[i]);
+            seg.signal += double(a[i]) * double(a[i]);
+            seg.noise += d * d;
+            if(std::fabs(d) > seg.peak)
+                seg.peak = std::fabs(d);
+            if(a[i] != b[i])
+                ++seg.diffSamples;
+        }
+
+        total.signal += seg.signal;
+        total.noise += seg.noise;
+        total.diffSamples += seg.diffSamples;
+        if(seg.peak > total.peak)
+            total.peak = seg.peak;
+
+        bool segOk = passes(seg, t);
+        if(!segOk || (verbose && !seg.exact()))
+        {
+            std::snprintf(what, sizeof(what), "%s, segment %lu (%.1f s)", label,
+                          (unsigned long)index, double(begin / 2) / double(rate));
+            printStats(what, seg);
+        }
+        ok &= segOk;
+    }
+
+    ok &= passes(total, t);
+    std::snprintf(what, sizeof(what), "%s%s", label, ok ? "" : " [FAILED]");
+    printStats(what, total);
+    return ok;
+}
+
+static void printUsage(const char *prog)
+{
+    std::fprintf(stderr,
+        "Reference-diff accuracy harness for libOPNMIDI " OPNMIDI_VERSION "\n"
+        "\n"
+        "Syntax: %s [options] [file.mid | file.vgm]\n"
+        "\n"
+        " --a <config>     Reference configuration (default emu=0,pcmrate=0,chips=2)\n"
+        " --b <config>     Tested configuration (default same as --a)\n"
+        "                  Config is a comma-separated list of emu=<OPNMIDI_Emulator>,\n"
+        "                  pcmrate=<0|1> and chips=<count>\n"
+        " --rate <hz>      Output sample rate (default 44100)\n"
+        " --segment <sec>  Length of compared segments (default 1.0)\n"
+        " --min-snr <dB>   Lowest allowed SNR (default: bit-exactness is required)\n"
+        " --max-peak <lsb> Highest allowed peak error in 16-bit LSB (default: any when --min-snr is set)\n"
+        " --bank <file>    WOPN bank for MIDI input (default %s)\n"
+        " --verbose        Print stats of every differing segment\n"
+        "\n"
+        "Without an input file, a built-in test song is used.\n"
+        "Exit code: 0 - passed, 1 - thresholds exceeded, 2 - error.\n"
+        "\n", prog, DEFAULT_BANK_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    RenderConfig cfgA, cfgB;
+    bool haveB = false, verbose = false;
+    long rate = 44100;
+    double segment = 1.0;
+    Thresholds t;
+    t.minSnr = HUGE_VAL;
+    t.maxPeakLsb = 0.0;
+    bool haveSnr = false, havePeak = false;
+    std::string bank = DEFAULT_BANK_PATH, input;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        bool hasArg = (i + 1 < argc);
+        const char *a = argv[i];
+        if(!std::strcmp(a, "--a") && hasArg)
+        {
+            if(!cfgA.parse(argv[++i]))
+            {
+                printUsage(argv[0]);
+                return EXIT_ERROR;
+            }
+        }
+        else if(!std::strcmp(a, "--b") && hasArg)
+        {
+            if(!cfgB.parse(argv[++i]))
+            {
+                printUsage(argv[0]);
+                return EXIT_ERROR;
+            }
+            haveB = true;
+        }
+        else if(!std::strcmp(a, "--rate") && hasArg)
+            rate = std::atol(argv[++i]);
+        else if(!std::strcmp(a, "--segment") && hasArg)
+            segment = std::atof(argv[++i]);
+        else if(!std::strcmp(a, "--min-snr") && hasArg)
+        {
+            t.minSnr = std::atof(argv[++i]);
+            haveSnr = true;
+        }
+        else if(!std::strcmp(a, "--max-peak") && hasArg)
+        {
+            t.maxPeakLsb = std::atof(argv[++i]);
+            havePeak = true;
+        }
+        else if(!std::strcmp(a, "--bank") && hasArg)
+            bank = argv[++i];
+        else if(!std::strcmp(a, "--verbose"))
+            verbose = true;
+        else if(a[0] != '-' && input.empty())
+            input = a;
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_ERROR;
+        }
+    }
+
+    if(haveSnr && !havePeak)
+        t.maxPeakLsb = HUGE_VAL;
+    if(havePeak && !haveSnr)
+        t.minSnr = -HUGE_VAL;
+    if(!haveB)
+        cfgB = cfgA;
+    if(rate <= 0 || segment <= 0.0)
+    {
+        printUsage(argv[0]);
+        return EXIT_ERROR;
+    }
+
+    std::vector<uint8_t> builtin;
+    if(input.empty())
+        makeBuiltinSong(builtin);
+
+    std::vector<OPN2_RegWrite> stream;
+    if(!captureStream(cfgA, rate, bank, input, builtin, stream))
+        return EXIT_ERROR;
+
+    int chips = 0;
+    for(size_t i = 0; i < stream.size(); ++i)
+    {
+        if(stream[i].chip + 1 > chips)
+            chips = stream[i].chip + 1;
+    }
+
+    std::printf("Comparing [%s] against [%s], %lu register writes on %d chip(s)\n",
+                cfgB.text.empty() ? "default" : cfgB.text.c_str(),
+                cfgA.text.empty() ? "default" : cfgA.text.c_str(),
+                (unsigned long)stream.size(), chips);
+
+    if(chips > cfgA.chips || chips > cfgB.chips)
+    {
+        std::fprintf(stderr, "Register stream needs %d chip(s), more than the configuration has\n", chips);
+        return EXIT_ERROR;
+    }
+
+    bool ok = true;
+    std::vector<float> refOut, testOut;
+    char label[64];
+
+    if(!replayStream(cfgA, rate, stream, refOut) ||
+       !replayStream(cfgB, rate, stream, testOut))
+        return EXIT_ERROR;
+    ok &= compare("All chips", refOut, testOut, rate, segment, t, verbose);
+
+    for(int chip = 0; chips > 1 && chip < chips; ++chip)
+    {
+        std::vector<OPN2_RegWrite> sub;
+        for(size_t i = 0; i < stream.size(); ++i)
+        {
+            if(stream[i].chip != chip)
+                continue;
+            sub.push_back(stream[i]);
+            sub.back().chip = 0;
+        }
+
+        if(!replayStream(cfgA, rate, sub, refOut) ||
+           !replayStream(cfgB, rate, sub, testOut))
+            return EXIT_ERROR;
+        std::snprintf(label, sizeof(label), "Chip %d", chip);
+        ok &= compare(label, refOut, testOut, rate, segment, t, verbose);
+    }
+
+    std::printf("%s\n", ok ? "PASSED" : "FAILED");
+    return ok ? EXIT_PASSED : EXIT_DIFFERS;
+}
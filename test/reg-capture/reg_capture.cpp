@@ -0,0 +1,154 @@
+/*
+ * Checks that the register capture ring keeps 64-bit sample offsets, counts
+ * dropped records, and gives the same stream when another thread drains it
+ * while the library renders.
+ */
+
+#include <catch.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+static const int blockSamples = 1024;
+
+//! About 8 seconds of chords with program changes on every step
+static std::vector<uint8_t> makeSong()
+{
+    std::vector<uint8_t> trk;
+
+    for(uint8_t step = 0; step < 16; ++step)
+    {
+        for(uint8_t ch = 0; ch < 4; ++ch)
+        {
+            putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(step * 4 + ch), 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(40 + ch * 5 + step % 12), 100);
+        }
+        for(uint8_t ch = 0; ch < 4; ++ch)
+            putEvent(trk, ch == 0 ? 96 : 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(40 + ch * 5 + step % 12), 64);
+    }
+
+    return makeMidiFile(trk);
+}
+
+static OPN2_MIDIPlayer *openPlayer(const std::vector<uint8_t> &song, OPN2_RegCaptureRing &ring)
+{
+    OPN2_MIDIPlayer *device = openPlayer();
+    REQUIRE(opn2_setRegisterCapture(device, &ring) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    return device;
+}
+
+static void initRing(OPN2_RegCaptureRing &ring, std::vector<OPN2_RegWrite> &storage)
+{
+    ring.records = storage.data();
+    ring.capacity = storage.size();
+    ring.head = ring.tail = ring.dropped = 0;
+}
+
+/*
+ * Takes everything appended to the ring, the head is loaded before
+ * the records and the tail is stored after them
+ */
+static void drain(OPN2_RegCaptureRing &ring, std::vector<OPN2_RegWrite> &dst)
+{
+    size_t tail = ring.tail;
+    const size_t head = ring.head;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    while(tail != head)
+    {
+        dst.push_back(ring.records[tail]);
+        tail = (tail + 1) % ring.capacity;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    ring.tail = tail;
+}
+
+static bool sameStream(const std::vector<OPN2_RegWrite> &a, const std::vector<OPN2_RegWrite> &b)
+{
+    if(a.size() != b.size())
+        return false;
+    for(size_t i = 0; i < a.size(); ++i)
+    {
+        if(a[i].sampleOffset != b[i].sampleOffset || a[i].chip != b[i].chip ||
+           a[i].port != b[i].port || a[i].addr != b[i].addr || a[i].value != b[i].value)
+            return false;
+    }
+    return true;
+}
+
+TEST_CASE("Sample offsets of captured writes are 64-bit", "[reg-capture]")
+{
+    OPN2_RegWrite rec;
+    rec.sampleOffset = 0x100000000ULL;
+    REQUIRE(sizeof(rec.sampleOffset) == 8);
+    REQUIRE(rec.sampleOffset > 0xFFFFFFFFULL);
+}
+
+TEST_CASE("Records are dropped when the ring is full", "[reg-capture]")
+{
+    const std::vector<uint8_t> song = makeSong();
+    std::vector<short> buf(blockSamples);
+    std::vector<OPN2_RegWrite> storage(16);
+    OPN2_RegCaptureRing ring;
+    initRing(ring, storage);
+
+    OPN2_MIDIPlayer *device = openPlayer(song, ring);
+    REQUIRE(opn2_play(device, blockSamples, buf.data()) == blockSamples);
+    opn2_close(device);
+
+    REQUIRE((ring.head + ring.capacity - ring.tail) % ring.capacity == ring.capacity - 1);
+    REQUIRE(ring.dropped > 0);
+}
+
+TEST_CASE("Ring drained by another thread gives the same stream", "[reg-capture]")
+{
+    const std::vector<uint8_t> song = makeSong();
+    const int blocks = 400;
+    std::vector<short> buf(blockSamples);
+
+    std::vector<OPN2_RegWrite> reference;
+    {
+        std::vector<OPN2_RegWrite> storage(65536);
+        OPN2_RegCaptureRing ring;
+        initRing(ring, storage);
+        OPN2_MIDIPlayer *device = openPlayer(song, ring);
+        for(int i = 0; i < blocks; ++i)
+        {
+            REQUIRE(opn2_play(device, blockSamples, buf.data()) == blockSamples);
+            drain(ring, reference);
+        }
+        opn2_close(device);
+        REQUIRE(ring.dropped == 0);
+    }
+    REQUIRE(reference.size() > 1000);
+
+    std::vector<OPN2_RegWrite> result;
+    std::vector<OPN2_RegWrite> storage(65536);
+    OPN2_RegCaptureRing ring;
+    initRing(ring, storage);
+    OPN2_MIDIPlayer *device = openPlayer(song, ring);
+
+    std::atomic<bool> done(false);
+    std::thread reader([&]()
+    {
+        while(!done.load())
+        {
+            drain(ring, result);
+            std::this_thread::yield();
+        }
+        drain(ring, result);
+    });
+
+    for(int i = 0; i < blocks; ++i)
+        REQUIRE(opn2_play(device, blockSamples, buf.data()) == blockSamples);
+    done.store(true);
+    reader.join();
+    opn2_close(device);
+
+    REQUIRE(ring.dropped == 0);
+    REQUIRE(sameStream(result, reference));
+}
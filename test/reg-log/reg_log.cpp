@@ -0,0 +1,178 @@
+/*
+ * Checks the playback of VGM files by the register log mode: files of both
+ * YM2612 and YM2608 are rejected, writes of another chip are ignored,
+ * opn2_generate() plays the log, and the chips are restored at the log end.
+ */
+
+#include <catch.hpp>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+
+static const uint32_t clockYM2612 = 7670453;
+static const uint32_t clockYM2608 = 7987200;
+static const uint32_t logSamples = 22050;
+static const int blockSamples = 1024;
+
+static void putLE32(std::vector<uint8_t> &out, size_t offset, uint32_t v)
+{
+    out[offset + 0] = static_cast<uint8_t>(v);
+    out[offset + 1] = static_cast<uint8_t>(v >> 8);
+    out[offset + 2] = static_cast<uint8_t>(v >> 16);
+    out[offset + 3] = static_cast<uint8_t>(v >> 24);
+}
+
+static void putReg(std::vector<uint8_t> &out, uint8_t cmd, uint8_t addr, uint8_t value)
+{
+    out.push_back(cmd);
+    out.push_back(addr);
+    out.push_back(value);
+}
+
+/*
+ * Half of second of the loud sine note on the first channel, register writes
+ * of the note are sent by the `cmd` command. The file starts with the key off
+ * written by the command of its chip, so, it always has some data to play.
+ */
+static std::vector<uint8_t> makeVgm(uint32_t clockOPN2, uint32_t clockOPNA, uint8_t cmd)
+{
+    std::vector<uint8_t> out(0x80, 0);
+    std::memcpy(&out[0], "Vgm ", 4);
+    putLE32(out, 0x08, 0x151);
+    putLE32(out, 0x18, logSamples);
+    putLE32(out, 0x2C, clockOPN2);
+    putLE32(out, 0x34, 0x80 - 0x34);
+    putLE32(out, 0x48, clockOPNA);
+
+    putReg(out, clockOPN2 != 0 ? 0x52 : 0x56, 0x28, 0x00);
+
+    putReg(out, cmd, 0xB0, 0x07); // Algorithm 7
+    for(uint8_t op = 0; op < 4; ++op)
+    {
+        putReg(out, cmd, static_cast<uint8_t>(0x30 + op * 4), 0x01); // Multiplier
+        putReg(out, cmd, static_cast<uint8_t>(0x40 + op * 4), 0x00); // Total level
+        putReg(out, cmd, static_cast<uint8_t>(0x50 + op * 4), 0x1F); // Attack rate
+        putReg(out, cmd, static_cast<uint8_t>(0x80 + op * 4), 0x0F); // Release rate
+    }
+    putReg(out, cmd, 0xB4, 0xC0); // Both speakers
+    putReg(out, cmd, 0xA4, 0x22);
+    putReg(out, cmd, 0xA0, 0x69);
+    putReg(out, cmd, 0x28, 0xF0); // Key on
+
+    out.push_back(0x61);
+    out.push_back(static_cast<uint8_t>(logSamples));
+    out.push_back(static_cast<uint8_t>(logSamples >> 8));
+    out.push_back(0x66);
+
+    putLE32(out, 0x04, static_cast<uint32_t>(out.size() - 4));
+    return out;
+}
+
+static OPN2_MIDIPlayer *openPlayer(const std::vector<uint8_t> &vgm)
+{
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_switchEmulator(device, OPNMIDI_EMU_MAME) == 0);
+    REQUIRE(opn2_openVgmData(device, vgm.data(), static_cast<unsigned long>(vgm.size())) == 0);
+    return device;
+}
+
+//! Render the whole log by blocks, by opn2_generate() or opn2_play()
+static std::vector<short> render(OPN2_MIDIPlayer *device, bool generate)
+{
+    std::vector<short> out;
+    std::vector<short> buf(blockSamples);
+    for(;;)
+    {
+        int got = generate ? opn2_generate(device, blockSamples, buf.data())
+                           : opn2_play(device, blockSamples, buf.data());
+        if(got <= 0)
+            break;
+        out.insert(out.end(), buf.begin(), buf.begin() + got);
+    }
+    return out;
+}
+
+static double energy(const std::vector<short> &s)
+{
+    double sum = 0.0;
+    for(size_t i = 0; i < s.size(); ++i)
+        sum += double(s[i]) * double(s[i]);
+    return sum;
+}
+
+TEST_CASE("VGM files of both YM2612 and YM2608 are rejected", "[reg-log]")
+{
+    const std::vector<uint8_t> vgm = makeVgm(clockYM2612, clockYM2608, 0x52);
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_openVgmData(device, vgm.data(), static_cast<unsigned long>(vgm.size())) < 0);
+    REQUIRE(std::strstr(opn2_errorInfo(device), "both YM2612 and YM2608") != NULL);
+    opn2_close(device);
+}
+
+TEST_CASE("VGM writes of another chip are ignored", "[reg-log]")
+{
+    SECTION("YM2612 file")
+    {
+        OPN2_MIDIPlayer *played = openPlayer(makeVgm(clockYM2612, 0, 0x52));
+        OPN2_MIDIPlayer *ignored = openPlayer(makeVgm(clockYM2612, 0, 0x56));
+        const double loud = energy(render(played, false));
+        const double quiet = energy(render(ignored, false));
+        opn2_close(played);
+        opn2_close(ignored);
+        REQUIRE(loud > 0.0);
+        REQUIRE(quiet < loud / 1000.0);
+    }
+
+    SECTION("YM2608 file")
+    {
+        OPN2_MIDIPlayer *played = openPlayer(makeVgm(0, clockYM2608, 0x56));
+        OPN2_MIDIPlayer *ignored = openPlayer(makeVgm(0, clockYM2608, 0x52));
+        const double loud = energy(render(played, false));
+        const double quiet = energy(render(ignored, false));
+        opn2_close(played);
+        opn2_close(ignored);
+        REQUIRE(loud > 0.0);
+        REQUIRE(quiet < loud / 1000.0);
+    }
+}
+
+TEST_CASE("opn2_generate() plays the register log", "[reg-log]")
+{
+    const std::vector<uint8_t> vgm = makeVgm(clockYM2612, 0, 0x52);
+
+    OPN2_MIDIPlayer *byPlay = openPlayer(vgm);
+    const std::vector<short> reference = render(byPlay, false);
+    opn2_close(byPlay);
+
+    OPN2_MIDIPlayer *byGenerate = openPlayer(vgm);
+    const std::vector<short> result = render(byGenerate, true);
+    opn2_close(byGenerate);
+
+    REQUIRE(reference.size() == logSamples * 2);
+    REQUIRE(energy(reference) > 0.0);
+    REQUIRE(result == reference);
+}
+
+TEST_CASE("Chips are restored at the end of the register log", "[reg-log]")
+{
+    const std::vector<uint8_t> vgm = makeVgm(0, clockYM2608, 0x56);
+
+    OPN2_MIDIPlayer *device = opn2_init(44100);
+    REQUIRE(device != NULL);
+    REQUIRE(opn2_setNumChips(device, 3) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 3);
+    REQUIRE(opn2_getChipType(device) == OPNMIDI_ChipType_OPN2);
+
+    REQUIRE(opn2_openVgmData(device, vgm.data(), static_cast<unsigned long>(vgm.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 1);
+    REQUIRE(opn2_getChipType(device) == OPNMIDI_ChipType_OPNA);
+
+    render(device, false);
+    REQUIRE(opn2_getNumChipsObtained(device) == 3);
+    REQUIRE(opn2_getChipType(device) == OPNMIDI_ChipType_OPN2);
+    opn2_close(device);
+}
@@ -0,0 +1,127 @@
+/*
+ * Checks that the render-ahead mode gives exactly the same audio as the direct
+ * rendering by blocks of the same size, and that nothing rendered before
+ * the seek is heard after it.
+ */
+
+#include <catch.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+//! Samples queued ahead, the render thread works by blocks of a quarter of it
+static const int aheadSamples = 4096;
+static const int blockSamples = aheadSamples / 4;
+
+/*
+ * About 16 seconds of chords, every step changes the programs,
+ * so any audio of the wrong position is easy to notice
+ */
+static std::vector<uint8_t> makeSong()
+{
+    std::vector<uint8_t> trk;
+
+    for(uint8_t step = 0; step < 32; ++step)
+    {
+        for(uint8_t ch = 0; ch < 4; ++ch)
+        {
+            putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(step * 4 + ch), 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(40 + ch * 5 + step % 12), 100);
+        }
+        for(uint8_t ch = 0; ch < 4; ++ch)
+            putEvent(trk, ch == 0 ? 96 : 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(40 + ch * 5 + step % 12), 64);
+    }
+
+    return makeMidiFile(trk);
+}
+
+static OPN2_MIDIPlayer *openPlayer(const std::vector<uint8_t> &song)
+{
+    OPN2_MIDIPlayer *device = openPlayer();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    return device;
+}
+
+//! Render directly by blocks of the render thread
+static std::vector<short> play(OPN2_MIDIPlayer *device, int samples)
+{
+    std::vector<short> out(static_cast<size_t>(samples));
+    for(int done = 0; done < samples; done += blockSamples)
+        REQUIRE(opn2_play(device, blockSamples, out.data() + done) == blockSamples);
+    return out;
+}
+
+//! Take the audio of the render-ahead mode, waiting on underruns
+static std::vector<short> read(OPN2_MIDIPlayer *device, int samples)
+{
+    std::vector<short> out(static_cast<size_t>(samples));
+    int done = 0;
+    for(int tries = 0; done < samples && tries < 100000; ++tries)
+    {
+        OPN2_UInt8 *dst = reinterpret_cast<OPN2_UInt8 *>(out.data() + done);
+        int got = opn2_readRendered(device, std::min(300, samples - done), dst, dst + sizeof(short));
+        if(got == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        done += got;
+    }
+    REQUIRE(done == samples);
+    return out;
+}
+
+//! Wait until the render thread fills the whole queue and stops
+static void waitFull(OPN2_MIDIPlayer *device)
+{
+    for(int tries = 0; opn2_renderedQueued(device) < aheadSamples && tries < 10000; ++tries)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    REQUIRE(opn2_renderedQueued(device) == aheadSamples);
+}
+
+TEST_CASE("Render-ahead gives the same audio as the direct rendering", "[render-ahead]")
+{
+    const std::vector<uint8_t> song = makeSong();
+    const int total = blockSamples * 200;
+
+    OPN2_MIDIPlayer *direct = openPlayer(song);
+    std::vector<short> reference = play(direct, total);
+    opn2_close(direct);
+
+    OPN2_MIDIPlayer *ahead = openPlayer(song);
+    REQUIRE(opn2_startRenderAhead(ahead, aheadSamples, NULL) == 0);
+    std::vector<short> result = read(ahead, total);
+    opn2_stopRenderAhead(ahead);
+    opn2_close(ahead);
+
+    REQUIRE(result == reference);
+}
+
+TEST_CASE("Nothing rendered before the seek is heard after it", "[render-ahead]")
+{
+    const std::vector<uint8_t> song = makeSong();
+    const int before = blockSamples * 20;
+    const int after = blockSamples * 40;
+    const double seekTo = 9.0;
+
+    OPN2_MIDIPlayer *ahead = openPlayer(song);
+    REQUIRE(opn2_startRenderAhead(ahead, aheadSamples, NULL) == 0);
+    read(ahead, before);
+    // The render thread stops on the full queue, so its position is known
+    waitFull(ahead);
+    opn2_positionSeek(ahead, seekTo);
+    std::vector<short> result = read(ahead, after);
+    opn2_stopRenderAhead(ahead);
+    opn2_close(ahead);
+
+    // The same amount is rendered before the seek, the queued part is dropped
+    OPN2_MIDIPlayer *direct = openPlayer(song);
+    play(direct, before + aheadSamples);
+    opn2_positionSeek(direct, seekTo);
+    std::vector<short> reference = play(direct, after);
+    opn2_close(direct);
+
+    REQUIRE(result == reference);
+}
@@ -0,0 +1,205 @@
+/*
+ * Checks song slots: every slot plays on its own block of MIDI channels,
+ * keeps playing when the main song gets loaded, its notes are protected
+ * by the priority, and its volume scales levels of its notes.
+ */
+
+#include <catch.hpp>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+/*
+ * A chord of a given size on the first channel, held for about a minute
+ */
+static std::vector<uint8_t> makeChordSong(uint8_t patch, uint8_t notes)
+{
+    std::vector<uint8_t> trk;
+    putEvent(trk, 0, 0xC0, patch, 0);
+    for(uint8_t n = 0; n < notes; ++n)
+        putEvent(trk, 0, 0x90, static_cast<uint8_t>(48 + n * 4), 100);
+    for(uint8_t n = 0; n < notes; ++n)
+        putEvent(trk, n == 0 ? 96 * 120 : 0, 0x80, static_cast<uint8_t>(48 + n * 4), 64);
+    return makeMidiFile(trk);
+}
+
+/*
+ * Short notes on every port of the song, each port takes a block of 16 channels
+ */
+static std::vector<uint8_t> makePortsSong(int ports)
+{
+    std::vector<uint8_t> trk;
+    for(int p = 0; p < ports; ++p)
+    {
+        putPort(trk, "Port " + std::to_string(p));
+        putEvent(trk, 0, 0x90, 60, 100);
+        putEvent(trk, 24, 0x80, 60, 64);
+    }
+    return makeMidiFile(trk);
+}
+
+static void play(OPN2_MIDIPlayer *device, int frames)
+{
+    std::vector<short> buf(1024);
+    while(frames > 0)
+    {
+        opn2_play(device, static_cast<int>(buf.size()), buf.data());
+        frames -= static_cast<int>(buf.size() / 2);
+    }
+}
+
+struct Snapshot
+{
+    std::vector<OPN2_ChipChannelState> chip;
+    std::vector<OPN2_MidiChannelState> midi;
+
+    explicit Snapshot(OPN2_MIDIPlayer *device) :
+        chip(64), midi(512)
+    {
+        OPN2_ChannelsSnapshot s;
+        s.chipChannels = chip.data();
+        s.chipChannelsCapacity = chip.size();
+        s.midiChannels = midi.data();
+        s.midiChannelsCapacity = midi.size();
+        REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+        chip.resize(std::min(s.chipChannelsCount, chip.size()));
+        midi.resize(std::min(s.midiChannelsCount, midi.size()));
+    }
+
+    //! Find the first channel after the main song block with the given patch
+    size_t findPatch(uint8_t patch) const
+    {
+        for(size_t i = 16; i < midi.size(); ++i)
+        {
+            if(midi[i].patch == patch && midi[i].activeNotes > 0)
+                return i;
+        }
+        return 0;
+    }
+};
+
+TEST_CASE("Slot songs survive loading of the main song", "[slots]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    const std::vector<uint8_t> slotSong = makeChordSong(20, 2);
+    const std::vector<uint8_t> mainSong = makeChordSong(5, 2);
+
+    REQUIRE(opn2_slotOpenData(device, 0, slotSong.data(), static_cast<unsigned long>(slotSong.size())) == 0);
+    REQUIRE(opn2_openData(device, mainSong.data(), static_cast<unsigned long>(mainSong.size())) == 0);
+    play(device, 4096);
+
+    {
+        Snapshot s(device);
+        size_t slotBase = s.findPatch(20);
+        REQUIRE(slotBase == 16);
+        REQUIRE(s.midi[0].patch == 5);
+        REQUIRE(s.midi[0].activeNotes == 2);
+    }
+
+    // The next main song keeps the slot channels and the slot continues to play
+    REQUIRE(opn2_openData(device, mainSong.data(), static_cast<unsigned long>(mainSong.size())) == 0);
+    {
+        Snapshot s(device);
+        REQUIRE(s.midi[16].patch == 20);
+    }
+    REQUIRE(opn2_slotAtEnd(device, 0) == 0);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Slot channels are placed beyond 256 MIDI channels", "[slots]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    const std::vector<uint8_t> mainSong = makePortsSong(18);
+    const std::vector<uint8_t> slotSong = makeChordSong(20, 2);
+
+    REQUIRE(opn2_openData(device, mainSong.data(), static_cast<unsigned long>(mainSong.size())) == 0);
+    // Let the song take blocks of all its ports
+    play(device, 44100 * 5);
+
+    REQUIRE(opn2_slotOpenData(device, 0, slotSong.data(), static_cast<unsigned long>(slotSong.size())) == 0);
+    play(device, 2048);
+
+    Snapshot s(device);
+    size_t slotBase = s.findPatch(20);
+    REQUIRE(slotBase >= 256);
+    REQUIRE(s.midi[slotBase].activeNotes == 2);
+    REQUIRE(s.midi[slotBase % 256].activeNotes == 0);
+
+    // Chip channels are reporting the full MIDI channel number
+    size_t slotNotes = 0;
+    for(size_t c = 0; c < s.chip.size(); ++c)
+    {
+        if(s.chip[c].state == OPNMIDI_ChipChan_KeyOn && s.chip[c].midiChannel == slotBase)
+            ++slotNotes;
+    }
+    REQUIRE(slotNotes == 2);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Priority of the slot protects its notes", "[slots]")
+{
+    // One OPN2 chip has 6 channels, all taken by the slot chord
+    const std::vector<uint8_t> slotSong = makeChordSong(20, 6);
+
+    for(int priority = -1; priority <= 1; priority += 2)
+    {
+        INFO("Priority " << priority);
+        OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+        REQUIRE(opn2_slotOpenData(device, 0, slotSong.data(), static_cast<unsigned long>(slotSong.size())) == 0);
+        opn2_slotSetPriority(device, 0, priority);
+        play(device, 2048);
+
+        opn2_rt_patchChange(device, 0, 5);
+        for(OPN2_UInt8 n = 0; n < 3; ++n)
+            opn2_rt_noteOn(device, 0, static_cast<OPN2_UInt8>(72 + n), 100);
+        play(device, 2048);
+
+        Snapshot s(device);
+        if(priority > 0)
+        {
+            REQUIRE(s.midi[0].chipChannels == 0);
+            REQUIRE(s.midi[16].chipChannels == 6);
+        }
+        else
+        {
+            REQUIRE(s.midi[0].chipChannels == 3);
+            REQUIRE(s.midi[16].chipChannels == 3);
+        }
+
+        opn2_close(device);
+    }
+}
+
+TEST_CASE("Slot volume scales levels of its notes", "[slots]")
+{
+    const std::vector<uint8_t> slotSong = makeChordSong(20, 1);
+    int levels[2];
+    const int volumes[2] = {127, 40};
+
+    for(int i = 0; i < 2; ++i)
+    {
+        OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+        REQUIRE(opn2_slotOpenData(device, 0, slotSong.data(), static_cast<unsigned long>(slotSong.size())) == 0);
+        opn2_slotSetVolume(device, 0, volumes[i]);
+        play(device, 2048);
+
+        Snapshot s(device);
+        levels[i] = -1;
+        for(size_t c = 0; c < s.chip.size(); ++c)
+        {
+            if(s.chip[c].notesCount > 0)
+                levels[i] = s.chip[c].totalLevel;
+        }
+        REQUIRE(levels[i] >= 0);
+
+        opn2_close(device);
+    }
+
+    // Higher total level is quieter
+    REQUIRE(levels[1] > levels[0]);
+}
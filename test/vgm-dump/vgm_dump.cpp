@@ -0,0 +1,131 @@
+/*
+ * Checks that the tick-driven VGM dump gives the same file as the dump
+ * driven by opn2_play(), and that players dump in parallel into their
+ * own write hooks without mixing their songs.
+ */
+
+#include <catch.hpp>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+/*
+ * Short chords with pitch bends and a tempo change, the event times
+ * don't fall on whole samples
+ */
+static std::vector<uint8_t> makeSong(uint8_t baseKey)
+{
+    std::vector<uint8_t> trk;
+    putTempo(trk, 0, 500000);
+
+    for(uint8_t step = 0; step < 8; ++step)
+    {
+        if(step == 4)
+            putTempo(trk, 0, 437219);
+        for(uint8_t ch = 0; ch < 3; ++ch)
+        {
+            putEvent(trk, 0, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(step * 3 + ch), 0);
+            putEvent(trk, 0, static_cast<uint8_t>(0x90 | ch), static_cast<uint8_t>(baseKey + ch * 4 + step), 100);
+        }
+        putEvent(trk, 7, 0xE0, 0, static_cast<uint8_t>(64 + step * 2));
+        for(uint8_t ch = 0; ch < 3; ++ch)
+            putEvent(trk, ch == 0 ? 29 : 0, static_cast<uint8_t>(0x80 | ch), static_cast<uint8_t>(baseKey + ch * 4 + step), 64);
+    }
+
+    return makeMidiFile(trk);
+}
+
+static void collect(void *userData, const OPN2_UInt8 *data, size_t size)
+{
+    std::vector<uint8_t> *out = static_cast<std::vector<uint8_t> *>(userData);
+    out->assign(data, data + size);
+}
+
+/*
+ * Dumps the song by opn2_tickVgmDump() calls when the block size is zero,
+ * or by opn2_play() calls of the given count of samples
+ */
+static std::vector<uint8_t> dumpSong(const std::vector<uint8_t> &song, int blockSamples)
+{
+    std::vector<uint8_t> vgm;
+
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_VGM_DUMPER, 1);
+    REQUIRE(opn2_setRunAtPcmRate(device, 1) == 0);
+    opn2_setLoopEnabled(device, 0);
+    opn2_setVgmWriteHook(device, collect, &vgm);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+
+    if(blockSamples == 0)
+    {
+        int ret;
+        while((ret = opn2_tickVgmDump(device)) > 0)
+            {}
+        REQUIRE(ret == 0);
+    }
+    else
+    {
+        std::vector<short> buf(blockSamples);
+        while(opn2_play(device, static_cast<int>(buf.size()), buf.data()) > 0)
+            {}
+    }
+
+    // The file gets finalized on closing
+    opn2_close(device);
+    return vgm;
+}
+
+static uint32_t totalSamples(const std::vector<uint8_t> &vgm)
+{
+    REQUIRE(vgm.size() > 0x40);
+    return uint32_t(vgm[0x18]) | (uint32_t(vgm[0x19]) << 8) |
+           (uint32_t(vgm[0x1A]) << 16) | (uint32_t(vgm[0x1B]) << 24);
+}
+
+TEST_CASE("Tick-driven dump equals the play-driven dump", "[vgm-dump]")
+{
+    const std::vector<uint8_t> song = makeSong(48);
+    const std::vector<uint8_t> byTicks = dumpSong(song, 0);
+    REQUIRE(!byTicks.empty());
+
+    // Blocks shorter and longer than the longest period between events
+    static const int blocks[] = {256, 1000, 4096};
+    for(size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); ++i)
+    {
+        INFO("Block of " << blocks[i] << " samples");
+        REQUIRE(dumpSong(song, blocks[i]) == byTicks);
+    }
+
+    // 4 steps of 36 ticks at 120 BPM and 4 steps at the faster tempo until the last write
+    const double seconds = 4 * 36 * 0.5 / 96 + 4 * 36 * 0.437219 / 96;
+    const double samples = seconds * 44100.0;
+    REQUIRE(totalSamples(byTicks) >= static_cast<uint32_t>(samples) - 1);
+    REQUIRE(totalSamples(byTicks) <= static_cast<uint32_t>(samples) + 1);
+}
+
+TEST_CASE("Players dump in parallel into their own hooks", "[vgm-dump]")
+{
+    const size_t players = 4;
+    std::vector<std::vector<uint8_t> > songs, expected(players), got(players);
+
+    for(size_t i = 0; i < players; ++i)
+    {
+        songs.push_back(makeSong(static_cast<uint8_t>(40 + i * 5)));
+        expected[i] = dumpSong(songs[i], 0);
+        REQUIRE(!expected[i].empty());
+    }
+
+    for(size_t i = 1; i < players; ++i)
+        REQUIRE(expected[i] != expected[0]);
+
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < players; ++i)
+        threads.push_back(std::thread([&songs, &got, i]() { got[i] = dumpSong(songs[i], 0); }));
+    for(size_t i = 0; i < players; ++i)
+        threads[i].join();
+
+    for(size_t i = 0; i < players; ++i)
+        REQUIRE(got[i] == expected[i]);
+}
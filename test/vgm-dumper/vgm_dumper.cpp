@@ -0,0 +1,232 @@
+/*
+ * Checks the command stream written by the VGM dumper: redundant register
+ * and timer writes are dropped, frequency writes are kept in pairs, key-on
+ * re-triggers and the OPNA trigger registers are always written, waits
+ * between writes are merged into the shortest commands, and loop points
+ * and errors are reported through the message hook.
+ */
+
+#include <catch.hpp>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "chips/vgm_file_dumper.h"
+
+static const uint32_t clockYM2612 = 7670454;
+static const uint32_t clockYM2608 = 7987200;
+
+static void collect(void *userData, const uint8_t *data, size_t size)
+{
+    std::vector<uint8_t> *out = static_cast<std::vector<uint8_t> *>(userData);
+    out->assign(data, data + size);
+}
+
+static void collectMessage(void *userData, const char *fmt, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    std::vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    static_cast<std::vector<std::string> *>(userData)->push_back(buf);
+}
+
+static uint32_t readLE32(const std::vector<uint8_t> &in, size_t offset)
+{
+    REQUIRE(in.size() >= offset + 4);
+    return uint32_t(in[offset]) | (uint32_t(in[offset + 1]) << 8) |
+           (uint32_t(in[offset + 2]) << 16) | (uint32_t(in[offset + 3]) << 24);
+}
+
+//! Song data after the header, with the check of the header fields
+static std::vector<uint8_t> songData(const std::vector<uint8_t> &file, uint32_t version, size_t dataStart)
+{
+    REQUIRE(file.size() > dataStart);
+    REQUIRE(std::string(file.begin(), file.begin() + 4) == "Vgm ");
+    REQUIRE(readLE32(file, 0x04) == file.size() - 0x04);
+    REQUIRE(readLE32(file, 0x08) == version);
+    REQUIRE(readLE32(file, 0x34) + 0x34 == dataStart);
+    REQUIRE(file.back() == 0x66);
+    return std::vector<uint8_t>(file.begin() + dataStart, file.end() - 1);
+}
+
+static void wait(VGMFileDumper &dumper, size_t samples)
+{
+    std::vector<int16_t> buf(samples * 2);
+    dumper.generate(buf.data(), samples);
+}
+
+TEST_CASE("YM2612 stream drops redundant writes and merges waits", "[vgm-dumper]")
+{
+    std::vector<uint8_t> file;
+    VGMFileDumper::Output sink;
+    sink.writeHook = collect;
+    sink.writeHookData = &file;
+
+    {
+        VGMFileDumper dumper(OPNChip_OPN2, 0, NULL, &sink);
+        REQUIRE(dumper.setRunningAtPcmRate(true));
+        dumper.setRate(44100, clockYM2612);
+
+        dumper.writeReg(0, 0x30, 0x71);
+        dumper.writeReg(0, 0x30, 0x71); // Same value
+        wait(dumper, 100);
+
+        // Timers are never recorded, only the Channel 3 mode bits of 0x27 matter
+        dumper.writeReg(0, 0x24, 0x05);
+        dumper.writeReg(0, 0x25, 0x01);
+        dumper.writeReg(0, 0x26, 0x03);
+        dumper.writeReg(0, 0x27, 0x15);
+        dumper.writeReg(0, 0x27, 0x3F);
+        dumper.writeReg(0, 0x27, 0x40);
+
+        // 1/60 of second in two parts
+        wait(dumper, 200);
+        wait(dumper, 535);
+
+        // The frequency high byte is written together with its low byte
+        dumper.writeReg(0, 0xA4, 0x22);
+        dumper.writeReg(0, 0xA0, 0x69);
+        dumper.writeReg(0, 0xA4, 0x22);
+        dumper.writeReg(0, 0xA0, 0x69); // Same pair
+        dumper.writeReg(0, 0xA4, 0x22);
+        dumper.writeReg(0, 0xA0, 0x70); // Only the low byte differs
+        dumper.writeReg(1, 0xA5, 0x1A);
+        dumper.writeReg(1, 0xA1, 0x10);
+        dumper.writeReg(0, 0xA6, 0x11);
+        dumper.writeReg(0, 0xB0, 0x32); // Not a pair, the held high byte goes first
+
+        // Key-on re-triggers after key-off
+        dumper.writeReg(0, 0x28, 0xF0);
+        dumper.writeReg(0, 0x28, 0xF0);
+        dumper.writeReg(0, 0x28, 0x00);
+        dumper.writeReg(0, 0x28, 0xF0);
+
+        // DAC samples are always written
+        dumper.writeReg(0, 0x2A, 0x80);
+        dumper.writeReg(0, 0x2A, 0x80);
+
+        // Longer than the maximum single wait
+        wait(dumper, 70000);
+        dumper.writeReg(0, 0x28, 0x00);
+    }
+
+    static const uint8_t expected[] =
+    {
+        0x52, 0x30, 0x71,
+        0x61, 0x64, 0x00,
+        0x52, 0x27, 0x15,
+        0x52, 0x27, 0x40,
+        0x62,
+        0x52, 0xA4, 0x22, 0x52, 0xA0, 0x69,
+        0x52, 0xA4, 0x22, 0x52, 0xA0, 0x70,
+        0x53, 0xA5, 0x1A, 0x53, 0xA1, 0x10,
+        0x52, 0xA6, 0x11,
+        0x52, 0xB0, 0x32,
+        0x52, 0x28, 0xF0,
+        0x52, 0x28, 0x00,
+        0x52, 0x28, 0xF0,
+        0x52, 0x2A, 0x80,
+        0x52, 0x2A, 0x80,
+        0x61, 0xFF, 0xFF,
+        0x61, 0x71, 0x11,
+        0x52, 0x28, 0x00
+    };
+
+    const std::vector<uint8_t> data = songData(file, 0x150, 0x38);
+    REQUIRE(data == std::vector<uint8_t>(expected, expected + sizeof(expected)));
+    REQUIRE(readLE32(file, 0x18) == 100 + 735 + 70000); // Total samples
+    REQUIRE(readLE32(file, 0x1C) + 0x1C == 0x38); // Loop from the start
+    REQUIRE(readLE32(file, 0x20) == 100 + 735 + 70000); // Loop samples
+    REQUIRE(readLE32(file, 0x2C) == clockYM2612);
+}
+
+TEST_CASE("YM2608 stream keeps trigger registers and the second chip", "[vgm-dumper]")
+{
+    std::vector<uint8_t> file;
+    VGMFileDumper::Output sink;
+    sink.writeHook = collect;
+    sink.writeHookData = &file;
+
+    {
+        VGMFileDumper first(OPNChip_OPNA, 0, NULL, &sink);
+        VGMFileDumper second(OPNChip_OPNA, 1, &first, &sink);
+        REQUIRE(first.setRunningAtPcmRate(true));
+        first.setRate(44100, clockYM2608);
+
+        first.writeReg(0, 0x07, 0x38);
+        first.writeReg(0, 0x07, 0x38); // Same value of a plain SSG register
+        first.writeReg(0, 0x0D, 0x0E);
+        first.writeReg(0, 0x0D, 0x0E); // Restarts the SSG envelope
+        first.writeReg(0, 0x10, 0x01);
+        first.writeReg(0, 0x10, 0x01); // Rhythm key-on
+        first.writeReg(1, 0x00, 0xA0);
+        first.writeReg(1, 0x00, 0xA0); // ADPCM start
+        wait(first, 882);
+        second.writeReg(0, 0x30, 0x01);
+        second.writeReg(1, 0x30, 0x02);
+        second.writeReg(1, 0x30, 0x02);
+    }
+
+    static const uint8_t expected[] =
+    {
+        0x56, 0x07, 0x38,
+        0x56, 0x0D, 0x0E, 0x56, 0x0D, 0x0E,
+        0x56, 0x10, 0x01, 0x56, 0x10, 0x01,
+        0x57, 0x00, 0xA0, 0x57, 0x00, 0xA0,
+        0x63,
+        0xA6, 0x30, 0x01,
+        0xA7, 0x30, 0x02
+    };
+
+    const std::vector<uint8_t> data = songData(file, 0x151, 0x80);
+    REQUIRE(data == std::vector<uint8_t>(expected, expected + sizeof(expected)));
+    REQUIRE(readLE32(file, 0x18) == 882);
+    REQUIRE(readLE32(file, 0x2C) == 0); // No YM2612
+    REQUIRE(readLE32(file, 0x48) == (clockYM2608 | 0x40000000)); // Dual chip
+}
+
+TEST_CASE("Nothing is written without waits", "[vgm-dumper]")
+{
+    std::vector<uint8_t> file;
+    VGMFileDumper::Output sink;
+    sink.writeHook = collect;
+    sink.writeHookData = &file;
+
+    {
+        VGMFileDumper dumper(OPNChip_OPN2, 0, NULL, &sink);
+        dumper.writeReg(0, 0x28, 0xF0);
+    }
+
+    REQUIRE(file.empty());
+}
+
+TEST_CASE("Loop points and errors go into the message hook", "[vgm-dumper]")
+{
+    std::vector<std::string> messages;
+    VGMFileDumper::Output sink;
+    sink.path = "no-such-directory/out.vgm";
+    sink.messageHook = collectMessage;
+    sink.messageHookData = &messages;
+
+    {
+        VGMFileDumper dumper(OPNChip_OPN2, 0, NULL, &sink);
+        REQUIRE(dumper.setRunningAtPcmRate(true));
+        dumper.setRate(44100, clockYM2612);
+
+        dumper.writeReg(0, 0x28, 0xF0);
+        dumper.writeLoopStart();
+        wait(dumper, 100);
+        dumper.writeReg(0, 0x28, 0x00);
+        dumper.writeLoopEnd();
+        REQUIRE(!dumper.overflowed());
+    }
+
+    REQUIRE(messages.size() == 3);
+    REQUIRE(messages[0] == "VGM: Loop start at 0x001F");
+    REQUIRE(messages[1] == "VGM: Loop end with total wait in 100 samples");
+    REQUIRE(messages[2] == "VGM: Can't open the output file no-such-directory/out.vgm");
+}
@@ -0,0 +1,279 @@
+/*
+ * Checks the channel allocation on a congested chip: the look-ahead mode
+ * steals the note which ends soon instead of cutting a long one.
+ * Also checks that prerendered drums take no chip channels and follow
+ * changes of their instruments, and the automatic count of chips.
+ */
+
+#include <catch.hpp>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#define OPNMIDI_UNSTABLE_API
+#include <opnmidi.h>
+#include "midi_builder.hpp"
+
+/*
+ * Five long notes on channels 0...4 and a short one on channel 5 fill all
+ * six channels of the chip, then a note on channel 6 comes 0.1 seconds
+ * before the short note ends.
+ */
+static std::vector<uint8_t> makeCongestedSong()
+{
+    std::vector<uint8_t> trk;
+    for(uint8_t c = 0; c < 5; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x90 + c), static_cast<uint8_t>(48 + c * 4), 100);
+    putEvent(trk, 96, 0x95, 72, 100);     // 0.5 s
+    putEvent(trk, 77, 0x96, 76, 100);     // 0.9 s
+    putEvent(trk, 19, 0x85, 72, 64);      // 1.0 s
+    putEvent(trk, 576, 0x86, 76, 64);     // 4.0 s
+    for(uint8_t c = 0; c < 5; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x80 + c), static_cast<uint8_t>(48 + c * 4), 64);
+    return makeMidiFile(trk);
+}
+
+/*
+ * Single snare drum hit
+ */
+static std::vector<uint8_t> makeDrumSong()
+{
+    std::vector<uint8_t> trk;
+    putEvent(trk, 0, 0x99, 38, 100);
+    putEvent(trk, 48, 0x89, 38, 64);
+    return makeMidiFile(trk);
+}
+
+static void play(OPN2_MIDIPlayer *device, int frames)
+{
+    std::vector<short> buf(1024);
+    while(frames > 0)
+    {
+        opn2_play(device, static_cast<int>(buf.size()), buf.data());
+        frames -= static_cast<int>(buf.size() / 2);
+    }
+}
+
+static std::vector<OPN2_ChipChannelState> chipStates(OPN2_MIDIPlayer *device)
+{
+    std::vector<OPN2_ChipChannelState> chip(64);
+    OPN2_ChannelsSnapshot s;
+    s.chipChannels = chip.data();
+    s.chipChannelsCapacity = chip.size();
+    s.midiChannels = NULL;
+    s.midiChannelsCapacity = 0;
+    REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+    chip.resize(std::min(s.chipChannelsCount, chip.size()));
+    return chip;
+}
+
+static size_t busyChannels(OPN2_MIDIPlayer *device)
+{
+    std::vector<OPN2_ChipChannelState> chip = chipStates(device);
+    size_t busy = 0;
+    for(size_t i = 0; i < chip.size(); ++i)
+        busy += (chip[i].state == OPNMIDI_ChipChan_KeyOn) ? 1 : 0;
+    return busy;
+}
+
+//! Count of the long notes still playing after the new note came
+static int playLongNotes(int chanAlloc, bool setBeforeLoad)
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    const std::vector<uint8_t> song = makeCongestedSong();
+
+    if(setBeforeLoad)
+        opn2_setChannelAllocMode(device, chanAlloc);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    if(!setBeforeLoad)
+        opn2_setChannelAllocMode(device, chanAlloc);
+
+    play(device, 44100 * 95 / 100);
+
+    OPN2_VoiceStats stats;
+    REQUIRE(opn2_getVoiceStats(device, &stats) == 0);
+    REQUIRE(stats.totalChannels == 6);
+    REQUIRE(stats.steals == 1);
+    REQUIRE(stats.drops == 0);
+
+    std::vector<OPN2_MidiChannelState> midi(16);
+    OPN2_ChannelsSnapshot s;
+    s.chipChannels = NULL;
+    s.chipChannelsCapacity = 0;
+    s.midiChannels = midi.data();
+    s.midiChannelsCapacity = midi.size();
+    REQUIRE(opn2_getChannelsSnapshot(device, &s) == 0);
+
+    // The new note is always played
+    REQUIRE(midi[6].activeNotes == 1);
+
+    int longNotes = 0;
+    for(size_t c = 0; c < 5; ++c)
+        longNotes += midi[c].activeNotes;
+
+    opn2_close(device);
+    return longNotes;
+}
+
+TEST_CASE("Look-ahead allocation steals the note which ends soon", "[voice-alloc]")
+{
+    // Without durations the oldest long note gets stolen
+    REQUIRE(playLongNotes(OPNMIDI_ChanAlloc_OffDelay, true) == 4);
+
+    // Durations get built on load, or later when the mode gets selected
+    REQUIRE(playLongNotes(OPNMIDI_ChanAlloc_LookAhead, true) == 5);
+    REQUIRE(playLongNotes(OPNMIDI_ChanAlloc_LookAhead, false) == 5);
+}
+
+TEST_CASE("Voice statistics keep their layout", "[voice-alloc]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    OPN2_VoiceStats stats;
+    REQUIRE(opn2_getVoiceStats(device, &stats) == 0);
+    for(size_t i = OPNMIDI_ChanAlloc_Count; i < OPNMIDI_VOICE_STATS_ALLOC_MODES; ++i)
+        REQUIRE(stats.releaseReuses[i] == 0);
+    opn2_close(device);
+}
+
+enum DrumChange
+{
+    Drum_Unchanged,
+    Drum_ChangedBeforeLoad,
+    Drum_ChangedAfterLoad
+};
+
+//! Render the drum song with the snare drum possibly replaced by the closed hi-hat
+static std::vector<short> playDrumSong(DrumChange change)
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    REQUIRE(opn2_setDacDrums(device, 1) == 0);
+    const std::vector<uint8_t> song = makeDrumSong();
+
+    OPN2_BankId id = {1, 0, 0};
+    OPN2_Bank bank;
+    OPN2_Instrument hihat;
+    REQUIRE(opn2_getBank(device, &id, 0, &bank) == 0);
+    REQUIRE(opn2_getInstrument(device, &bank, 42, &hihat) == 0);
+
+    if(change == Drum_ChangedBeforeLoad)
+        REQUIRE(opn2_setInstrument(device, &bank, 38, &hihat) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    if(change == Drum_ChangedAfterLoad)
+        REQUIRE(opn2_setInstrument(device, &bank, 38, &hihat) == 0);
+
+    std::vector<short> out(8192);
+    opn2_play(device, static_cast<int>(out.size()), out.data());
+    // The drum is played by the sample
+    REQUIRE(busyChannels(device) == 0);
+
+    opn2_close(device);
+    return out;
+}
+
+TEST_CASE("Prerendered drums follow changes of instruments", "[voice-alloc]")
+{
+    const std::vector<short> snare = playDrumSong(Drum_Unchanged);
+    const std::vector<short> before = playDrumSong(Drum_ChangedBeforeLoad);
+    const std::vector<short> after = playDrumSong(Drum_ChangedAfterLoad);
+
+    REQUIRE(before != snare);
+    REQUIRE(after == before);
+}
+
+TEST_CASE("Drums unknown to the song are played by FM channels", "[voice-alloc]")
+{
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    REQUIRE(opn2_setDacDrums(device, 1) == 0);
+    const std::vector<uint8_t> song = makeDrumSong();
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+
+    std::vector<short> buf(512);
+
+    // Prerendered by the load
+    opn2_rt_noteOn(device, 9, 38, 100);
+    opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+    REQUIRE(busyChannels(device) == 0);
+
+    // Not a part of the song, nothing gets rendered while playing
+    opn2_rt_noteOn(device, 9, 42, 100);
+    opn2_generate(device, static_cast<int>(buf.size()), buf.data());
+    REQUIRE(busyChannels(device) == 1);
+
+    opn2_close(device);
+}
+
+/*
+ * Four long notes on channels 0...3, and two bass drums (keys 35 and 36
+ * are both played by the bass drum rhythm voice of OPNA) at once
+ */
+static std::vector<uint8_t> makeWideSong()
+{
+    std::vector<uint8_t> trk;
+    for(uint8_t c = 0; c < 4; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x90 + c), static_cast<uint8_t>(48 + c * 4), 100);
+    putEvent(trk, 0, 0x99, 35, 100);
+    putEvent(trk, 0, 0x99, 36, 100);
+    putEvent(trk, 192, 0x89, 35, 64);
+    putEvent(trk, 0, 0x89, 36, 64);
+    for(uint8_t c = 0; c < 4; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x80 + c), static_cast<uint8_t>(48 + c * 4), 64);
+    return makeMidiFile(trk);
+}
+
+TEST_CASE("Automatic count of chips fits channels of the song", "[voice-alloc]")
+{
+    const std::vector<uint8_t> song = makeWideSong();
+
+    // Six notes on six FM channels of the chip
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    REQUIRE(opn2_setAutoNumChips(device, 8) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 1);
+
+    // Every chip has a single bass drum channel
+    opn2_setChipType(device, OPNMIDI_ChipType_OPNA);
+    REQUIRE(opn2_setOpnaExtraChannels(device, 1) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 2);
+
+    // The explicit count of chips turns the automatic choice off
+    REQUIRE(opn2_setNumChips(device, 3) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 3);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 3);
+
+    opn2_close(device);
+}
+
+TEST_CASE("Automatic count of chips counts SSG channels", "[voice-alloc]")
+{
+    std::vector<uint8_t> trk;
+    for(uint8_t c = 0; c < 7; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x90 + c), static_cast<uint8_t>(48 + c * 4), 100);
+    putEvent(trk, 192, 0x80, 48, 64);
+    for(uint8_t c = 1; c < 7; ++c)
+        putEvent(trk, 0, static_cast<uint8_t>(0x80 + c), static_cast<uint8_t>(48 + c * 4), 64);
+    const std::vector<uint8_t> song = makeMidiFile(trk);
+
+    OPN2_MIDIPlayer *device = openPlayer(OPNMIDI_EMU_MAME, 1);
+    REQUIRE(opn2_setAutoNumChips(device, 8) == 0);
+    opn2_setChipType(device, OPNMIDI_ChipType_OPNA);
+    REQUIRE(opn2_setOpnaExtraChannels(device, 1) == 0);
+
+    // Notes of regular instruments never go to SSG channels
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 2);
+
+    // The seventh note fits into SSG channels of the single chip
+    OPN2_BankId id = {0, 0, 0};
+    OPN2_Bank bank;
+    OPN2_Instrument piano;
+    REQUIRE(opn2_getBank(device, &id, 0, &bank) == 0);
+    REQUIRE(opn2_getInstrument(device, &bank, 0, &piano) == 0);
+    piano.inst_flags |= OPNMIDI_Ins_SSG;
+    REQUIRE(opn2_setInstrument(device, &bank, 0, &piano) == 0);
+    REQUIRE(opn2_openData(device, song.data(), static_cast<unsigned long>(song.size())) == 0);
+    REQUIRE(opn2_getNumChipsObtained(device) == 1);
+
+    opn2_close(device);
+}
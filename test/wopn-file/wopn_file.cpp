@@ -11,6 +11,7 @@ static const char *test_files[] = {
 };
 
 static WOPNFile *LoadBankFromFile(const char *path);
+static char *LoadRawFile(const char *path, size_t *size);
 
 TEST_CASE("[WOPNFile] Load, Save, Load")
 {
@@ -94,6 +95,86 @@ TEST_CASE("[WOPNFile] Load, Save, Load")
     }
 }
 
+TEST_CASE("[WOPNFile] Random access instruments load")
+{
+    for (const char *test_file : test_files) {
+        fprintf(stderr, "--- Test '%s'\n", test_file);
+
+        WOPNFile *wopn = LoadBankFromFile(test_file);
+        REQUIRE(wopn != nullptr);
+
+        size_t size = 0;
+        char *mem = LoadRawFile(test_file, &size);
+        REQUIRE(mem != nullptr);
+
+        WOPNFile info;
+        size_t ins_offset = 0;
+        REQUIRE(WOPN_LoadBankInfoFromMem(&info, mem, size, &ins_offset) == 0);
+        REQUIRE(info.version == wopn->version);
+        REQUIRE(info.banks_count_melodic == wopn->banks_count_melodic);
+        REQUIRE(info.banks_count_percussion == wopn->banks_count_percussion);
+        REQUIRE(info.lfo_freq == wopn->lfo_freq);
+        REQUIRE(info.chip_type == wopn->chip_type);
+        REQUIRE(info.banks_melodic == nullptr);
+        REQUIRE(info.banks_percussive == nullptr);
+
+        unsigned melo_banks = wopn->banks_count_melodic;
+        unsigned drum_banks = wopn->banks_count_percussion;
+        size_t ins_size = WOPN_BankInstRecordSize(info.version);
+
+        for(unsigned Bi = 0; Bi < melo_banks + drum_banks; ++Bi)
+        {
+            uint8_t is_drum = Bi >= melo_banks;
+            uint16_t index = is_drum ? (Bi - melo_banks) : Bi;
+            const WOPNBank &bank = is_drum ?
+                wopn->banks_percussive[index] : wopn->banks_melodic[index];
+
+            uint8_t msb = 0xFF, lsb = 0xFF;
+            REQUIRE(WOPN_LoadBankIdFromMem(mem, size, is_drum, index, &msb, &lsb) == 0);
+            REQUIRE(msb == bank.bank_midi_msb);
+            REQUIRE(lsb == bank.bank_midi_lsb);
+
+            for(unsigned Pi = 0; Pi < 128; ++Pi)
+            {
+                WOPNInstrument ins;
+                WOPN_LoadBankInstRecord(&ins, mem + ins_offset + ((size_t)Bi * 128 + Pi) * ins_size, info.version);
+                REQUIRE(memcmp(&ins, &bank.ins[Pi], sizeof(WOPNInstrument)) == 0);
+            }
+        }
+
+        uint8_t msb, lsb;
+        REQUIRE(WOPN_LoadBankIdFromMem(mem, size, 0, melo_banks, &msb, &lsb) == WOPN_ERR_INVALID_BANKS_COUNT);
+        REQUIRE(WOPN_LoadBankInfoFromMem(&info, mem, size / 2, &ins_offset) == WOPN_ERR_UNEXPECTED_ENDING);
+
+        delete[] mem;
+        WOPN_Free(wopn);
+    }
+}
+
+static char *LoadRawFile(const char *path, size_t *size)
+{
+    FILE *fh;
+    struct stat st;
+    char *mem = nullptr;
+
+    if(!(fh = fopen(path, "rb")) || fstat(fileno(fh), &st) != 0)
+        goto fail;
+
+    mem = new char[st.st_size];
+    if(fread(mem, st.st_size, 1, fh) != 1)
+    {
+        delete[] mem;
+        mem = nullptr;
+        goto fail;
+    }
+
+    *size = st.st_size;
+
+fail:
+    if (fh) fclose(fh);
+    return mem;
+}
+
 static WOPNFile *LoadBankFromFile(const char *path)
 {
     WOPNFile *file = nullptr;
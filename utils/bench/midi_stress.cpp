@@ -0,0 +1,227 @@
+/*
+ * Synthetic MIDI stress generator, an additional tool included with libOPNMIDI library
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "midi_stress.h"
+#include "midi_builder.hpp"
+
+// 120 BPM with 480 PPQN gives 960 ticks per second
+static const uint32_t c_division = 480;
+static const uint32_t c_tempo = 500000;
+static const double   c_ticksPerSecond = 960.0;
+
+MidiStressParams::MidiStressParams() :
+    duration(30.0),
+    notesPerSecond(40.0),
+    polyphony(12.0),
+    ccPerSecond(20.0),
+    channels(0xFDFF),
+    keyLow(36),
+    keyHigh(96),
+    seed(0x2612)
+{}
+
+bool MidiStressParams::setPreset(const char *name)
+{
+    if(!std::strcmp(name, "drums"))
+    {
+        // Dense drum track: short hits on the percussion channel only
+        notesPerSecond = 64.0;
+        polyphony = 8.0;
+        ccPerSecond = 4.0;
+        channels = 0x0200;
+        keyLow = 35;
+        keyHigh = 81;
+    }
+    else if(!std::strcmp(name, "pads"))
+    {
+        // Long notes on all 16 channels with heavy pitch bend and controller traffic
+        notesPerSecond = 16.0;
+        polyphony = 48.0;
+        ccPerSecond = 400.0;
+        channels = 0xFFFF;
+        keyLow = 36;
+        keyHigh = 84;
+    }
+    else if(!std::strcmp(name, "flood"))
+    {
+        // Black MIDI style note flood
+        notesPerSecond = 2000.0;
+        polyphony = 200.0;
+        ccPerSecond = 20.0;
+        channels = 0xFFFF;
+        keyLow = 21;
+        keyHigh = 108;
+    }
+    else
+        return false;
+    return true;
+}
+
+struct StressEvent
+{
+    uint32_t tick;
+    //! Order of events at the same tick: note-offs go before everything else
+    uint32_t order;
+    uint8_t data[3];
+    uint8_t size;
+
+    bool operator<(const StressEvent &o) const
+    {
+        if(tick != o.tick)
+            return tick < o.tick;
+        return order < o.order;
+    }
+};
+
+class StressRandom
+{
+    uint32_t m_state;
+public:
+    explicit StressRandom(uint32_t seed) : m_state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        // xorshift32
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    uint32_t range(uint32_t n)
+    {
+        return n ? next() % n : 0;
+    }
+};
+
+static void pushEvent(std::vector<StressEvent> &events, uint32_t tick, uint32_t order,
+                      uint8_t a, uint8_t b, uint8_t c, uint8_t size)
+{
+    StressEvent e;
+    e.tick = tick;
+    e.order = order;
+    e.data[0] = a;
+    e.data[1] = b;
+    e.data[2] = c;
+    e.size = size;
+    events.push_back(e);
+}
+
+void midiStressGenerate(const MidiStressParams &params, std::vector<uint8_t> &out)
+{
+    StressRandom rnd(params.seed);
+    std::vector<StressEvent> events;
+    std::vector<uint8_t> chans;
+
+    for(uint8_t ch = 0; ch < 16; ++ch)
+    {
+        if(params.channels & (1u << ch))
+            chans.push_back(ch);
+    }
+    if(chans.empty())
+        chans.push_back(0);
+
+    uint8_t keyLow = params.keyLow, keyHigh = params.keyHigh;
+    if(keyHigh < keyLow)
+        std::swap(keyLow, keyHigh);
+    if(keyHigh > 127)
+        keyHigh = 127;
+
+    const uint32_t length = static_cast<uint32_t>(params.duration * c_ticksPerSecond);
+
+    // Instruments and initial controllers
+    for(size_t i = 0; i < chans.size(); ++i)
+    {
+        uint8_t ch = chans[i];
+        pushEvent(events, 0, 1, static_cast<uint8_t>(0xC0 | ch), static_cast<uint8_t>(rnd.range(128)), 0, 2);
+        pushEvent(events, 0, 1, static_cast<uint8_t>(0xB0 | ch), 7, 100, 3);
+        pushEvent(events, 0, 1, static_cast<uint8_t>(0xB0 | ch), 10, static_cast<uint8_t>(rnd.range(128)), 3);
+    }
+
+    // Notes: the average note length keeps the requested polyphony
+    if(params.notesPerSecond > 0.0)
+    {
+        double noteLen = params.polyphony / params.notesPerSecond;
+        size_t count = static_cast<size_t>(params.duration * params.notesPerSecond);
+        for(size_t i = 0; i < count; ++i)
+        {
+            double start = (double(i) + double(rnd.range(1000)) / 1000.0) / params.notesPerSecond;
+            double len = noteLen * (0.5 + double(rnd.range(1000)) / 1000.0);
+            uint32_t on = static_cast<uint32_t>(start * c_ticksPerSecond);
+            uint32_t off = static_cast<uint32_t>((start + len) * c_ticksPerSecond);
+            if(off <= on)
+                off = on + 1;
+            if(on >= length)
+                break;
+            if(off > length)
+                off = length;
+
+            uint8_t ch = chans[rnd.range(static_cast<uint32_t>(chans.size()))];
+            uint8_t key = static_cast<uint8_t>(keyLow + rnd.range(keyHigh - keyLow + 1u));
+            uint8_t vel = static_cast<uint8_t>(40 + rnd.range(88));
+            pushEvent(events, on, 2, static_cast<uint8_t>(0x90 | ch), key, vel, 3);
+            pushEvent(events, off, 0, static_cast<uint8_t>(0x80 | ch), key, 0x40, 3);
+        }
+    }
+
+    // Pitch bends and controllers
+    if(params.ccPerSecond > 0.0)
+    {
+        size_t count = static_cast<size_t>(params.duration * params.ccPerSecond);
+        static const uint8_t controllers[] = {1, 7, 10, 11, 64};
+        for(size_t i = 0; i < count; ++i)
+        {
+            uint32_t tick = static_cast<uint32_t>((double(i) / params.ccPerSecond) * c_ticksPerSecond);
+            uint8_t ch = chans[rnd.range(static_cast<uint32_t>(chans.size()))];
+            if(i % 2 == 0)
+            {
+                uint32_t bend = rnd.range(0x4000);
+                pushEvent(events, tick, 1, static_cast<uint8_t>(0xE0 | ch),
+                          static_cast<uint8_t>(bend & 0x7F), static_cast<uint8_t>(bend >> 7), 3);
+            }
+            else
+            {
+                uint8_t cc = controllers[rnd.range(sizeof(controllers))];
+                uint8_t value = static_cast<uint8_t>(cc == 64 ? (rnd.range(2) ? 127 : 0) : rnd.range(128));
+                pushEvent(events, tick, 1, static_cast<uint8_t>(0xB0 | ch), cc, value, 3);
+            }
+        }
+    }
+
+    std::stable_sort(events.begin(), events.end());
+
+    std::vector<uint8_t> track;
+    putTempo(track, 0, c_tempo);
+
+    uint32_t lastTick = 0;
+    for(size_t i = 0; i < events.size(); ++i)
+    {
+        const StressEvent &e = events[i];
+        putVarLen(track, e.tick - lastTick);
+        lastTick = e.tick;
+        track.insert(track.end(), e.data, e.data + e.size);
+    }
+
+    putEndOfTrack(track, length > lastTick ? length - lastTick : 0);
+
+    out = makeMidiFile(std::vector<std::vector<uint8_t> >(1, track), c_division);
+}
@@ -0,0 +1,63 @@
+/*
+ * Synthetic MIDI stress generator, an additional tool included with libOPNMIDI library
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDI_STRESS_H
+#define MIDI_STRESS_H
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * @brief Parameters of the generated stress song
+ */
+struct MidiStressParams
+{
+    //! Length of the song in seconds
+    double duration;
+    //! Count of note-on events per second
+    double notesPerSecond;
+    //! Average count of simultaneously sounding notes
+    double polyphony;
+    //! Count of pitch bend and controller events per second
+    double ccPerSecond;
+    //! Bit mask of used MIDI channels (bit 0 is the first channel)
+    uint16_t channels;
+    //! Lowest and highest generated keys
+    uint8_t keyLow, keyHigh;
+    //! Seed of the pseudo-random generator, same seed gives the same song
+    uint32_t seed;
+
+    MidiStressParams();
+
+    /**
+     * @brief Set one of built-in presets
+     * @param name "drums", "pads" or "flood"
+     * @return false when the preset is unknown
+     */
+    bool setPreset(const char *name);
+};
+
+/**
+ * @brief Generate Standard MIDI File (format 0) by given parameters
+ * @param params Song parameters
+ * @param out Destination for the file data
+ */
+extern void midiStressGenerate(const MidiStressParams &params, std::vector<uint8_t> &out);
+
+#endif /* MIDI_STRESS_H */
@@ -0,0 +1,501 @@
+/*
+ * Emulator throughput benchmark, an additional tool included with libOPNMIDI library
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Drives every compiled-in chip emulator directly through the OPNChipBase
+ * interface with a deterministic register script and prints the measured
+ * throughput as JSON.
+ */
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+#include <opnmidi.h>
+#include "chips/opn_chip_base.h"
+
+#ifndef OPNMIDI_DISABLE_MAME_EMULATOR
+#include "chips/mame_opn2.h"
+#endif
+#ifndef OPNMIDI_DISABLE_NUKED_EMULATOR
+#include "chips/nuked_opn2.h"
+#endif
+#ifndef OPNMIDI_DISABLE_GENS_EMULATOR
+#include "chips/gens_opn2.h"
+#endif
+#ifndef OPNMIDI_DISABLE_NP2_EMULATOR
+#include "chips/np2_opna.h"
+#endif
+#ifndef OPNMIDI_DISABLE_MAME_2608_EMULATOR
+#include "chips/mame_opna.h"
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+#include "chips/ymfm_opn2.h"
+#include "chips/ymfm_opna.h"
+#endif
+#ifdef OPNMIDI_ENABLE_OPN2_LLE_EMULATOR
+#include "chips/ym2612_lle.h"
+#include "chips/ymf276_lle.h"
+#endif
+#ifdef OPNMIDI_ENABLE_OPNA_LLE_EMULATOR
+#include "chips/ym2608_lle.h"
+#endif
+
+static double nowSeconds()
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if(freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+}
+
+/* ======== Emulators ======== */
+
+struct Emulator
+{
+    //! Identifier to use with the -e argument
+    const char *id;
+    //! Chip family to create
+    OPNFamily family;
+    //! Heavy low-level emulators are skipped unless requested explicitly
+    bool heavy;
+    //! Constructs the chip in the place, or only reports the size of it when place is NULL
+    OPNChipBase *(*create)(OPNFamily family, void *place, size_t &size);
+};
+
+/*
+ * Constructs the chip with its emulator core in the given place,
+ * or only reports the size of the block when place is NULL
+ */
+#define BENCH_CHIP(name, Type, args) \
+    static OPNChipBase *name(OPNFamily f, void *place, size_t &size) \
+    { \
+        (void)f; \
+        size = opn_chipBlockSize<Type>(); \
+        return place ? new(place) Type args : NULL; \
+    }
+
+#ifndef OPNMIDI_DISABLE_MAME_EMULATOR
+BENCH_CHIP(createMame, MameOPN2, (f))
+#endif
+#ifndef OPNMIDI_DISABLE_NUKED_EMULATOR
+BENCH_CHIP(createNuked3438, NukedOPN2, (f, true, opn_chipCore<NukedOPN2>(place)))
+BENCH_CHIP(createNuked2612, NukedOPN2, (f, false, opn_chipCore<NukedOPN2>(place)))
+#endif
+#ifndef OPNMIDI_DISABLE_GENS_EMULATOR
+BENCH_CHIP(createGens, GensOPN2, (f, opn_chipCore<GensOPN2>(place)))
+#endif
+#ifndef OPNMIDI_DISABLE_NP2_EMULATOR
+BENCH_CHIP(createNP2, NP2OPNA<>, (f, opn_chipCore<NP2OPNA<> >(place)))
+#endif
+#ifndef OPNMIDI_DISABLE_MAME_2608_EMULATOR
+BENCH_CHIP(createMame2608, MameOPNA, (f, opn_chipCore<MameOPNA>(place)))
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+BENCH_CHIP(createYmFmOPN2, YmFmOPN2, (f, opn_chipCore<YmFmOPN2>(place)))
+BENCH_CHIP(createYmFmOPNA, YmFmOPNA, (f, opn_chipCore<YmFmOPNA>(place)))
+#endif
+#ifdef OPNMIDI_ENABLE_OPN2_LLE_EMULATOR
+BENCH_CHIP(createLLE2612, Ym2612LLEOPN2, (f))
+BENCH_CHIP(createLLE3438, Ymf276LLEOPN2, (f, false))
+BENCH_CHIP(createLLE276, Ymf276LLEOPN2, (f, true))
+#endif
+#ifdef OPNMIDI_ENABLE_OPNA_LLE_EMULATOR
+BENCH_CHIP(createLLE2608, Ym2608LLEOPNA, (f))
+#endif
+
+#undef BENCH_CHIP
+
+static const Emulator g_emulators[] =
+{
+#ifndef OPNMIDI_DISABLE_MAME_EMULATOR
+    {"mame", OPNChip_OPN2, false, &createMame},
+#endif
+#ifndef OPNMIDI_DISABLE_NUKED_EMULATOR
+    {"nuked-ym3438", OPNChip_OPN2, false, &createNuked3438},
+    {"nuked-ym2612", OPNChip_OPN2, false, &createNuked2612},
+#endif
+#ifndef OPNMIDI_DISABLE_GENS_EMULATOR
+    {"gens", OPNChip_OPN2, false, &createGens},
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+    {"ymfm-opn2", OPNChip_OPN2, false, &createYmFmOPN2},
+#endif
+#ifndef OPNMIDI_DISABLE_NP2_EMULATOR
+    {"np2", OPNChip_OPNA, false, &createNP2},
+#endif
+#ifndef OPNMIDI_DISABLE_MAME_2608_EMULATOR
+    {"mame-2608", OPNChip_OPNA, false, &createMame2608},
+#endif
+#ifndef OPNMIDI_DISABLE_YMFM_EMULATOR
+    {"ymfm-opna", OPNChip_OPNA, false, &createYmFmOPNA},
+#endif
+#ifdef OPNMIDI_ENABLE_OPN2_LLE_EMULATOR
+    {"lle-ym2612", OPNChip_OPN2, true, &createLLE2612},
+    {"lle-ym3438", OPNChip_OPN2, true, &createLLE3438},
+    {"lle-ymf276", OPNChip_OPN2, true, &createLLE276},
+#endif
+#ifdef OPNMIDI_ENABLE_OPNA_LLE_EMULATOR
+    {"lle-ym2608", OPNChip_OPNA, true, &createLLE2608},
+#endif
+    {NULL, OPNChip_OPN2, false, NULL}
+};
+
+/* ======== Register script ======== */
+
+/**
+ * @brief Deterministic register script: all six channels always sounding,
+ * one note re-triggered with a new pitch every 10 milliseconds
+ */
+class RegScript
+{
+    uint32_t m_seed;
+    bool m_lfo;
+
+    uint32_t random()
+    {
+        m_seed = m_seed * 1103515245u + 12345u;
+        return (m_seed >> 16) & 0x7FFF;
+    }
+
+    static void keyOn(OPNChipBase *chip, unsigned ch, bool on)
+    {
+        uint8_t slot = static_cast<uint8_t>(ch < 3 ? ch : ch + 1);
+        chip->writeReg(0, 0x28, static_cast<uint8_t>((on ? 0xF0 : 0x00) | slot));
+    }
+
+    static void setPitch(OPNChipBase *chip, unsigned ch, unsigned block, unsigned fnum)
+    {
+        uint32_t port = ch / 3, cc = ch % 3;
+        chip->writeReg(port, static_cast<uint16_t>(0xA4 + cc), static_cast<uint8_t>((block << 3) | ((fnum >> 8) & 7)));
+        chip->writeReg(port, static_cast<uint16_t>(0xA0 + cc), static_cast<uint8_t>(fnum & 0xFF));
+    }
+
+public:
+    explicit RegScript(bool lfo) : m_seed(0x2612), m_lfo(lfo) {}
+
+    void init(OPNChipBase *chip)
+    {
+        static const uint8_t ops[4][6] =
+        {
+            /* DT/MUL, TL,  KS/AR, AM/D1R, D2R,  SL/RR */
+            {0x71,     0x23, 0x5F, 0x05,   0x02, 0x11},
+            {0x0D,     0x2D, 0x99, 0x05,   0x02, 0x11},
+            {0x33,     0x26, 0x5F, 0x05,   0x02, 0x11},
+            {0x01,     0x00, 0x94, 0x07,   0x02, 0xA6}
+        };
+
+        chip->writeReg(0, 0x22, m_lfo ? 0x0B : 0x00);
+        chip->writeReg(0, 0x27, 0x00);
+        chip->writeReg(0, 0x2B, 0x00); // DAC off
+
+        for(unsigned ch = 0; ch < 6; ++ch)
+        {
+            uint32_t port = ch / 3, cc = ch % 3;
+            for(unsigned op = 0; op < 4; ++op)
+            {
+                uint16_t o = static_cast<uint16_t>(cc + op * 4);
+                chip->writeReg(port, 0x30 + o, ops[op][0]);
+                chip->writeReg(port, 0x40 + o, ops[op][1]);
+                chip->writeReg(port, 0x50 + o, ops[op][2]);
+                chip->writeReg(port, 0x60 + o, static_cast<uint8_t>(ops[op][3] | (m_lfo ? 0x80 : 0x00)));
+                chip->writeReg(port, 0x70 + o, ops[op][4]);
+                chip->writeReg(port, 0x80 + o, ops[op][5]);
+                chip->writeReg(port, 0x90 + o, 0x00);
+            }
+            chip->writeReg(port, static_cast<uint16_t>(0xB0 + cc), 0x32);
+            chip->writeReg(port, static_cast<uint16_t>(0xB4 + cc), m_lfo ? 0xF3 : 0xC0);
+            setPitch(chip, ch, 3 + ch % 3, 0x269 + ch * 16);
+            keyOn(chip, ch, true);
+        }
+    }
+
+    void event(OPNChipBase *chip)
+    {
+        unsigned ch = random() % 6;
+        keyOn(chip, ch, false);
+        setPitch(chip, ch, 2 + random() % 4, 0x200 + random() % 0x200);
+        keyOn(chip, ch, true);
+    }
+};
+
+/* ======== Benchmark ======== */
+
+struct BenchConfig
+{
+    const Emulator *emu;
+    unsigned rate;
+    bool pcmRate;
+    bool lfo;
+    unsigned chips;
+};
+
+struct BenchResult
+{
+    std::string name;
+    unsigned long frames;
+    double seconds;
+};
+
+//! Chip with its emulator core in one block, like the library makes it
+static OPNChipBase *makeChip(const Emulator *emu, std::vector<void *> &blocks)
+{
+    size_t size = 0;
+    emu->create(emu->family, NULL, size);
+    void *block = std::malloc(size);
+    if(!block)
+        return NULL;
+    blocks.push_back(block);
+    return emu->create(emu->family, block, size);
+}
+
+static void freeChips(std::vector<OPNChipBase *> &chips, std::vector<void *> &blocks)
+{
+    for(size_t i = 0; i < chips.size(); ++i)
+        chips[i]->~OPNChipBase();
+    for(size_t i = 0; i < blocks.size(); ++i)
+        std::free(blocks[i]);
+    chips.clear();
+    blocks.clear();
+}
+
+static bool runBench(const BenchConfig &cfg, double duration, BenchResult &res)
+{
+    std::vector<OPNChipBase *> chips;
+    std::vector<void *> blocks;
+    std::vector<RegScript> scripts;
+
+    for(unsigned i = 0; i < cfg.chips; ++i)
+    {
+        OPNChipBase *chip = makeChip(cfg.emu, blocks);
+        if(!chip)
+        {
+            freeChips(chips, blocks);
+            return false;
+        }
+        chips.push_back(chip);
+        chip->setChipId(i);
+        chip->setRate(cfg.rate, chip->nativeClockRate());
+        if(cfg.pcmRate && !chip->setRunningAtPcmRate(true))
+        {
+            freeChips(chips, blocks);
+            return false;
+        }
+        scripts.push_back(RegScript(cfg.lfo));
+        scripts.back().init(chip);
+    }
+
+    res.name = chips[0]->emulatorName();
+
+    const unsigned long total = static_cast<unsigned long>(duration * cfg.rate);
+    unsigned long eventPeriod = cfg.rate / 100;
+    if(eventPeriod < 1)
+        eventPeriod = 1;
+    std::vector<int32_t> buf(512 * 2);
+    unsigned long done = 0, nextEvent = eventPeriod;
+
+    double start = nowSeconds();
+    while(done < total)
+    {
+        size_t frames = 512;
+        if(frames > total - done)
+            frames = total - done;
+        if(frames > nextEvent - done)
+            frames = nextEvent - done;
+
+        std::memset(&buf[0], 0, frames * 2 * sizeof(int32_t));
+        if(cfg.chips == 1)
+            chips[0]->generate32(&buf[0], frames);
+        else for(unsigned i = 0; i < cfg.chips; ++i)
+            chips[i]->generateAndMix32(&buf[0], frames);
+        done += static_cast<unsigned long>(frames);
+
+        if(done == nextEvent)
+        {
+            for(unsigned i = 0; i < cfg.chips; ++i)
+                scripts[i].event(chips[i]);
+            nextEvent += eventPeriod;
+        }
+    }
+    res.seconds = nowSeconds() - start;
+    res.frames = done;
+
+    freeChips(chips, blocks);
+    return true;
+}
+
+static void printUsage(const char *prog)
+{
+    std::fprintf(stderr,
+        "Emulator throughput benchmark for libOPNMIDI " OPNMIDI_VERSION "\n"
+        "\n"
+        "Syntax: %s [options]\n"
+        "\n"
+        " -o <file>    Write JSON into the file instead of standard output\n"
+        " -t <sec>     Seconds of audio to render per measurement (default 1.0)\n"
+        " -c <count>   Maximum number of chips; 1, 2, 4... up to this count are measured (default 4)\n"
+        " -r <rate>    Add an output sample rate, 1000 or more (default 22050, 44100 and 48000)\n"
+        " -e <id>      Measure only given emulator, can be repeated\n"
+        " -l           List emulators and exit\n"
+        "\n"
+        "Heavy LLE emulators are only measured when requested by -e.\n"
+        "\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *outPath = NULL;
+    double duration = 1.0;
+    unsigned maxChips = 4;
+    std::vector<unsigned> rates;
+    std::vector<std::string> selected;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        bool hasArg = (i + 1 < argc);
+        if(!std::strcmp(argv[i], "-o") && hasArg)
+            outPath = argv[++i];
+        else if(!std::strcmp(argv[i], "-t") && hasArg)
+            duration = std::atof(argv[++i]);
+        else if(!std::strcmp(argv[i], "-c") && hasArg)
+            maxChips = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if(!std::strcmp(argv[i], "-r") && hasArg)
+            rates.push_back(static_cast<unsigned>(std::atoi(argv[++i])));
+        else if(!std::strcmp(argv[i], "-e") && hasArg)
+            selected.push_back(argv[++i]);
+        else if(!std::strcmp(argv[i], "-l"))
+        {
+            for(const Emulator *e = g_emulators; e->id; ++e)
+                std::printf("%s%s\n", e->id, e->heavy ? " (heavy)" : "");
+            return 0;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(duration <= 0.0 || maxChips < 1 || maxChips > 100)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    for(size_t r = 0; r < rates.size(); ++r)
+    {
+        if(rates[r] < 1000)
+        {
+            std::fprintf(stderr, "Sample rate %u is too low\n", rates[r]);
+            return 1;
+        }
+    }
+
+    if(rates.empty())
+    {
+        rates.push_back(22050);
+        rates.push_back(44100);
+        rates.push_back(48000);
+    }
+
+    std::vector<unsigned> chipCounts;
+    for(unsigned c = 1; c < maxChips; c *= 2)
+        chipCounts.push_back(c);
+    chipCounts.push_back(maxChips);
+
+    FILE *out = stdout;
+    if(outPath)
+    {
+        out = std::fopen(outPath, "w");
+        if(!out)
+        {
+            std::fprintf(stderr, "Can't open %s for writing\n", outPath);
+            return 1;
+        }
+    }
+
+    std::fprintf(out, "{\n  \"library\": \"%s\",\n  \"duration\": %g,\n  \"results\": [", OPNMIDI_VERSION, duration);
+
+    bool first = true;
+    for(const Emulator *e = g_emulators; e->id; ++e)
+    {
+        bool wanted = selected.empty() ? !e->heavy : false;
+        for(size_t i = 0; i < selected.size(); ++i)
+            wanted |= (selected[i] == e->id);
+        if(!wanted)
+            continue;
+
+        for(size_t r = 0; r < rates.size(); ++r)
+        for(int pcmRate = 0; pcmRate < 2; ++pcmRate)
+        for(int lfo = 0; lfo < 2; ++lfo)
+        for(size_t c = 0; c < chipCounts.size(); ++c)
+        {
+            BenchConfig cfg;
+            cfg.emu = e;
+            cfg.rate = rates[r];
+            cfg.pcmRate = (pcmRate != 0);
+            cfg.lfo = (lfo != 0);
+            cfg.chips = chipCounts[c];
+
+            BenchResult res;
+            if(!runBench(cfg, duration, res))
+                continue; // PCM-rate mode is not supported by this emulator
+
+            double nsPerSample = res.seconds * 1e9 / (double)res.frames;
+            std::fprintf(stderr, "%-14s %6u Hz %-8s %-7s %3u chip(s): %10.1f ns/sample\n",
+                         e->id, cfg.rate, cfg.pcmRate ? "pcm-rate" : "native",
+                         cfg.lfo ? "lfo" : "no-lfo", cfg.chips, nsPerSample);
+
+            std::fprintf(out,
+                "%s\n    {\"emulator\": \"%s\", \"name\": \"%s\", \"family\": \"%s\", "
+                "\"rate\": %u, \"pcmRate\": %s, \"lfo\": %s, \"chips\": %u, "
+                "\"frames\": %lu, \"seconds\": %.6f, \"samplesPerSecond\": %.1f, "
+                "\"nsPerSample\": %.3f, \"realtimeFactor\": %.3f}",
+                first ? "" : ",",
+                e->id, res.name.c_str(), e->family == OPNChip_OPNA ? "OPNA" : "OPN2",
+                cfg.rate, cfg.pcmRate ? "true" : "false", cfg.lfo ? "true" : "false", cfg.chips,
+                res.frames, res.seconds, (double)res.frames / res.seconds,
+                nsPerSample, ((double)res.frames / cfg.rate) / res.seconds);
+            first = false;
+        }
+    }
+
+    std::fprintf(out, "\n  ]\n}\n");
+    if(out != stdout)
+        std::fclose(out);
+
+    return 0;
+}
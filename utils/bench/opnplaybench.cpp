@@ -0,0 +1,387 @@
+/*
+ * End-to-end player benchmark, an additional tool included with libOPNMIDI library
+ *
+ * Copyright (c) 2017-2026 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Plays generated stress songs through the public API in fixed-size
+ * buffers, like an audio callback would, and prints the timings as JSON.
+ */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+#include <opnmidi.h>
+#include "midi_stress.h"
+
+#ifndef DEFAULT_BANK_PATH
+#define DEFAULT_BANK_PATH "xg.wopn"
+#endif
+
+static double nowSeconds()
+{
+#if defined(_WIN32)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER t;
+    if(freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+}
+
+/* ======== Latency histogram ======== */
+
+static const double c_bucketsUs[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
+static const size_t c_bucketsCount = sizeof(c_bucketsUs) / sizeof(double);
+
+struct Histogram
+{
+    std::vector<double> samples;
+
+    double percentile(double p) const
+    {
+        if(samples.empty())
+            return 0.0;
+        std::vector<double> s(samples);
+        std::sort(s.begin(), s.end());
+        size_t i = static_cast<size_t>(p * double(s.size() - 1) + 0.5);
+        return s[i];
+    }
+
+    void print(FILE *out) const
+    {
+        std::vector<unsigned long> counts(c_bucketsCount + 1, 0);
+        for(size_t i = 0; i < samples.size(); ++i)
+        {
+            size_t b = 0;
+            while(b < c_bucketsCount && samples[i] > c_bucketsUs[b])
+                ++b;
+            ++counts[b];
+        }
+
+        std::fprintf(out, "{\"count\": %lu, \"p50Us\": %.2f, \"p99Us\": %.2f, \"maxUs\": %.2f, \"buckets\": [",
+                     (unsigned long)samples.size(), percentile(0.5), percentile(0.99), percentile(1.0));
+        for(size_t b = 0; b <= c_bucketsCount; ++b)
+        {
+            if(b < c_bucketsCount)
+                std::fprintf(out, "%s{\"leUs\": %g, \"count\": %lu}", b ? ", " : "", c_bucketsUs[b], counts[b]);
+            else
+                std::fprintf(out, ", {\"leUs\": null, \"count\": %lu}", counts[b]);
+        }
+        std::fprintf(out, "]}");
+    }
+};
+
+/* ======== Event tracking ======== */
+
+/**
+ * Note-on events are counted by the raw event hook to tell buffers
+ * which have to allocate voices from other ones.
+ */
+struct PlayState
+{
+    unsigned long noteOns;
+    unsigned long noteOnsInBuffer;
+
+    PlayState() :
+        noteOns(0), noteOnsInBuffer(0)
+    {}
+};
+
+static void rawEventHook(void *userdata, OPN2_UInt8 type, OPN2_UInt8 subtype, OPN2_UInt8 channel, const OPN2_UInt8 *data, size_t len)
+{
+    PlayState *st = reinterpret_cast<PlayState *>(userdata);
+    (void)subtype;
+    (void)channel;
+    if(type == 0x9 && len >= 2 && data[1] != 0)
+    {
+        ++st->noteOns;
+        ++st->noteOnsInBuffer;
+    }
+}
+
+/* ======== Benchmark ======== */
+
+struct PlayConfig
+{
+    std::string preset;
+    MidiStressParams params;
+    int emulator;
+    int chips;
+    long rate;
+    int bufferFrames;
+    std::string bankPath;
+};
+
+static bool runPlay(const PlayConfig &cfg, FILE *out, bool first)
+{
+    std::vector<uint8_t> song;
+    midiStressGenerate(cfg.params, song);
+
+    OPN2_MIDIPlayer *p = opn2_init(cfg.rate);
+    if(!p)
+    {
+        std::fprintf(stderr, "Failed to initialize libOPNMIDI: %s\n", opn2_errorString());
+        return false;
+    }
+
+    if(opn2_switchEmulator(p, cfg.emulator) < 0 ||
+       opn2_setNumChips(p, cfg.chips) < 0 ||
+       opn2_openBankFile(p, cfg.bankPath.c_str()) < 0 ||
+       opn2_openData(p, &song[0], static_cast<unsigned long>(song.size())) < 0)
+    {
+        std::fprintf(stderr, "Failed to prepare the player: %s\n", opn2_errorInfo(p));
+        opn2_close(p);
+        return false;
+    }
+
+    PlayState st;
+    opn2_setRawEventHook(p, &rawEventHook, &st);
+
+    std::vector<short> buf(static_cast<size_t>(cfg.bufferFrames) * 2);
+    Histogram all, noteOn;
+    const double deadline = double(cfg.bufferFrames) / double(cfg.rate);
+    unsigned long frames = 0, misses = 0;
+    double total = 0.0;
+
+    for(;;)
+    {
+        st.noteOnsInBuffer = 0;
+        double t0 = nowSeconds();
+        int got = opn2_play(p, cfg.bufferFrames * 2, &buf[0]);
+        double t = nowSeconds() - t0;
+        if(got <= 0)
+            break;
+
+        frames += static_cast<unsigned long>(got / 2);
+        total += t;
+        all.samples.push_back(t * 1e6);
+        if(st.noteOnsInBuffer > 0)
+            noteOn.samples.push_back(t * 1e6);
+        if(t > deadline)
+            ++misses;
+    }
+
+    OPN2_VoiceStats vs;
+    opn2_getVoiceStats(p, &vs);
+
+    const char *emuName = opn2_chipEmulatorName(p);
+    double audio = double(frames) / double(cfg.rate);
+    std::fprintf(stderr, "%-6s %-22s %3d chip(s): %8.2fx realtime, %lu note-ons, %lu steals, %lu drops, note-on p99 %.1f us\n",
+                 cfg.preset.c_str(), emuName, cfg.chips, audio / total, st.noteOns, vs.steals, vs.drops, noteOn.percentile(0.99));
+
+    std::fprintf(out,
+        "%s\n    {\"preset\": \"%s\", \"emulator\": \"%s\", \"chips\": %d, \"rate\": %ld, \"bufferFrames\": %d,\n"
+        "     \"params\": {\"duration\": %g, \"notesPerSecond\": %g, \"polyphony\": %g, \"ccPerSecond\": %g, \"channels\": %u, \"seed\": %lu},\n"
+        "     \"songBytes\": %lu, \"frames\": %lu, \"seconds\": %.6f, \"realtimeFactor\": %.3f,\n"
+        "     \"noteOns\": %lu, \"voiceSteals\": %lu, \"voiceDrops\": %lu, \"peakChannels\": %u, \"deadlineMisses\": %lu,\n"
+        "     \"bufferLatency\": ",
+        first ? "" : ",",
+        cfg.preset.c_str(), emuName, cfg.chips, cfg.rate, cfg.bufferFrames,
+        cfg.params.duration, cfg.params.notesPerSecond, cfg.params.polyphony, cfg.params.ccPerSecond,
+        (unsigned)cfg.params.channels, (unsigned long)cfg.params.seed,
+        (unsigned long)song.size(), frames, total, audio / total,
+        st.noteOns, vs.steals, vs.drops, vs.peakChannels, misses);
+    all.print(out);
+    std::fprintf(out, ",\n     \"noteOnLatency\": ");
+    noteOn.print(out);
+    std::fprintf(out, "}");
+
+    opn2_close(p);
+    return true;
+}
+
+static void printUsage(const char *prog)
+{
+    std::fprintf(stderr,
+        "End-to-end player benchmark for libOPNMIDI " OPNMIDI_VERSION "\n"
+        "\n"
+        "Syntax: %s [options]\n"
+        "\n"
+        " -s <preset>    Song preset: drums, pads, flood or custom (default: all three presets)\n"
+        " -t <sec>       Song length in seconds (default 30)\n"
+        " --nps <n>      Note-ons per second\n"
+        " --poly <n>     Average polyphony\n"
+        " --cc <n>       Pitch bend and controller events per second\n"
+        " --channels <m> Hexadecimal mask of used MIDI channels\n"
+        " --seed <n>     Seed of the song generator\n"
+        " -e <emu>       Emulator ID as in OPNMIDI_Emulator (default 0, MAME YM2612)\n"
+        " -n <chips>     Number of chips (default 4)\n"
+        " -r <rate>      Output sample rate (default 44100)\n"
+        " -B <frames>    Size of the rendered buffer (default 256)\n"
+        " -b <bank>      WOPN bank file (default %s)\n"
+        " -w <file>      Write the generated MIDI file of the first preset and exit\n"
+        " -o <file>      Write JSON into the file instead of standard output\n"
+        "\n", prog, DEFAULT_BANK_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    PlayConfig base;
+    std::vector<std::string> presets;
+    const char *outPath = NULL, *midiPath = NULL;
+    bool haveDuration = false;
+    double duration = 30.0;
+    // Custom values override presets
+    double nps = -1.0, poly = -1.0, cc = -1.0;
+    long channels = -1, seed = -1;
+
+    base.emulator = 0;
+    base.chips = 4;
+    base.rate = 44100;
+    base.bufferFrames = 256;
+    base.bankPath = DEFAULT_BANK_PATH;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        bool hasArg = (i + 1 < argc);
+        const char *a = argv[i];
+        if(!std::strcmp(a, "-s") && hasArg)
+            presets.push_back(argv[++i]);
+        else if(!std::strcmp(a, "-t") && hasArg)
+        {
+            duration = std::atof(argv[++i]);
+            haveDuration = true;
+        }
+        else if(!std::strcmp(a, "--nps") && hasArg)
+            nps = std::atof(argv[++i]);
+        else if(!std::strcmp(a, "--poly") && hasArg)
+            poly = std::atof(argv[++i]);
+        else if(!std::strcmp(a, "--cc") && hasArg)
+            cc = std::atof(argv[++i]);
+        else if(!std::strcmp(a, "--channels") && hasArg)
+            channels = std::strtol(argv[++i], NULL, 16);
+        else if(!std::strcmp(a, "--seed") && hasArg)
+            seed = std::strtol(argv[++i], NULL, 0);
+        else if(!std::strcmp(a, "-e") && hasArg)
+            base.emulator = std::atoi(argv[++i]);
+        else if(!std::strcmp(a, "-n") && hasArg)
+            base.chips = std::atoi(argv[++i]);
+        else if(!std::strcmp(a, "-r") && hasArg)
+            base.rate = std::atol(argv[++i]);
+        else if(!std::strcmp(a, "-B") && hasArg)
+            base.bufferFrames = std::atoi(argv[++i]);
+        else if(!std::strcmp(a, "-b") && hasArg)
+            base.bankPath = argv[++i];
+        else if(!std::strcmp(a, "-w") && hasArg)
+            midiPath = argv[++i];
+        else if(!std::strcmp(a, "-o") && hasArg)
+            outPath = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(base.bufferFrames < 1 || base.rate < 1 || base.chips < 1 || duration <= 0.0)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if(presets.empty())
+    {
+        presets.push_back("drums");
+        presets.push_back("pads");
+        presets.push_back("flood");
+    }
+
+    std::vector<PlayConfig> configs;
+    for(size_t i = 0; i < presets.size(); ++i)
+    {
+        PlayConfig cfg = base;
+        cfg.preset = presets[i];
+        if(cfg.preset != "custom" && !cfg.params.setPreset(cfg.preset.c_str()))
+        {
+            std::fprintf(stderr, "Unknown preset %s\n", cfg.preset.c_str());
+            return 1;
+        }
+        if(haveDuration)
+            cfg.params.duration = duration;
+        if(nps >= 0.0)
+            cfg.params.notesPerSecond = nps;
+        if(poly >= 0.0)
+            cfg.params.polyphony = poly;
+        if(cc >= 0.0)
+            cfg.params.ccPerSecond = cc;
+        if(channels >= 0)
+            cfg.params.channels = static_cast<uint16_t>(channels);
+        if(seed >= 0)
+            cfg.params.seed = static_cast<uint32_t>(seed);
+        configs.push_back(cfg);
+    }
+
+    if(midiPath)
+    {
+        std::vector<uint8_t> song;
+        midiStressGenerate(configs[0].params, song);
+        FILE *f = std::fopen(midiPath, "wb");
+        if(!f || std::fwrite(&song[0], 1, song.size(), f) != song.size())
+        {
+            std::fprintf(stderr, "Can't write %s\n", midiPath);
+            if(f)
+                std::fclose(f);
+            return 1;
+        }
+        std::fclose(f);
+        return 0;
+    }
+
+    FILE *out = stdout;
+    if(outPath)
+    {
+        out = std::fopen(outPath, "w");
+        if(!out)
+        {
+            std::fprintf(stderr, "Can't open %s for writing\n", outPath);
+            return 1;
+        }
+    }
+
+    std::fprintf(out, "{\n  \"library\": \"%s\",\n  \"results\": [", OPNMIDI_VERSION);
+    int ret = 0;
+    for(size_t i = 0; i < configs.size(); ++i)
+    {
+        if(!runPlay(configs[i], out, i == 0))
+        {
+            ret = 1;
+            break;
+        }
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+
+    if(out != stdout)
+        std::fclose(out);
+
+    return ret;
+}
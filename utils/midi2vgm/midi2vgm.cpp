@@ -29,7 +29,7 @@
 #include <algorithm>
 #include <signal.h>
 
-#include "compact/vgm_cmp.h"
+#include <zlib.h>
 
 #if defined(_MSC_VER) && _MSC_VER < 1900
 
@@ -63,11 +63,6 @@ __inline int c99_snprintf(char *outBuf, size_t size, const char *format, ...)
 
 #include <opnmidi.h>
 
-extern "C"
-{
-    extern OPNMIDI_DECLSPEC void opn2_set_vgm_out_path(const char *path);
-}
-
 const char* volume_model_to_str(int vm)
 {
     switch(vm)
@@ -99,6 +94,8 @@ const char* chanalloc_to_str(int vm)
         return "Same instrument";
     case OPNMIDI_ChanAlloc_AnyReleased:
         return "Any released";
+    case OPNMIDI_ChanAlloc_LookAhead:
+        return "Look-ahead";
     }
 }
 
@@ -108,6 +105,19 @@ static void printError(const char *err)
     std::fflush(stderr);
 }
 
+static void writeVgzFile(void *userdata, const OPN2_UInt8 *data, size_t size)
+{
+    const char *path = reinterpret_cast<const char *>(userdata);
+    gzFile f_out = gzopen(path, "wb");
+    if(!f_out)
+    {
+        printError("Can't open the output file!");
+        return;
+    }
+    gzwrite(f_out, data, static_cast<unsigned>(size));
+    gzclose(f_out);
+}
+
 static int stop = 0;
 static void sighandler(int dum)
 {
@@ -237,6 +247,7 @@ int main(int argc, char **argv)
             "    0 Sounding delay"
             "    1 Released channel with the same instrument"
             "    2 Any released channel"
+            "    3 Sounding delay, steal notes which end soonest"
             " -na               Disables the automatical arpeggio\n"
             " -z                Make a compressed VGZ file\n"
             " -frb              Enables full-ranged CC74 XG Brightness controller\n"
@@ -253,9 +264,6 @@ int main(int argc, char **argv)
             "\n"
             "TIP-2: Use addional WOPN bank files to alter sounding of generated song.\n"
             "\n"
-            "TIP-3: Use \"vgm_cmp\" tool from 'VGM Tools' toolchain to optimize size of\n"
-            "       generated VGM song when it appears too bug (300+, 500+, or even 1000+ KB).\n"
-            "\n"
         );
         std::fflush(stdout);
 
@@ -389,7 +397,6 @@ int main(int argc, char **argv)
     }
 
     std::string vgm_out = musPath + (makeVgz ? ".vgz" : ".vgm");
-    opn2_set_vgm_out_path(vgm_out.c_str());
 
     myDevice = opn2_init(sampleRate);
     if(!myDevice)
@@ -398,6 +405,11 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    if(makeVgz)
+        opn2_setVgmWriteHook(myDevice, writeVgzFile, const_cast<char *>(vgm_out.c_str()));
+    else
+        opn2_setVgmOutPath(myDevice, vgm_out.c_str());
+
     //Set internal debug messages hook to print all libADLMIDI's internal debug messages
     opn2_setDebugMessageHook(myDevice, debugPrint, NULL);
 
@@ -517,11 +529,15 @@ int main(int argc, char **argv)
     std::fprintf(stdout, "\n==========================================\n");
     std::fflush(stdout);
 
-    short buff[4096];
     while(!stop)
     {
-        size_t got = (size_t)opn2_play(myDevice, 4096, buff);
-        if(got <= 0)
+        int ret = opn2_tickVgmDump(myDevice);
+        if(ret < 0)
+        {
+            printError(opn2_errorInfo(myDevice));
+            break;
+        }
+        else if(ret == 0)
             break;
     }
     std::fprintf(stdout, "                                               \n\n");
@@ -535,7 +551,6 @@ int main(int argc, char **argv)
     else
     {
         opn2_close(myDevice);
-        VgmCMP::vgm_cmp_main(vgm_out, makeVgz);
         std::fprintf(stdout, "Completed!\n");
         std::fflush(stdout);
     }
@@ -27,6 +27,13 @@
 #include <cmath>
 #include <cctype>
 #include <cstring>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <dirent.h>
+#endif
 #include "opnmidi.h"
 #include "misc.h"
 #include "dev_setup.h"
@@ -72,6 +79,88 @@ static std::string findDefaultBank()
     return ret;
 }
 
+static bool hasExtension(const std::string &path, const char *ext)
+{
+    size_t extLen = std::strlen(ext);
+    if(path.size() <= extLen)
+        return false;
+
+    for(size_t i = 0; i < extLen; ++i)
+    {
+        if(std::tolower(static_cast<unsigned char>(path[path.size() - extLen + i])) != ext[i])
+            return false;
+    }
+
+    return true;
+}
+
+static bool isMusicFile(const std::string &path)
+{
+    const char *const exts[] =
+        {
+            ".mid", ".midi", ".kar", ".rmi", ".smf", ".xmi", ".mus"
+        };
+    const size_t exts_count = sizeof(exts) / sizeof(const char *);
+
+    for(size_t i = 0; i < exts_count; i++)
+    {
+        if(hasExtension(path, exts[i]))
+            return true;
+    }
+
+    return false;
+}
+
+static bool isDirectory(const std::string &path)
+{
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0)
+        return false;
+    return (st.st_mode & S_IFMT) == S_IFDIR;
+}
+
+/**
+ * @brief Add all music files of the directory, in alphabetical order
+ */
+static void addMusicDirectory(const std::string &dir, std::vector<std::string> &out)
+{
+    std::vector<std::string> found;
+    std::string prefix = dir;
+    if(!prefix.empty() && prefix[prefix.size() - 1] != '/' && prefix[prefix.size() - 1] != '\\')
+        prefix.push_back('/');
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE h = FindFirstFileA((prefix + "*").c_str(), &data);
+    if(h != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            std::string path = prefix + data.cFileName;
+            if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isMusicFile(path))
+                found.push_back(path);
+        } while(FindNextFileA(h, &data));
+        FindClose(h);
+    }
+#else
+    DIR *d = opendir(dir.c_str());
+    if(d)
+    {
+        struct dirent *e;
+        while((e = readdir(d)) != NULL)
+        {
+            std::string path = prefix + e->d_name;
+            if(isMusicFile(path) && !isDirectory(path))
+                found.push_back(path);
+        }
+        closedir(d);
+    }
+#endif
+
+    std::sort(found.begin(), found.end());
+    out.insert(out.end(), found.begin(), found.end());
+}
+
 static bool is_number(const std::string &s)
 {
     std::string::const_iterator it = s.begin();
@@ -92,6 +181,7 @@ Args::Args() :
     sampleRate(44100),
 #if !defined(OUTPUT_WAVE_ONLY)
     recordWave(false),
+    latencyMs(100),
 #endif
     scaleModulators(false),
     fullRangedBrightness(false),
@@ -99,11 +189,15 @@ Args::Args() :
     autoArpeggioEnabled(0),
     chanAlloc(OPNMIDI_ChanAlloc_AUTO),
     fullPanEnabled(false),
+    extraChannels(false),
+    dacDrums(false),
     emulator(OPNMIDI_EMU_MAME),
     volumeModel(OPNMIDI_VolumeModel_AUTO),
     soloTrack(~static_cast<size_t>(0u)),
     songNumLoad(-1),
-    chipsCount(-1)
+    chipsCount(-1),
+    chipGroups(1),
+    jobs(0)
 
 {
     spec.freq     = sampleRate;
@@ -124,9 +218,11 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             "Usage:\n"
             "   opnmidiplay [-s] [-w] [-nl] [--emu-mame|--emu-nuked|--emu-gens|--emu-gx|--emu-np2|--emu-mame-opna|--emu-pmdwin] \\\n"
             "               [--chips <count>] [<bankfile>.wopn] <midifilename>\n"
+            "   opnmidiplay -w [-j <count>] [<bankfile>.wopn] <midifilename|directory> ...\n"
             "\n"
             " <bankfile>.wopn   Path to WOPN bank file\n"
             " <midifilename>    Path to music file to play\n"
+            " <directory>       Directory of music files to record into WAV\n"
             "\n"
             " -s                Enables scaling of modulator volumes\n"
             " -vm <num> Chooses one of volume models: \n"
@@ -140,6 +236,7 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             "    0 Sounding delay"
             "    1 Released channel with the same instrument"
             "    2 Any released channel"
+            "    3 Sounding delay, steal notes which end soonest"
             " -frb              Enables full-ranged CC74 XG Brightness controller\n"
             " -mc <nums>        Mute selected MIDI channels"
             "                     where <num> - space separated numbers list (0-based!):"
@@ -150,6 +247,8 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             " -w                Write WAV file rather than playing\n"
 #endif
             " -fp               Enables full-panning stereo support\n"
+            " -ex               Use SSG and rhythm of OPNA chips as extra channels\n"
+            " -dd               Play drums by prerendered PCM samples\n"
             " -ea               Enable the auto-arpeggio\n"
             " --gain <value>    Set the gaining factor (default 2.0)\n"
 #ifndef OPNMIDI_DISABLE_MAME_EMULATOR
@@ -190,6 +289,14 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             " --emu-lle-f276    Use the very accurate Nuked LLE YMF276 [EXTRA HEAVY]\n"
 #endif
             " --chips <count>   Choose a count of emulated concurrent chips\n"
+            " --chip-groups <count> Split chips into groups rendered separately, MIDI ports\n"
+            "                   of multi-port songs are spread between groups\n"
+            " -j, --jobs <count> Count of files recorded into WAV at once, all CPU cores\n"
+            "                   are used by default\n"
+#if !defined(OUTPUT_WAVE_ONLY)
+            " --latency <ms>    Length of the audio rendered ahead of the output (default 100),\n"
+            "                   larger values prevent sound chopping at the cost of the lag\n"
+#endif
             "\n"
             );
         std::fflush(stdout);
@@ -264,6 +371,10 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             emulator = OPNMIDI_EMU_YMFM_OPNA;
         else if(!std::strcmp("-fp", argv[arg]))
             fullPanEnabled = true;
+        else if(!std::strcmp("-ex", argv[arg]))
+            extraChannels = true;
+        else if(!std::strcmp("-dd", argv[arg]))
+            dacDrums = true;
         else if(!std::strcmp("-s", argv[arg]))
             scaleModulators = true;
         else if(!std::strcmp("--gain", argv[arg]))
@@ -306,6 +417,40 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             }
             chipsCount = static_cast<int>(std::strtoul(argv[++arg], NULL, 10));
         }
+        else if(!std::strcmp("--chip-groups", argv[arg]))
+        {
+            if(arg + 1 >= argc)
+            {
+                printError("The option --chip-groups requires an argument!\n");
+                *quit = true;
+                return 1;
+            }
+            chipGroups = static_cast<int>(std::strtoul(argv[++arg], NULL, 10));
+        }
+        else if(!std::strcmp("-j", argv[arg]) || !std::strcmp("--jobs", argv[arg]))
+        {
+            if(arg + 1 >= argc)
+            {
+                printError("The option -j/--jobs requires an argument!\n");
+                *quit = true;
+                return 1;
+            }
+            jobs = static_cast<unsigned int>(std::strtoul(argv[++arg], NULL, 10));
+        }
+#if !defined(OUTPUT_WAVE_ONLY)
+        else if(!std::strcmp("--latency", argv[arg]))
+        {
+            if(arg + 1 >= argc)
+            {
+                printError("The option --latency requires an argument!\n");
+                *quit = true;
+                return 1;
+            }
+            latencyMs = static_cast<unsigned int>(std::strtoul(argv[++arg], NULL, 10));
+            if(latencyMs < 10)
+                latencyMs = 10;
+        }
+#endif
         else if(!std::strcmp("--solo", argv[arg]))
         {
             if(arg + 1 >= argc)
@@ -348,12 +493,18 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             break;
     }
 
-    if(arg == argc - 2)
+    if(arg > argc - 1)
     {
-        bankPath = argv[arg];
-        musPath = argv[arg + 1];
+        printError("Missing music file path!\n");
+        return 2;
     }
-    else if(arg == argc - 1)
+
+    // The first of several arguments is a bank when it has the .wopn extension,
+    // or when it's neither a music file nor a directory of them
+    if(arg < argc - 1 &&
+       (hasExtension(argv[arg], ".wopn") || (!isMusicFile(argv[arg]) && !isDirectory(argv[arg]))))
+        bankPath = argv[arg++];
+    else
     {
         std::fprintf(stdout, " - Bank is not specified, searching for default...\n");
         std::fflush(stdout);
@@ -363,14 +514,25 @@ int Args::parseArgs(int argc, char **argv_arr, bool *quit)
             printError("Missing default bank file xg.wopn!\n");
             return 2;
         }
-        musPath = argv[arg];
     }
-    else if(arg > argc - 1)
+
+    musPaths.clear();
+    for(; arg < argc; ++arg)
     {
-        printError("Missing music file path!\n");
+        if(isDirectory(argv[arg]))
+            addMusicDirectory(argv[arg], musPaths);
+        else
+            musPaths.push_back(argv[arg]);
+    }
+
+    if(musPaths.empty())
+    {
+        printError("No music files were found!\n");
         return 2;
     }
 
+    musPath = musPaths.front();
+
     *quit = false;
 
     return 0;
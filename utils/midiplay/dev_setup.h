@@ -44,6 +44,8 @@ struct Args
      */
 #if !defined(OUTPUT_WAVE_ONLY)
     bool recordWave;
+    //! Length of the audio queued ahead of the output, in milliseconds
+    unsigned int latencyMs;
 #endif
     bool scaleModulators;
     bool fullRangedBrightness;
@@ -51,16 +53,23 @@ struct Args
     int autoArpeggioEnabled;
     int chanAlloc;
     bool fullPanEnabled;
+    bool extraChannels;
+    bool dacDrums;
     int emulator;
     int volumeModel;
     size_t soloTrack;
     int songNumLoad;
     int chipsCount;
+    int chipGroups;
+    //! Count of files rendered into WAV at once, 0 to use all CPU cores
+    unsigned int jobs;
 
     std::vector<int> muteChannels;
 
     std::string bankPath;
     std::string musPath;
+    //! All music files given by the command line, directories are expanded
+    std::vector<std::string> musPaths;
 
     Args();
 
@@ -72,6 +72,8 @@ const char* chanalloc_to_str(int vm)
         return "Same instrument";
     case OPNMIDI_ChanAlloc_AnyReleased:
         return "Any released";
+    case OPNMIDI_ChanAlloc_LookAhead:
+        return "Look-ahead";
     }
 }
 
@@ -114,45 +116,31 @@ static void debugPrintEvent(void * /*userdata*/, OPN2_UInt8 type, OPN2_UInt8 sub
 #endif
 
 
-int main(int argc, char **argv)
+/**
+ * Create the device and apply all options given by the command line
+ */
+static OPN2_MIDIPlayer *createDevice()
 {
-    s_fprintf(stdout,
-                "==========================================\n"
-                "         libOPNMIDI demo utility\n"
-                "==========================================\n\n");
-    flushout(stdout);
-
-    bool doQuit = false;
-    int parseRet = s_devSetup.parseArgs(argc, argv, &doQuit);
-
-    if(doQuit)
-        return parseRet;
-
-    OPN2_MIDIPlayer *myDevice;
-
-    myDevice = opn2_init(s_devSetup.sampleRate);
+    OPN2_MIDIPlayer *myDevice = opn2_init(s_devSetup.sampleRate);
     if(myDevice == NULL)
     {
         std::fprintf(stderr, "Failed to init MIDI device!\n");
-        return 1;
+        return NULL;
     }
 
     //Set internal debug messages hook to print all libADLMIDI's internal debug messages
     opn2_setDebugMessageHook(myDevice, debugPrint, NULL);
 
-#if !defined(OUTPUT_WAVE_ONLY)
-    g_audioFormat.type = OPNMIDI_SampleType_S16;
-    g_audioFormat.containerSize = sizeof(int16_t);
-    g_audioFormat.sampleOffset = sizeof(int16_t) * 2;
-#endif
-
-    //Turn loop on/off (for WAV recording loop must be disabled!)
     if(s_devSetup.scaleModulators)
         opn2_setScaleModulators(myDevice, 1);//Turn on modulators scaling by volume
     if(s_devSetup.fullRangedBrightness)
         opn2_setFullRangeBrightness(myDevice, 1);//Turn on a full-ranged XG CC74 Brightness
     if(s_devSetup.fullPanEnabled)
         opn2_setSoftPanEnabled(myDevice, 1);
+    if(s_devSetup.extraChannels)
+        opn2_setOpnaExtraChannels(myDevice, 1);
+    if(s_devSetup.dacDrums)
+        opn2_setDacDrums(myDevice, 1);
 
 #ifndef OUTPUT_WAVE_ONLY
     //Turn loop on/off (for WAV recording loop must be disabled!)
@@ -174,34 +162,82 @@ int main(int argc, char **argv)
 
     if(opn2_switchEmulator(myDevice, s_devSetup.emulator) != 0)
     {
-        std::fprintf(stdout, "FAILED!\n");
-        std::fflush(stdout);
         printError(opn2_errorInfo(myDevice));
-        return 2;
+        opn2_close(myDevice);
+        return NULL;
     }
 
-    std::fprintf(stdout, " - Library version %s\n", opn2_linkedLibraryVersion());
-    std::fprintf(stdout, " - %s Emulator in use\n", opn2_chipEmulatorName(myDevice));
-
-    std::fprintf(stdout, " - Use bank [%s]...", s_devSetup.bankPath.c_str());
-    std::fflush(stdout);
     if(opn2_openBankFile(myDevice, s_devSetup.bankPath.c_str()) != 0)
     {
-        std::fprintf(stdout, "FAILED!\n");
-        std::fflush(stdout);
-        printError(opn2_errorInfo(myDevice));
-        return 2;
+        printError(opn2_errorInfo(myDevice), s_devSetup.bankPath.c_str());
+        opn2_close(myDevice);
+        return NULL;
     }
-    std::fprintf(stdout, "OK!\n");
+
+    opn2_setNumChips(myDevice, s_devSetup.chipsCount);
+    opn2_setChipGroups(myDevice, s_devSetup.chipGroups);
+
+    if(s_devSetup.volumeModel != OPNMIDI_VolumeModel_AUTO)
+        opn2_setVolumeRangeModel(myDevice, s_devSetup.volumeModel);
+
+    return myDevice;
+}
+
+
+int main(int argc, char **argv)
+{
+    s_fprintf(stdout,
+                "==========================================\n"
+                "         libOPNMIDI demo utility\n"
+                "==========================================\n\n");
+    flushout(stdout);
+
+    bool doQuit = false;
+    int parseRet = s_devSetup.parseArgs(argc, argv, &doQuit);
+
+    if(doQuit)
+        return parseRet;
+
+#if !defined(OUTPUT_WAVE_ONLY)
+    g_audioFormat.type = OPNMIDI_SampleType_S16;
+    g_audioFormat.containerSize = sizeof(int16_t);
+    g_audioFormat.sampleOffset = sizeof(int16_t) * 2;
+#endif
 
     if(s_devSetup.emulator == OPNMIDI_EMU_NUKED && (s_devSetup.chipsCount < 0))
         s_devSetup.chipsCount = 3;
     else if(s_devSetup.chipsCount < 0)
         s_devSetup.chipsCount = 8;
-    opn2_setNumChips(myDevice, s_devSetup.chipsCount);
 
-    if(s_devSetup.volumeModel != OPNMIDI_VolumeModel_AUTO)
-        opn2_setVolumeRangeModel(myDevice, s_devSetup.volumeModel);
+    OPN2_MIDIPlayer *myDevice = createDevice();
+    if(myDevice == NULL)
+        return 2;
+
+    std::fprintf(stdout, " - Library version %s\n", opn2_linkedLibraryVersion());
+    std::fprintf(stdout, " - %s Emulator in use\n", opn2_chipEmulatorName(myDevice));
+    std::fprintf(stdout, " - Use bank [%s]...OK!\n", s_devSetup.bankPath.c_str());
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+#ifndef _WIN32
+    signal(SIGHUP, sighandler);
+#endif
+
+    if(s_devSetup.musPaths.size() > 1)
+    {
+#ifndef OUTPUT_WAVE_ONLY
+        if(!s_devSetup.recordWave)
+        {
+            printError("Multiple music files can be only recorded into WAV files, use the -w option!\n");
+            opn2_close(myDevice);
+            return 1;
+        }
+#endif
+        // Every file will get its own device, this one was only needed to check the setup
+        opn2_close(myDevice);
+        return runWaveOutBatch(createDevice, s_devSetup.musPaths,
+                               s_devSetup.spec, s_devSetup.sampleRate, s_devSetup.jobs);
+    }
 
     if(opn2_openFile(myDevice, s_devSetup.musPath.c_str()) != 0)
     {
@@ -210,6 +246,8 @@ int main(int argc, char **argv)
     }
 
     std::fprintf(stdout, " - Number of chips %d\n", opn2_getNumChipsObtained(myDevice));
+    if(opn2_getChipGroups(myDevice) > 1)
+        std::fprintf(stdout, " - Chip groups: %d\n", opn2_getChipGroups(myDevice));
     std::fprintf(stdout, " - Track count: %lu\n", static_cast<unsigned long>(opn2_trackCount(myDevice)));
     std::fprintf(stdout, " - Volume model: %s\n", volume_model_to_str(opn2_getVolumeRangeModel(myDevice)));
     std::fprintf(stdout, " - Channel allocation mode: %s\n", chanalloc_to_str(opn2_getChannelAllocMode(myDevice)));
@@ -247,12 +285,6 @@ int main(int argc, char **argv)
     std::fprintf(stdout, " - File [%s] opened!\n", s_devSetup.musPath.c_str());
     std::fflush(stdout);
 
-    signal(SIGINT, sighandler);
-    signal(SIGTERM, sighandler);
-#ifndef _WIN32
-    signal(SIGHUP, sighandler);
-#endif
-
     s_timeCounter.setTotal(opn2_totalTimeLength(myDevice));
 
 #ifndef OUTPUT_WAVE_ONLY
@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include "../audio/audio.h"
 #include <string>
+#include <vector>
 
 
 
@@ -49,5 +50,13 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec);
 
 int runWaveOutLoopLoop(OPN2_MIDIPlayer *myDevice, const std::string &musPath, const AudioOutputSpec &obtained, unsigned sampleRate);
 
+/**
+ * Record every music file into its own WAV file, files are shared between
+ * the worker threads, and every file is played by a new device made by createDevice().
+ */
+int runWaveOutBatch(OPN2_MIDIPlayer *(*createDevice)(),
+                    const std::vector<std::string> &paths, const AudioOutputSpec &obtained,
+                    unsigned sampleRate, unsigned jobs);
+
 
 #endif /* MIDIPLAY_PLAYBACK_H */
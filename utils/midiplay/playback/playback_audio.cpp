@@ -23,13 +23,20 @@
  */
 
 #include <cstdio>
-#include <deque>
 #include <cstring>
+#include <vector>
+#include <stddef.h>
 #include "playback.h"
 #include "../dev_setup.h"
 #include "../time_counter.h"
 #include "../misc.h"
 
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <pthread.h>
+#endif
+
 
 class MutexType
 {
@@ -50,9 +57,186 @@ public:
     }
 };
 
-typedef std::deque<uint8_t> AudioBuff;
-static AudioBuff g_audioBuffer;
-static MutexType g_audioBuffer_lock;
+typedef void (*RenderThreadFunc)(void *arg);
+
+struct RenderThread
+{
+    RenderThreadFunc func;
+    void *arg;
+#ifdef _WIN32
+    HANDLE handle;
+
+    static DWORD WINAPI entry(LPVOID self)
+    {
+        RenderThread *t = static_cast<RenderThread *>(self);
+        t->func(t->arg);
+        return 0;
+    }
+
+    bool start(RenderThreadFunc f, void *a)
+    {
+        func = f;
+        arg = a;
+        handle = CreateThread(NULL, 0, &entry, this, 0, NULL);
+        return handle != NULL;
+    }
+
+    void join()
+    {
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+    }
+#else
+    pthread_t handle;
+
+    static void *entry(void *self)
+    {
+        RenderThread *t = static_cast<RenderThread *>(self);
+        t->func(t->arg);
+        return NULL;
+    }
+
+    bool start(RenderThreadFunc f, void *a)
+    {
+        func = f;
+        arg = a;
+        return pthread_create(&handle, NULL, &entry, this) == 0;
+    }
+
+    void join()
+    {
+        pthread_join(handle, NULL);
+    }
+#endif
+};
+
+static inline size_t ringLoad(const volatile size_t *p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(_WIN32)
+    size_t v = *p;
+    MemoryBarrier();
+    return v;
+#else
+    return *p;
+#endif
+}
+
+static inline void ringStore(volatile size_t *p, size_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#elif defined(_WIN32)
+    MemoryBarrier();
+    *p = v;
+#else
+    *p = v;
+#endif
+}
+
+/**
+ * @brief Fixed-size queue of rendered bytes between the render thread and the audio callback
+ *
+ * There is one writer and one reader, and each of them moves only its own
+ * position, so, none of them ever waits for another. Positions are counted
+ * in bytes from the start and wrap around the buffer size.
+ */
+class AudioRing
+{
+    std::vector<uint8_t> m_buf;
+    //! Position of the writer, moved by the render thread
+    volatile size_t m_tail;
+    //! Position of the reader, moved by the audio callback
+    volatile size_t m_head;
+    //! Everything before this position is stale and gets skipped by the reader
+    volatile size_t m_dropUntil;
+
+public:
+    AudioRing() : m_tail(0), m_head(0), m_dropUntil(0) {}
+
+    //! Sets the size and clears, none of threads may use the queue at this moment
+    void reset(size_t capacity)
+    {
+        m_buf.assign(capacity, 0);
+        m_tail = 0;
+        m_head = 0;
+        m_dropUntil = 0;
+    }
+
+    size_t queued() const
+    {
+        return ringLoad(&m_tail) - ringLoad(&m_head);
+    }
+
+    size_t space() const
+    {
+        return m_buf.size() - queued();
+    }
+
+    //! Writer: appends the bytes, they must fit into the space()
+    void write(const uint8_t *data, size_t len)
+    {
+        const size_t tail = m_tail;
+        const size_t at = tail % m_buf.size();
+        const size_t first = len < m_buf.size() - at ? len : m_buf.size() - at;
+        std::memcpy(&m_buf[at], data, first);
+        std::memcpy(&m_buf[0], data + first, len - first);
+        ringStore(&m_tail, tail + len);
+    }
+
+    /**
+     * @brief Writer: makes the reader skip everything written so far
+     *
+     * The writer must not write at this moment, so, it's called while the render thread is locked out.
+     */
+    void dropQueued()
+    {
+        ringStore(&m_dropUntil, ringLoad(&m_tail));
+    }
+
+    //! Reader: takes up to the given count of bytes, returns the count taken
+    size_t read(uint8_t *out, size_t len)
+    {
+        size_t head = m_head;
+        const size_t tail = ringLoad(&m_tail);
+        const size_t drop = ringLoad(&m_dropUntil);
+
+        if(drop - head <= tail - head) // The drop position is still ahead
+            head = drop;
+
+        size_t got = tail - head;
+        if(got > len)
+            got = len;
+
+        const size_t at = head % m_buf.size();
+        const size_t first = got < m_buf.size() - at ? got : m_buf.size() - at;
+        std::memcpy(out, &m_buf[at], first);
+        std::memcpy(out + first, &m_buf[0], got - first);
+        ringStore(&m_head, head + got);
+        return got;
+    }
+};
+
+//! Held by the render thread while it renders, and by the main thread while it changes the playback
+static MutexType g_renderLock;
+
+//! Instance of the library played by the render thread
+static OPN2_MIDIPlayer *s_device = NULL;
+//! Audio is rendered ahead by the library's own thread, otherwise, by the render thread of the player
+static bool s_renderAhead = false;
+//! Audio rendered by the render thread of the player and waiting for the audio callback
+static AudioRing s_ring;
+//! Render thread of the player, used when the library has no render-ahead support
+static RenderThread s_renderThread;
+//! Count of bytes rendered by one step of the render thread
+static size_t s_renderChunk = 0;
+//! Tells the render thread to quit
+static volatile int s_renderStop = 0;
+//! The song has ended, nothing gets rendered anymore
+static volatile int s_renderEnded = 0;
+//! Count of audio callbacks that didn't get enough data
+static volatile unsigned s_underruns = 0;
 
 //#define DEBUG_SONG_CHANGE
 //#define DEBUG_SONG_CHANGE_BY_HOOK
@@ -76,58 +260,111 @@ static void loopEndCallback(void *)
 #endif
 
 
+static void s_renderThreadFunc(void *)
+{
+    const size_t frameSize = g_audioFormat.containerSize * 2;
+    std::vector<uint8_t> chunk(s_renderChunk);
+
+    while(!s_renderStop)
+    {
+        size_t want = s_ring.space();
+        if(want > chunk.size())
+            want = chunk.size();
+        want -= want % frameSize;
+
+        if(s_renderEnded || want == 0)
+        {
+            audio_delay(1);
+            continue;
+        }
+
+        g_renderLock.Lock();
+        size_t got = (size_t)opn2_playFormat(s_device, static_cast<int>(want / g_audioFormat.containerSize),
+                                             &chunk[0],
+                                             &chunk[0] + g_audioFormat.containerSize,
+                                             &g_audioFormat) * g_audioFormat.containerSize;
+        s_ring.write(&chunk[0], got);
+        if(got < want) // Rendered less only at the song end
+            s_renderEnded = 1;
+        g_renderLock.Unlock();
+    }
+}
+
+#if defined(DEBUG_SONG_SWITCHING) || defined(DEBUG_SEEKING_TEST) || \
+    defined(DEBUG_SONG_CHANGE) || defined(DEBUG_SONG_CHANGE_BY_HOOK)
+/**
+ * @brief Locks out the render thread before the change of the playback position
+ */
+static void transportBegin()
+{
+    g_renderLock.Lock();
+}
+
+/**
+ * @brief Lets the render thread go on from the new position, everything rendered before gets dropped
+ */
+static void transportEnd()
+{
+    if(!s_renderAhead)
+    {
+        s_ring.dropQueued();
+        s_renderEnded = 0;
+    }
+    g_renderLock.Unlock();
+}
+#endif
+
 static void s_audioPlaybackCallback(void *, uint8_t *stream, int len)
 {
-    unsigned ate = static_cast<unsigned>(len); // number of bytes
+    size_t want = static_cast<size_t>(len); // number of bytes
+    size_t got;
+    int samples = static_cast<int>(want / g_audioFormat.containerSize);
 
-    audio_lock();
-    //short *target = (short *) stream;
-    g_audioBuffer_lock.Lock();
+    if(s_renderAhead)
+    {
+        // Never waits: takes what the render thread has queued
+        got = (size_t)opn2_readRendered(s_device, samples,
+                                        stream,
+                                        stream + g_audioFormat.containerSize) * g_audioFormat.containerSize;
+        if(got < want && !opn2_renderAheadAtEnd(s_device))
+            s_underruns = s_underruns + 1;
+    }
+    else
+    {
+        // Never waits as well: takes what the render thread of the player has queued
+        got = s_ring.read(stream, want);
+        if(got < want && !s_renderEnded)
+            s_underruns = s_underruns + 1;
+    }
 
-    if(g_audioBuffer.empty()) // Just in a case, if queue is blank, just zero the output
+    if(got < want) // Queue has ran out, fill the rest with silence
     {
+        uint8_t *tail = stream + got;
+        size_t tailLen = want - got;
+
         switch(g_audioFormat.type)
         {
         case OPNMIDI_SampleType_S8:
-            std::memset(stream, 0x7f, len);
+            std::memset(tail, 0x7f, tailLen);
             break;
         case OPNMIDI_SampleType_U16:
-            for(size_t i = 0; i < (size_t)len; i += 2)
-                *(uint32_t*)(stream + i) = 0x7FFF;
+            for(size_t i = 0; i + 1 < tailLen; i += 2)
+                *(uint16_t*)(tail + i) = 0x7FFF;
             break;
         default:
-            std::memset(stream, 0, len);
+            std::memset(tail, 0, tailLen);
         }
     }
 
-    if(ate > g_audioBuffer.size())
-        ate = (unsigned)g_audioBuffer.size();
-
-    for(unsigned a = 0; a < ate; ++a)
-        stream[a] = g_audioBuffer[a];
-
-    applyGain(stream, len);
-
-    g_audioBuffer.erase(g_audioBuffer.begin(), g_audioBuffer.begin() + ate);
-    g_audioBuffer_lock.Unlock();
-    audio_unlock();
+    applyGain(stream, want);
 }
 
 
 int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
 {
-    //const unsigned MaxSamplesAtTime = 512; // 512=dbopl limitation
-    // How long is SDL buffer, in seconds?
-    // The smaller the value, the more often SDL_AudioCallBack()
-    // is called.
-    //const double AudioBufferLength = 0.08;
-
-    // How much do WE buffer, in seconds? The smaller the value,
-    // the more prone to sound chopping we are.
-    const double OurHeadRoomLength = 0.1;
-    // The lag between visual content and audio content equals
-    // the sum of these two buffers.
-
+    // How much do WE buffer (the --latency option)? The smaller the value,
+    // the more prone to sound chopping we are. The lag between visual
+    // content and audio content equals the sum of it and the device buffer.
     AudioOutputSpec obtained;
 
     // Set up Audio Output
@@ -147,6 +384,44 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
 
     fillAudioFormat(obtained);
 
+    const size_t latencyFrames = static_cast<size_t>(obtained.freq) * s_devSetup.latencyMs / 1000;
+    s_device = myDevice;
+    s_renderEnded = 0;
+    s_underruns = 0;
+
+    // The render thread of the library keeps the queue filled, transport calls drop
+    // everything queued before them. Without the render-ahead support in the library,
+    // the player runs the same kind of the thread by itself, the audio callback never renders.
+    s_renderAhead = opn2_startRenderAhead(myDevice, static_cast<int>((obtained.samples + latencyFrames) * 2), &g_audioFormat) == 0;
+
+    if(!s_renderAhead)
+    {
+        const size_t frameSize = g_audioFormat.containerSize * 2;
+        s_ring.reset((obtained.samples + latencyFrames) * frameSize);
+        s_renderChunk = obtained.samples * frameSize;
+        s_renderStop = 0;
+        if(!s_renderThread.start(&s_renderThreadFunc, NULL))
+        {
+            s_fprintf(stdout, "\nERROR: Couldn't start the render thread\n\n");
+            audio_close();
+            return 1;
+        }
+    }
+
+    // Fill the queue before start to don't begin with an underrun
+    if(s_renderAhead)
+    {
+        while(!stop && !opn2_renderAheadAtEnd(myDevice) &&
+              static_cast<size_t>(opn2_renderedQueued(myDevice)) < latencyFrames * 2)
+            audio_delay(1);
+    }
+    else
+    {
+        while(!stop && !s_renderEnded &&
+              s_ring.queued() < latencyFrames * g_audioFormat.containerSize * 2)
+            audio_delay(1);
+    }
+
 #if defined(DEBUG_SONG_SWITCHING)
     int songsCount = opn2_getSongsCount(myDevice);
 #endif
@@ -175,8 +450,7 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
     scrollok(stdscr, TRUE);
 #endif
 
-    size_t got;
-    uint8_t buff[4096];
+    unsigned underrunsReported = 0;
 
     audio_start();
 
@@ -186,14 +460,16 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
 
     while(!stop)
     {
-        got = (size_t)opn2_playFormat(myDevice, 1024,
-                                      buff,
-                                      buff + g_audioFormat.containerSize,
-                                      &g_audioFormat) * g_audioFormat.containerSize;
-        if(got <= 0)
+        if(s_renderAhead ? opn2_renderAheadAtEnd(myDevice) : (s_renderEnded && s_ring.queued() == 0))
             break;
 
+        // Console output happens outside of the lock to never hold the render thread
+        g_renderLock.Lock();
+        const double position = opn2_positionTell(myDevice);
+        g_renderLock.Unlock();
+
 #   ifdef DEBUG_TRACE_ALL_CHANNELS
+        (void)position;
         enum { TerminalColumns = 80 };
         char channelText[TerminalColumns + 1];
         char channelAttr[TerminalColumns + 1];
@@ -203,27 +479,15 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
 #   endif
 
 #   ifndef DEBUG_TRACE_ALL_EVENTS
-        s_timeCounter.printTime(opn2_positionTell(myDevice));
+        s_timeCounter.printTime(position);
 #   endif
 
-        g_audioBuffer_lock.Lock();
-#if defined(__GNUC__) && (__GNUC__ == 15) && (__GNUC_MINOR__ == 1)
-        // Workaround for GCC 15.1.0 on faulty std::deque's resize() call when C++11 is set
-        // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=120931
-        for(size_t p = 0; p < got; ++p)
-            g_audioBuffer.push_back(buff[p]);
-#else
-        size_t pos = g_audioBuffer.size();
-        g_audioBuffer.resize(pos + got);
-        for(size_t p = 0; p < got; ++p)
-            g_audioBuffer[pos + p] = buff[p];
-#endif
-        g_audioBuffer_lock.Unlock();
-
-        const AudioOutputSpec &spec = obtained;
-        while(!stop && (g_audioBuffer.size() > static_cast<size_t>(spec.samples + (spec.freq * g_audioFormat.sampleOffset) * OurHeadRoomLength)))
+        if(s_underruns != underrunsReported)
         {
-            audio_delay(1);
+            underrunsReported = s_underruns;
+            s_timeCounter.clearLineR();
+            s_fprintf(stdout, " - Audio underrun (%u in total), consider a larger --latency\n", underrunsReported);
+            flushout(stdout);
         }
 
 #       if defined(DEBUG_SONG_SWITCHING) || defined(ENABLE_TERMINAL_HOTKEYS)
@@ -242,7 +506,9 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
                     s_devSetup.songNumLoad++;
                     if(s_devSetup.songNumLoad >= songsCount)
                         s_devSetup.songNumLoad = songsCount;
+                    transportBegin();
                     opn2_selectSongNum(myDevice, s_devSetup.songNumLoad);
+                    transportEnd();
                     s_fprintf(stdout, "\rSwitching song to %d/%d...                               \r\n", s_devSetup.songNumLoad, songsCount);
                     flushout(stdout);
                     break;
@@ -251,7 +517,9 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
                     s_devSetup.songNumLoad--;
                     if(s_devSetup.songNumLoad < 0)
                         s_devSetup.songNumLoad = 0;
+                    transportBegin();
                     opn2_selectSongNum(myDevice, s_devSetup.songNumLoad);
+                    transportEnd();
                     s_fprintf(stdout, "\rSwitching song to %d/%d...                               \r\n", s_devSetup.songNumLoad, songsCount);
                     flushout(stdout);
                     break;
@@ -275,7 +543,9 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
         {
             delayBeforeSeek = rand() % 50;
             double seekTo = double((rand() % int(opn2_totalTimeLength(myDevice)) - delayBeforeSeek - 1 ));
+            transportBegin();
             opn2_positionSeek(myDevice, seekTo);
+            transportEnd();
         }
 #       endif
 
@@ -283,7 +553,9 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
         if(delayBeforeSongChange-- <= 0)
         {
             delayBeforeSongChange = rand() % 100;
+            transportBegin();
             opn2_selectSongNum(myDevice, rand() % 10);
+            transportEnd();
         }
 #       endif
 
@@ -291,9 +563,13 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
         if(gotXmiTrigger)
         {
             gotXmiTrigger = false;
+            transportBegin();
             opn2_selectSongNum(myDevice, (rand() % 10) + 1);
+            transportEnd();
         }
 #       endif
+
+        audio_delay(10);
     }
 
     setCursorVisibility(true);
@@ -301,7 +577,22 @@ int runAudioLoop(OPN2_MIDIPlayer *myDevice, AudioOutputSpec &spec)
     s_timeCounter.clearLine();
 
     audio_stop();
+
+    if(s_renderAhead)
+        opn2_stopRenderAhead(myDevice);
+    else
+    {
+        s_renderStop = 1;
+        s_renderThread.join();
+    }
+
     audio_close();
 
+    if(s_underruns > 0)
+    {
+        s_fprintf(stdout, " - Audio underruns in total: %u\n", static_cast<unsigned>(s_underruns));
+        flushout(stdout);
+    }
+
     return 0;
 }
@@ -23,6 +23,7 @@
  */
 
 #include <cstdio>
+#include <vector>
 
 #include "playback.h"
 #include "../dev_setup.h"
@@ -30,6 +31,305 @@
 #include "../time_counter.h"
 #include "wave_writer.h"
 
+#if !defined(__DJGPP__) && !defined(ADLMIDI_ENABLE_HW_DOS)
+#   define WAVE_RENDER_THREADS
+#   ifdef _WIN32
+#       include <windows.h>
+#   else
+#       include <pthread.h>
+#       include <unistd.h>
+#   endif
+#endif
+
+
+#ifdef WAVE_RENDER_THREADS
+class WaveMutex
+{
+    friend class WaveCond;
+#   ifdef _WIN32
+    CRITICAL_SECTION m;
+#   else
+    pthread_mutex_t m;
+#   endif
+public:
+#   ifdef _WIN32
+    WaveMutex() { InitializeCriticalSection(&m); }
+    ~WaveMutex() { DeleteCriticalSection(&m); }
+    void Lock() { EnterCriticalSection(&m); }
+    void Unlock() { LeaveCriticalSection(&m); }
+#   else
+    WaveMutex() { pthread_mutex_init(&m, NULL); }
+    ~WaveMutex() { pthread_mutex_destroy(&m); }
+    void Lock() { pthread_mutex_lock(&m); }
+    void Unlock() { pthread_mutex_unlock(&m); }
+#   endif
+};
+
+class WaveCond
+{
+#   ifdef _WIN32
+    CONDITION_VARIABLE c;
+#   else
+    pthread_cond_t c;
+#   endif
+public:
+#   ifdef _WIN32
+    WaveCond() { InitializeConditionVariable(&c); }
+    ~WaveCond() {}
+    void Wait(WaveMutex &mut) { SleepConditionVariableCS(&c, &mut.m, INFINITE); }
+    void Signal() { WakeConditionVariable(&c); }
+    void Broadcast() { WakeAllConditionVariable(&c); }
+#   else
+    WaveCond() { pthread_cond_init(&c, NULL); }
+    ~WaveCond() { pthread_cond_destroy(&c); }
+    void Wait(WaveMutex &mut) { pthread_cond_wait(&c, &mut.m); }
+    void Signal() { pthread_cond_signal(&c); }
+    void Broadcast() { pthread_cond_broadcast(&c); }
+#   endif
+};
+
+typedef void (*WaveThreadFunc)(void *arg);
+
+struct WaveThread
+{
+    WaveThreadFunc func;
+    void *arg;
+#   ifdef _WIN32
+    HANDLE handle;
+
+    static DWORD WINAPI entry(LPVOID self)
+    {
+        WaveThread *t = static_cast<WaveThread *>(self);
+        t->func(t->arg);
+        return 0;
+    }
+
+    bool start(WaveThreadFunc f, void *a)
+    {
+        func = f;
+        arg = a;
+        handle = CreateThread(NULL, 0, &entry, this, 0, NULL);
+        return handle != NULL;
+    }
+
+    void join()
+    {
+        WaitForSingleObject(handle, INFINITE);
+        CloseHandle(handle);
+    }
+#   else
+    pthread_t handle;
+
+    static void *entry(void *self)
+    {
+        WaveThread *t = static_cast<WaveThread *>(self);
+        t->func(t->arg);
+        return NULL;
+    }
+
+    bool start(WaveThreadFunc f, void *a)
+    {
+        func = f;
+        arg = a;
+        return pthread_create(&handle, NULL, &entry, this) == 0;
+    }
+
+    void join()
+    {
+        pthread_join(handle, NULL);
+    }
+#   endif
+};
+
+static unsigned cpuCoresCount()
+{
+#   ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? static_cast<unsigned>(info.dwNumberOfProcessors) : 1;
+#   else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<unsigned>(n) : 1;
+#   endif
+}
+#endif // WAVE_RENDER_THREADS
+
+
+/**
+ * @brief Double-buffered WAV writer
+ *
+ * One buffer is filled by the renderer while another one is written into
+ * the file by the writer thread, so, disk writes never stall the rendering.
+ * Without threads support the buffer is written right at the submit.
+ */
+class WaveDoubleWriter
+{
+    void *m_ctx;
+    std::vector<uint8_t> m_buffers[2];
+    size_t m_lengths[2];
+    //! Buffer being filled by the renderer
+    int m_current;
+#ifdef WAVE_RENDER_THREADS
+    //! Buffer waiting for the writer thread or being written, -1 if none
+    int m_pending;
+    bool m_quit;
+    bool m_threaded;
+    WaveMutex m_lock;
+    WaveCond m_hasJob;
+    WaveCond m_jobDone;
+    WaveThread m_thread;
+
+    static void writerThread(void *arg)
+    {
+        static_cast<WaveDoubleWriter *>(arg)->runWriter();
+    }
+
+    void runWriter()
+    {
+        m_lock.Lock();
+        for(;;)
+        {
+            while(m_pending < 0 && !m_quit)
+                m_hasJob.Wait(m_lock);
+
+            if(m_pending < 0) // Quit only when everything got written
+                break;
+
+            int buf = m_pending;
+            m_lock.Unlock();
+
+            ctx_wave_write(m_ctx, &m_buffers[buf][0], static_cast<long>(m_lengths[buf]));
+
+            m_lock.Lock();
+            m_pending = -1;
+            m_jobDone.Signal();
+        }
+        m_lock.Unlock();
+    }
+#endif
+
+public:
+    WaveDoubleWriter(void *ctx, size_t bufferSize) :
+        m_ctx(ctx),
+        m_current(0)
+#ifdef WAVE_RENDER_THREADS
+        , m_pending(-1),
+        m_quit(false),
+        m_threaded(false)
+#endif
+    {
+        m_buffers[0].resize(bufferSize);
+        m_buffers[1].resize(bufferSize);
+        m_lengths[0] = 0;
+        m_lengths[1] = 0;
+#ifdef WAVE_RENDER_THREADS
+        m_threaded = m_thread.start(&writerThread, this);
+#endif
+    }
+
+    ~WaveDoubleWriter()
+    {
+        finish();
+    }
+
+    /**
+     * @brief Buffer to fill by the next portion of audio
+     */
+    uint8_t *buffer()
+    {
+        return &m_buffers[m_current][0];
+    }
+
+    /**
+     * @brief Pass the filled buffer to the writer and switch to another one
+     * @param len Count of bytes to write
+     */
+    void submit(size_t len)
+    {
+        m_lengths[m_current] = len;
+
+#ifdef WAVE_RENDER_THREADS
+        if(m_threaded)
+        {
+            m_lock.Lock();
+            while(m_pending >= 0)
+                m_jobDone.Wait(m_lock);
+            m_pending = m_current;
+            m_hasJob.Signal();
+            m_lock.Unlock();
+            // The previous write is done, so, another buffer is free
+            m_current ^= 1;
+            return;
+        }
+#endif
+
+        ctx_wave_write(m_ctx, &m_buffers[m_current][0], static_cast<long>(len));
+    }
+
+    /**
+     * @brief Write everything submitted and stop the writer thread
+     */
+    void finish()
+    {
+#ifdef WAVE_RENDER_THREADS
+        if(!m_threaded)
+            return;
+        m_lock.Lock();
+        m_quit = true;
+        m_hasJob.Signal();
+        m_lock.Unlock();
+        m_thread.join();
+        m_threaded = false;
+#endif
+    }
+};
+
+
+static void *openWaveFile(const std::string &wave_out, const AudioOutputSpec &obtained, unsigned sampleRate)
+{
+    int wav_format = obtained.format == OPNMIDI_SampleType_F32 ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
+    int wav_has_sign = obtained.format != OPNMIDI_SampleType_U8 && obtained.format != OPNMIDI_SampleType_U16;
+
+    return ctx_wave_open(obtained.channels,
+                         static_cast<long>(sampleRate),
+                         g_audioFormat.containerSize,
+                         wav_format,
+                         wav_has_sign,
+                         (int)obtained.is_msb,
+                         wave_out.c_str()
+                         );
+}
+
+/**
+ * @brief Render the whole opened song into the WAV file
+ * @param showProgress Print the progress line while rendering
+ */
+static void renderWave(OPN2_MIDIPlayer *myDevice, void *wav_ctx, bool showProgress)
+{
+    const int samplesAtTime = 4096;
+    WaveDoubleWriter writer(wav_ctx, samplesAtTime * g_audioFormat.containerSize);
+
+    while(!stop)
+    {
+        uint8_t *buff = writer.buffer();
+        size_t got = (size_t)opn2_playFormat(myDevice, samplesAtTime,
+                                             buff,
+                                             buff + g_audioFormat.containerSize,
+                                             &g_audioFormat) * g_audioFormat.containerSize;
+        if(got <= 0)
+            break;
+
+        applyGain(buff, got);
+
+        writer.submit(got);
+
+        if(showProgress)
+            s_timeCounter.printProgress(opn2_positionTell(myDevice));
+    }
+
+    writer.finish();
+}
+
 
 int runWaveOutLoopLoop(OPN2_MIDIPlayer *myDevice, const std::string &musPath, const AudioOutputSpec &obtained, unsigned sampleRate)
 {
@@ -40,43 +340,17 @@ int runWaveOutLoopLoop(OPN2_MIDIPlayer *myDevice, const std::string &musPath, co
     s_fprintf(stdout, " - Output WAV spec (format=%s,samples=%d,rate=%u,channels=%u);\n",
               audio_format_to_str(obtained.format, obtained.is_msb), obtained.samples, obtained.freq, obtained.channels);
 
-    int wav_format = obtained.format == OPNMIDI_SampleType_F32 ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM;
-    int wav_has_sign = obtained.format != OPNMIDI_SampleType_U8 && obtained.format != OPNMIDI_SampleType_U16;
-
-    void *wav_ctx = ctx_wave_open(obtained.channels,
-                                  static_cast<long>(sampleRate),
-                                  g_audioFormat.containerSize,
-                                  wav_format,
-                                  wav_has_sign,
-                                  (int)obtained.is_msb,
-                                  wave_out.c_str()
-                                  );
+    void *wav_ctx = openWaveFile(wave_out, obtained, sampleRate);
 
     if(wav_ctx)
     {
-        uint8_t buff[16384];
-
         s_fprintf(stdout, " - Recording WAV file %s...\n", wave_out.c_str());
         s_fprintf(stdout, "\n==========================================\n");
         flushout(stdout);
 
         setCursorVisibility(false);
 
-        while(!stop)
-        {
-            size_t got = (size_t)opn2_playFormat(myDevice, 4096,
-                                                 buff,
-                                                 buff + g_audioFormat.containerSize,
-                                                 &g_audioFormat) * g_audioFormat.containerSize;
-            if(got <= 0)
-                break;
-
-            applyGain(buff, got);
-
-            ctx_wave_write(wav_ctx, buff, static_cast<long>(got));
-
-            s_timeCounter.printProgress(opn2_positionTell(myDevice));
-        }
+        renderWave(myDevice, wav_ctx, true);
 
         setCursorVisibility(true);
 
@@ -97,3 +371,190 @@ int runWaveOutLoopLoop(OPN2_MIDIPlayer *myDevice, const std::string &musPath, co
 
     return 0;
 }
+
+
+struct WaveBatch
+{
+    const std::vector<std::string> *paths;
+    const AudioOutputSpec *obtained;
+    unsigned sampleRate;
+    OPN2_MIDIPlayer *(*createDevice)();
+    //! Index of the next file to take
+    size_t next;
+    //! Count of files finished, successfully or not
+    size_t done;
+    size_t failed;
+#ifdef WAVE_RENDER_THREADS
+    WaveMutex lock;
+#endif
+
+    bool take(size_t &index)
+    {
+        bool ret = false;
+#ifdef WAVE_RENDER_THREADS
+        lock.Lock();
+#endif
+        if(!stop && next < paths->size())
+        {
+            index = next++;
+            ret = true;
+        }
+#ifdef WAVE_RENDER_THREADS
+        lock.Unlock();
+#endif
+        return ret;
+    }
+
+    void report(const std::string &path, const char *error)
+    {
+#ifdef WAVE_RENDER_THREADS
+        lock.Lock();
+#endif
+        ++done;
+        if(error)
+        {
+            ++failed;
+            s_fprintf(stdout, " - [%u/%u] %s: FAILED (%s)\n",
+                      (unsigned)done, (unsigned)paths->size(), path.c_str(), error);
+        }
+        else
+        {
+            s_fprintf(stdout, " - [%u/%u] %s.wav%s\n",
+                      (unsigned)done, (unsigned)paths->size(), path.c_str(), stop ? " (incomplete)" : "");
+        }
+        flushout(stdout);
+#ifdef WAVE_RENDER_THREADS
+        lock.Unlock();
+#endif
+    }
+
+    /**
+     * @brief Make a device and open the music file by it
+     * @return NULL on failure, already reported
+     */
+    OPN2_MIDIPlayer *openSong(const std::string &path)
+    {
+        OPN2_MIDIPlayer *device = createDevice();
+        const char *error = NULL;
+
+        if(!device)
+            error = "can't make the device";
+        else if(opn2_openFile(device, path.c_str()) != 0)
+        {
+            report(path, opn2_errorInfo(device));
+            opn2_close(device);
+            device = NULL;
+        }
+        else
+        {
+            if(s_devSetup.soloTrack != ~static_cast<size_t>(0u))
+                opn2_setTrackOptions(device, s_devSetup.soloTrack, OPNMIDI_TrackOption_Solo);
+
+            for(size_t i = 0; i < s_devSetup.muteChannels.size(); ++i)
+                opn2_setChannelEnabled(device, s_devSetup.muteChannels[i], 0);
+        }
+
+        if(error)
+            report(path, error);
+
+        return device;
+    }
+};
+
+static void runWaveBatchWorker(void *arg)
+{
+    WaveBatch *batch = static_cast<WaveBatch *>(arg);
+    size_t index;
+
+    while(batch->take(index))
+    {
+        const std::string &path = (*batch->paths)[index];
+
+        // Every file gets a new device: the state of chips left from the previous song
+        // would change the output, so it would depend on the order the files were taken
+        OPN2_MIDIPlayer *device = batch->openSong(path);
+        if(!device)
+            continue;
+
+        void *wav_ctx = openWaveFile(path + ".wav", *batch->obtained, batch->sampleRate);
+        if(!wav_ctx)
+        {
+            batch->report(path, "can't open the WAV file");
+            opn2_close(device);
+            continue;
+        }
+
+        renderWave(device, wav_ctx, false);
+        ctx_wave_close(wav_ctx);
+        opn2_close(device);
+        batch->report(path, NULL);
+    }
+}
+
+int runWaveOutBatch(OPN2_MIDIPlayer *(*createDevice)(),
+                    const std::vector<std::string> &paths, const AudioOutputSpec &obtained,
+                    unsigned sampleRate, unsigned jobs)
+{
+    fillAudioFormat(obtained);
+
+#ifdef WAVE_RENDER_THREADS
+    if(jobs == 0)
+        jobs = cpuCoresCount();
+#else
+    jobs = 1;
+#endif
+    if(jobs > paths.size())
+        jobs = static_cast<unsigned>(paths.size());
+    if(jobs == 0)
+        jobs = 1;
+
+    s_fprintf(stdout, " - Output WAV spec (format=%s,samples=%d,rate=%u,channels=%u);\n",
+              audio_format_to_str(obtained.format, obtained.is_msb), obtained.samples, obtained.freq, obtained.channels);
+
+    WaveBatch batch;
+    batch.paths = &paths;
+    batch.obtained = &obtained;
+    batch.sampleRate = sampleRate;
+    batch.createDevice = createDevice;
+    batch.next = 0;
+    batch.done = 0;
+    batch.failed = 0;
+
+    // The calling thread is one of workers
+    size_t started = 1;
+#ifdef WAVE_RENDER_THREADS
+    // Emulators build their shared tables when the first chip gets made,
+    // make one device before workers start, they only read those tables then
+    OPN2_MIDIPlayer *first = createDevice();
+    if(first)
+        opn2_close(first);
+
+    std::vector<WaveThread> threads(jobs - 1);
+    for(; started < jobs; ++started)
+    {
+        if(!threads[started - 1].start(&runWaveBatchWorker, &batch))
+            break;
+    }
+#endif
+
+    s_fprintf(stdout, " - Recording %u WAV files by %u job(s)...\n", (unsigned)paths.size(), (unsigned)started);
+    s_fprintf(stdout, "\n==========================================\n");
+    flushout(stdout);
+
+    runWaveBatchWorker(&batch);
+
+#ifdef WAVE_RENDER_THREADS
+    for(size_t i = 1; i < started; ++i)
+        threads[i - 1].join();
+#endif
+
+    if(stop)
+        s_fprintf(stdout, "Interrupted! Recorded WAV files are incomplete, but playable!\n");
+    else if(batch.failed > 0)
+        s_fprintf(stdout, "Completed, %u of %u files have failed!\n", (unsigned)batch.failed, (unsigned)paths.size());
+    else
+        s_fprintf(stdout, "Completed!\n");
+    flushout(stdout);
+
+    return batch.failed > 0 ? 1 : 0;
+}